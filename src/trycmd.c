@@ -15,6 +15,12 @@
 
 /* Application entry point. */
 int main(int argc, char* argv[]) {
+    int result;
+
+    /* Have a resident daemon run the command, if there is one. */
+    if (trycmd_daemon_call(argc, argv, &result) == 0) {
+        return result;
+    }
     return trycmd_main(argc, argv);
 }
 
@@ -13,7 +13,13 @@
  */
 
 #include <stddef.h>  /* size_t. */
+#include <stdint.h>  /* uint64_t. */
+#include <signal.h>  /* sigset_t. */
 #include <stdio.h>   /* FILE. */
+#include <sys/resource.h>  /* struct rusage. */
+#include <sys/types.h>  /* off_t, pid_t, ssize_t. */
+#include <sys/uio.h>    /* struct iovec. */
+#include <time.h>       /* struct timespec. */
 
 /**
  * Constant added to the exit status if a subcommand fails with a signal.
@@ -22,207 +28,2069 @@
  */
 #define TRYCMD_SIGNAL_BASE (128)
 
+/**
+ * Exit status used if a subcommand could not be found.
+ * This matches the behaviour of Bash.
+ */
+#define TRYCMD_STATUS_NOT_FOUND (127)
+
+/**
+ * Exit status used if a subcommand was found but could not be executed.
+ * This matches the behaviour of Bash.
+ */
+#define TRYCMD_STATUS_NOT_EXECUTABLE (126)
+
+/**
+ * The number of lines of output shown upon failure by '\-\-tail', if no
+ * other is given.
+ */
+#define TRYCMD_TAIL_LINES (20)
+
+/**
+ * The least size of the ring buffer kept by '\-\-tail' for a number of
+ * lines.
+ */
+#define TRYCMD_TAIL_MIN_SIZE (64 * 1024)
+
+/**
+ * The number of bytes of output held in memory by '\-\-quiet', if no other
+ * is given.
+ */
+#define TRYCMD_QUIET_SIZE (16 * 1024 * 1024)
+
+/** The most input patterns which may be given by '\-\-inputs'. */
+#define TRYCMD_INPUTS_MAX (16)
+
+/** The most paths which may be given by '\-\-watch'. */
+#define TRYCMD_WATCH_MAX (16)
+
+/**
+ * The time for which changes to watched paths must settle, before the
+ * subcommand is run again, in milliseconds (if no other is given by
+ * '\-\-debounce').
+ */
+#define TRYCMD_WATCH_DEBOUNCE (100)
+
+/**
+ * The time allowed for a watched subcommand, once stopped, to exit before
+ * it is killed, in milliseconds (if no other is given by '\-\-kill-after').
+ */
+#define TRYCMD_WATCH_KILL_AFTER (5000)
+
+/**
+ * The most storage held within a trycmd_arena itself; any more is mapped.
+ * This suffices to build most commands upon the stack.
+ */
+#define TRYCMD_ARENA_LOCAL_SIZE (2048)
+
+/**
+ * The size to which '\-\-cache' bounds its directory, if no other is given.
+ */
+#define TRYCMD_CACHE_SIZE (256 * 1024 * 1024)
+
+/**
+ * Exit status used if a subcommand was stopped upon reaching its timeout.
+ * This matches the behaviour of timeout(1).
+ */
+#define TRYCMD_STATUS_TIMED_OUT (124)
+
 /** Constants for the control of colored output. */
 enum trycmd_color {
     /** Never use color in trycmd output. */
     trycmd_color_never = 0,
 
-    /** Always use color in trycmd output. */
-    trycmd_color_always,
+    /** Always use color in trycmd output. */
+    trycmd_color_always,
+
+    /**
+     * Use color in trycmd output if and only if
+     * output is connected to a terminal (TTY).
+     */
+    trycmd_color_auto
+};
+
+/** Constants for the selection of a subcommand spawn backend. */
+enum trycmd_spawn {
+    /** Use the cheapest safe backend available on this system. */
+    trycmd_spawn_auto = 0,
+
+    /** Use fork(), copying the parent's page tables. */
+    trycmd_spawn_fork,
+
+    /** Use vfork(), suspending the parent until the child execs. */
+    trycmd_spawn_vfork,
+
+    /** Use posix_spawn(), as implemented by the C library. */
+    trycmd_spawn_posix_spawn,
+
+    /** Use clone3(), which also provides a pidfd for the child. */
+    trycmd_spawn_clone3
+};
+
+/** Constants for the control of how subcommands are executed. */
+enum trycmd_exec {
+    /** Always execute subcommands within a shell. */
+    trycmd_exec_shell = 0,
+
+    /** Execute subcommands directly, resolving them upon PATH. */
+    trycmd_exec_direct,
+
+    /**
+     * Execute subcommands directly if and only if they are plain program
+     * names, with no meaning to the shell, and can be found upon PATH.
+     * Otherwise, execute them within a shell.
+     */
+    trycmd_exec_auto
+};
+
+/** Constants for the control of delays between subcommand retries. */
+enum trycmd_backoff {
+    /** Wait for the same delay before every retry. */
+    trycmd_backoff_none = 0,
+
+    /** Double the delay after every retry. */
+    trycmd_backoff_exp
+};
+
+/** How each line of subcommand output is prefixed by a timestamp. */
+enum trycmd_timestamps {
+    /** Output is not timestamped. */
+    trycmd_timestamps_none = 0,
+
+    /** With the time elapsed since the subcommand was started. */
+    trycmd_timestamps_relative,
+
+    /** With the local time of day. */
+    trycmd_timestamps_absolute
+};
+
+/** Options settable by users via the command-line or environment. */
+struct trycmd_opts {
+    /**
+     * If non-zero, spawn all subcommands within an interactive subshell.
+     * Setting this option may be required if the command is an alias, or
+     * similar. Alias commands will likely only be interpretted as proper
+     * commands within the shell if it is interactive.
+     */
+    int               opt_interactive;
+
+    /**
+     * Control of colored output. If 'never', output will always be in
+     * the terminal's standard color scheme. If 'always', output will
+     * always be colored and change according to subcommand exit status.
+     * If 'auto', output will be colored if any only if connected to
+     * a terminal (TTY).
+     */
+    enum trycmd_color opt_color;
+
+    /**
+     * The path to the shell within which all subcommands are to be spawned.
+     * This shell must support the '-i' interactive, '-c' command string and
+     * '--' end-of-options options in order to function correctly.
+     */
+    char*             opt_shell;
+
+    /**
+     * The backend used to spawn subcommands. If 'auto', the cheapest safe
+     * backend available will be selected. Backends unavailable on this
+     * system fall back to 'fork'.
+     */
+    enum trycmd_spawn opt_spawn;
+
+    /**
+     * Control of how subcommands are executed. If 'shell', all subcommands
+     * are run within opt_shell. If 'direct', the subcommand is resolved
+     * upon PATH and executed without a shell. If 'auto', a direct execution
+     * is used only where doing so is indistinguishable from using a shell.
+     */
+    enum trycmd_exec  opt_exec;
+
+    /**
+     * The maximum number of batch commands which may run concurrently.
+     * Always at least one.
+     */
+    int               opt_jobs;
+
+    /**
+     * If non-NULL, the file from which batch commands are to be read,
+     * one command per line. "-" denotes the standard input. A batch is
+     * mutually exclusive with a subcommand given via opt_sub_argv.
+     */
+    char*             opt_batch;
+
+    /**
+     * If non-NULL, the file to which all subcommand output (and each
+     * result message) is also written. See trycmd_relay_open().
+     */
+    char*             opt_log;
+
+    /**
+     * If non-zero, the number of lines of output shown upon failure (see
+     * trycmd_parse_tail).
+     */
+    unsigned long     opt_tail_lines;
+
+    /**
+     * If non-zero, the number of bytes of output shown upon failure (see
+     * trycmd_parse_tail).
+     */
+    unsigned long     opt_tail_size;
+
+    /**
+     * If non-zero, all subcommand output is held back, and shown only upon
+     * failure. This many bytes are held in memory, beyond which output is
+     * spilled into a temporary file (see trycmd_spool_open()).
+     */
+    unsigned long     opt_quiet;
+
+    /**
+     * Control of whether each line of subcommand output is prefixed by the
+     * time at which it was read (see trycmd_relay::timestamps).
+     */
+    enum trycmd_timestamps opt_timestamps;
+
+    /**
+     * If non-NULL, the file (or, if a number, the inherited descriptor) to
+     * which a JSON record of each subcommand's result is appended. See
+     * trycmd_json_write().
+     */
+    char*             opt_json_out;
+
+    /**
+     * If non-NULL, the history file to which each subcommand's result is
+     * appended (see trycmd_history_append), as given by TRY_HISTORY.
+     */
+    char*             opt_history;
+
+    /**
+     * If non-zero, no subcommand is run. Instead, the results recorded
+     * within opt_history are summarized (see trycmd_history_report).
+     */
+    int               opt_history_query;
+
+    /**
+     * If non-zero, a subcommand's result and output are kept within a
+     * cache and replayed, instead of running the subcommand again, while
+     * the subcommand, its environment and inputs are unchanged. See
+     * trycmd_cache_open().
+     */
+    int               opt_cache;
+
+    /**
+     * The cache directory, or NULL for the default ($XDG_CACHE_HOME/try,
+     * or ~/.cache/try).
+     */
+    char*             opt_cache_dir;
+
+    /** The size to which the cache directory is bounded, in bytes. */
+    unsigned long     opt_cache_size;
+
+    /**
+     * A comma-separated list of those environment variables upon which
+     * the subcommand's cached result depends, or NULL for none.
+     */
+    char*             opt_cache_env;
+
+    /**
+     * Patterns (see glob(7)) naming those files upon which the
+     * subcommand's cached result depends, opt_inputs_len in number.
+     */
+    char*             opt_inputs[TRYCMD_INPUTS_MAX];
+    int               opt_inputs_len;
+
+    /**
+     * Files or directories, opt_watch_len in number, upon any change within
+     * which the subcommand is run again (see trycmd_run_watch). If none,
+     * the subcommand is run only once.
+     */
+    char*             opt_watch[TRYCMD_WATCH_MAX];
+    int               opt_watch_len;
+
+    /**
+     * The time for which changes to watched paths must settle before the
+     * subcommand is run again, in milliseconds.
+     */
+    unsigned long     opt_debounce;
+
+    /**
+     * If non-zero, no further batch commands are started once any batch
+     * command has failed. Commands already running are allowed to finish.
+     */
+    int               opt_fail_fast;
+
+    /**
+     * If non-zero, and no GNU make jobserver is already available, act as
+     * a jobserver of opt_jobs slots, shared by try's own batch commands
+     * and any 'make' they run.
+     */
+    int               opt_jobserver;
+
+    /**
+     * The maximum number of times a failed subcommand is run again.
+     * If zero, the subcommand is run only once.
+     */
+    int               opt_retry;
+
+    /** The delay before the first retry, in milliseconds. */
+    unsigned long     opt_retry_delay;
+
+    /** How the delay grows between retries. */
+    enum trycmd_backoff opt_backoff;
+
+    /**
+     * If non-zero, each delay between retries is chosen at random from
+     * the range [delay/2, delay], so that many retrying clients spread out.
+     */
+    int               opt_jitter;
+
+    /**
+     * A bitmap of those exit statuses (0-255) which may be retried, with
+     * status n at bit (n % 32) of element (n / 32). If all zero, every
+     * failure may be retried. See trycmd_parse_retry_on.
+     */
+    uint32_t          opt_retry_on[8];
+
+    /**
+     * The time limit for each run of a subcommand, in milliseconds, or zero
+     * for none. Upon reaching it, the subcommand's process group is sent
+     * SIGTERM and the run fails with TRYCMD_STATUS_TIMED_OUT.
+     */
+    unsigned long     opt_timeout;
+
+    /**
+     * If non-zero, the time after sending SIGTERM (see opt_timeout) when
+     * SIGKILL is sent, should the subcommand still be running, in
+     * milliseconds.
+     */
+    unsigned long     opt_kill_after;
+
+    /**
+     * If non-zero, the result message is followed by a summary of the
+     * resources used by the subcommand (see trycmd_show_result).
+     */
+    int               opt_stats;
+
+    /**
+     * If non-zero, the result message is followed by the subcommand's
+     * performance counters (see trycmd_perf_open).
+     */
+    int               opt_perf;
+
+    /**
+     * If non-zero, enables verbose application output.
+     * This will print the command being spawned onto stderr.
+     */
+    int               opt_verbose;
+
+    /**
+     * If non-zero, prints application usage information to stdout.
+     * If help is requested then no subcommand will be spawned.
+     */
+    int               opt_help;
+
+    /**
+     * Subcommand argument count.
+     * The length of opt_sub_argv in elements, less any terminating NULL.
+     */
+    int               opt_sub_argc;
+
+    /**
+     * Subcommand argument list.
+     * This list does not require a NULL terminator.
+     */
+    char**            opt_sub_argv;
+};
+
+/** Attributes controlling how a single child process is spawned. */
+struct trycmd_spawn_attr {
+    /** The backend to use. */
+    enum trycmd_spawn backend;
+
+    /**
+     * Descriptors to install as the child's stdin, stdout and stderr,
+     * or -1 for any stream that the child should inherit unchanged.
+     */
+    int               stdio[3];
+
+    /**
+     * If non-zero, the child is made the leader of a new process group,
+     * so that it may be signalled together with all of its descendants.
+     */
+    int               new_pgroup;
+
+    /** If non-NULL, the signal mask to install within the child. */
+    const sigset_t*   sigmask;
+};
+
+/** A spawned child process. */
+struct trycmd_child {
+    /** The child's process ID, or -1 if no child is running. */
+    pid_t pid;
+
+    /**
+     * A pidfd referring to the child, or -1 if none was obtained.
+     * If valid, this is owned by the caller and must be closed.
+     */
+    int   pidfd;
+};
+
+/**
+ * A persistent cache of PATH resolution results, for one PATH string.
+ * See trycmd_pathcache_open().
+ */
+struct trycmd_pathcache {
+    /** The PATH string, as searched. */
+    const char* search;
+
+    /** Hash of search. */
+    uint64_t    search_hash;
+
+    /** The mapped cache file, or NULL if the cache is unavailable. */
+    void*       map;
+};
+
+/**
+ * A GNU make jobserver, either inherited via MAKEFLAGS or created by try.
+ * See trycmd_jobserver_open().
+ */
+struct trycmd_jobserver {
+    /**
+     * The jobserver's descriptors, or -1 if unavailable. For a named fifo,
+     * read_fd is -1 and write_fd is private to this process.
+     */
+    int   read_fd;
+    int   write_fd;
+
+    /** A private, non-blocking descriptor from which to read tokens. */
+    int   token_fd;
+
+    /** If non-zero, this jobserver was created by trycmd_jobserver_create. */
+    int   owner;
+
+    /** MAKEFLAGS, as it was before trycmd_jobserver_create (if owner). */
+    char* saved_makeflags;
+};
+
+/**
+ * The performance counters which may be opened by trycmd_perf_open. Those
+ * before trycmd_perf_task_clock are hardware events; the rest are software.
+ */
+enum trycmd_perf_event {
+    /** CPU cycles. */
+    trycmd_perf_cycles = 0,
+
+    /** Instructions retired. */
+    trycmd_perf_instructions,
+
+    /** Mispredicted branch instructions. */
+    trycmd_perf_branch_misses,
+
+    /** Last-level cache misses. */
+    trycmd_perf_cache_misses,
+
+    /** CPU time, in nanoseconds. */
+    trycmd_perf_task_clock,
+
+    /** Page faults. */
+    trycmd_perf_page_faults,
+
+    /** Context switches (only if no hardware event is available). */
+    trycmd_perf_context_switches,
+
+    /** Migrations between CPUs (only if no hardware event is available). */
+    trycmd_perf_cpu_migrations,
+
+    /** The number of events. */
+    trycmd_perf_events
+};
+
+/** A set of open performance counters. See trycmd_perf_open(). */
+struct trycmd_perf {
+    /** The descriptor of each event, or -1 if it is not counted. */
+    int fd[trycmd_perf_events];
+};
+
+/** The values read from a set of performance counters. */
+struct trycmd_perf_counts {
+    /** A bit set of the events counted, by (1 << trycmd_perf_event). */
+    unsigned int valid;
+
+    /** The value of each event counted. */
+    uint64_t     value[trycmd_perf_events];
+};
+
+/**
+ * A fixed-size ring buffer, keeping only the last bytes written to it.
+ * See trycmd_ring_init().
+ */
+struct trycmd_ring {
+    /** The buffer, or NULL if none was allocated. */
+    char*    data;
+
+    /** The size of data in bytes. */
+    size_t   size;
+
+    /** The number of bytes ever written, of which the last size are kept. */
+    uint64_t total;
+};
+
+/**
+ * A bump allocator, holding storage for a command as it is built: within
+ * itself if small, else mapped. See trycmd_arena_init().
+ */
+struct trycmd_arena {
+    /** The storage, either local or mapped. */
+    char*  base;
+
+    /** The size of base in bytes. */
+    size_t size;
+
+    /** The number of bytes of base allocated. */
+    size_t used;
+
+    /** If non-zero, base was mapped (see mmap(2)) and must be unmapped. */
+    int    mapped;
+
+    /** Storage for a small command, aligned as for any argument list. */
+    union {
+        char  bytes[TRYCMD_ARENA_LOCAL_SIZE];
+        char* align;
+    }      local;
+};
+
+/** The result of running a subcommand, perhaps more than once. */
+struct trycmd_result {
+    /** The exit status of the final attempt. */
+    int          exit_status;
+
+    /** The number of attempts made (at least 1). */
+    unsigned int attempts;
+
+    /** The time spent running all attempts, in nanoseconds. */
+    uint64_t     elapsed_ns;
+
+    /** If non-zero, the final attempt was stopped upon its timeout. */
+    int          timed_out;
+
+    /** The signal which ended the final attempt, or 0 if none did. */
+    int          term_signal;
+
+    /** When the first attempt was started (by CLOCK_REALTIME). */
+    struct timespec started;
+
+    /** When the final attempt ended (by CLOCK_REALTIME). */
+    struct timespec ended;
+
+    /**
+     * The resources used by all attempts (and their reaped descendants).
+     * ru_maxrss is the greatest of any attempt.
+     */
+    struct rusage rusage;
+
+    /** The performance counters of all attempts, if opts->opt_perf. */
+    struct trycmd_perf_counts perf;
+
+    /**
+     * The tail of all output, if opts->opt_tail_lines or opt_tail_size.
+     * This is to be released with trycmd_ring_free().
+     */
+    struct trycmd_ring        tail;
+
+    /** If non-zero, the result was replayed from a cache, not run. */
+    int                       cached;
+
+    /**
+     * If non-zero, the final attempt was stopped before it could finish,
+     * to be run again (see trycmd_run_watch); its status means nothing.
+     */
+    int                       cancelled;
+};
+
+/** The kinds of event source which may be registered with a trycmd_loop. */
+enum trycmd_loop_kind {
+    /** Not registered. */
+    trycmd_loop_none = 0,
+
+    /** Any descriptor, owned by the caller. */
+    trycmd_loop_fd,
+
+    /** A child process, which has exited once its handler is called. */
+    trycmd_loop_child,
+
+    /** A timerfd, which has expired once its handler is called. */
+    trycmd_loop_timer,
+
+    /** A signalfd, from which signals are read with trycmd_loop_read_signal. */
+    trycmd_loop_signals
+};
+
+struct trycmd_loop;
+struct trycmd_loop_handler;
+
+/**
+ * A function called upon each event for a handler within a trycmd_loop.
+ * @param  loop    The loop dispatching the event.
+ * @param  handler The handler registered for the event.
+ * @param  events  The epoll events which occurred (e.g. EPOLLIN).
+ */
+typedef void (*trycmd_loop_callback)(struct trycmd_loop* loop,
+                                     struct trycmd_loop_handler* handler,
+                                     uint32_t events);
+
+/**
+ * A single source of events within a trycmd_loop. Handlers must be zero
+ * initialized (or removed) before first being registered.
+ */
+struct trycmd_loop_handler {
+    /** The kind of event source, or trycmd_loop_none if unregistered. */
+    enum trycmd_loop_kind kind;
+
+    /** The descriptor watched, or -1 for a child checked upon SIGCHLD. */
+    int                  fd;
+
+    /** If non-zero, fd was opened by the loop and is closed upon removal. */
+    int                  owned;
+
+    /** For a child, its process ID (otherwise -1). */
+    pid_t                pid;
+
+    /** The function called upon each event. */
+    trycmd_loop_callback callback;
+
+    /** Context for callback, for the caller's own use. */
+    void*                data;
+
+    /** The next child checked upon SIGCHLD (see trycmd_loop.polled). */
+    struct trycmd_loop_handler* next;
+};
+
+/** An epoll-based event loop. See trycmd_loop_open(). */
+struct trycmd_loop {
+    /** The epoll instance, upon which handlers are registered. */
+    int      epoll_fd;
+
+    /** The number of handlers registered (excluding sigchld). */
+    unsigned handlers;
+
+    /** If non-zero, trycmd_loop_run returns after the current event. */
+    int      stop;
+
+    /** All signals blocked for delivery through signalfd handlers. */
+    sigset_t blocked;
+
+    /** The signal mask as it was when opened, as for any new child. */
+    sigset_t saved_mask;
+
+    /** The loop's own handler of SIGCHLD, for children lacking a pidfd. */
+    struct trycmd_loop_handler  sigchld;
+
+    /** Those children lacking a pidfd, checked upon each SIGCHLD. */
+    struct trycmd_loop_handler* polled;
+};
+
+/**
+ * A running subcommand, supervised upon a trycmd_loop: its exit is awaited
+ * and any timeout is enforced. See trycmd_monitor_start().
+ */
+struct trycmd_monitor {
+    /** Options describing the subcommand, including its timeout. */
+    const struct trycmd_opts* opts;
+
+    /** The subcommand's process, or pid -1 once it has been reaped. */
+    struct trycmd_child        child;
+
+    /** The handler of the subcommand's exit. */
+    struct trycmd_loop_handler exit_handler;
+
+    /** The handler of the subcommand's timeout (if any). */
+    struct trycmd_loop_handler timer_handler;
+
+    /** The last signal sent upon timeout (SIGTERM or SIGKILL), or 0. */
+    int                        signalled;
+
+    /** If non-zero, the subcommand was stopped upon its timeout. */
+    int                        timed_out;
+
+    /** The subcommand's exit status, once finished has been called. */
+    int                        exit_status;
+
+    /** The signal which ended the subcommand (if any), once finished. */
+    int                        term_signal;
+
+    /** The resources used by the subcommand, once finished has been called. */
+    struct rusage              rusage;
+
+    /** Called once the subcommand has been reaped. */
+    void (*finished)(struct trycmd_loop* loop, struct trycmd_monitor* monitor);
+
+    /** Context for finished, for the caller's own use. */
+    void*                      data;
+};
+
+/**
+ * Output held back in place of try's own, until it is known to be wanted.
+ * See trycmd_spool_open().
+ */
+struct trycmd_spool {
+    /** The spool's descriptor: in memory, or a file once spilled. */
+    int      fd;
+
+    /** The number of bytes spooled. */
+    uint64_t size;
+
+    /** The number of bytes which may be spooled in memory. */
+    uint64_t limit;
+
+    /** If non-zero, the spool has been spilled into a temporary file. */
+    int      spilled;
+};
+
+/** A subcommand's entry within a result cache. See trycmd_cache_open(). */
+struct trycmd_cache {
+    /** The options with which the subcommand is run. */
+    const struct trycmd_opts* opts;
+
+    /** The path of the entry, within the cache directory. */
+    char*               path;
+
+    /** The length of the cache directory's path, a prefix of path. */
+    size_t              dir_len;
+
+    /** Copies of the subcommand's standard output and error, as run. */
+    struct trycmd_spool output[2];
+
+    /** If non-zero, output is being captured. */
+    int                 capturing;
+};
+
+/** A destination for JSON result records. See trycmd_json_open(). */
+struct trycmd_json {
+    /** The buffered stream through which records are written. */
+    FILE* os;
+
+    /** A stream escaping all written for a JSON string into os, or NULL. */
+    FILE* escaped;
+};
+
+/**
+ * A growable buffer into which a message is rendered whole, before it is
+ * written at once. See trycmd_obuf_open().
+ */
+struct trycmd_obuf {
+    /** The stream to which the message is finally written. */
+    FILE*  dest;
+
+    /** The stream to render into: a memory stream, else dest itself. */
+    FILE*  os;
+
+    /** The message rendered, once os is closed. */
+    char*  data;
+
+    /** The length of data in bytes. */
+    size_t len;
+};
+
+/** One output relayed by a trycmd_relay. */
+struct trycmd_relay_stream {
+    /** The pipe's read end, from which the subcommand's output is read. */
+    int                        pipe_fd;
+
+    /** The pipe's write end, to become the subcommand's output. */
+    int                        child_fd;
+
+    /** try's own output (STDOUT_FILENO or STDERR_FILENO). */
+    int                        out_fd;
+
+    /** If non-zero, out_fd is a pipe, so may be written with tee(2). */
+    int                        use_tee;
+
+    /** If non-zero, the next byte relayed begins a line. */
+    int                        at_line_start;
+
+    /**
+     * A spool keeping a copy of all output relayed (as for a result cache,
+     * and without any timestamp), or NULL. This may be set once the relay
+     * is opened.
+     */
+    struct trycmd_spool*       capture;
+
+    /** The handler of data arriving within the pipe. */
+    struct trycmd_loop_handler handler;
+};
+
+/**
+ * Relays subcommand output to try's own outputs and to a log, upon a
+ * trycmd_loop. See trycmd_relay_open().
+ */
+struct trycmd_relay {
+    /** The loop upon which the pipes are read. */
+    struct trycmd_loop*        loop;
+
+    /** The log file. */
+    int                        log_fd;
+
+    /** A stream upon log_fd, if made by trycmd_relay_log(). */
+    FILE*                      log;
+
+    /** The ring buffer keeping the tail of all output, or NULL. */
+    struct trycmd_ring*        tail;
+
+    /**
+     * The spool holding back all output in place of try's own, or NULL.
+     */
+    struct trycmd_spool*       spool;
+
+    /**
+     * How each line relayed is prefixed by a timestamp (by default, not).
+     * This may be set once the relay is opened. Timestamped output is
+     * always read into a buffer, then written by writev(2) in batches of
+     * many lines; each line read at once shares a single timestamp.
+     */
+    enum trycmd_timestamps     timestamps;
+
+    /** When the relay was opened (see trycmd_clock_ns). */
+    uint64_t                   start_ns;
+
+    /** The relayed standard output and error, in that order. */
+    struct trycmd_relay_stream streams[2];
+};
+
+/** If non-zero, enables the printing of application diagnostic output. */
+extern int      trycmd_debug_enabled;
+
+/**
+ * Initialise the Try diagnostic system.
+ * If TRYCMD_DEBUG is present in the environment, and non-zero,
+ * then diagnostics will be enabled.
+ */
+extern void     trycmd_debug_init(void);
+
+/**
+ * Print a single diagnostic message.
+ * @param format A standard printf format string
+ */
+extern void     trycmd_debug(const char* format, ...);
+
+/**
+ * Initialize application strings internationalization support.
+ * Must be called once, at application startup and before any calls
+ * to the _() or N_() functions. The locale and message catalog are not
+ * loaded until the first call to _(), so may be called again (as by a
+ * daemon's worker, once its environment is replaced) to reload them.
+ */
+extern void     trycmd_intl_init(void);
+
+/**
+ * Translates the given string, to the user's
+ * own language, using the current LOCALE. Upon first use, the locale is
+ * loaded; thereafter, recent translations are kept by the address of s,
+ * which must therefore be a string literal.
+ * If built without translation (TRYCMD_NO_INTL, see configure's
+ * \-\-enable\-fast\-startup), this instead returns s, as does N_().
+ * @param  s The string to be translated.
+ * @return The translated string, or s if no more
+ *         appropriate translation was available.
+ */
+#if defined(TRYCMD_NO_INTL)
+inline char*    _(char* s) {
+    /* Translation is compiled out, so return the given string. */
+    return s;
+}
+#else
+extern char*    _(char* s);
+#endif
+
+/**
+ * Performs a null translation upon the given string.
+ * This is sibling to the _() translation function. It intentionally does
+ * nothing to the given string and is used to document that strings are not
+ * to be translated (because they are either non-translatable or critical).
+ * @param  s The string to be translated.
+ * @return s unmodified.
+ */
+inline char*    N_(char* s) {
+    /* Intentionally do nothing but return the given string. */
+    return s;
+}
+
+/**
+ * Construct a shell command for use with the standard exec functions.
+ * Converts the given options - shell and subcommand - to  an argument
+ * list for passing to one of the family of exec functions. Only the
+ * shell's script (the subcommand's first argument, followed by "$@") is
+ * copied into buffer; the shell, its options and each argument are
+ * referred to in place. No argument's length is limited.
+ * @param  opts     Input options defining the shell and subcommand.
+ * @param  buffer   Generic storage to hold argv_out data.
+ * @param  buflen   Length of buffer, in bytes.
+ * @param  argv_out Output command (stored in buffer).
+ * @return The required or used buflen to store the command, in full.
+ *         If buflen is less than this required length, then no output
+ *         will be written to either buffer or argv_out.
+ */
+extern size_t   trycmd_make_shell_cmd(const struct trycmd_opts* opts,
+                                      void*  buffer,
+                                      size_t buflen,
+                                      char** argv_out[]);
+
+/**
+ * Construct a direct command for use with the standard exec functions.
+ * Converts the given subcommand options to a NULL terminated argument list
+ * (referring to, but not copying, each argument). The program itself must
+ * be resolved separately, using trycmd_find_program().
+ * @param  opts     Input options defining the subcommand.
+ * @param  buffer   Generic storage to hold argv_out data.
+ * @param  buflen   Length of buffer, in bytes.
+ * @param  argv_out Output command (stored in buffer).
+ * @return The required or used buflen to store the command, in full.
+ *         If buflen is less than this required length, then no output
+ *         will be written to either buffer or argv_out.
+ */
+extern size_t   trycmd_make_direct_cmd(const struct trycmd_opts* opts,
+                                       void*  buffer,
+                                       size_t buflen,
+                                       char** argv_out[]);
+
+/**
+ * Construct and run a shell command from the given options.
+ * Upon completion of the subcommand (if any), this function will return
+ * its exit status as-if it had been run from a terminal directly. An exit
+ * status of zero indicates success, any other value indicates failure. For
+ * more information on specific error codes, refer to the Bash shell's
+ * documentation on exit status codes, behavior this function duplicates.
+ * @param  opts Options describing the shell and subcommand.
+ * @return The subcommand's result value as-if it had been run from a
+ *         terminal, directly.
+ */
+extern int      trycmd_run_subcommand(const struct trycmd_opts* opts);
+
+/**
+ * Construct and run a shell command from the given options, as for
+ * trycmd_run_subcommand(), retrying any retryable failure up to
+ * opts->opt_retry times. The command is built only once, for all attempts.
+ * @param  opts       Options describing the shell and subcommand.
+ * @param  result_out The final exit status, attempts made and time taken.
+ * @return The final attempt's exit status (as result_out->exit_status).
+ */
+extern int      trycmd_run_subcommand_result(const struct trycmd_opts* opts,
+                                             struct trycmd_result* result_out);
+
+/**
+ * Construct and start a shell command from the given options, without
+ * waiting for it to complete. The caller must wait for child_out->pid and
+ * then close child_out->pidfd (if not -1).
+ * @param  opts      Options describing the shell and subcommand.
+ * @param  attr      Attributes controlling how the subcommand is spawned.
+ * @param  child_out The started child process. Both fields are set to -1
+ *                   if no child was started.
+ * @return 0 if the subcommand was started, otherwise the non-zero exit
+ *         status with which it failed (e.g. 127 if it was not found).
+ */
+extern int      trycmd_start_subcommand(const struct trycmd_opts* opts,
+                                        const struct trycmd_spawn_attr* attr,
+                                        struct trycmd_child* child_out);
+
+/**
+ * Convert a wait status, as returned by waitpid(), to an exit status as-if
+ * the process had been run from a terminal directly.
+ * @param  wait_status The status to convert.
+ * @return The exit status (0-255).
+ */
+extern int      trycmd_exit_status(int wait_status);
+
+/**
+ * Run all commands within opts->opt_batch, up to opts->opt_jobs at a
+ * time. Each line is split into words and expanded as-if by a shell (but
+ * without command substitution); blank lines and those starting with '#'
+ * are ignored. All commands read from /dev/null. A result message is
+ * shown for each command upon its completion, followed by a summary.
+ * @param  opts Options describing the batch and how to run each command.
+ * @return 0 if every command succeeded, otherwise the exit status of the
+ *         first command to fail (or EXIT_FAILURE if the batch could not be
+ *         read).
+ */
+extern int      trycmd_run_batch(const struct trycmd_opts* opts);
+
+/**
+ * Run the subcommand, then run it again upon each change to those files
+ * or directories within opts->opt_watch, until try is sent a terminating
+ * signal. Directories are watched recursively (excepting hidden entries,
+ * whose names start with '.'), including those created meanwhile. A burst
+ * of changes is coalesced into a single run, once no further change has
+ * been seen for opts->opt_debounce. Should a change be seen while the
+ * subcommand is running, that run is stopped (its process group is sent
+ * SIGTERM then, after opts->opt_kill_after or TRYCMD_WATCH_KILL_AFTER,
+ * SIGKILL) before the next; it is shown as cancelled, and is not recorded
+ * as JSON nor within the history. Each run reads from /dev/null, and a
+ * result message is shown upon its completion. Runs are never retried.
+ * @param  opts Options describing the subcommand and what to watch.
+ * @return The exit status of the last run not cancelled (or of that stopped
+ *         upon a terminating signal), or EXIT_FAILURE if any path could not
+ *         be watched.
+ */
+extern int      trycmd_run_watch(const struct trycmd_opts* opts);
+
+/**
+ * Initialize the given spawn attributes to their defaults: use the backend
+ * selected within opts (or 'auto' if opts is NULL) and inherit all streams.
+ * @param  attr The attributes to initialize.
+ * @param  opts Options selecting the spawn backend, or NULL.
+ */
+extern void     trycmd_spawn_attr_init(struct trycmd_spawn_attr* attr,
+                                       const struct trycmd_opts* opts);
+
+/**
+ * Spawn a child process which immediately executes the given program.
+ * Every backend reports a failure to exec synchronously: if this function
+ * fails after a child was created, then that child will have been reaped.
+ * @param  attr      Attributes controlling the spawn, including backend.
+ * @param  path      The path of the program to be executed.
+ * @param  argv      The program's argument list, terminated by NULL.
+ * @param  child_out On success, the spawned child process.
+ * @return 0 on success, -1 on failure with errno set (e.g. ENOENT if
+ *         path does not exist).
+ */
+extern int      trycmd_spawn(const struct trycmd_spawn_attr* attr,
+                             const char* path,
+                             char* argv[],
+                             struct trycmd_child* child_out);
+
+/**
+ * Obtain a pidfd referring to the given (unreaped) child process.
+ * @param  pid The child's process ID.
+ * @return The pidfd (close-on-exec), or -1 on failure with errno set
+ *         (e.g. ENOSYS if the kernel predates Linux 5.3).
+ */
+extern int      trycmd_pidfd_open(pid_t pid);
+
+/**
+ * Convert the given NAME string to a trycmd_spawn value.
+ * Supported NAME values are: "auto", "fork", "vfork", "posix_spawn" and
+ * "clone3". If the given NAME is NULL or unrecognised, this function will
+ * return -1.
+ * @param  name The input NAME string.
+ * @param  out  On success, destination for the parsed result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_spawn(const char* name, enum trycmd_spawn* out);
+
+/**
+ * Convert the given trycmd_spawn value to its NAME string.
+ * @param  backend The spawn backend.
+ * @return The backend's name, as accepted by trycmd_parse_spawn().
+ */
+extern const char* trycmd_spawn_name(enum trycmd_spawn backend);
+
+/**
+ * Resolve the given spawn backend to one which is usable on this system.
+ * 'auto' is resolved to the cheapest safe backend, and any backend which
+ * is unavailable is resolved to 'fork'.
+ * @param  backend The requested spawn backend.
+ * @return The backend which will actually be used.
+ */
+extern enum trycmd_spawn trycmd_resolve_spawn(enum trycmd_spawn backend);
+
+/**
+ * Print a colorful message for the given subcommand exit status.
+ * If exit_status is zero, this will be interpretted as success.
+ * A non-zero exit_status will be interpretted as failure.
+ * @param  opts Options describing the subcommand.
+ * @param  exit_status The exit status to illustrate.
+ * @param  os   The destination stream (stdout, stderr).
+ */
+extern int      trycmd_show_exit_status(const struct trycmd_opts* opts,
+                                        int exit_status,
+                                        FILE* os);
+
+/**
+ * Print a colorful message for the given subcommand result, as for
+ * trycmd_show_exit_status(). If retries were enabled, the message also
+ * reports the number of attempts made and the total time they took. A
+ * timed out result is reported as such. If opts->opt_stats is non-zero,
+ * the message also summarizes the resources used: wall time, user and
+ * system CPU time, maximum resident set size, major and minor page faults,
+ * and voluntary and involuntary context switches. If opts->opt_perf is
+ * non-zero, the message also shows the performance counters read (see
+ * trycmd_print_perf). Upon failure, any tail of output kept is shown last.
+ * @param  opts   Options describing the subcommand.
+ * @param  result The result to illustrate.
+ * @param  os     The destination stream (stdout, stderr).
+ * @return The result's exit status.
+ */
+extern int      trycmd_show_result(const struct trycmd_opts* opts,
+                                   const struct trycmd_result* result,
+                                   FILE* os);
+
+/**
+ * Print a colorful summary of a completed batch of subcommands.
+ * The summary is interpretted as success only if no command failed
+ * and none were skipped.
+ * @param  opts      Options describing the batch.
+ * @param  succeeded The number of commands which succeeded.
+ * @param  failed    The number of commands which failed.
+ * @param  skipped   The number of commands which were never started.
+ * @param  os        The destination stream (stdout, stderr).
+ */
+extern void     trycmd_show_batch_status(const struct trycmd_opts* opts,
+                                         unsigned long succeeded,
+                                         unsigned long failed,
+                                         unsigned long skipped,
+                                         FILE* os);
+
+/**
+ * Print this application's usage information to the given stream.
+ * This is given in the form of a human-readable message.
+ * @param  os The destination stream (stdout, stderr).
+ */
+extern void     trycmd_print_usage(FILE* os);
+
+/**
+ * Read and parse the given option strings into a trycmd_opts structure.
+ * Command-line options:
+ *   1. \-i \-\-interactive
+ *      Force the subshell to behave as-if it was an interactive session.
+ *      This option may be necessary if your command is, or relies upon,
+ *      aliases.
+ *   2. \-\-color[=WHEN], \-\-colour[=WHEN]
+ *      Color the result according to command's exit status.
+ *   3. \-\-spawn=BACKEND
+ *      Select the subcommand spawn backend (see trycmd_parse_spawn).
+ *   4. \-\-exec=MODE, \-\-no\-shell
+ *      Select how the subcommand is executed (see trycmd_parse_exec).
+ *      '\-\-no\-shell' is equivalent to '\-\-exec=direct'.
+ *   5. \-j \-\-jobs=N
+ *      Run up to N batch commands at once (see trycmd_parse_jobs).
+ *   6. \-\-batch=FILE
+ *      Run each line of FILE as a command, instead of a single COMMAND.
+ *   7. \-\-fail\-fast
+ *      Start no further batch commands once any has failed.
+ *   8. \-\-jobserver
+ *      Act as a GNU make jobserver of '\-\-jobs' slots (see
+ *      trycmd_jobserver_setup).
+ *   9. \-\-retry=N, \-\-retry\-delay=DURATION, \-\-backoff=MODE,
+ *      \-\-jitter, \-\-retry\-on=STATUSES
+ *      Retry a failed subcommand up to N times, waiting DURATION (see
+ *      trycmd_parse_duration) before the first retry, and growing this
+ *      delay according to MODE (see trycmd_parse_backoff). Only those
+ *      exit statuses within STATUSES are retried, if given (see
+ *      trycmd_parse_retry_on).
+ *  10. \-\-timeout=DURATION, \-\-kill\-after=DURATION
+ *      Send SIGTERM to a subcommand still running after the timeout's
+ *      DURATION, then SIGKILL if still running after the kill\-after
+ *      DURATION.
+ *  11. \-\-stats
+ *      Summarize the resources used by the subcommand in its result
+ *      message (see trycmd_show_result).
+ *  12. \-\-perf
+ *      Show the subcommand's performance counters in its result message
+ *      (see trycmd_perf_open).
+ *  13. \-\-log=FILE
+ *      Write all subcommand output, and each result message, to FILE as
+ *      well as to the standard output and error (see trycmd_relay_open).
+ *  14. \-\-tail[=TAIL]
+ *      Upon failure, show the last lines (or kibibytes) of the subcommand's
+ *      output within its result message (see trycmd_parse_tail).
+ *  15. \-q \-\-quiet[=MAX]
+ *      Show the subcommand's output only upon failure, holding up to MAX
+ *      bytes (see trycmd_parse_size) in memory meanwhile.
+ *  16. \-\-timestamps[=MODE]
+ *      Prefix each line of the subcommand's output with a timestamp. MODE
+ *      is "relative" (the default if omitted) or "absolute".
+ *  17. \-\-json\-out=FD|FILE
+ *      Append a JSON record of each subcommand's result to the given
+ *      descriptor or file (see trycmd_json_write).
+ *  18. \-\-cache[=DIR]
+ *      Replay the subcommand's result and output from a cache within DIR,
+ *      if its arguments, environment and inputs are unchanged, else run
+ *      it and keep them (see trycmd_cache_open).
+ *  19. \-\-inputs=GLOB
+ *      Name files upon which a cached result depends (repeatable, up to
+ *      TRYCMD_INPUTS_MAX times).
+ *  20. \-\-cache\-env=NAMES
+ *      Name environment variables, comma-separated, upon which a cached
+ *      result depends.
+ *  21. \-\-cache\-size=MAX
+ *      Bound the cache to MAX bytes (see trycmd_parse_size).
+ *  22. \-\-watch=PATH, \-\-watch PATH... \-\-
+ *      Run the subcommand again upon each change within PATH (repeatable,
+ *      up to TRYCMD_WATCH_MAX times); see trycmd_run_watch.
+ *  23. \-\-debounce=DURATION
+ *      Wait for changes to settle for DURATION before running again.
+ *  24. \-\-history
+ *      Instead of running the subcommand, summarize its results (or, if
+ *      none is given, those of every subcommand) within the history file
+ *      given by TRY_HISTORY (see trycmd_history_report).
+ *  25. \-v \-\-verbose
+ *      Enable verbose output.
+ *  26. \-h \-\-help
+ *      Display a usage message on stdout and exit successfully.
+ *
+ * Environment options:
+ *   1. TRY_INTERACTIVE=1
+ *      Always execute commands in an interactive subshell.
+ *   2. TRY_COLOR=WHEN
+ *      Add color to the result (see '--color').
+ *   3. TRY_SPAWN=BACKEND
+ *      Select the subcommand spawn backend (see '--spawn').
+ *   4. TRY_EXEC=MODE
+ *      Select how the subcommand is executed (see '\-\-exec').
+ *   5. TRY_HISTORY=FILE
+ *      Append each subcommand's result to the history FILE.
+ *   6. SHELL=/bin/sh
+ *      The shell to use when executing the command.
+ *
+ * @param  argc     The length of argv in elements.
+ * @param  argv     The command-line arguments, in the order presented
+ *                  by the user (need not be NULL terminated).
+ * @param  opts_out The options translated into a trycmd_opts structure.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_read_options(int argc, char* argv[],
+                                    struct trycmd_opts* opts_out);
+
+/**
+ * Convert the given WHEN string to a trycmd_color value.
+ * Supported WHEN values are: "never", "always", and "auto", and each
+ * maps to its corresponding trycmd_color enumerated counterpart. If
+ * the given WHEN value is unrecognised, this function will return -1.
+ * @param  when The input WHEN string.
+ * @param  out  On success, destination for the parsed result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_when(const char* when, enum trycmd_color* out);
+
+/**
+ * Convert the given MODE string to a trycmd_exec value.
+ * Supported MODE values are: "shell", "direct" and "auto". If the given
+ * MODE value is NULL or unrecognised, this function will return -1.
+ * @param  mode The input MODE string.
+ * @param  out  On success, destination for the parsed result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_exec(const char* mode, enum trycmd_exec* out);
+
+/**
+ * Convert the given MODE string to a trycmd_backoff value.
+ * Supported MODE values are: "none" and "exp". If the given MODE value is
+ * NULL or unrecognised, this function will return -1.
+ * @param  mode The input MODE string.
+ * @param  out  On success, destination for the parsed result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_backoff(const char* mode, enum trycmd_backoff* out);
+
+/**
+ * Convert the given MODE string to a trycmd_timestamps value.
+ * Supported MODE values are: "relative" and "absolute". If the given MODE
+ * value is NULL or unrecognised, this function will return -1.
+ * @param  mode The input MODE string.
+ * @param  out  On success, destination for the parsed result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_timestamps(const char* mode,
+                                        enum trycmd_timestamps* out);
+
+/**
+ * Convert the given STATUSES string to a bitmap of retryable exit statuses.
+ * STATUSES is a comma-separated list of exit statuses (e.g. "1"), ranges
+ * of exit statuses (e.g. "2-5"), and signal names (e.g. "SIGKILL" or "KILL",
+ * each meaning 128+n, as for a subcommand killed by signal n).
+ * @param  statuses The input STATUSES string.
+ * @param  out      On success, the bitmap (see trycmd_opts.opt_retry_on).
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_retry_on(const char* statuses, uint32_t out[8]);
+
+/**
+ * Check whether a subcommand which failed with the given exit status may
+ * be retried, according to opts->opt_retry_on.
+ * @param  opts        Options describing the retries.
+ * @param  exit_status The non-zero exit status.
+ * @return 1 if it may be retried, 0 otherwise.
+ */
+extern int      trycmd_is_retryable(const struct trycmd_opts* opts,
+                                    int exit_status);
+
+/**
+ * Compute the delay before the given retry, according to opts.
+ * @param  opts    Options describing the retries.
+ * @param  retry   The retry about to be made (1 for the first).
+ * @param  seed    Random state for any jitter, updated upon each use.
+ * @return The delay, in milliseconds.
+ */
+extern unsigned long trycmd_retry_delay(const struct trycmd_opts* opts,
+                                        unsigned int retry,
+                                        uint64_t* seed);
+
+/**
+ * Convert the given JOBS string to a concurrent job count.
+ * JOBS must be a decimal integer from 0 to 4096, where 0 selects one job
+ * per online processor. If the given JOBS value is NULL or invalid, this
+ * function will return -1.
+ * @param  jobs The input JOBS string.
+ * @param  out  On success, destination for the parsed result (at least 1).
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_jobs(const char* jobs, int* out);
+
+/**
+ * Convert the given TAIL string to an amount of output to be shown upon
+ * failure. TAIL is either a number of lines from 1 to 65535, or a number
+ * of kibibytes from 1 to 65536 suffixed by "K" or "KiB" (e.g. "64K"). If
+ * TAIL is NULL, TRYCMD_TAIL_LINES lines are selected.
+ * @param  tail  The input TAIL string.
+ * @param  lines On success, the number of lines (or zero).
+ * @param  size  On success, the number of bytes (or zero).
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_tail(const char* tail,
+                                  unsigned long* lines,
+                                  unsigned long* size);
+
+/**
+ * Convert the given SIZE string to a number of bytes. SIZE is a positive
+ * integer, optionally suffixed by "K", "M" or "G" (e.g. "64M"), denoting
+ * kibibytes, mebibytes or gibibytes respectively.
+ * @param  size The input SIZE string.
+ * @param  out  On success, the number of bytes.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_size(const char* size, unsigned long* out);
+
+/**
+ * Check whether the given command name is a plain program name, which has
+ * no special meaning to the shell. Such a name contains no characters that
+ * would require quoting, and is neither a shell reserved word nor a builtin
+ * (such as 'cd' or 'export', which only affect the shell itself, or 'echo',
+ * whose standalone program may behave differently).
+ * @param  name The command name (i.e. argv[0]).
+ * @return 1 if name is a plain program name, 0 otherwise.
+ */
+extern int      trycmd_is_plain_command(const char* name);
+
+/**
+ * Check whether the given path names an executable, regular file.
+ * @param  path The path to check.
+ * @return 0 if executable, otherwise -1 with errno set.
+ */
+extern int      trycmd_check_program(const char* path);
+
+/**
+ * Resolve the given program name to the path of an executable file.
+ * Names containing a slash are used as given. All others are searched for
+ * within each directory of PATH, in order, as the shell would. Searches
+ * are short-cut using the persistent cache (see trycmd_pathcache_open).
+ * @param  name     The program name (i.e. argv[0]).
+ * @param  path_out Destination for the resolved path.
+ * @param  path_len Length of path_out, in bytes.
+ * @return 0 on success, -1 on failure with errno set: ENOENT if no such
+ *         program was found, or EACCES if it was found but not executable.
+ */
+extern int      trycmd_find_program(const char* name,
+                                    char* path_out,
+                                    size_t path_len);
+
+/**
+ * Open the persistent PATH resolution cache for the given PATH string.
+ * The cache is held under $XDG_RUNTIME_DIR and is disabled if that is
+ * unset, or if TRY_PATH_CACHE=0 is present in the environment.
+ * @param  cache  The cache to open. Must be closed by the caller, even
+ *                on failure.
+ * @param  search The PATH string (must outlive cache).
+ * @return 0 on success, -1 if the cache is unavailable.
+ */
+extern int      trycmd_pathcache_open(struct trycmd_pathcache* cache,
+                                      const char* search);
+
+/**
+ * Close a cache opened by trycmd_pathcache_open().
+ * @param  cache The cache to close.
+ */
+extern void     trycmd_pathcache_close(struct trycmd_pathcache* cache);
+
+/**
+ * Find a program's previously resolved path within the cache.
+ * An entry is used only if no PATH directory, up to and including the one
+ * in which the program was found, has since changed; and if the program
+ * remains executable. No other PATH directories are searched.
+ * @param  cache    An open cache.
+ * @param  name     The program name (containing no slash).
+ * @param  path_out Destination for the resolved path.
+ * @param  path_len Length of path_out, in bytes.
+ * @return 0 on a valid hit, -1 otherwise.
+ */
+extern int      trycmd_pathcache_lookup(const struct trycmd_pathcache* cache,
+                                        const char* name,
+                                        char* path_out,
+                                        size_t path_len);
+
+/**
+ * Record a program's resolution within the cache.
+ * @param  cache     An open cache.
+ * @param  name      The program name (containing no slash).
+ * @param  dir_index Index of the PATH directory in which name was found.
+ */
+extern void     trycmd_pathcache_store(const struct trycmd_pathcache* cache,
+                                       const char* name,
+                                       unsigned int dir_index);
+
+/**
+ * Open the GNU make jobserver described by the given MAKEFLAGS, if any.
+ * Both the "--jobserver-auth=R,W" (or older "--jobserver-fds=R,W") and
+ * "--jobserver-auth=fifo:PATH" forms are supported. Inherited descriptors
+ * are made inheritable by all subcommands, so that any 'make' they run
+ * will share the same jobserver.
+ * @param  js        The jobserver to open.
+ * @param  makeflags The MAKEFLAGS value, or NULL.
+ * @return 0 on success, -1 if no usable jobserver is available.
+ */
+extern int      trycmd_jobserver_open(struct trycmd_jobserver* js,
+                                      const char* makeflags);
+
+/**
+ * Create a GNU make jobserver with the given number of slots, and export
+ * it to all subcommands via MAKEFLAGS. As with make, the calling process
+ * holds one implicit slot, so slots-1 tokens are made available.
+ * @param  js    The jobserver to create.
+ * @param  slots The total number of slots (at least 1).
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_jobserver_create(struct trycmd_jobserver* js,
+                                        int slots);
+
+/**
+ * Open any jobserver inherited via MAKEFLAGS or, failing that and if
+ * requested by opts->opt_jobserver, create one of opts->opt_jobs slots.
+ * @param  js   The jobserver to set up.
+ * @param  opts Options requesting a jobserver (if any).
+ * @return 0 if a jobserver is available, otherwise -1.
+ */
+extern int      trycmd_jobserver_setup(struct trycmd_jobserver* js,
+                                       const struct trycmd_opts* opts);
+
+/**
+ * Acquire a single token from the jobserver, without blocking.
+ * @param  js        An open jobserver.
+ * @param  token_out On success, the token acquired (to be released).
+ * @return 0 on success, -1 with errno set (EAGAIN if none are available).
+ */
+extern int      trycmd_jobserver_acquire(const struct trycmd_jobserver* js,
+                                         int* token_out);
+
+/**
+ * Return a token, as acquired by trycmd_jobserver_acquire.
+ * @param  js    An open jobserver.
+ * @param  token The token to return.
+ */
+extern void     trycmd_jobserver_release(const struct trycmd_jobserver* js,
+                                         int token);
+
+/**
+ * Close a jobserver opened by trycmd_jobserver_open() or created by
+ * trycmd_jobserver_create(). A created jobserver is destroyed and any
+ * previous MAKEFLAGS restored. Closing an unavailable jobserver is a no-op.
+ * @param  js The jobserver to close.
+ */
+extern void     trycmd_jobserver_close(struct trycmd_jobserver* js);
+
+/**
+ * Open a new, empty event loop.
+ * @param  loop The loop to open. Must be closed by the caller on success.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_open(struct trycmd_loop* loop);
+
+/**
+ * Close a loop opened by trycmd_loop_open(). All handlers must have been
+ * removed first. The signal mask is restored, as it was when opened.
+ * @param  loop The loop to close.
+ */
+extern void     trycmd_loop_close(struct trycmd_loop* loop);
+
+/**
+ * Register a handler for events upon any descriptor (which remains owned
+ * by the caller, and must not be closed until the handler is removed).
+ * @param  loop     An open loop.
+ * @param  handler  The handler to register.
+ * @param  fd       The descriptor to watch.
+ * @param  events   The epoll events to watch for (e.g. EPOLLIN).
+ * @param  callback The function called upon each event.
+ * @param  data     Context for callback.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_add(struct trycmd_loop* loop,
+                                struct trycmd_loop_handler* handler,
+                                int fd,
+                                uint32_t events,
+                                trycmd_loop_callback callback,
+                                void* data);
+
+/**
+ * Register a handler of a child's exit. The child is watched through its
+ * pidfd, which is opened (into child->pidfd) if need be, or otherwise upon
+ * each SIGCHLD. The callback is called once only, after which the child
+ * may be reaped without blocking; it must then remove the handler.
+ * @param  loop     An open loop.
+ * @param  handler  The handler to register.
+ * @param  child    The child to watch (unreaped).
+ * @param  callback The function called once the child has exited.
+ * @param  data     Context for callback.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_add_child(struct trycmd_loop* loop,
+                                      struct trycmd_loop_handler* handler,
+                                      struct trycmd_child* child,
+                                      trycmd_loop_callback callback,
+                                      void* data);
+
+/**
+ * Register a handler of a timer, which expires once after the given
+ * time (see trycmd_loop_set_timer).
+ * @param  loop     An open loop.
+ * @param  handler  The handler to register.
+ * @param  ms       The time until expiry, in milliseconds (0 for never).
+ * @param  callback The function called upon expiry.
+ * @param  data     Context for callback.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_add_timer(struct trycmd_loop* loop,
+                                      struct trycmd_loop_handler* handler,
+                                      unsigned long ms,
+                                      trycmd_loop_callback callback,
+                                      void* data);
+
+/**
+ * Re-arm (or, given 0ms, disarm) a timer registered by
+ * trycmd_loop_add_timer, to expire once after the given time.
+ * @param  handler The timer's handler.
+ * @param  ms      The time until expiry, in milliseconds (0 for never).
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_set_timer(struct trycmd_loop_handler* handler,
+                                      unsigned long ms);
+
+/**
+ * Register a handler of the given signals, which are blocked (until the
+ * loop is closed) and instead received through a signalfd. The callback
+ * should read every pending signal, using trycmd_loop_read_signal.
+ * @param  loop     An open loop.
+ * @param  handler  The handler to register.
+ * @param  signals  The signals to handle.
+ * @param  callback The function called once any signal is pending.
+ * @param  data     Context for callback.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+extern int      trycmd_loop_add_signals(struct trycmd_loop* loop,
+                                        struct trycmd_loop_handler* handler,
+                                        const sigset_t* signals,
+                                        trycmd_loop_callback callback,
+                                        void* data);
+
+/**
+ * Read the next pending signal from a signal handler, without blocking.
+ * @param  handler A handler registered by trycmd_loop_add_signals.
+ * @return The signal's number, or 0 if none is pending.
+ */
+extern int      trycmd_loop_read_signal(const struct trycmd_loop_handler* handler);
+
+/**
+ * Remove a handler from its loop. This may be called from within any
+ * callback, for any handler. Removing an unregistered handler is a no-op.
+ * @param  loop    An open loop.
+ * @param  handler The handler to remove.
+ */
+extern void     trycmd_loop_remove(struct trycmd_loop* loop,
+                                   struct trycmd_loop_handler* handler);
+
+/**
+ * Dispatch events, one at a time, until trycmd_loop_stop is called or no
+ * handlers remain registered.
+ * @param  loop An open loop.
+ * @return 0 on success, -1 if events could not be waited for.
+ */
+extern int      trycmd_loop_run(struct trycmd_loop* loop);
+
+/**
+ * Request that trycmd_loop_run returns, once the current event is handled.
+ * @param  loop An open loop.
+ */
+extern void     trycmd_loop_stop(struct trycmd_loop* loop);
+
+/**
+ * Begin supervising a started subcommand upon the given loop. Its exit is
+ * awaited and, if opts->opt_timeout is non-zero, its process group is sent
+ * SIGTERM once that has passed, then SIGKILL once any opts->opt_kill_after
+ * has also passed (or the subcommand has exited, whichever is first). Once
+ * the subcommand has been reaped, finished is called with its exit status
+ * (TRYCMD_STATUS_TIMED_OUT, if timed out) in monitor->exit_status.
+ * @param  loop     An open loop.
+ * @param  monitor  The monitor to start.
+ * @param  opts     Options describing the subcommand (must outlive monitor).
+ * @param  child    The started subcommand, now owned by monitor.
+ * @param  finished The function called once the subcommand has finished.
+ * @param  data     Context for finished.
+ * @return 0 on success, or -1 on failure with errno set (in which case the
+ *         subcommand will have been killed and reaped).
+ */
+extern int      trycmd_monitor_start(struct trycmd_loop* loop,
+                                     struct trycmd_monitor* monitor,
+                                     const struct trycmd_opts* opts,
+                                     const struct trycmd_child* child,
+                                     void (*finished)(struct trycmd_loop*,
+                                                      struct trycmd_monitor*),
+                                     void* data);
+
+/**
+ * Stop supervising a subcommand, killing and reaping it (and its process
+ * group) if it is still running. finished is not called.
+ * @param  loop    The monitor's loop.
+ * @param  monitor The monitor to cancel.
+ */
+extern void     trycmd_monitor_cancel(struct trycmd_loop* loop,
+                                      struct trycmd_monitor* monitor);
+
+/**
+ * Send the given signal to a supervised subcommand's process group or,
+ * should it have none of its own, to the subcommand alone. Does nothing
+ * if the subcommand is no longer running.
+ * @param  monitor The subcommand's monitor.
+ * @param  signum  The signal to send.
+ */
+extern void     trycmd_monitor_signal(const struct trycmd_monitor* monitor,
+                                      int signum);
+
+/**
+ * Fill the given set with those signals which try forwards to subcommands
+ * running within process groups of their own (SIGHUP, SIGINT, SIGQUIT and
+ * SIGTERM), which would otherwise not receive them from the terminal.
+ * @param  signals The set to fill.
+ */
+extern void     trycmd_forwarded_signals(sigset_t* signals);
+
+/**
+ * Open performance counters upon the calling process, each disabled but
+ * inherited by every process it creates afterwards, and enabled within
+ * those only once they exec. The counts of each such process are added
+ * to the calling process's upon its exit. Hardware events are counted if
+ * available, otherwise further software events are counted instead.
+ * @param  perf The counters to open.
+ * @return 0 if any event could be opened, otherwise -1.
+ */
+extern int      trycmd_perf_open(struct trycmd_perf* perf);
 
-    /**
-     * Use color in trycmd output if and only if
-     * output is connected to a terminal (TTY).
-     */
-    trycmd_color_auto
-};
+/**
+ * Read the counts of all events opened by trycmd_perf_open(). Values of
+ * events which were multiplexed are scaled to estimate their totals.
+ * @param  perf   The counters to read.
+ * @param  counts The values read.
+ */
+extern void     trycmd_perf_read(const struct trycmd_perf* perf,
+                                 struct trycmd_perf_counts* counts);
 
-/** Options settable by users via the command-line or environment. */
-struct trycmd_opts {
-    /**
-     * If non-zero, spawn all subcommands within an interactive subshell.
-     * Setting this option may be required if the command is an alias, or
-     * similar. Alias commands will likely only be interpretted as proper
-     * commands within the shell if it is interactive.
-     */
-    int               opt_interactive;
+/**
+ * Close all counters opened by trycmd_perf_open().
+ * @param  perf The counters to close.
+ */
+extern void     trycmd_perf_close(struct trycmd_perf* perf);
 
-    /**
-     * Control of colored output. If 'never', output will always be in
-     * the terminal's standard color scheme. If 'always', output will
-     * always be colored and change according to subcommand exit status.
-     * If 'auto', output will be colored if any only if connected to
-     * a terminal (TTY).
-     */
-    enum trycmd_color opt_color;
+/** The name of each performance event, as shown in a result message. */
+extern const char* const trycmd_perf_names[trycmd_perf_events];
 
-    /**
-     * The path to the shell within which all subcommands are to be spawned.
-     * This shell must support the '-i' interactive, '-c' command string and
-     * '--' end-of-options options in order to function correctly.
-     */
-    char*             opt_shell;
+/**
+ * Print the given performance counter values on a single line, followed by
+ * the instructions per cycle (if both were counted).
+ * @param  counts The values to print.
+ * @param  os     The destination stream (stdout, stderr).
+ */
+extern void     trycmd_print_perf(const struct trycmd_perf_counts* counts,
+                                  FILE* os);
 
-    /**
-     * If non-zero, enables verbose application output.
-     * This will print the command being spawned onto stderr.
-     */
-    int               opt_verbose;
+/**
+ * Create (or truncate) any given log file, then a pipe for each of the
+ * standard output and error, to be given to subcommands in their place
+ * (see trycmd_relay_stream::child_fd). Data arriving within either pipe is
+ * written to both try's own output and the log (and tail), upon the given
+ * loop. Where try's output is itself a pipe, data is relayed with tee(2)
+ * and splice(2) so as never to be copied through user space (unless a
+ * tail is kept); otherwise (as for a terminal) it is copied. Given a
+ * spool, both outputs are written there in place of try's own, spliced
+ * where neither a log nor tail is kept. Without any log, tail or spool,
+ * output is relayed unchanged (unless timestamped).
+ * @param  loop  The loop upon which to relay data.
+ * @param  relay The relay to open.
+ * @param  path  The log file's path, or NULL for none.
+ * @param  tail  A ring buffer to keep all output's tail, or NULL for none.
+ * @param  spool A spool to hold back all output, or NULL for none.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_relay_open(struct trycmd_loop* loop,
+                                  struct trycmd_relay* relay,
+                                  const char* path,
+                                  struct trycmd_ring* tail,
+                                  struct trycmd_spool* spool);
 
-    /**
-     * If non-zero, prints application usage information to stdout.
-     * If help is requested then no subcommand will be spawned.
-     */
-    int               opt_help;
+/**
+ * Relay all data now waiting, such as that written by a subcommand which
+ * has since exited. This does not wait for any further data.
+ * @param  relay The relay to flush.
+ */
+extern void     trycmd_relay_flush(struct trycmd_relay* relay);
 
-    /**
-     * Subcommand argument count.
-     * The length of opt_sub_argv in elements, less any terminating NULL.
-     */
-    int               opt_sub_argc;
+/**
+ * Gain a stream upon the relay's log, to which other messages may be
+ * written amongst relayed data (once flushed).
+ * @param  relay The relay whose log to use.
+ * @return The log stream, or NULL on failure.
+ */
+extern FILE*    trycmd_relay_log(struct trycmd_relay* relay);
 
-    /**
-     * Subcommand argument list.
-     * This list does not require a NULL terminator.
-     */
-    char**            opt_sub_argv;
-};
+/**
+ * Relay all data now waiting, then close everything opened by
+ * trycmd_relay_open(). Data written by any process still holding a pipe
+ * is lost.
+ * @param  relay The relay to close.
+ */
+extern void     trycmd_relay_close(struct trycmd_relay* relay);
 
-/** If non-zero, enables the printing of application diagnostic output. */
-extern int      trycmd_debug_enabled;
+/**
+ * Allocate a ring buffer of the given size.
+ * @param  ring The ring buffer to initialise.
+ * @param  size The number of bytes to keep (non-zero).
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_ring_init(struct trycmd_ring* ring, size_t size);
 
 /**
- * Initialise the Try diagnostic system.
- * If TRYCMD_DEBUG is present in the environment, and non-zero,
- * then diagnostics will be enabled.
+ * Write data to a ring buffer, overwriting its oldest data once full.
+ * @param  ring The ring buffer to write.
+ * @param  data The data to write.
+ * @param  len  The length of data in bytes.
  */
-extern void     trycmd_debug_init(void);
+extern void     trycmd_ring_write(struct trycmd_ring* ring,
+                                  const char* data,
+                                  size_t len);
 
 /**
- * Print a single diagnostic message.
- * @param format A standard printf format string
+ * Print the last lines kept by a ring buffer, ending with a newline. If
+ * the oldest line kept was partly overwritten, it is never printed.
+ * @param  ring  The ring buffer to print.
+ * @param  lines The number of lines to print, or zero for all kept.
+ * @param  os    The destination stream (stdout, stderr).
  */
-extern void     trycmd_debug(const char* format, ...);
+extern void     trycmd_ring_print(const struct trycmd_ring* ring,
+                                  unsigned long lines,
+                                  FILE* os);
 
 /**
- * Initialize application strings internationalization support.
- * Must be called once, at application startup and before any calls
- * to the _() or N_() functions.
+ * Release a ring buffer allocated by trycmd_ring_init() (if any).
+ * @param  ring The ring buffer to release.
  */
-extern void     trycmd_intl_init(void);
+extern void     trycmd_ring_free(struct trycmd_ring* ring);
 
 /**
- * Translates the given string, to the user's
- * own language, using the current LOCALE.
- * @param  s The string to be translated.
- * @return The translated string, or s if no more
- *         appropriate translation was available.
+ * Prepare an arena of at least the given size, sized by a single pass over
+ * all that will be allocated. Storage of up to TRYCMD_ARENA_LOCAL_SIZE
+ * bytes is held within the arena itself (so, as a local variable, upon the
+ * stack); any more is mapped, so that commands of up to the kernel's
+ * ARG_MAX may be built without using the heap or overflowing the stack.
+ * @param  arena The arena to prepare.
+ * @param  size  The number of bytes to be allocated from the arena.
+ * @return 0 on success, -1 on failure.
  */
-extern char*    _(char* s);
+extern int      trycmd_arena_init(struct trycmd_arena* arena, size_t size);
 
 /**
- * Performs a null translation upon the given string.
- * This is sibling to the _() translation function. It intentionally does
- * nothing to the given string and is used to document that strings are not
- * to be translated (because they are either non-translatable or critical).
- * @param  s The string to be translated.
- * @return s unmodified.
+ * Allocate from an arena, aligned as for a pointer.
+ * @param  arena The arena from which to allocate.
+ * @param  size  The number of bytes to allocate.
+ * @return The storage allocated, or NULL if the arena is exhausted.
  */
-inline char*    N_(char* s) {
-    /* Intentionally do nothing but return the given string. */
-    return s;
-}
+extern void*    trycmd_arena_alloc(struct trycmd_arena* arena, size_t size);
 
 /**
- * Construct a shell command for use with the standard exec functions.
- * Converts the given options - shell and subcommand - to  an argument
- * list for passing to one of the family of exec functions.
- * @param  opts     Input options defining the shell and subcommand.
- * @param  buffer   Generic storage to hold argv_out data.
- * @param  buflen   Length of buffer, in bytes.
- * @param  argv_out Output command (stored in buffer).
- * @return The required or used buflen to store the command, in full.
- *         If buflen is less than this required length, then no output
- *         will be written to either buffer or argv_out.
+ * Release an arena prepared by trycmd_arena_init(), and all allocated
+ * from it.
+ * @param  arena The arena to release.
  */
-extern size_t   trycmd_make_shell_cmd(const struct trycmd_opts* opts,
-                                      void*  buffer,
-                                      size_t buflen,
-                                      char** argv_out[]);
+extern void     trycmd_arena_free(struct trycmd_arena* arena);
 
 /**
- * Construct and run a shell command from the given options.
- * Upon completion of the subcommand (if any), this function will return
- * its exit status as-if it had been run from a terminal directly. An exit
- * status of zero indicates success, any other value indicates failure. For
- * more information on specific error codes, refer to the Bash shell's
- * documentation on exit status codes, behavior this function duplicates.
- * @param  opts Options describing the shell and subcommand.
- * @return The subcommand's result value as-if it had been run from a
- *         terminal, directly.
+ * Open a destination for JSON result records: either an inherited
+ * descriptor, given by number (e.g. "3"), or a file to be appended (and
+ * created if necessary). A descriptor is duplicated, and the original left
+ * open for subcommands; the duplicate or file is closed upon exec, so is
+ * never inherited by subcommands.
+ * @param  json   The destination to open.
+ * @param  target The descriptor number or file path.
+ * @return 0 on success, -1 on failure.
  */
-extern int      trycmd_run_subcommand(const struct trycmd_opts* opts);
+extern int      trycmd_json_open(struct trycmd_json* json, const char* target);
 
 /**
- * Print a colorful message for the given subcommand exit status.
- * If exit_status is zero, this will be interpretted as success.
- * A non-zero exit_status will be interpretted as failure.
- * @param  opts Options describing the subcommand.
- * @param  exit_status The exit status to illustrate.
- * @param  os   The destination stream (stdout, stderr).
+ * Write a subcommand's result as a single line of JSON (NDJSON). Each
+ * record holds: "argv", an array of the subcommand's arguments; "command",
+ * the subcommand as shown by trycmd_print_argv(); "status", its exit
+ * status; "signal", the signal which ended it (or null); "timed_out" and
+ * "attempts"; "start" and "end", as UTC timestamps; "duration_ns", the time
+ * spent running; "rusage", the resources used (see trycmd_result::rusage)
+ * and, if opts->opt_perf, "perf", the performance counters read.
+ * The record is written in a single write(2) unless exceeding 64KiB.
+ * @param  json   The destination.
+ * @param  opts   The subcommand's options.
+ * @param  result The subcommand's result.
+ * @return 0 on success, -1 on failure.
  */
-extern int      trycmd_show_exit_status(const struct trycmd_opts* opts,
-                                        int exit_status,
-                                        FILE* os);
+extern int      trycmd_json_write(struct trycmd_json* json,
+                                  const struct trycmd_opts* opts,
+                                  const struct trycmd_result* result);
 
 /**
- * Print this application's usage information to the given stream.
- * This is given in the form of a human-readable message.
- * @param  os The destination stream (stdout, stderr).
+ * Close a destination for JSON result records.
+ * @param  json The destination to close.
  */
-extern void     trycmd_print_usage(FILE* os);
+extern void     trycmd_json_close(struct trycmd_json* json);
 
 /**
- * Read and parse the given option strings into a trycmd_opts structure.
- * Command-line options:
- *   1. \-i \-\-interactive
- *      Force the subshell to behave as-if it was an interactive session.
- *      This option may be necessary if your command is, or relies upon,
- *      aliases.
- *   2. \-\-color[=WHEN], \-\-colour[=WHEN]
- *      Color the result according to command's exit status.
- *   3. \-v \-\-verbose
- *      Enable verbose output.
- *   4. \-h \-\-help
- *      Display a usage message on stdout and exit successfully.
- *
- * Environment options:
- *   1. TRY_INTERACTIVE=1
- *      Always execute commands in an interactive subshell.
- *   2. TRY_COLOR=WHEN
- *      Add color to the result (see '--color').
- *   3. SHELL=/bin/sh
- *      The shell to use when executing the command.
- *
- * @param  argc     The length of argv in elements.
- * @param  argv     The command-line arguments, in the order presented
- *                  by the user (need not be NULL terminated).
- * @param  opts_out The options translated into a trycmd_opts structure.
+ * Prepare a subcommand's entry within a result cache, creating the cache
+ * directory if necessary. The entry is named by a 128-bit key: a hash of
+ * the subcommand's arguments, working directory and how it is executed,
+ * of each environment variable within opts->opt_cache_env, and of the
+ * name and content of each file matching opts->opt_inputs. A pattern
+ * matching no file is hashed itself, so that the file's later creation
+ * changes the key.
+ * @param  cache The entry to prepare.
+ * @param  opts  The subcommand's options.
+ * @return 0 on success, -1 on failure (as should an input be unreadable).
+ */
+extern int      trycmd_cache_open(struct trycmd_cache* cache,
+                                  const struct trycmd_opts* opts);
+
+/**
+ * Replay a cached result, if there is one: its standard output and error
+ * are written to try's own (unless quiet and successful), and the entry
+ * is marked as recently used.
+ * @param  cache      The entry.
+ * @param  result_out The replayed result (only exit_status and cached are
+ *                    set).
+ * @return 0 if replayed, -1 if there is no such result.
+ */
+extern int      trycmd_cache_replay(struct trycmd_cache* cache,
+                                    struct trycmd_result* result_out);
+
+/**
+ * Begin to capture the subcommand's output, within cache->output, to be
+ * kept by trycmd_cache_store(). See trycmd_relay_stream::capture.
+ * @param  cache The entry.
  * @return 0 on success, -1 on failure.
  */
-extern int      trycmd_read_options(int argc, char* argv[],
-                                    struct trycmd_opts* opts_out);
+extern int      trycmd_cache_capture(struct trycmd_cache* cache);
 
 /**
- * Convert the given WHEN string to a trycmd_color value.
- * Supported WHEN values are: "never", "always", and "auto", and each
- * maps to its corresponding trycmd_color enumerated counterpart. If
- * the given WHEN value is unrecognised, this function will return -1.
- * @param  when The input WHEN string.
- * @param  out  On success, destination for the parsed result.
+ * Keep a result and the output captured, replacing any entry of the same
+ * key, then evict the least recently used entries until the cache is
+ * within opts->opt_cache_size.
+ * @param  cache  The entry.
+ * @param  result The subcommand's result.
  * @return 0 on success, -1 on failure.
  */
-extern int      trycmd_parse_when(const char* when, enum trycmd_color* out);
+extern int      trycmd_cache_store(struct trycmd_cache* cache,
+                                   const struct trycmd_result* result);
+
+/**
+ * Release a cache entry, and any output captured.
+ * @param  cache The entry.
+ */
+extern void     trycmd_cache_close(struct trycmd_cache* cache);
+
+/**
+ * Hash a subcommand, identifying it within a history file.
+ * @param  argv The subcommand's arguments, NULL terminated.
+ * @return The subcommand's hash.
+ */
+extern uint64_t trycmd_history_hash(char* const argv[]);
+
+/**
+ * Append a subcommand's result to a history file (created if necessary)
+ * as a single fixed-size record of: the subcommand's hash (see
+ * trycmd_history_hash), its exit status, when it started, how long it ran,
+ * its maximum resident set size, and the start of its arguments. The
+ * record is appended by a single write(2), so that concurrent appends to
+ * the same file are never interleaved.
+ * @param  path   The history file.
+ * @param  opts   The subcommand's options.
+ * @param  result The subcommand's result.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_history_append(const char* path,
+                                      const struct trycmd_opts* opts,
+                                      const struct trycmd_result* result);
+
+/**
+ * Summarize the results within a history file, printing one line for
+ * each subcommand (in order of first run) of the form:
+ *   "History (runs=N, failed=P%, p50=T, p90=T, p99=T): COMMAND"
+ * where each T is that percentile of the subcommand's durations. Any
+ * incomplete or unrecognised record is ignored.
+ * @param  path The history file.
+ * @param  argv The subcommand to summarize, NULL terminated, or NULL to
+ *              summarize every subcommand.
+ * @param  os   The stream upon which to print.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_history_report(const char* path,
+                                      char* const argv[],
+                                      FILE* os);
+
+/**
+ * Write all of the given data to a descriptor, despite any interruption.
+ * @param  fd   The destination descriptor.
+ * @param  data The data to write.
+ * @param  len  The length of data in bytes.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_write_all(int fd, const char* data, size_t len);
+
+/**
+ * Write all of the given buffers to a descriptor, despite any interruption
+ * or partial write. The buffers are consumed as they are written.
+ * @param  fd     The destination descriptor.
+ * @param  iov    The buffers to write.
+ * @param  iovcnt The number of buffers.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_writev_all(int fd, struct iovec* iov, int iovcnt);
+
+/**
+ * Open a buffer, into which a message for the given stream may be rendered
+ * whole (see open_memstream(3)), so that it is written by a single write(2)
+ * by trycmd_obuf_flush(). So written, a message costs one system call
+ * however many parts it is printed in, even to an unbuffered stream such
+ * as stderr, and is not interleaved with those of other writers. Where
+ * dest has no descriptor (as a memory stream), or no buffer can be made,
+ * the message is instead rendered into dest directly.
+ * @param  obuf The buffer to open.
+ * @param  dest The stream to which the message is to be written.
+ * @return The stream into which to render the message (never NULL).
+ */
+extern FILE*    trycmd_obuf_open(struct trycmd_obuf* obuf, FILE* dest);
+
+/**
+ * Close a buffer opened by trycmd_obuf_open(), writing its message to the
+ * destination stream after anything already pending upon it.
+ * @param  obuf The buffer to flush and close.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_obuf_flush(struct trycmd_obuf* obuf);
+
+/**
+ * Copy part of one descriptor to another, at the latter's current offset,
+ * without copying through user space where possible (see sendfile(2)).
+ * @param  out_fd The destination descriptor.
+ * @param  in_fd  The source descriptor, which must support pread(2).
+ * @param  offset The offset within in_fd from which to copy.
+ * @param  len    The number of bytes to copy.
+ * @return 0 on success, -1 on failure (including should in_fd end early).
+ */
+extern int      trycmd_sendfile_all(int out_fd, int in_fd, off_t offset,
+                                    uint64_t len);
+
+/**
+ * Open a spool, to hold back output in memory (see memfd_create(2)) until
+ * it exceeds the given limit, then within an unlinked temporary file in
+ * $TMPDIR (or /tmp). Where memory-backed files are unavailable, a
+ * temporary file is used throughout.
+ * @param  spool The spool to open.
+ * @param  limit The number of bytes which may be held in memory.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_spool_open(struct trycmd_spool* spool, uint64_t limit);
+
+/**
+ * Append data to a spool.
+ * @param  spool The spool to write.
+ * @param  data  The data to write.
+ * @param  len   The length of data in bytes.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_spool_write(struct trycmd_spool* spool,
+                                   const char* data,
+                                   size_t len);
+
+/**
+ * Append the given buffers to a spool. The buffers are consumed as they
+ * are written.
+ * @param  spool  The spool to write.
+ * @param  iov    The buffers to write.
+ * @param  iovcnt The number of buffers.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_spool_writev(struct trycmd_spool* spool,
+                                    struct iovec* iov,
+                                    int iovcnt);
+
+/**
+ * Move up to len bytes, known to be waiting within a pipe, to a spool
+ * with splice(2) (or, where unsupported, by copying).
+ * @param  spool   The spool to write.
+ * @param  pipe_fd The pipe's read end.
+ * @param  len     The number of bytes waiting.
+ * @return The number of bytes moved, or -1 on failure.
+ */
+extern ssize_t  trycmd_spool_splice(struct trycmd_spool* spool,
+                                    int pipe_fd,
+                                    size_t len);
+
+/**
+ * Write everything spooled to the given descriptor, with sendfile(2)
+ * where possible. The spool itself is unchanged.
+ * @param  spool  The spool to replay.
+ * @param  out_fd The destination descriptor.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_spool_replay(const struct trycmd_spool* spool,
+                                    int out_fd);
+
+/**
+ * Close a spool, discarding everything within it.
+ * @param  spool The spool to close.
+ */
+extern void     trycmd_spool_close(struct trycmd_spool* spool);
+
+/**
+ * Convert the given DURATION string to milliseconds.
+ * DURATION is a non-negative decimal number (e.g. "1.5") with an optional
+ * unit suffix: "ms", "s" (the default), "m" or "h".
+ * @param  text The input DURATION string.
+ * @param  out  On success, the duration in milliseconds.
+ * @return 0 on success, -1 on failure.
+ */
+extern int      trycmd_parse_duration(const char* text, unsigned long* out);
+
+/**
+ * Read the monotonic clock.
+ * @return The current time, in nanoseconds since an arbitrary point.
+ */
+extern uint64_t trycmd_clock_ns(void);
+
+/**
+ * Compute a 64-bit, non-cryptographic hash (FNV-1a) of the given data.
+ * @param  data The data to hash.
+ * @param  len  Length of data, in bytes.
+ * @param  seed A previous hash to continue from, or 0 to begin.
+ * @return The hash value.
+ */
+extern uint64_t trycmd_hash64(const void* data, size_t len, uint64_t seed);
+
+/**
+ * Compute a 64-bit, non-cryptographic hash (XXH64) of the given data.
+ * Unlike trycmd_hash64(), this consumes several bytes per cycle, so suits
+ * the hashing of whole files.
+ * @param  data The data to hash.
+ * @param  len  Length of data, in bytes.
+ * @param  seed The seed (such as a previous hash to continue from).
+ * @return The hash value.
+ */
+extern uint64_t trycmd_xxh64(const void* data, size_t len, uint64_t seed);
 
 /**
  * Align the given size up, to fall on the next aligned boundary.
@@ -271,12 +2139,25 @@ extern int      trycmd_is_color_enabled(enum trycmd_color c, FILE* os);
 
 /**
  * Check whether the given character would require 'quoting' if passed to
- * a typical shell.
+ * a typical shell. Only [0-9a-zA-Z], '_', '-', '.' and '/' do not, in
+ * every locale.
  * @param  c The ASCII character to check.
  * @return Non-zero if the character requires quoting, 0 otherwise.
  */
 extern int      trycmd_needs_quoting(char c);
 
+/**
+ * Check whether the given argument would require 'quoting' if passed to
+ * a typical shell (see trycmd_needs_quoting), and count its single quotes,
+ * in one pass. Where available, SSE2 is used to classify sixteen bytes at
+ * a time.
+ * @param  arg        The argument to check.
+ * @param  len        The length of arg in bytes.
+ * @param  quotes_out Set to the number of single quotes within arg.
+ * @return Non-zero if the argument requires quoting, 0 otherwise.
+ */
+extern int      trycmd_scan_arg(const char* arg, size_t len, size_t* quotes_out);
+
 /**
  * Print a given command-line argument with quoting as necessary.
  * @param  arg The argument to be printed as null-terminated string.
@@ -292,6 +2173,42 @@ extern void     trycmd_pretty_print_arg(const char* arg, FILE* os);
  */
 extern void     trycmd_print_argv(const char* prefix, char* argv[], FILE* os);
 
+/**
+ * Have a resident daemon (see trycmd_daemon_serve) run try for the given
+ * command-line options, if TRY_DAEMON names its socket. The daemon is
+ * passed the arguments, environment, working directory, umask and every
+ * inheritable descriptor below 64, so that it behaves as would
+ * trycmd_main(). Meanwhile, SIGHUP, SIGINT, SIGQUIT and SIGTERM are
+ * forwarded to the daemon's worker.
+ * @param  argc       The length of argv in elements.
+ * @param  argv       The command-line arguments.
+ * @param  result_out On success, the result of trycmd_main() as run by the
+ *                    daemon.
+ * @return 0 on success, -1 if there is no daemon to run the command (in
+ *         which case nothing has been run).
+ */
+extern int      trycmd_daemon_call(int argc, char* argv[], int* result_out);
+
+/**
+ * Serve requests from trycmd_daemon_call() upon a Unix socket, created at
+ * the given path (accessible only to the current user), until stopped by
+ * SIGHUP, SIGINT, SIGQUIT or SIGTERM. Each request is served by one of a
+ * pool of forked workers, already waiting upon the socket, which is then
+ * replaced.
+ * @param  path    The socket's path.
+ * @param  workers The number of workers to keep waiting.
+ * @return 0 once stopped, -1 on failure.
+ */
+extern int      trycmd_daemon_serve(const char* path, int workers);
+
+/**
+ * Daemon entry point. Runs 'tryd' for the given command-line options.
+ * @param  argc The length of argv in elements.
+ * @param  argv The command-line arguments.
+ * @return 0 on success, non-zero on failure.
+ */
+extern int      trycmd_daemon_main(int argc, char* argv[]);
+
 /**
  * Application entry point. Runs 'try' for the given command-line options.
  * @param  argc The length of argv in elements.
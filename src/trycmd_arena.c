@@ -0,0 +1,74 @@
+/**
+ * \file      trycmd_arena.c
+ * \brief     A bump allocator, holding a command as it is built.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno. */
+#include <stddef.h>        /* size_t. */
+#include <string.h>        /* strerror. */
+#include <sys/mman.h>      /* mmap, munmap, MAP_*, PROT_*. */
+
+int trycmd_arena_init(struct trycmd_arena* const arena, const size_t size) {
+    /* Check arguments. */
+    assert("Unexpected NULL arena" && (arena != NULL));
+    arena->used   = 0;
+    arena->mapped = 0;
+
+    /* Use local storage where it suffices. */
+    if (size <= sizeof(arena->local.bytes)) {
+        arena->base = arena->local.bytes;
+        arena->size = sizeof(arena->local.bytes);
+        return 0;
+    }
+
+    /* Otherwise, map fresh pages: these are returned whole once freed. */
+    arena->base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena->base == MAP_FAILED) {
+        trycmd_debug("trycmd_arena_init: cannot map %zu byte(s): %s\n",
+                     size, strerror(errno));
+        arena->base = NULL;
+        arena->size = 0;
+        return -1;
+    }
+    arena->size   = size;
+    arena->mapped = 1;
+    return 0;
+}
+
+void* trycmd_arena_alloc(struct trycmd_arena* const arena, const size_t size) {
+    size_t offset;
+
+    /* Check arguments. */
+    assert("Unexpected NULL arena" && (arena != NULL));
+
+    /* Bump the allocation, if room remains. */
+    offset = trycmd_align_sz(arena->used, sizeof(char*));
+    if (offset > arena->size || size > arena->size - offset) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return &arena->base[offset];
+}
+
+void trycmd_arena_free(struct trycmd_arena* const arena) {
+    /* Check arguments. */
+    assert("Unexpected NULL arena" && (arena != NULL));
+    if (arena->mapped) {
+        munmap(arena->base, arena->size);
+    }
+    arena->base   = NULL;
+    arena->size   = 0;
+    arena->used   = 0;
+    arena->mapped = 0;
+}
+
+/* EOF */
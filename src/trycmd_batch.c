@@ -0,0 +1,499 @@
+/**
+ * \file      trycmd_batch.c
+ * \brief     Run a batch of subcommands upon a bounded pool of children.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno. */
+#include <fcntl.h>         /* open, O_*. */
+#include <signal.h>        /* sigset_t. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint64_t. */
+#include <stdio.h>         /* FILE, fopen, fclose, getline, fprintf. */
+#include <stdlib.h>        /* calloc, free, EXIT_FAILURE. */
+#include <string.h>        /* memset, strcmp, strerror, strspn. */
+#include <sys/epoll.h>     /* EPOLLIN. */
+#include <time.h>          /* clock_gettime, CLOCK_REALTIME. */
+#include <unistd.h>        /* close. */
+#include <wordexp.h>       /* wordexp, wordfree. */
+
+struct trycmd_batch_state;
+
+/** A single batch command, which is running or has yet to be started. */
+struct trycmd_batch_job {
+    /** The command's options, whose subcommand is words.we_wordv. */
+    struct trycmd_opts  opts;
+
+    /** The command's words, as expanded from its line. */
+    wordexp_t           words;
+
+    /** The command's monitor, whose pid is -1 if this slot is free. */
+    struct trycmd_monitor monitor;
+
+    /** The jobserver token held by the command, or -1 if none. */
+    int                 token;
+
+    /** When the command was started (see trycmd_clock_ns). */
+    uint64_t            start_ns;
+
+    /** When the command was started (by CLOCK_REALTIME). */
+    struct timespec     started;
+
+    /** The batch to which this command belongs. */
+    struct trycmd_batch_state* state;
+};
+
+/** The progress of a batch, so far. */
+struct trycmd_batch_state {
+    const struct trycmd_opts* opts;
+    unsigned long succeeded;
+    unsigned long failed;
+    unsigned long skipped;
+    unsigned long line_no;
+    int           result;
+    int           stop;
+
+    /** The batch input and its current line. */
+    FILE*         is;
+    char*         line;
+    size_t        line_len;
+    int           at_end;
+
+    /** The pool of opts->opt_jobs slots, and how many are in use. */
+    struct trycmd_batch_job* jobs;
+    struct trycmd_spawn_attr spawn_attr;
+    int           running;
+    int           untokened;
+
+    /** The event loop, upon which every command is supervised. */
+    struct trycmd_loop loop;
+    struct trycmd_loop_handler token_handler;
+    struct trycmd_loop_handler signal_handler;
+
+    /** The relay of all output, if have_relay is non-zero. */
+    int           have_relay;
+    struct trycmd_relay relay;
+
+    /** The destination of JSON result records, if have_json is non-zero. */
+    int           have_json;
+    struct trycmd_json json;
+
+    /** The jobserver, if have_jobserver is non-zero. */
+    int           have_jobserver;
+    struct trycmd_jobserver jobserver;
+};
+
+/**
+ * Read the next command from the given batch stream into job.
+ * Blank and comment lines are skipped.
+ * @return 1 if a command was read, 0 at end of input, or -1 if the next
+ *         command could not be parsed (in which case it is consumed).
+ */
+static int trycmd_batch_read(const struct trycmd_opts* const opts,
+                             FILE* const is,
+                             char** const line,
+                             size_t* const line_len,
+                             struct trycmd_batch_state* const state,
+                             struct trycmd_batch_job* const job) {
+    ssize_t len;
+    while ((len = getline(line, line_len, is)) >= 0) {
+        const char* start;
+        int result;
+
+        /* Strip the line's end then skip any blank or comment line. */
+        ++state->line_no;
+        if (len > 0 && (*line)[len - 1] == '\n') {
+            (*line)[--len] = '\0';
+        }
+        start = *line + strspn(*line, " \t");
+        if (start[0] == '\0' || start[0] == '#') {
+            continue;
+        }
+
+        /* Split the line into words, as a shell would (but run nothing). */
+        result = wordexp(start, &job->words, WRDE_NOCMD);
+        if (result != 0) {
+            if (result == WRDE_NOSPACE) {
+                wordfree(&job->words);
+            }
+            fprintf(stderr, _("try: %s:%lu: cannot parse command: %s\n"),
+                    opts->opt_batch, state->line_no, start);
+            return -1;
+        }
+        if (job->words.we_wordc == 0) {
+            wordfree(&job->words);
+            continue;
+        }
+        job->opts = *opts;
+        job->opts.opt_retry = 0;  /* Batch commands are never retried, */
+        job->opts.opt_perf  = 0;  /* nor counted (see trycmd_perf_open). */
+        job->opts.opt_sub_argc = (int)job->words.we_wordc;
+        job->opts.opt_sub_argv = job->words.we_wordv;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Record a command's completion, showing its exit status then
+ * releasing its slot.
+ */
+static void trycmd_batch_finish(struct trycmd_batch_state* const state,
+                                struct trycmd_batch_job* const job,
+                                const int exit_status) {
+    struct trycmd_result result;
+    result.exit_status = exit_status;
+    result.attempts    = 1;
+    result.elapsed_ns  = trycmd_clock_ns() - job->start_ns;
+    result.timed_out   = job->monitor.timed_out;
+    result.term_signal = job->monitor.term_signal;
+    result.started     = job->started;
+    result.rusage      = job->monitor.rusage;
+    clock_gettime(CLOCK_REALTIME, &result.ended);
+    memset(&result.tail, 0, sizeof(result.tail));  /* Never kept. */
+    result.cached      = 0;                        /* Never cached. */
+    result.cancelled   = 0;
+    trycmd_show_result(&job->opts, &result, stderr);
+    if (state->have_relay && trycmd_relay_log(&state->relay) != NULL) {
+        trycmd_show_result(&job->opts, &result, state->relay.log);
+        fflush(state->relay.log);
+    }
+    if (state->have_json && trycmd_json_write(&state->json, &job->opts,
+                                              &result) != 0) {
+        trycmd_debug("trycmd_batch_finish: cannot write JSON: %s\n",
+                     strerror(errno));
+    }
+    if (job->opts.opt_history != NULL
+        && trycmd_history_append(job->opts.opt_history, &job->opts,
+                                 &result) != 0) {
+        trycmd_debug("trycmd_batch_finish: cannot append history: %s\n",
+                     strerror(errno));
+    }
+    if (exit_status == EXIT_SUCCESS) {
+        ++state->succeeded;
+    } else {
+        ++state->failed;
+        if (state->result == EXIT_SUCCESS) {
+            state->result = exit_status;
+        }
+        if (job->opts.opt_fail_fast) {
+            state->stop = 1;
+        }
+    }
+    job->monitor.child.pid   = -1;
+    job->monitor.child.pidfd = -1;
+    job->monitor.timed_out   = 0;
+    memset(&job->monitor.rusage, 0, sizeof(job->monitor.rusage));
+    wordfree(&job->words);
+}
+
+/**
+ * Return a slot's jobserver token (if any), once its command has finished
+ * or was never started.
+ */
+static void trycmd_batch_release(struct trycmd_batch_state* const state,
+                                 struct trycmd_batch_job* const job) {
+    if (job->token >= 0) {
+        trycmd_jobserver_release(&state->jobserver, job->token);
+        job->token = -1;
+    }
+}
+
+/**
+ * Record a command which could not be parsed, as a failure.
+ */
+static void trycmd_batch_invalid(const struct trycmd_opts* const opts,
+                                 struct trycmd_batch_state* const state) {
+    ++state->failed;
+    if (state->result == EXIT_SUCCESS) {
+        state->result = EXIT_FAILURE;
+    }
+    if (opts->opt_fail_fast) {
+        state->stop = 1;
+    }
+}
+
+static void trycmd_batch_fill(struct trycmd_batch_state* state);
+
+/**
+ * Handle a command's completion, then start another in its place.
+ */
+static void trycmd_batch_finished(struct trycmd_loop* const loop,
+                                  struct trycmd_monitor* const monitor) {
+    struct trycmd_batch_job* const job = monitor->data;
+    struct trycmd_batch_state* const state = job->state;
+    (void) loop;
+    if (state->have_relay) {
+        trycmd_relay_flush(&state->relay);
+    }
+    state->untokened -= (job->token < 0);
+    trycmd_batch_finish(state, job, monitor->exit_status);
+    trycmd_batch_release(state, job);
+    --state->running;
+    trycmd_batch_fill(state);
+}
+
+/**
+ * Handle the availability of a jobserver token, by starting another
+ * command (should one still be waiting).
+ */
+static void trycmd_batch_token(struct trycmd_loop* const loop,
+                               struct trycmd_loop_handler* const handler,
+                               const uint32_t events) {
+    struct trycmd_batch_state* const state = handler->data;
+    (void) events;
+    trycmd_loop_remove(loop, handler);
+    trycmd_batch_fill(state);
+}
+
+/**
+ * Forward each terminating signal received by try to every running command
+ * (each within a process group of its own), and start no more.
+ */
+static void trycmd_batch_forward(struct trycmd_loop* const loop,
+                                 struct trycmd_loop_handler* const handler,
+                                 const uint32_t events) {
+    struct trycmd_batch_state* const state = handler->data;
+    int signum;
+    int idx;
+    (void) events;
+    while ((signum = trycmd_loop_read_signal(handler)) > 0) {
+        state->stop = 1;
+        for (idx = 0; idx < state->opts->opt_jobs; ++idx) {
+            trycmd_monitor_signal(&state->jobs[idx].monitor, signum);
+        }
+    }
+    if (state->running == 0) {
+        trycmd_loop_stop(loop);
+    }
+}
+
+/**
+ * Fill every free slot, until the batch ends or is stopped. With a
+ * jobserver, only one command may run without a token (using our own
+ * implicit slot); all others must first acquire one. Once no command
+ * remains running, the event loop is stopped.
+ */
+static void trycmd_batch_fill(struct trycmd_batch_state* const state) {
+    const struct trycmd_opts* const opts = state->opts;
+    int idx;
+
+    for (idx = 0; idx < opts->opt_jobs && !state->at_end && !state->stop;
+         ++idx) {
+        struct trycmd_batch_job* const job = &state->jobs[idx];
+        struct trycmd_child child;
+        int result;
+        if (job->monitor.child.pid >= 0) {
+            continue;
+        }
+        job->token    = -1;
+        job->start_ns = trycmd_clock_ns();
+        clock_gettime(CLOCK_REALTIME, &job->started);
+        if (state->have_jobserver && state->untokened > 0
+            && trycmd_jobserver_acquire(&state->jobserver, &job->token) != 0) {
+            /* No slot is free. Wait for a token, or a command to finish. */
+            if (state->token_handler.kind == trycmd_loop_none
+                && trycmd_loop_add(&state->loop, &state->token_handler,
+                                   state->jobserver.token_fd, EPOLLIN,
+                                   trycmd_batch_token, state) != 0) {
+                trycmd_debug("trycmd_run_batch: cannot await tokens: %s\n",
+                             strerror(errno));
+            }
+            break;
+        }
+        result = trycmd_batch_read(opts, state->is, &state->line,
+                                   &state->line_len, state, job);
+        if (result == 0) {
+            state->at_end = 1;
+        } else if (result < 0) {
+            trycmd_batch_invalid(opts, state);
+            --idx;  /* Retry this slot. */
+        } else if ((result = trycmd_start_subcommand(&job->opts,
+                                                     &state->spawn_attr,
+                                                     &child)) != 0
+                   || (result = trycmd_monitor_start(&state->loop,
+                                                     &job->monitor,
+                                                     &job->opts, &child,
+                                                     trycmd_batch_finished,
+                                                     job)) != 0) {
+            if (result < 0) {
+                fprintf(stderr, _("try: cannot wait for command: %s\n"),
+                        strerror(errno));
+                result = EXIT_FAILURE;
+            }
+            trycmd_batch_finish(state, job, result);
+            --idx;  /* Retry this slot. */
+        } else {
+            state->untokened += (job->token < 0);
+            ++state->running;
+            continue;
+        }
+        trycmd_batch_release(state, job);
+    }
+    if (state->running == 0) {
+        trycmd_loop_remove(&state->loop, &state->token_handler);
+        trycmd_loop_stop(&state->loop);
+    }
+}
+
+int trycmd_run_batch(const struct trycmd_opts* const opts) {
+    struct trycmd_batch_state state;
+    int null_fd;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL opt_batch" && (opts->opt_batch != NULL));
+    assert("Unexpected non-positive opt_jobs" && (opts->opt_jobs > 0));
+    memset(&state, 0, sizeof(state));
+    state.opts = opts;
+
+    /*
+     * Open the batch, the pool, the event loop, and a null input shared by
+     * all commands.
+     */
+    state.is = (strcmp(opts->opt_batch, "-") == 0)
+             ? stdin
+             : fopen(opts->opt_batch, "r");
+    if (state.is == NULL) {
+        fprintf(stderr, _("try: %s: %s\n"), opts->opt_batch, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    state.jobs = calloc((size_t)opts->opt_jobs, sizeof(*state.jobs));
+    null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (state.jobs == NULL || null_fd < 0 || trycmd_loop_open(&state.loop) != 0) {
+        fprintf(stderr, _("try: %s: %s\n"), opts->opt_batch, strerror(errno));
+        free(state.jobs);
+        if (null_fd >= 0) {
+            close(null_fd);
+        }
+        if (state.is != stdin) {
+            fclose(state.is);
+        }
+        return EXIT_FAILURE;
+    }
+    for (idx = 0; idx < opts->opt_jobs; ++idx) {
+        state.jobs[idx].monitor.child.pid   = -1;
+        state.jobs[idx].monitor.child.pidfd = -1;
+        state.jobs[idx].token               = -1;
+        state.jobs[idx].state               = &state;
+    }
+    state.have_jobserver =
+        (trycmd_jobserver_setup(&state.jobserver, opts) == 0);
+    if (opts->opt_log != NULL
+        || opts->opt_timestamps != trycmd_timestamps_none) {
+        if (trycmd_relay_open(&state.loop, &state.relay, opts->opt_log,
+                              NULL, NULL) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"),
+                    (opts->opt_log != NULL) ? opts->opt_log : N_("output"),
+                    strerror(errno));
+            state.result = EXIT_FAILURE;
+            state.stop   = 1;
+        } else {
+            state.relay.timestamps = opts->opt_timestamps;
+            state.have_relay = 1;
+        }
+    }
+    if (opts->opt_json_out != NULL) {
+        if (trycmd_json_open(&state.json, opts->opt_json_out) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"), opts->opt_json_out,
+                    strerror(errno));
+            state.result = EXIT_FAILURE;
+            state.stop   = 1;
+        } else {
+            state.have_json = 1;
+        }
+    }
+
+    /*
+     * Commands which may time out are each given their own process group
+     * (see trycmd_run_subcommand), and forwarded terminating signals.
+     */
+    trycmd_spawn_attr_init(&state.spawn_attr, opts);
+    state.spawn_attr.stdio[0]   = null_fd;
+    state.spawn_attr.new_pgroup = (opts->opt_timeout > 0
+                                   && !opts->opt_interactive);
+    state.spawn_attr.sigmask    = &state.loop.saved_mask;
+    if (state.have_relay) {
+        state.spawn_attr.stdio[1] = state.relay.streams[0].child_fd;
+        state.spawn_attr.stdio[2] = state.relay.streams[1].child_fd;
+    }
+    if (state.spawn_attr.new_pgroup) {
+        sigset_t signals;
+        trycmd_forwarded_signals(&signals);
+        if (trycmd_loop_add_signals(&state.loop, &state.signal_handler,
+                                    &signals, trycmd_batch_forward,
+                                    &state) != 0) {
+            trycmd_debug("trycmd_run_batch: cannot forward signals: %s\n",
+                         strerror(errno));
+        }
+    }
+    trycmd_debug("trycmd_run_batch: %s with %d job(s)\n",
+                 opts->opt_batch, opts->opt_jobs);
+
+    /* Start the first commands, then each other as another finishes. */
+    trycmd_batch_fill(&state);
+    if (state.running > 0 && trycmd_loop_run(&state.loop) != 0) {
+        /* Not expected, but cannot continue. */
+        for (idx = 0; idx < opts->opt_jobs; ++idx) {
+            if (state.jobs[idx].monitor.child.pid > 0) {
+                trycmd_monitor_cancel(&state.loop, &state.jobs[idx].monitor);
+                trycmd_batch_finish(&state, &state.jobs[idx], EXIT_FAILURE);
+                trycmd_batch_release(&state, &state.jobs[idx]);
+            }
+        }
+    }
+
+    /* Count, without running, every command remaining after a stop. */
+    while (!state.at_end) {
+        struct trycmd_batch_job skipped_job;
+        const int result = trycmd_batch_read(opts, state.is, &state.line,
+                                             &state.line_len, &state,
+                                             &skipped_job);
+        if (result > 0) {
+            wordfree(&skipped_job.words);
+        }
+        if (result == 0) {
+            state.at_end = 1;
+        } else {
+            ++state.skipped;
+        }
+    }
+
+    /* Summarize the batch then release everything. */
+    trycmd_show_batch_status(opts, state.succeeded, state.failed,
+                             state.skipped, stderr);
+    if (state.have_relay) {
+        if (trycmd_relay_log(&state.relay) != NULL) {
+            trycmd_show_batch_status(opts, state.succeeded, state.failed,
+                                     state.skipped, state.relay.log);
+        }
+        trycmd_relay_close(&state.relay);
+    }
+    if (state.have_json) {
+        trycmd_json_close(&state.json);
+    }
+    if (state.have_jobserver) {
+        trycmd_jobserver_close(&state.jobserver);
+    }
+    trycmd_loop_remove(&state.loop, &state.token_handler);
+    trycmd_loop_remove(&state.loop, &state.signal_handler);
+    trycmd_loop_close(&state.loop);
+    free(state.line);
+    free(state.jobs);
+    close(null_fd);
+    if (state.is != stdin) {
+        fclose(state.is);
+    }
+    trycmd_debug("trycmd_run_batch: returning %d\n", state.result);
+    return state.result;
+}
+
+/* EOF */
@@ -0,0 +1,435 @@
+/**
+ * \file      trycmd_bench.c
+ * \brief     Benchmarks of the overhead of try itself.
+ * \details   Each benchmark is run for a number of iterations (by default
+ *            TRYCMD_BENCH_ITERATIONS, else as given by the only argument),
+ *            then its distribution of times is written to stdout as one
+ *            JSON object per line (NDJSON), for tracking between releases:
+ *
+ *            {"bench":"NAME","runs":N,"min_ns":..,"p50_ns":..,
+ *             "p99_ns":..,"max_ns":..}
+ *
+ *            "bare" runs the command that try would (DEF_SHELL_PATH,
+ *            given 'true', as built by trycmd_make_shell_cmd) by fork, exec
+ *            and wait alone; "main" runs it through trycmd_main(), with
+ *            the same shell. Their difference is try's overhead, which the
+ *            following benchmarks divide into its phases. "quote" shows a
+ *            long (256 KiB) argument, as within a result message.
+ *            "intl_eager" and "intl_lazy" each time, within a new process,
+ *            try's path from its start to its subcommand's spawn (through
+ *            trycmd_read_options and trycmd_make_shell_cmd): the first
+ *            loading the locale and message catalog at once, as try once
+ *            did, the second deferring the load (until the result is
+ *            shown), as try now does. These are run only if a catalog
+ *            translates try's messages within the locale named by LANG
+ *            (such as LANG=de_DE.UTF-8); otherwise, they are skipped.
+ *            "relay" runs a command writing 4 MiB of output in lines of a
+ *            typical length, relayed and logged (to /dev/null);
+ *            "relay_timestamps" runs it again with each line timestamped.
+ *            These run for a twentieth of the iterations
+ *            (TRYCMD_BENCH_RELAY_SHARE).
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <fcntl.h>         /* open, O_*. */
+#include <stdint.h>        /* uint64_t. */
+#include <stdio.h>         /* FILE, fopen, fclose, fprintf, printf, setvbuf. */
+#include <stdlib.h>        /* EXIT_*, calloc, free, getenv, malloc, qsort, setenv,
+                              strtol, unsetenv. */
+#include <string.h>        /* memset. */
+#include <sys/wait.h>      /* waitpid, WIFEXITED, WEXITSTATUS. */
+#include <unistd.h>        /* close, dup, dup2, execv, fork, pipe, read,
+                              write, _exit. */
+
+/** The number of iterations of each benchmark, if no other is given. */
+#define TRYCMD_BENCH_ITERATIONS (2000)
+
+/** The length of the argument quoted by the "quote" benchmark. */
+#define TRYCMD_BENCH_QUOTE_LEN  (256 * 1024)
+
+/** The command run by the "relay" benchmarks, as given to try. */
+#define TRYCMD_BENCH_RELAY_CMD  "yes 'a line of output, of a typical length" \
+                                " for a build' | head -c 4194304"
+
+/** The fraction of the iterations run by the "relay" benchmarks. */
+#define TRYCMD_BENCH_RELAY_SHARE 20
+
+/** Timings of a single benchmark. */
+struct trycmd_bench {
+    const char* name;
+    uint64_t*   ns;
+    size_t      runs;
+};
+
+/* Benchmark function declarations. */
+static void     trycmd_bench_bare(struct trycmd_bench* bench);
+static void     trycmd_bench_main(struct trycmd_bench* bench);
+static void     trycmd_bench_phases(struct trycmd_bench* read_options,
+                                    struct trycmd_bench* make_shell_cmd,
+                                    struct trycmd_bench* spawn,
+                                    struct trycmd_bench* wait,
+                                    struct trycmd_bench* banner);
+static void     trycmd_bench_quote(struct trycmd_bench* bench);
+static void     trycmd_bench_intl(struct trycmd_bench* eager,
+                                  struct trycmd_bench* lazy);
+static void     trycmd_bench_relay(struct trycmd_bench* bench, char* argv[]);
+
+/** The command run by every benchmark, as given to try. */
+static char* trycmd_bench_argv[] = { "try", "true", NULL };
+
+/** The commands run by the "relay" benchmarks, as given to try. */
+static char* trycmd_bench_relay_argv[] = {
+    "try", "--log=/dev/null", TRYCMD_BENCH_RELAY_CMD, NULL
+};
+static char* trycmd_bench_stamped_argv[] = {
+    "try", "--log=/dev/null", "--timestamps", TRYCMD_BENCH_RELAY_CMD, NULL
+};
+
+/**
+ * Order timings, ascending.
+ */
+static int trycmd_bench_cmp(const void* const lhs_ptr,
+                            const void* const rhs_ptr) {
+    const uint64_t lhs = *(const uint64_t*)lhs_ptr;
+    const uint64_t rhs = *(const uint64_t*)rhs_ptr;
+    return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+}
+
+/**
+ * Print a benchmark's distribution of timings, as a line of JSON.
+ */
+static void trycmd_bench_report(struct trycmd_bench* const bench) {
+    const size_t runs = bench->runs;
+    assert("Unexpected empty benchmark" && (runs > 0));
+    qsort(bench->ns, runs, sizeof(*bench->ns), trycmd_bench_cmp);
+
+    /* Percentiles by nearest rank, as are those of the history. */
+    printf("{\"bench\":\"%s\",\"runs\":%lu,\"min_ns\":%lu,\"p50_ns\":%lu,"
+           "\"p99_ns\":%lu,\"max_ns\":%lu}\n",
+           bench->name, (unsigned long)runs,
+           (unsigned long)bench->ns[0],
+           (unsigned long)bench->ns[(runs * 50 + 99) / 100 - 1],
+           (unsigned long)bench->ns[(runs * 99 + 99) / 100 - 1],
+           (unsigned long)bench->ns[runs - 1]);
+    fflush(stdout);
+}
+
+void trycmd_bench_bare(struct trycmd_bench* const bench) {
+    struct trycmd_opts opts;
+    char buffer[1024];
+    char** argv = NULL;
+    size_t idx;
+
+    /* The very command that try would run, from the same options. */
+    trycmd_read_options(2, trycmd_bench_argv, &opts);
+    if (trycmd_make_shell_cmd(&opts, buffer, sizeof(buffer), &argv)
+        > sizeof(buffer)) {
+        bench->runs = 0;
+        return;
+    }
+    for (idx = 0; idx < bench->runs; ++idx) {
+        const uint64_t start_ns = trycmd_clock_ns();
+        const pid_t pid = fork();
+        if (pid == 0) {
+            execv(argv[0], argv);
+            _exit(TRYCMD_STATUS_NOT_EXECUTABLE);
+        }
+        waitpid(pid, NULL, 0);
+        bench->ns[idx] = trycmd_clock_ns() - start_ns;
+    }
+}
+
+void trycmd_bench_main(struct trycmd_bench* const bench) {
+    size_t idx;
+    for (idx = 0; idx < bench->runs; ++idx) {
+        const uint64_t start_ns = trycmd_clock_ns();
+        trycmd_main(2, trycmd_bench_argv);
+        bench->ns[idx] = trycmd_clock_ns() - start_ns;
+    }
+}
+
+void trycmd_bench_phases(struct trycmd_bench* const read_options,
+                         struct trycmd_bench* const make_shell_cmd,
+                         struct trycmd_bench* const spawn,
+                         struct trycmd_bench* const wait,
+                         struct trycmd_bench* const banner) {
+    FILE* const os = fopen("/dev/null", "w");
+    size_t spawned = 0;
+    size_t idx;
+
+    /* Show each banner as to stderr: unbuffered. */
+    assert("Unexpected failure to open /dev/null" && (os != NULL));
+    setvbuf(os, NULL, _IONBF, 0);
+    for (idx = 0; idx < read_options->runs; ++idx) {
+        struct trycmd_spawn_attr attr;
+        struct trycmd_result result;
+        struct trycmd_child child;
+        struct trycmd_opts opts;
+        char buffer[1024];
+        char** argv = NULL;
+        uint64_t start_ns = trycmd_clock_ns();
+        int status = 0;
+
+        trycmd_read_options(2, trycmd_bench_argv, &opts);
+        read_options->ns[idx] = trycmd_clock_ns() - start_ns;
+
+        start_ns = trycmd_clock_ns();
+        trycmd_make_shell_cmd(&opts, buffer, sizeof(buffer), &argv);
+        make_shell_cmd->ns[idx] = trycmd_clock_ns() - start_ns;
+
+        start_ns = trycmd_clock_ns();
+        trycmd_spawn_attr_init(&attr, &opts);
+        if (trycmd_spawn(&attr, argv[0], argv, &child) == 0) {
+            /* Only successful spawns are timed. */
+            spawn->ns[spawned] = trycmd_clock_ns() - start_ns;
+            start_ns = trycmd_clock_ns();
+            waitpid(child.pid, &status, 0);
+            if (child.pidfd >= 0) {
+                close(child.pidfd);
+            }
+            wait->ns[spawned++] = trycmd_clock_ns() - start_ns;
+        }
+
+        memset(&result, 0, sizeof(result));
+        result.exit_status = trycmd_exit_status(status);
+        result.attempts    = 1;
+        start_ns = trycmd_clock_ns();
+        trycmd_show_result(&opts, &result, os);
+        banner->ns[idx] = trycmd_clock_ns() - start_ns;
+    }
+    spawn->runs = spawned;
+    wait->runs  = spawned;
+    fclose(os);
+}
+
+void trycmd_bench_quote(struct trycmd_bench* const bench) {
+    FILE* const os = fopen("/dev/null", "w");
+    char* const arg = malloc(TRYCMD_BENCH_QUOTE_LEN + 1);
+    size_t idx;
+
+    /* A long argument, as of a link command, with a few quotes to escape. */
+    assert("Unexpected failure to open /dev/null" && (os != NULL));
+    assert("Unexpected failure to allocate" && (arg != NULL));
+    for (idx = 0; idx < TRYCMD_BENCH_QUOTE_LEN; ++idx) {
+        arg[idx] = (idx % 64 == 63) ? ' ' : (idx % 4096 == 0) ? '\'' : 'o';
+    }
+    arg[TRYCMD_BENCH_QUOTE_LEN] = '\0';
+    for (idx = 0; idx < bench->runs; ++idx) {
+        const uint64_t start_ns = trycmd_clock_ns();
+        trycmd_pretty_print_arg(arg, os);
+        bench->ns[idx] = trycmd_clock_ns() - start_ns;
+    }
+    free(arg);
+    fclose(os);
+}
+
+/**
+ * Check whether, within the locale named by the environment, try's messages
+ * are translated (by a message catalog). This is checked within a new
+ * process, so that the locale is not loaded here.
+ */
+static int trycmd_bench_has_catalog(void) {
+    int status = -1;
+    const pid_t pid = fork();
+    if (pid == 0) {
+        char* const message = "Success:";
+        trycmd_intl_init();
+        _exit((_(message) != message) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    return pid > 0 && waitpid(pid, &status, 0) == pid
+        && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/**
+ * Time, within a new process, try's path from its start to its
+ * subcommand's spawn, loading the locale eagerly (as try once did) if
+ * eager is non-zero.
+ * @return The time taken, in nanoseconds, or 0 if the spawn failed.
+ */
+static uint64_t trycmd_bench_pre_exec(const int eager) {
+    uint64_t ns = 0;
+    pid_t pid;
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+    pid = fork();
+    if (pid == 0) {
+        struct trycmd_spawn_attr attr;
+        struct trycmd_child child;
+        struct trycmd_opts opts;
+        char buffer[1024];
+        char** argv = NULL;
+        const uint64_t start_ns = trycmd_clock_ns();
+
+        close(fds[0]);
+        trycmd_intl_init();
+        if (eager) {
+            (void) _("Success:");
+        }
+        trycmd_read_options(2, trycmd_bench_argv, &opts);
+        trycmd_make_shell_cmd(&opts, buffer, sizeof(buffer), &argv);
+        trycmd_spawn_attr_init(&attr, &opts);
+        if (trycmd_spawn(&attr, argv[0], argv, &child) == 0) {
+            ns = trycmd_clock_ns() - start_ns;
+            waitpid(child.pid, NULL, 0);
+        }
+        _exit((write(fds[1], &ns, sizeof(ns)) == sizeof(ns))
+              ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &ns, sizeof(ns)) != sizeof(ns)) {
+        ns = 0;
+    }
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+    return ns;
+}
+
+void trycmd_bench_intl(struct trycmd_bench* const eager,
+                       struct trycmd_bench* const lazy) {
+    size_t eager_runs = 0;
+    size_t lazy_runs  = 0;
+    size_t idx;
+
+    if (!trycmd_bench_has_catalog()) {
+        eager->runs = 0;
+        lazy->runs  = 0;
+        return;
+    }
+
+    /* Interleave the two, so that each sees the same conditions. */
+    for (idx = 0; idx < eager->runs; ++idx) {
+        uint64_t ns;
+        if ((ns = trycmd_bench_pre_exec(1)) > 0) {
+            eager->ns[eager_runs++] = ns;
+        }
+        if ((ns = trycmd_bench_pre_exec(0)) > 0) {
+            lazy->ns[lazy_runs++] = ns;
+        }
+    }
+    eager->runs = eager_runs;
+    lazy->runs  = lazy_runs;
+}
+
+void trycmd_bench_relay(struct trycmd_bench* const bench, char* argv[]) {
+    struct trycmd_opts opts;
+    int argc = 0;
+    size_t idx;
+    while (argv[argc] != NULL) {
+        ++argc;
+    }
+    trycmd_read_options(argc, argv, &opts);
+    for (idx = 0; idx < bench->runs; ++idx) {
+        struct trycmd_result result;
+        const uint64_t start_ns = trycmd_clock_ns();
+        trycmd_run_subcommand_result(&opts, &result);
+        bench->ns[idx] = trycmd_clock_ns() - start_ns;
+        trycmd_ring_free(&result.tail);
+    }
+}
+
+/* Benchmark entry point. */
+int main(int argc, char* argv[]) {
+    struct trycmd_bench benches[] = {
+        { "bare",           NULL, 0 },
+        { "main",           NULL, 0 },
+        { "read_options",   NULL, 0 },
+        { "make_shell_cmd", NULL, 0 },
+        { "spawn",          NULL, 0 },
+        { "wait",           NULL, 0 },
+        { "banner",         NULL, 0 },
+        { "quote",          NULL, 0 },
+        { "intl_eager",     NULL, 0 },
+        { "intl_lazy",      NULL, 0 },
+        { "relay",          NULL, 0 },
+        { "relay_timestamps", NULL, 0 },
+    };
+    const size_t count = sizeof(benches) / sizeof(benches[0]);
+    long runs = TRYCMD_BENCH_ITERATIONS;
+    int saved_stdout;
+    int saved_stderr;
+    int devnull;
+    size_t idx;
+
+    /* Read the number of iterations, if given. */
+    if (argc > 2 || (argc == 2 && (runs = strtol(argv[1], NULL, 10)) <= 0)) {
+        fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (idx = 0; idx < count; ++idx) {
+        benches[idx].runs = (size_t)runs;
+        benches[idx].ns   = calloc((size_t)runs, sizeof(*benches[idx].ns));
+        if (benches[idx].ns == NULL) {
+            fprintf(stderr, "%s: out of memory\n", argv[0]);
+            while (idx > 0) {
+                free(benches[--idx].ns);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    /*
+     * Initialize as would try, with the shell pinned and no options taken
+     * from the environment (so "bare" and "main" run the same command),
+     * then run every benchmark with its output (and that of its command)
+     * discarded.
+     */
+    trycmd_debug_init();
+    trycmd_intl_init();
+    setenv("SHELL", DEF_SHELL_PATH, 1);
+    unsetenv("TRY_HISTORY");
+    unsetenv("TRY_DAEMON");
+    unsetenv("TRY_EXEC");
+    unsetenv("TRY_SPAWN");
+    unsetenv("TRY_INTERACTIVE");
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    saved_stderr = dup(STDERR_FILENO);
+    devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    dup2(devnull, STDERR_FILENO);
+    close(devnull);
+    trycmd_bench_intl(&benches[8], &benches[9]);  /* Before any load. */
+    trycmd_bench_bare(&benches[0]);
+    trycmd_bench_main(&benches[1]);
+    trycmd_bench_phases(&benches[2], &benches[3], &benches[4],
+                        &benches[5], &benches[6]);
+    trycmd_bench_quote(&benches[7]);
+    benches[10].runs = (benches[10].runs + TRYCMD_BENCH_RELAY_SHARE - 1) /
+                       TRYCMD_BENCH_RELAY_SHARE;
+    benches[11].runs = benches[10].runs;
+    trycmd_bench_relay(&benches[10], trycmd_bench_relay_argv);
+    trycmd_bench_relay(&benches[11], trycmd_bench_stamped_argv);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stdout);
+    close(saved_stderr);
+
+    /* Report them all (but any never run, as should spawning fail). */
+    if (benches[8].runs == 0) {
+        fprintf(stderr, "%s: skipping intl_eager and intl_lazy: no message"
+                " catalog for LANG=%s\n", argv[0],
+                (getenv("LANG") != NULL) ? getenv("LANG") : "");
+    }
+    for (idx = 0; idx < count; ++idx) {
+        if (benches[idx].runs > 0) {
+            trycmd_bench_report(&benches[idx]);
+        }
+        free(benches[idx].ns);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* EOF */
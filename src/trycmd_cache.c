@@ -0,0 +1,427 @@
+/**
+ * \file      trycmd_cache.c
+ * \brief     Cache subcommand results, replaying them for unchanged inputs.
+ * \details   Each entry is a file within the cache directory, named by the
+ *            hash of all that the subcommand's result depends upon, and
+ *            holding its exit status then its standard output and error.
+ *            Entries are written to a temporary file then renamed into
+ *            place, so are never seen incomplete. An entry's modification
+ *            time is updated as it is replayed, so that the least recently
+ *            used entries are those evicted once the cache grows too large.
+ *            Inputs are mapped and hashed with XXH64, several bytes at a
+ *            time, and replayed output is sent without copying it through
+ *            user space where possible.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <dirent.h>        /* opendir, readdir, closedir, DIR. */
+#include <errno.h>         /* errno, EEXIST. */
+#include <fcntl.h>         /* open, AT_*, O_*. */
+#include <glob.h>          /* glob, globfree, glob_t. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* int32_t, uint32_t, uint64_t. */
+#include <stdio.h>         /* rename, snprintf. */
+#include <stdlib.h>        /* free, malloc, mkstemp, qsort. */
+#include <string.h>        /* memcpy, memset, strchr, strerror, strlen. */
+#include <sys/mman.h>      /* mmap, munmap. */
+#include <sys/stat.h>      /* fstat, fstatat, futimens, mkdir. */
+#include <time.h>          /* struct timespec. */
+#include <unistd.h>        /* close, getcwd, pread, unlink, unlinkat. */
+
+/** Identifies a cache entry, and its layout version. */
+#define TRYCMD_CACHE_MAGIC    (0x31435254u)  /* "TRC1". */
+
+/** The length of an entry's name: its key, in hexadecimal. */
+#define TRYCMD_CACHE_NAME_LEN (32u)
+
+/** A cache entry's header, followed by its standard output then error. */
+struct trycmd_cache_header {
+    uint32_t magic;
+    int32_t  exit_status;
+    uint64_t output_len[2];
+};
+
+/** An entry found within the cache directory, as a candidate for eviction. */
+struct trycmd_cache_file {
+    struct timespec used;
+    uint64_t        size;
+    char            name[TRYCMD_CACHE_NAME_LEN + 1];
+};
+
+/**
+ * Add data to a key, as two independently seeded hashes.
+ */
+static void trycmd_cache_mix(uint64_t key[2],
+                             const void* const data,
+                             const size_t len) {
+    key[0] = trycmd_xxh64(data, len, key[0]);
+    key[1] = trycmd_xxh64(data, len, key[1]);
+}
+
+/**
+ * Add a string, including its terminator, to a key.
+ */
+static void trycmd_cache_mix_s(uint64_t key[2], const char* const text) {
+    trycmd_cache_mix(key, text, strlen(text) + 1);
+}
+
+/**
+ * Add a file's name and, if a regular file, its content and size to a key
+ * (else its mode). The content is added to both of the key's hashes.
+ * @return 0 on success, -1 on failure.
+ */
+static int trycmd_cache_mix_file(uint64_t key[2], const char* const path) {
+    struct stat st;
+    uint64_t tag;
+    int fd;
+
+    trycmd_cache_mix_s(key, path);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        trycmd_debug("trycmd_cache_open: cannot read input %s: %s\n",
+                     path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    /* Only a regular file's content is hashed (by mapping it whole). */
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* const map = mmap(NULL, (size_t)st.st_size, PROT_READ,
+                               MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        trycmd_cache_mix(key, map, (size_t)st.st_size);
+        munmap(map, (size_t)st.st_size);
+    }
+    close(fd);
+    tag = S_ISREG(st.st_mode) ? (uint64_t)st.st_size : (uint64_t)st.st_mode;
+    trycmd_cache_mix(key, &tag, sizeof(tag));
+    return 0;
+}
+
+/**
+ * Create a directory, and any parents, unless already present.
+ * @return 0 on success, -1 on failure.
+ */
+static int trycmd_cache_mkdirs(char* const path) {
+    char* slash;
+    for (slash = strchr(path + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+        if (slash != NULL) {
+            *slash = '\0';
+        }
+        if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+            if (slash != NULL) {
+                *slash = '/';
+            }
+            return -1;
+        }
+        if (slash == NULL) {
+            return 0;
+        }
+        *slash = '/';
+    }
+}
+
+int trycmd_cache_open(struct trycmd_cache* const cache,
+                      const struct trycmd_opts* const opts) {
+    uint64_t key[2] = { TRYCMD_CACHE_MAGIC, ~(uint64_t)TRYCMD_CACHE_MAGIC };
+    const char* dir = opts->opt_cache_dir;
+    const char* suffix = N_("");
+    char cwd[4096];
+    int32_t how[2];
+    size_t len;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+    assert("Unexpected NULL opts" && (opts != NULL));
+    memset(cache, 0, sizeof(*cache));
+    cache->opts = opts;
+    cache->output[0].fd = -1;
+    cache->output[1].fd = -1;
+
+    /* The subcommand, where and how it is run. */
+    for (idx = 0; idx < opts->opt_sub_argc; ++idx) {
+        trycmd_cache_mix_s(key, opts->opt_sub_argv[idx]);
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return -1;
+    }
+    trycmd_cache_mix_s(key, cwd);
+    how[0] = (int32_t)opts->opt_exec;
+    how[1] = (int32_t)opts->opt_interactive;
+    trycmd_cache_mix(key, how, sizeof(how));
+    trycmd_cache_mix_s(key, (opts->opt_shell != NULL) ? opts->opt_shell : "");
+
+    /* Each environment variable named, whether set or not. */
+    if (opts->opt_cache_env != NULL) {
+        const char* name = opts->opt_cache_env;
+        while (*name != '\0') {
+            const char* const comma = strchr(name, ',');
+            const size_t name_len = (comma != NULL) ? (size_t)(comma - name)
+                                                    : strlen(name);
+            char copy[name_len + 1];
+            const char* value;
+            memcpy(copy, name, name_len);
+            copy[name_len] = '\0';
+            value = trycmd_getenv_s(copy, NULL);
+            trycmd_cache_mix_s(key, copy);
+            trycmd_cache_mix(key, (value != NULL) ? value : "\377",
+                             (value != NULL) ? strlen(value) + 1 : 1);
+            name += name_len + (comma != NULL);
+        }
+    }
+
+    /* Each input file, by name and content, in order. */
+    for (idx = 0; idx < opts->opt_inputs_len; ++idx) {
+        glob_t matches;
+        size_t match;
+        trycmd_cache_mix_s(key, opts->opt_inputs[idx]);
+        if (glob(opts->opt_inputs[idx], 0, NULL, &matches) != 0) {
+            continue;  /* No match (or cannot search), so the pattern alone. */
+        }
+        for (match = 0; match < matches.gl_pathc; ++match) {
+            if (trycmd_cache_mix_file(key, matches.gl_pathv[match]) != 0) {
+                globfree(&matches);
+                return -1;
+            }
+        }
+        globfree(&matches);
+    }
+
+    /* Name the entry within the cache directory, creating it if need be. */
+    if (dir == NULL) {
+        dir = trycmd_getenv_s(N_("XDG_CACHE_HOME"), NULL);
+        suffix = N_("/try");
+        if (dir == NULL || dir[0] != '/') {
+            dir = trycmd_getenv_s(N_("HOME"), NULL);
+            suffix = N_("/.cache/try");
+            if (dir == NULL || dir[0] != '/') {
+                return -1;
+            }
+        }
+    }
+    len = strlen(dir) + strlen(suffix) + 1 + TRYCMD_CACHE_NAME_LEN + 1;
+    cache->path = malloc(len);
+    if (cache->path == NULL) {
+        return -1;
+    }
+    cache->dir_len = (size_t)snprintf(cache->path, len, N_("%s%s"),
+                                      dir, suffix);
+    if (trycmd_cache_mkdirs(cache->path) != 0) {
+        trycmd_debug("trycmd_cache_open: cannot create %s: %s\n",
+                     cache->path, strerror(errno));
+        trycmd_cache_close(cache);
+        return -1;
+    }
+    snprintf(&cache->path[cache->dir_len], len - cache->dir_len,
+             N_("/%016llx%016llx"),
+             (unsigned long long)key[0], (unsigned long long)key[1]);
+    trycmd_debug("trycmd_cache_open: entry %s\n", cache->path);
+    return 0;
+}
+
+int trycmd_cache_replay(struct trycmd_cache* const cache,
+                        struct trycmd_result* const result_out) {
+    struct trycmd_cache_header header;
+    struct stat st;
+    int show;
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+    assert("Unexpected NULL result_out" && (result_out != NULL));
+
+    /* Find a complete entry. */
+    fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0
+        || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)
+        || header.magic != TRYCMD_CACHE_MAGIC
+        || (uint64_t)st.st_size != sizeof(header) + header.output_len[0]
+                                                  + header.output_len[1]) {
+        trycmd_debug("trycmd_cache_replay: ignoring invalid %s\n",
+                     cache->path);
+        close(fd);
+        return -1;
+    }
+
+    /* Replay its output, as would have been shown, then mark it used. */
+    show = (cache->opts->opt_quiet == 0 || header.exit_status != 0);
+    if (show
+        && (trycmd_sendfile_all(STDOUT_FILENO, fd, sizeof(header),
+                                header.output_len[0]) != 0
+            || trycmd_sendfile_all(STDERR_FILENO, fd,
+                                   (off_t)(sizeof(header)
+                                           + header.output_len[0]),
+                                   header.output_len[1]) != 0)) {
+        trycmd_debug("trycmd_cache_replay: cannot replay: %s\n",
+                     strerror(errno));
+    }
+    close(fd);
+    utimensat(AT_FDCWD, cache->path, NULL, 0);
+    result_out->exit_status = header.exit_status;
+    result_out->cached      = 1;
+    return 0;
+}
+
+int trycmd_cache_capture(struct trycmd_cache* const cache) {
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+
+    if (trycmd_spool_open(&cache->output[0], TRYCMD_QUIET_SIZE) != 0) {
+        return -1;
+    }
+    if (trycmd_spool_open(&cache->output[1], TRYCMD_QUIET_SIZE) != 0) {
+        trycmd_spool_close(&cache->output[0]);
+        return -1;
+    }
+    cache->capturing = 1;
+    return 0;
+}
+
+/**
+ * Order cache files from least to most recently used.
+ */
+static int trycmd_cache_file_cmp(const void* const lhs_ptr,
+                                 const void* const rhs_ptr) {
+    const struct trycmd_cache_file* const lhs = lhs_ptr;
+    const struct trycmd_cache_file* const rhs = rhs_ptr;
+    if (lhs->used.tv_sec != rhs->used.tv_sec) {
+        return (lhs->used.tv_sec < rhs->used.tv_sec) ? -1 : 1;
+    } else if (lhs->used.tv_nsec != rhs->used.tv_nsec) {
+        return (lhs->used.tv_nsec < rhs->used.tv_nsec) ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Remove the least recently used entries until the cache fits its limit.
+ */
+static void trycmd_cache_evict(struct trycmd_cache* const cache) {
+    struct trycmd_cache_file* files = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    uint64_t total = 0;
+    struct dirent* entry;
+    size_t idx;
+    DIR* dir;
+
+    cache->path[cache->dir_len] = '\0';
+    dir = opendir(cache->path);
+    cache->path[cache->dir_len] = '/';
+    if (dir == NULL) {
+        return;
+    }
+
+    /* Find every entry, and the cache's total size. */
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat st;
+        if (strlen(entry->d_name) != TRYCMD_CACHE_NAME_LEN
+            || fstatat(dirfd(dir), entry->d_name, &st,
+                       AT_SYMLINK_NOFOLLOW) != 0
+            || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        if (count == capacity) {
+            struct trycmd_cache_file* const grown =
+                realloc(files, (capacity * 2 + 64) * sizeof(*files));
+            if (grown == NULL) {
+                break;
+            }
+            files = grown;
+            capacity = capacity * 2 + 64;
+        }
+        files[count].used = st.st_mtim;
+        files[count].size = (uint64_t)st.st_size;
+        memcpy(files[count].name, entry->d_name, TRYCMD_CACHE_NAME_LEN + 1);
+        total += files[count].size;
+        ++count;
+    }
+
+    /* Then remove the oldest, until within the limit. */
+    if (total > cache->opts->opt_cache_size) {
+        qsort(files, count, sizeof(*files), trycmd_cache_file_cmp);
+        for (idx = 0; idx < count && total > cache->opts->opt_cache_size;
+             ++idx) {
+            if (unlinkat(dirfd(dir), files[idx].name, 0) == 0) {
+                trycmd_debug("trycmd_cache_evict: evicted %s\n",
+                             files[idx].name);
+                total -= files[idx].size;
+            }
+        }
+    }
+    free(files);
+    closedir(dir);
+}
+
+int trycmd_cache_store(struct trycmd_cache* const cache,
+                       const struct trycmd_result* const result) {
+    static const char tmp_name[] = "/.tmp-XXXXXX";
+    struct trycmd_cache_header header;
+    char tmp_path[cache->dir_len + sizeof(tmp_name)];
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+    assert("Unexpected NULL result" && (result != NULL));
+    if (!cache->capturing) {
+        return -1;
+    }
+
+    /* Write the entry in full beside its final name, then move it there. */
+    memcpy(tmp_path, cache->path, cache->dir_len);
+    memcpy(&tmp_path[cache->dir_len], tmp_name, sizeof(tmp_name));
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    header.magic         = TRYCMD_CACHE_MAGIC;
+    header.exit_status   = result->exit_status;
+    header.output_len[0] = cache->output[0].size;
+    header.output_len[1] = cache->output[1].size;
+    if (trycmd_write_all(fd, (const char*)&header, sizeof(header)) != 0
+        || trycmd_spool_replay(&cache->output[0], fd) != 0
+        || trycmd_spool_replay(&cache->output[1], fd) != 0) {
+        const int saved_errno = errno;
+        close(fd);  /* Released before the entry is removed, below. */
+        errno = saved_errno;
+        fd = -1;
+    }
+    if (fd < 0 || close(fd) != 0 || rename(tmp_path, cache->path) != 0) {
+        trycmd_debug("trycmd_cache_store: cannot store %s: %s\n",
+                     cache->path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    trycmd_cache_evict(cache);
+    return 0;
+}
+
+void trycmd_cache_close(struct trycmd_cache* const cache) {
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+    if (cache->capturing) {
+        trycmd_spool_close(&cache->output[0]);
+        trycmd_spool_close(&cache->output[1]);
+        cache->capturing = 0;
+    }
+    free(cache->path);
+    cache->path = NULL;
+}
+
+/* EOF */
@@ -0,0 +1,677 @@
+/**
+ * \file      trycmd_daemon.c
+ * \brief     A resident daemon which runs try on behalf of a client.
+ * \details   The daemon (tryd) initializes once, then keeps a pool of
+ *            forked workers waiting upon a Unix socket. A client (try,
+ *            given TRY_DAEMON) sends its arguments, environment, working
+ *            directory, umask and open descriptors (by SCM_RIGHTS) to the
+ *            first worker to accept it. The worker takes these as its own,
+ *            runs trycmd_main() exactly as the client would have, then
+ *            returns the exit status and exits; the daemon then forks a
+ *            replacement. Should no worker accept the request, the client
+ *            simply runs trycmd_main() itself.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EADDRINUSE, ECONNREFUSED, EINTR. */
+#include <fcntl.h>         /* fcntl, F_*, FD_CLOEXEC. */
+#include <getopt.h>        /* getopt_long, struct option. */
+#include <signal.h>        /* kill, raise, sigaction, sigprocmask, sigwaitinfo. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* int32_t, uint32_t. */
+#include <stdio.h>         /* fprintf, fputs, stderr, stdout. */
+#include <stdlib.h>        /* calloc, free, malloc, EXIT_*. */
+#include <string.h>        /* memchr, memcpy, memset, strerror, strlen. */
+#include <sys/socket.h>    /* accept, bind, connect, recvmsg, sendmsg, ... */
+#include <sys/stat.h>      /* umask. */
+#include <sys/un.h>        /* struct sockaddr_un. */
+#include <sys/wait.h>      /* waitpid, WNOHANG. */
+#include <unistd.h>        /* chdir, close, dup2, fork, getcwd, setpgid, unlink. */
+
+/** Identifies a request, and its layout version. */
+#define TRYCMD_DAEMON_MAGIC        (0x31445254u)  /* "TRD1". */
+
+/** Descriptors at or above this number are not passed to a worker. */
+#define TRYCMD_DAEMON_FDS          (64)
+
+/** The largest request accepted, in bytes (beyond its header). */
+#define TRYCMD_DAEMON_REQUEST_MAX  (16 * 1024 * 1024)
+
+/** The number of workers kept waiting, if no other is given. */
+#define TRYCMD_DAEMON_WORKERS      (2)
+
+/**
+ * A request's header, sent with the client's descriptors. It is followed
+ * by fd_count descriptor numbers (as int32_t), then argc arguments, envc
+ * environment entries and the working directory, each NUL terminated.
+ */
+struct trycmd_daemon_request {
+    uint32_t magic;
+    uint32_t umask;
+    uint32_t fd_count;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t len;
+};
+
+/** Space for a control message passing every descriptor. */
+union trycmd_daemon_control {
+    struct cmsghdr align;
+    char           buf[CMSG_SPACE(sizeof(int) * TRYCMD_DAEMON_FDS)];
+};
+
+/** The worker to whose process group a client's signals are forwarded. */
+static pid_t trycmd_daemon_worker_pid = -1;
+
+/** The last signal forwarded by a client, if any. */
+static volatile sig_atomic_t trycmd_daemon_signal = 0;
+
+/**
+ * Read all of the given length from a descriptor, despite any interruption.
+ * @return 0 on success, -1 on failure or early end of file.
+ */
+static int trycmd_daemon_read_all(const int fd, void* const data,
+                                  const size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t nread = read(fd, (char*)data + done, len - done);
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        } else if (nread <= 0) {
+            return -1;
+        }
+        done += (size_t)nread;
+    }
+    return 0;
+}
+
+/**
+ * Send all of the given data to a socket, without raising SIGPIPE should
+ * its peer have gone.
+ * @return 0 on success, -1 on failure.
+ */
+static int trycmd_daemon_send_all(const int fd, const void* const data,
+                                  const size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t sent = send(fd, (const char*)data + done, len - done,
+                                  MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0) {
+            return -1;
+        }
+        done += (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * Fill in the address of a socket.
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int trycmd_daemon_address(const char* const path,
+                                 struct sockaddr_un* const addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(addr->sun_path, path, strlen(path) + 1);
+    return 0;
+}
+
+/**
+ * Forward a signal received by the client to its worker's process group,
+ * as it would have been sent to the client's own (by the terminal).
+ */
+static void trycmd_daemon_forward(const int signum) {
+    trycmd_daemon_signal = signum;
+    if (trycmd_daemon_worker_pid > 0) {
+        kill(-trycmd_daemon_worker_pid, signum);
+    }
+}
+
+/**
+ * Send a request for the given command to a worker.
+ * @return 0 on success, -1 on failure.
+ */
+static int trycmd_daemon_request(const int fd,
+                                 const int argc,
+                                 char* argv[]) {
+    extern char** environ;
+    union trycmd_daemon_control control;
+    struct trycmd_daemon_request request;
+    int32_t fds[TRYCMD_DAEMON_FDS];
+    struct msghdr msg;
+    struct iovec iov;
+    char cwd[4096];
+    char* payload;
+    char* next;
+    size_t len;
+    int idx;
+
+    /* Pass every descriptor which a subcommand would inherit. */
+    memset(&request, 0, sizeof(request));
+    for (idx = 0; idx < TRYCMD_DAEMON_FDS; ++idx) {
+        const int flags = fcntl(idx, F_GETFD);
+        if (flags >= 0 && !(flags & FD_CLOEXEC)) {
+            fds[request.fd_count++] = idx;
+        }
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return -1;
+    }
+
+    /* Gather all else into one payload. */
+    len = request.fd_count * sizeof(fds[0]) + strlen(cwd) + 1;
+    for (idx = 0; idx < argc; ++idx) {
+        len += strlen(argv[idx]) + 1;
+    }
+    for (request.envc = 0; environ[request.envc] != NULL; ++request.envc) {
+        len += strlen(environ[request.envc]) + 1;
+    }
+    if (len > TRYCMD_DAEMON_REQUEST_MAX) {
+        return -1;
+    }
+    payload = malloc(len);
+    if (payload == NULL) {
+        return -1;
+    }
+    memcpy(payload, fds, request.fd_count * sizeof(fds[0]));
+    next = payload + request.fd_count * sizeof(fds[0]);
+    for (idx = 0; idx < argc; ++idx) {
+        memcpy(next, argv[idx], strlen(argv[idx]) + 1);
+        next += strlen(argv[idx]) + 1;
+    }
+    for (idx = 0; (uint32_t)idx < request.envc; ++idx) {
+        memcpy(next, environ[idx], strlen(environ[idx]) + 1);
+        next += strlen(environ[idx]) + 1;
+    }
+    memcpy(next, cwd, strlen(cwd) + 1);
+    request.magic = TRYCMD_DAEMON_MAGIC;
+    request.umask = (uint32_t)umask(0);
+    umask((mode_t)request.umask);
+    request.argc  = (uint32_t)argc;
+    request.len   = (uint32_t)len;
+
+    /* Send the header with every descriptor, then the payload. */
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &request;
+    iov.iov_len  = sizeof(request);
+    msg.msg_iov  = &iov;
+    msg.msg_iovlen = 1;
+    if (request.fd_count > 0) {
+        struct cmsghdr* const cmsg = (struct cmsghdr*)control.buf;
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * request.fd_count);
+        cmsg->cmsg_level   = SOL_SOCKET;
+        cmsg->cmsg_type    = SCM_RIGHTS;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(int) * request.fd_count);
+        for (idx = 0; (uint32_t)idx < request.fd_count; ++idx) {
+            const int child_fd = (int)fds[idx];
+            memcpy(CMSG_DATA(cmsg) + idx * sizeof(int), &child_fd, sizeof(int));
+        }
+    }
+    while (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            free(payload);
+            return -1;
+        }
+    }
+    idx = trycmd_daemon_send_all(fd, payload, len);
+    free(payload);
+    return idx;
+}
+
+int trycmd_daemon_call(const int argc, char* argv[], int* const result_out) {
+    const char* const path = trycmd_getenv_s(N_("TRY_DAEMON"), NULL);
+    struct sigaction action, saved[4];
+    static const int signals[4] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM };
+    struct sockaddr_un addr;
+    int32_t reply;
+    int lost;
+    int idx;
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected negative argc" && (argc >= 0));
+    assert("Unexpected NULL argv" && (argv != NULL));
+    assert("Unexpected NULL result_out" && (result_out != NULL));
+
+    /* Connect to the daemon, if there is one. */
+    if (path == NULL || path[0] == '\0'
+        || trycmd_daemon_address(path, &addr) != 0) {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0
+        || trycmd_daemon_request(fd, argc, argv) != 0
+        || trycmd_daemon_read_all(fd, &reply, sizeof(reply)) != 0) {
+        /* Nothing has been run, so the caller may run it instead. */
+        close(fd);
+        return -1;
+    }
+
+    /*
+     * The worker has begun, and replied with its process ID. Until it
+     * is done, forward it those signals which we would otherwise handle
+     * ourselves (such as an interrupt from the terminal).
+     */
+    trycmd_daemon_worker_pid = (pid_t)reply;
+    trycmd_daemon_signal = 0;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = trycmd_daemon_forward;
+    sigemptyset(&action.sa_mask);
+    for (idx = 0; idx < 4; ++idx) {
+        sigaction(signals[idx], &action, &saved[idx]);
+        if (saved[idx].sa_handler == SIG_IGN) {
+            sigaction(signals[idx], &saved[idx], NULL);  /* Still ignored. */
+        }
+    }
+    lost = (trycmd_daemon_read_all(fd, &reply, sizeof(reply)) != 0);
+    for (idx = 0; idx < 4; ++idx) {
+        sigaction(signals[idx], &saved[idx], NULL);
+    }
+    trycmd_daemon_worker_pid = -1;
+
+    /* Should the worker have been stopped by a signal, so are we. */
+    if (lost) {
+        if (trycmd_daemon_signal != 0) {
+            raise(trycmd_daemon_signal);
+        }
+        fputs(_("try: lost connection to daemon\n"), stderr);
+        reply = EXIT_FAILURE;
+    }
+    close(fd);
+    *result_out = (int)reply;
+    return 0;
+}
+
+/**
+ * Receive a request's header and descriptors.
+ * @return The number of descriptors received, or -1 on failure.
+ */
+static int trycmd_daemon_receive(const int fd,
+                                 struct trycmd_daemon_request* const request,
+                                 int fds[TRYCMD_DAEMON_FDS]) {
+    union trycmd_daemon_control control;
+    struct cmsghdr* cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    int count = 0;
+    ssize_t nread;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = request;
+    iov.iov_len  = sizeof(*request);
+    msg.msg_iov  = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    do {
+        nread = recvmsg(fd, &msg, MSG_WAITALL);
+    } while (nread < 0 && errno == EINTR);
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(cmsg), (size_t)count * sizeof(int));
+        }
+    }
+
+    /* Accept only a complete request, with every descriptor promised. */
+    if (nread != (ssize_t)sizeof(*request)
+        || (msg.msg_flags & MSG_CTRUNC) != 0
+        || request->magic != TRYCMD_DAEMON_MAGIC
+        || request->fd_count != (uint32_t)count
+        || request->len > TRYCMD_DAEMON_REQUEST_MAX
+        || request->len < request->fd_count * sizeof(int32_t)) {
+        while (count > 0) {
+            close(fds[--count]);
+        }
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * Take the client's descriptors as our own, each at its original number,
+ * closing all others below TRYCMD_DAEMON_FDS (keeping conn_fd, moved
+ * above them).
+ * @return The connection's new descriptor, or -1 on failure.
+ */
+static int trycmd_daemon_adopt(int conn_fd,
+                               int fds[TRYCMD_DAEMON_FDS],
+                               const int32_t* const numbers,
+                               const int count) {
+    int idx;
+
+    /* Move every descriptor kept out of the way. */
+    for (idx = -1; idx < count; ++idx) {
+        int* const from = (idx < 0) ? &conn_fd : &fds[idx];
+        const int moved = fcntl(*from, F_DUPFD_CLOEXEC, TRYCMD_DAEMON_FDS);
+        close(*from);
+        *from = moved;
+        if (moved < 0) {
+            return -1;
+        }
+    }
+
+    /* Then replace all below them with the client's. */
+    for (idx = 0; idx < TRYCMD_DAEMON_FDS; ++idx) {
+        close(idx);
+    }
+    for (idx = 0; idx < count; ++idx) {
+        if (numbers[idx] < 0 || numbers[idx] >= TRYCMD_DAEMON_FDS
+            || dup2(fds[idx], (int)numbers[idx]) < 0) {
+            return -1;
+        }
+        close(fds[idx]);
+    }
+    return conn_fd;
+}
+
+/**
+ * Unpack a request's strings, given its payload (after any descriptor
+ * numbers), into argv and envp.
+ * @return The working directory, or NULL if the request is malformed.
+ */
+static const char* trycmd_daemon_unpack(char* payload,
+                                        const size_t len,
+                                        const struct trycmd_daemon_request* const request,
+                                        char** const argv,
+                                        char** const envp) {
+    char* const end = payload + len;
+    uint32_t idx;
+
+    for (idx = 0; idx < request->argc + request->envc + 1; ++idx) {
+        char* const nul = (payload < end) ? memchr(payload, '\0',
+                                                   (size_t)(end - payload))
+                                          : NULL;
+        if (nul == NULL) {
+            return NULL;
+        }
+        if (idx < request->argc) {
+            argv[idx] = payload;
+        } else if (idx < request->argc + request->envc) {
+            envp[idx - request->argc] = payload;
+        } else {
+            return payload;
+        }
+        payload = nul + 1;
+    }
+    return NULL;
+}
+
+/**
+ * Serve a single request upon the given connection, then exit.
+ */
+static void trycmd_daemon_serve_one(int conn_fd) {
+    extern char** environ;
+    struct trycmd_daemon_request request;
+    int fds[TRYCMD_DAEMON_FDS];
+    const char* cwd;
+    char* payload;
+    char** argv;
+    char** envp;
+    int32_t reply;
+    int count;
+
+    /* Receive the request, then take on the client's state as our own. */
+    count = trycmd_daemon_receive(conn_fd, &request, fds);
+    if (count < 0) {
+        trycmd_debug("tryd: rejected malformed request\n");
+        _exit(EXIT_FAILURE);
+    }
+    payload = malloc(request.len);
+    argv    = calloc(request.argc + 1, sizeof(*argv));
+    envp    = calloc(request.envc + 1, sizeof(*envp));
+    if (payload == NULL || argv == NULL || envp == NULL
+        || trycmd_daemon_read_all(conn_fd, payload, request.len) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    cwd = trycmd_daemon_unpack(payload + count * sizeof(int32_t),
+                               request.len - count * sizeof(int32_t),
+                               &request, argv, envp);
+    if (cwd == NULL || chdir(cwd) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    conn_fd = trycmd_daemon_adopt(conn_fd, fds, (const int32_t*)payload, count);
+    if (conn_fd < 0) {
+        _exit(EXIT_FAILURE);
+    }
+    environ = envp;
+    umask((mode_t)request.umask);
+
+    /* Reply with our process ID, run, then reply with the exit status. */
+    reply = (int32_t)getpid();
+    if (trycmd_daemon_send_all(conn_fd, &reply, sizeof(reply)) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    reply = (int32_t)trycmd_main((int)request.argc, argv);
+    fflush(stdout);
+    fflush(stderr);
+    trycmd_daemon_send_all(conn_fd, &reply, sizeof(reply));
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Fork a worker, to wait upon the listening socket for a single request.
+ * @return The worker's process ID, or -1 on failure.
+ */
+static pid_t trycmd_daemon_fork(const int listen_fd,
+                                const sigset_t* const saved_mask) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        int conn_fd;
+
+        /*
+         * Lead a process group of our own, to which the client forwards
+         * those signals that its own group receives from the terminal.
+         */
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, saved_mask, NULL);
+        do {
+            conn_fd = accept(listen_fd, NULL, NULL);
+        } while (conn_fd < 0 && errno == EINTR);
+        if (conn_fd < 0) {
+            _exit(EXIT_FAILURE);
+        }
+        close(listen_fd);
+#if defined(SO_PEERCRED)
+        {
+            /* Serve only our own user (as does the socket's mode). */
+            struct ucred cred;
+            socklen_t cred_len = sizeof(cred);
+            if (getsockopt(conn_fd, SOL_SOCKET, SO_PEERCRED,
+                           &cred, &cred_len) != 0
+                || cred.uid != getuid()) {
+                _exit(EXIT_FAILURE);
+            }
+        }
+#endif
+        trycmd_daemon_serve_one(conn_fd);
+    }
+    return pid;
+}
+
+/**
+ * Create a listening socket at the given path, replacing any left by a
+ * daemon no longer running.
+ * @return The socket's descriptor, or -1 on failure.
+ */
+static int trycmd_daemon_listen(const char* const path) {
+    struct sockaddr_un addr;
+    mode_t saved_umask;
+    int fd;
+    int rc;
+
+    if (trycmd_daemon_address(path, &addr) != 0) {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* Only our own user may connect. */
+    saved_umask = umask(0077);
+    rc = bind(fd, (const struct sockaddr*)&addr, sizeof(addr));
+    if (rc != 0 && errno == EADDRINUSE) {
+        const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe >= 0
+            && connect(probe, (const struct sockaddr*)&addr, sizeof(addr)) != 0
+            && errno == ECONNREFUSED) {
+            unlink(path);
+            rc = bind(fd, (const struct sockaddr*)&addr, sizeof(addr));
+        } else {
+            errno = EADDRINUSE;
+        }
+        if (probe >= 0) {
+            close(probe);
+        }
+    }
+    umask(saved_umask);
+    if (rc != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int trycmd_daemon_serve(const char* const path, const int workers) {
+    sigset_t signals, saved_mask;
+    pid_t* pids;
+    int listen_fd;
+    int signum = 0;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL path" && (path != NULL));
+    assert("Unexpected non-positive workers" && (workers > 0));
+
+    /*
+     * Initialize once. Each worker loads its client's locale as needed
+     * (see trycmd_intl_init).
+     */
+    trycmd_debug_init();
+
+    /* Handle those signals by which we are stopped, and those of workers. */
+    trycmd_forwarded_signals(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, &saved_mask);
+    listen_fd = trycmd_daemon_listen(path);
+    pids = calloc((size_t)workers, sizeof(*pids));
+    if (listen_fd < 0 || pids == NULL) {
+        const int saved_errno = errno;
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(path);
+        }
+        free(pids);
+        sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+        errno = saved_errno;
+        return -1;
+    }
+    trycmd_debug("tryd: listening on %s with %d worker(s)\n", path, workers);
+
+    /* Keep every worker waiting, replacing each as it finishes. */
+    while (signum == 0 || signum == SIGCHLD) {
+        pid_t pid;
+        for (idx = 0; idx < workers; ++idx) {
+            if (pids[idx] <= 0) {
+                pids[idx] = trycmd_daemon_fork(listen_fd, &saved_mask);
+            }
+        }
+        signum = sigwaitinfo(&signals, NULL);
+        while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+            for (idx = 0; idx < workers; ++idx) {
+                if (pids[idx] == pid) {
+                    pids[idx] = 0;
+                }
+            }
+        }
+        if (signum < 0 && errno == EINTR) {
+            signum = 0;
+        }
+    }
+
+    /* Stop every worker, then all is done. */
+    trycmd_debug("tryd: stopping upon signal %d\n", signum);
+    close(listen_fd);
+    unlink(path);
+    for (idx = 0; idx < workers; ++idx) {
+        if (pids[idx] > 0) {
+            kill(pids[idx], SIGTERM);
+            waitpid(pids[idx], NULL, 0);
+        }
+    }
+    free(pids);
+    sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+    return 0;
+}
+
+int trycmd_daemon_main(const int argc, char* argv[]) {
+    const char* const shortopts = N_("+h");
+    const struct option longopts[] = {
+        { N_("workers"), required_argument, NULL, 'w' },
+        { N_("help"),    no_argument,       NULL, 'h' },
+        { NULL,          0,                 NULL, 0   }
+    };
+    int workers = TRYCMD_DAEMON_WORKERS;
+    int help = 0;
+    int valid = 1;
+    int opt;
+
+    /* Check arguments. */
+    assert("Unexpected negative argc" && (argc >= 0));
+    assert("Unexpected NULL argv" && (argv != NULL));
+
+    /* Read options, then expect only the socket. */
+    optind = 1;
+    while ((opt = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1) {
+        switch (opt) {
+            case 'w':  /* Workers=N. */
+                valid = valid && (trycmd_parse_jobs(optarg, &workers) == 0);
+                break;
+            case 'h':  /* Help me! */
+                help = 1;
+                break;
+            default:   /* Invalid option. */
+                valid = 0;
+                break;
+        }
+    }
+    if (help || !valid || optind != argc - 1) {
+        fputs(_("Usage: tryd [OPTION]... SOCKET\n"
+                "Run commands for try, given TRY_DAEMON=SOCKET, from a pool of"
+                " waiting processes.\n"
+                "\nOptions:\n"
+                "  --workers=N        Keep N processes waiting (default 2,"
+                " 0 for one per CPU).\n"
+                "  -h, --help         Show this message.\n\n"), stdout);
+        return help ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Serve until stopped. */
+    if (trycmd_daemon_serve(argv[optind], workers) != 0) {
+        fprintf(stderr, _("tryd: %s: %s\n"), argv[optind], strerror(errno));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* EOF */
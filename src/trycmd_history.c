@@ -0,0 +1,309 @@
+/**
+ * \file      trycmd_history.c
+ * \brief     Persistent history of subcommand results.
+ * \details   Each result is appended to a history file as a single,
+ *            fixed-size record, by one write(2) to a file opened with
+ *            O_APPEND, so that any number of concurrent try processes may
+ *            share a history without locking. The history is queried by
+ *            mapping the whole file and scanning its records in place.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <fcntl.h>         /* open, O_*. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* int32_t, uint32_t, uint64_t. */
+#include <stdio.h>         /* fprintf. */
+#include <stdlib.h>        /* free, malloc, qsort. */
+#include <string.h>        /* memcpy, memset, strlen. */
+#include <sys/mman.h>      /* mmap, munmap. */
+#include <sys/stat.h>      /* fstat. */
+#include <unistd.h>        /* close. */
+
+/** Identifies a history record, and its layout version. */
+#define TRYCMD_HISTORY_MAGIC   (0x31485254u)  /* "TRH1". */
+
+/** The length of the command name kept within each record. */
+#define TRYCMD_HISTORY_NAME_SZ (24u)
+
+/** A single subcommand's result (64 bytes). */
+struct trycmd_history_record {
+    /** TRYCMD_HISTORY_MAGIC. */
+    uint32_t magic;
+
+    /** The subcommand's exit status. */
+    int32_t  exit_status;
+
+    /** The subcommand's hash (see trycmd_history_hash). */
+    uint64_t command_hash;
+
+    /** When the subcommand was started, in nanoseconds since the epoch. */
+    uint64_t start_ns;
+
+    /** The time spent running the subcommand, in nanoseconds. */
+    uint64_t duration_ns;
+
+    /** The subcommand's maximum resident set size, in kibibytes. */
+    uint64_t maxrss_kib;
+
+    /** The start of the subcommand, as its arguments joined by spaces. */
+    char     name[TRYCMD_HISTORY_NAME_SZ];
+};
+
+/** A record's place within a history being summarized. */
+struct trycmd_history_entry {
+    uint64_t command_hash;
+    uint64_t duration_ns;
+    size_t   index;
+    int      failed;
+};
+
+/** A summary of all records for a single subcommand. */
+struct trycmd_history_summary {
+    /** The first and last of the subcommand's entries, once sorted. */
+    const struct trycmd_history_entry* first;
+    const struct trycmd_history_entry* last;
+
+    /** The index of the subcommand's first record. */
+    size_t   first_index;
+
+    /** The number of failed runs. */
+    size_t   failed;
+};
+
+uint64_t trycmd_history_hash(char* const argv[]) {
+    uint64_t hash = 0;
+
+    /* Check arguments. */
+    assert("Unexpected NULL argv" && (argv != NULL));
+
+    /* Include each terminator, so that 'a b' differs from 'ab'. */
+    for (; *argv != NULL; ++argv) {
+        hash = trycmd_hash64(*argv, strlen(*argv) + 1, hash);
+    }
+    return hash;
+}
+
+int trycmd_history_append(const char* const path,
+                          const struct trycmd_opts* const opts,
+                          const struct trycmd_result* const result) {
+    struct trycmd_history_record record;
+    size_t name_len = 0;
+    char** argv;
+    int fd;
+    int rc;
+
+    /* Check arguments. */
+    assert("Unexpected NULL path" && (path != NULL));
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL result" && (result != NULL));
+
+    memset(&record, 0, sizeof(record));
+    record.magic        = TRYCMD_HISTORY_MAGIC;
+    record.exit_status  = result->exit_status;
+    record.command_hash = trycmd_history_hash(opts->opt_sub_argv);
+    record.start_ns     = (uint64_t)result->started.tv_sec * UINT64_C(1000000000)
+                        + (uint64_t)result->started.tv_nsec;
+    record.duration_ns  = result->elapsed_ns;
+    record.maxrss_kib   = (uint64_t)result->rusage.ru_maxrss;
+
+    /* Keep as much of the command as fits, for display. */
+    for (argv = opts->opt_sub_argv; *argv != NULL; ++argv) {
+        size_t len = strlen(*argv);
+        if (argv != opts->opt_sub_argv
+            && name_len < TRYCMD_HISTORY_NAME_SZ - 1) {
+            record.name[name_len++] = ' ';
+        }
+        if (len > TRYCMD_HISTORY_NAME_SZ - 1 - name_len) {
+            len = TRYCMD_HISTORY_NAME_SZ - 1 - name_len;
+        }
+        memcpy(&record.name[name_len], *argv, len);
+        name_len += len;
+    }
+
+    /* Append the record by a single write, so never interleaved. */
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    rc = trycmd_write_all(fd, (const char*)&record, sizeof(record));
+    close(fd);
+    return rc;
+}
+
+/**
+ * Order history entries by subcommand, then by duration.
+ */
+static int trycmd_history_entry_cmp(const void* const lhs_ptr,
+                                    const void* const rhs_ptr) {
+    const struct trycmd_history_entry* const lhs = lhs_ptr;
+    const struct trycmd_history_entry* const rhs = rhs_ptr;
+    if (lhs->command_hash != rhs->command_hash) {
+        return (lhs->command_hash < rhs->command_hash) ? -1 : 1;
+    } else if (lhs->duration_ns != rhs->duration_ns) {
+        return (lhs->duration_ns < rhs->duration_ns) ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Order history summaries by when each subcommand was first run.
+ */
+static int trycmd_history_summary_cmp(const void* const lhs_ptr,
+                                      const void* const rhs_ptr) {
+    const struct trycmd_history_summary* const lhs = lhs_ptr;
+    const struct trycmd_history_summary* const rhs = rhs_ptr;
+    return (lhs->first_index < rhs->first_index) ? -1
+         : (lhs->first_index > rhs->first_index) ?  1 : 0;
+}
+
+/**
+ * Print the summary of one subcommand's runs, without a trailing newline.
+ * Its durations are given in ascending order.
+ */
+static void trycmd_history_print(const struct trycmd_history_entry* const first,
+                                 const size_t count,
+                                 const size_t failed,
+                                 FILE* const os) {
+    static const unsigned int percentiles[] = { 50, 90, 99 };
+    const unsigned long failed_permille =
+        (unsigned long)((failed * 1000 + count / 2) / count);
+    size_t idx;
+
+    fprintf(os, _("History (runs=%lu, failed=%lu.%lu%%"),
+            (unsigned long)count, failed_permille / 10, failed_permille % 10);
+    for (idx = 0; idx < sizeof(percentiles) / sizeof(percentiles[0]); ++idx) {
+        /* By nearest rank. */
+        const size_t rank = (count * percentiles[idx] + 99) / 100;
+        const unsigned long ms =
+            (unsigned long)(first[rank - 1].duration_ns / 1000000);
+        fprintf(os, _(", p%u=%lu.%03lus"), percentiles[idx],
+                ms / 1000, ms % 1000);
+    }
+    fputs(N_("):"), os);
+}
+
+/**
+ * Summarize and print those records matching argv (or, if NULL, all),
+ * given space for an entry and a summary per record.
+ */
+static void trycmd_history_scan(const struct trycmd_history_record* const records,
+                                const size_t record_count,
+                                char* const argv[],
+                                struct trycmd_history_entry* const entries,
+                                struct trycmd_history_summary* const summaries,
+                                FILE* const os) {
+    const uint64_t command_hash = (argv != NULL) ? trycmd_history_hash(argv) : 0;
+    struct trycmd_history_summary* summary = NULL;
+    size_t entry_count = 0;
+    size_t summary_count = 0;
+    size_t idx;
+
+    /* Gather the runs of interest, ordered by subcommand then duration. */
+    for (idx = 0; idx < record_count; ++idx) {
+        const struct trycmd_history_record* const record = &records[idx];
+        if (record->magic != TRYCMD_HISTORY_MAGIC
+            || (argv != NULL && record->command_hash != command_hash)) {
+            continue;
+        }
+        entries[entry_count].command_hash = record->command_hash;
+        entries[entry_count].duration_ns  = record->duration_ns;
+        entries[entry_count].index        = idx;
+        entries[entry_count].failed       = (record->exit_status != 0);
+        ++entry_count;
+    }
+    qsort(entries, entry_count, sizeof(*entries), trycmd_history_entry_cmp);
+
+    /* Summarize each subcommand, then show them in order of first run. */
+    for (idx = 0; idx < entry_count; ++idx) {
+        if (summary == NULL
+            || entries[idx].command_hash != summary->first->command_hash) {
+            summary = &summaries[summary_count++];
+            summary->first       = &entries[idx];
+            summary->first_index = entries[idx].index;
+            summary->failed      = 0;
+        }
+        summary->last = &entries[idx];
+        summary->failed += (size_t)entries[idx].failed;
+        if (entries[idx].index < summary->first_index) {
+            summary->first_index = entries[idx].index;
+        }
+    }
+    qsort(summaries, summary_count, sizeof(*summaries),
+          trycmd_history_summary_cmp);
+    for (idx = 0; idx < summary_count; ++idx) {
+        const struct trycmd_history_record* const record =
+            &records[summaries[idx].first_index];
+        trycmd_history_print(summaries[idx].first,
+                             (size_t)(summaries[idx].last
+                                      - summaries[idx].first) + 1,
+                             summaries[idx].failed, os);
+        if (argv != NULL) {
+            trycmd_print_argv(N_(""), (char**)argv, os);
+        } else {
+            fprintf(os, N_(" %.*s\n"), (int)sizeof(record->name),
+                    record->name);
+        }
+    }
+    if (argv != NULL && summary_count == 0) {
+        trycmd_print_argv(_("History (runs=0):"), (char**)argv, os);
+    }
+    fflush(os);
+}
+
+int trycmd_history_report(const char* const path,
+                          char* const argv[],
+                          FILE* const os) {
+    const struct trycmd_history_record* records = NULL;
+    struct trycmd_history_entry* entries;
+    struct trycmd_history_summary* summaries;
+    size_t record_count;
+    struct stat st;
+    int result = -1;
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL path" && (path != NULL));
+    assert("Unexpected NULL os" && (os != NULL));
+
+    /* Map the whole history, ignoring any record still being written. */
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    record_count = (size_t)st.st_size / sizeof(*records);
+    if (record_count > 0) {
+        records = mmap(NULL, record_count * sizeof(*records), PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (records == MAP_FAILED) {
+        return -1;
+    }
+
+    /* Then scan it, with space to summarize every record. */
+    entries   = malloc((record_count + 1) * sizeof(*entries));
+    summaries = malloc((record_count + 1) * sizeof(*summaries));
+    if (entries != NULL && summaries != NULL) {
+        trycmd_history_scan(records, record_count, argv, entries, summaries, os);
+        result = 0;
+    }
+    free(summaries);
+    free(entries);
+    if (records != NULL) {
+        munmap((void*)records, record_count * sizeof(*records));
+    }
+    return result;
+}
+
+/* EOF */
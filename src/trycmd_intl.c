@@ -10,9 +10,20 @@
 
 #include "trycmd_config.h"
 #include "trycmd.h"
+
+#if defined(TRYCMD_NO_INTL)
+/* Translation is compiled out. Emit _() for any call not inlined. */
+extern inline char* _(char* s);
+
+void trycmd_intl_init(void) {
+    /* Nothing to do: the locale is never loaded. */
+}
+#else
 #include <assert.h>   /* assert. */
 #include <locale.h>   /* setlocale, bindtextdomain, textdomain. */
 #include <libintl.h>  /* gettext. */
+#include <stdint.h>   /* uint64_t, uintptr_t, UINT64_C. */
+#include <string.h>   /* memset. */
 
 /* Check for required defined values. */
 #if !defined(PACKAGE)
@@ -27,7 +38,25 @@
 #  error Missing required function 'setlocale'.
 #endif
 
-void trycmd_intl_init(void) {
+/** The number of translations kept, each by the address of its message. */
+#define TRYCMD_INTL_CACHE_SIZE (64)
+
+/** A message, by address, and its translation. */
+struct trycmd_intl_entry {
+    const char* msgid;
+    char*       msgstr;
+};
+
+/** If non-zero, the locale and message catalog have been loaded. */
+static int trycmd_intl_loaded = 0;
+
+/** Those translations most recently used, indexed by message address. */
+static struct trycmd_intl_entry trycmd_intl_cache[TRYCMD_INTL_CACHE_SIZE];
+
+/**
+ * Load the user's locale and message catalog.
+ */
+static void trycmd_intl_load(void) {
     /*
      * Standard gettext boilerplate.
      * "PACKAGE" and "LOCALEDIR" to be set by external tools.
@@ -47,13 +76,42 @@ void trycmd_intl_init(void) {
     (void) locale;
     (void) txt_domain;
     (void) msg_domain;
+    trycmd_intl_loaded = 1;
+}
+
+void trycmd_intl_init(void) {
+    /*
+     * Defer loading the locale until a message is first translated, as
+     * many runs (such as those of a successful, quiet, subcommand) print
+     * very little, and only after the subcommand has been run. Forget any
+     * translation kept meanwhile, as the locale may since have changed.
+     */
+    trycmd_intl_loaded = 0;
+    memset(trycmd_intl_cache, 0, sizeof(trycmd_intl_cache));
 }
 
 char* _(char* const s) {
+    /*
+     * Every message is a string literal, so is identified by its address.
+     * Keep each translation once made, replacing any other in its slot.
+     */
+    struct trycmd_intl_entry* const entry = &trycmd_intl_cache[
+        (size_t)(((uint64_t)(uintptr_t)s * UINT64_C(0x9e3779b97f4a7c15)) >> 32)
+        % TRYCMD_INTL_CACHE_SIZE];
+    if (entry->msgid == s) {
+        return entry->msgstr;
+    }
+    if (!trycmd_intl_loaded) {
+        trycmd_intl_load();
+    }
+
     /*
      * Pass the given string onward to gettext for translation.
      */
-    return gettext(s);
+    entry->msgid  = s;
+    entry->msgstr = gettext(s);
+    return entry->msgstr;
 }
+#endif /* TRYCMD_NO_INTL */
 
 /* EOF */
@@ -0,0 +1,306 @@
+/**
+ * \file      trycmd_jobserver.c
+ * \brief     GNU make jobserver client and server.
+ * \details   A jobserver is a pipe (or named fifo) holding one single-byte
+ *            token per free job slot. Every participant holds one implicit
+ *            slot, and must read a token before using any other, writing
+ *            that same token back once done. Its descriptors are described
+ *            to each 'make' through MAKEFLAGS.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EAGAIN, EINTR. */
+#include <fcntl.h>         /* fcntl, open, F_*, FD_CLOEXEC, O_*. */
+#include <stddef.h>        /* size_t. */
+#include <stdio.h>         /* snprintf, sscanf. */
+#include <stdlib.h>        /* free, malloc, setenv, unsetenv. */
+#include <string.h>        /* memcpy, strdup, strlen, strncmp. */
+#include <unistd.h>        /* close, pipe, read, write. */
+#include <linux/limits.h>  /* PATH_MAX. */
+
+/** The token written by try, as for GNU make. */
+#define TRYCMD_JOBSERVER_TOKEN ('+')
+
+/**
+ * Find the last jobserver description within the given MAKEFLAGS.
+ * @param  makeflags The MAKEFLAGS value.
+ * @param  auth_len  On success, the description's length.
+ * @return The description (e.g. "3,4" or "fifo:/tmp/x"), or NULL.
+ */
+static const char* trycmd_jobserver_find(const char* makeflags,
+                                         size_t* const auth_len) {
+    static const char* const prefixes[] = {
+        "--jobserver-auth=",
+        "--jobserver-fds=",
+    };
+    const char* auth = NULL;
+
+    while (*makeflags != '\0') {
+        size_t word_len = 0;
+        size_t idx;
+
+        /* Split at whitespace (make escapes any within a word). */
+        while (*makeflags == ' ' || *makeflags == '\t') {
+            ++makeflags;
+        }
+        while (makeflags[word_len] != '\0' && makeflags[word_len] != ' '
+               && makeflags[word_len] != '\t') {
+            ++word_len;
+        }
+        for (idx = 0; idx < sizeof(prefixes) / sizeof(prefixes[0]); ++idx) {
+            const size_t prefix_len = strlen(prefixes[idx]);
+            if (word_len > prefix_len
+                && strncmp(makeflags, prefixes[idx], prefix_len) == 0) {
+                auth = makeflags + prefix_len;
+                *auth_len = word_len - prefix_len;
+            }
+        }
+        makeflags += word_len;
+    }
+    return auth;
+}
+
+/**
+ * Open a private, non-blocking descriptor for reading from the same pipe
+ * as fd. Non-blocking reads must not be made through a shared descriptor,
+ * as doing so would alter the behaviour of every other participant.
+ * @return The new descriptor, or -1 on failure.
+ */
+static int trycmd_jobserver_reopen(const int fd) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+/**
+ * Mark the inherited descriptor fd as inheritable by subcommands.
+ * @return 0 on success, -1 if fd is not open.
+ */
+static int trycmd_jobserver_inherit(const int fd) {
+    const int flags = fcntl(fd, F_GETFD);
+    if (flags < 0) {
+        return -1;
+    }
+    return (flags & FD_CLOEXEC) ? fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC) : 0;
+}
+
+int trycmd_jobserver_open(struct trycmd_jobserver* const js,
+                          const char* const makeflags) {
+    const char* auth;
+    size_t auth_len = 0;
+
+    /* Check arguments. */
+    assert("Unexpected NULL js" && (js != NULL));
+    js->read_fd         = -1;
+    js->write_fd        = -1;
+    js->token_fd        = -1;
+    js->owner           = 0;
+    js->saved_makeflags = NULL;
+    if (makeflags == NULL
+        || (auth = trycmd_jobserver_find(makeflags, &auth_len)) == NULL) {
+        return -1;
+    }
+
+    if (auth_len > 5 && strncmp(auth, "fifo:", 5) == 0) {
+        /* A named fifo, opened privately by each participant. */
+        char path[PATH_MAX];
+        if (auth_len - 5 >= sizeof(path)) {
+            return -1;
+        }
+        memcpy(path, auth + 5, auth_len - 5);
+        path[auth_len - 5] = '\0';
+        js->token_fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (js->token_fd >= 0) {
+            js->write_fd = open(path, O_WRONLY | O_CLOEXEC);
+        }
+        trycmd_debug("trycmd_jobserver_open: fifo %s\n", path);
+    } else {
+        /* Inherited pipe descriptors, which must be passed on. */
+        char fds[32];
+        int read_fd = -1;
+        int write_fd = -1;
+        char end;
+        if (auth_len >= sizeof(fds)) {
+            return -1;
+        }
+        memcpy(fds, auth, auth_len);
+        fds[auth_len] = '\0';
+        if (sscanf(fds, "%d,%d%c", &read_fd, &write_fd, &end) != 2
+            || read_fd < 0 || write_fd < 0
+            || trycmd_jobserver_inherit(read_fd) != 0
+            || trycmd_jobserver_inherit(write_fd) != 0) {
+            /* Likely closed by make, as try was not marked as recursive. */
+            trycmd_debug("trycmd_jobserver_open: unusable jobserver: %s\n",
+                         fds);
+            return -1;
+        }
+        js->read_fd  = read_fd;
+        js->write_fd = write_fd;
+        js->token_fd = trycmd_jobserver_reopen(read_fd);
+        trycmd_debug("trycmd_jobserver_open: fds %d,%d\n", read_fd, write_fd);
+    }
+    if (js->token_fd < 0 || js->write_fd < 0) {
+        trycmd_jobserver_close(js);
+        return -1;
+    }
+    return 0;
+}
+
+int trycmd_jobserver_create(struct trycmd_jobserver* const js,
+                            const int slots) {
+    const char* const makeflags = trycmd_getenv_s("MAKEFLAGS", NULL);
+    const char token = TRYCMD_JOBSERVER_TOKEN;
+    char* new_makeflags;
+    size_t new_len;
+    int pipe_fds[2];
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL js" && (js != NULL));
+    assert("Unexpected non-positive slots" && (slots > 0));
+    js->read_fd         = -1;
+    js->write_fd        = -1;
+    js->token_fd        = -1;
+    js->owner           = 1;
+    js->saved_makeflags = NULL;
+
+    /*
+     * Save MAKEFLAGS first, so that closing this jobserver upon any
+     * failure restores it unchanged.
+     */
+    new_len = ((makeflags != NULL) ? strlen(makeflags) : 0) + 64;
+    if ((new_makeflags = malloc(new_len)) == NULL
+        || (makeflags != NULL
+            && (js->saved_makeflags = strdup(makeflags)) == NULL)) {
+        free(new_makeflags);
+        trycmd_jobserver_close(js);
+        return -1;
+    }
+
+    /* Fill a new pipe with one token per slot, less our implicit slot. */
+    if (pipe(pipe_fds) != 0) {
+        free(new_makeflags);
+        trycmd_jobserver_close(js);
+        return -1;
+    }
+    js->read_fd  = pipe_fds[0];
+    js->write_fd = pipe_fds[1];
+    for (idx = 1; idx < slots; ++idx) {
+        if (write(js->write_fd, &token, 1) != 1) {
+            break;
+        }
+    }
+    if (idx < slots
+        || (js->token_fd = trycmd_jobserver_reopen(js->read_fd)) < 0) {
+        free(new_makeflags);
+        trycmd_jobserver_close(js);
+        return -1;
+    }
+
+    /* Describe the jobserver to every subcommand, via MAKEFLAGS. */
+    snprintf(new_makeflags, new_len, "%s%s-j%d --jobserver-auth=%d,%d",
+             (makeflags != NULL) ? makeflags : "",
+             (makeflags != NULL && makeflags[0] != '\0') ? " " : "",
+             slots, js->read_fd, js->write_fd);
+    setenv("MAKEFLAGS", new_makeflags, 1);
+    trycmd_debug("trycmd_jobserver_create: MAKEFLAGS=%s\n", new_makeflags);
+    free(new_makeflags);
+    return 0;
+}
+
+int trycmd_jobserver_setup(struct trycmd_jobserver* const js,
+                           const struct trycmd_opts* const opts) {
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+
+    /* An existing jobserver always takes precedence. */
+    if (trycmd_jobserver_open(js, trycmd_getenv_s("MAKEFLAGS", NULL)) == 0) {
+        return 0;
+    }
+    if (opts->opt_jobserver) {
+        return trycmd_jobserver_create(js, (opts->opt_jobs > 0) ? opts->opt_jobs
+                                                                : 1);
+    }
+    return -1;
+}
+
+int trycmd_jobserver_acquire(const struct trycmd_jobserver* const js,
+                             int* const token_out) {
+    unsigned char token;
+    ssize_t result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL js" && (js != NULL));
+    assert("Unexpected NULL token_out" && (token_out != NULL));
+
+    do {
+        result = read(js->token_fd, &token, 1);
+    } while (result < 0 && errno == EINTR);
+    if (result != 1) {
+        /* A closed jobserver cannot provide more tokens. */
+        if (result == 0) {
+            errno = EAGAIN;
+        }
+        return -1;
+    }
+    *token_out = token;
+    return 0;
+}
+
+void trycmd_jobserver_release(const struct trycmd_jobserver* const js,
+                              const int token) {
+    const unsigned char value = (unsigned char)token;
+    ssize_t result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL js" && (js != NULL));
+
+    do {
+        result = write(js->write_fd, &value, 1);
+    } while (result < 0 && errno == EINTR);
+    if (result != 1) {
+        /* Nothing more can be done, but the slot is lost to all. */
+        trycmd_debug("trycmd_jobserver_release: failed to return a token\n");
+    }
+}
+
+void trycmd_jobserver_close(struct trycmd_jobserver* const js) {
+    assert("Unexpected NULL js" && (js != NULL));
+
+    /* Close only those descriptors which are our own. */
+    if (js->token_fd >= 0) {
+        close(js->token_fd);
+    }
+    if (js->owner || js->read_fd < 0) {
+        if (js->read_fd >= 0) {
+            close(js->read_fd);
+        }
+        if (js->write_fd >= 0) {
+            close(js->write_fd);
+        }
+    }
+
+    /* Restore MAKEFLAGS, as it was before this jobserver was created. */
+    if (js->owner) {
+        if (js->saved_makeflags != NULL) {
+            setenv("MAKEFLAGS", js->saved_makeflags, 1);
+        } else {
+            unsetenv("MAKEFLAGS");
+        }
+        free(js->saved_makeflags);
+    }
+    js->read_fd         = -1;
+    js->write_fd        = -1;
+    js->token_fd        = -1;
+    js->owner           = 0;
+    js->saved_makeflags = NULL;
+}
+
+/* EOF */
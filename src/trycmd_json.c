@@ -0,0 +1,274 @@
+/**
+ * \file      trycmd_json.c
+ * \brief     Write each subcommand's result as a JSON record.
+ * \details   Records are written one per line (as NDJSON) through a single
+ *            fully-buffered stream, opened once, so that nothing is
+ *            allocated per record or field and each record (unless very
+ *            large) reaches its destination in a single write. The
+ *            command, as shown within a result message, is escaped as it
+ *            is printed through a second, unbuffered, stream.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EBADF. */
+#include <fcntl.h>         /* fcntl, open, F_*, O_*. */
+#include <limits.h>        /* INT_MAX. */
+#include <stddef.h>        /* size_t. */
+#include <stdio.h>         /* fdopen, fclose, fflush, fopencookie, fprintf, fwrite. */
+#include <stdlib.h>        /* strtol. */
+#include <string.h>        /* memset, strlen, strspn. */
+#include <sys/types.h>     /* ssize_t. */
+#include <time.h>          /* gmtime_r, strftime, struct timespec, struct tm. */
+#include <unistd.h>        /* close. */
+
+/** The size of the buffer through which records are written. */
+#define TRYCMD_JSON_BUFFER_SIZE (64 * 1024)
+
+/**
+ * Find the length of the UTF-8 sequence starting the given text.
+ * @return The sequence's length in bytes, or 0 if it is not valid UTF-8
+ *         (being truncated, overlong, a surrogate, or beyond U+10FFFF).
+ */
+static size_t trycmd_json_utf8_len(const unsigned char* const text,
+                                   const size_t len) {
+    size_t seq_len;
+    unsigned long code;
+    size_t idx;
+    if (text[0] >= 0xc2 && text[0] <= 0xdf) {
+        seq_len = 2;
+        code    = text[0] & 0x1f;
+    } else if (text[0] >= 0xe0 && text[0] <= 0xef) {
+        seq_len = 3;
+        code    = text[0] & 0x0f;
+    } else if (text[0] >= 0xf0 && text[0] <= 0xf4) {
+        seq_len = 4;
+        code    = text[0] & 0x07;
+    } else {
+        return 0;
+    }
+    if (seq_len > len) {
+        return 0;
+    }
+    for (idx = 1; idx < seq_len; ++idx) {
+        if ((text[idx] & 0xc0) != 0x80) {
+            return 0;
+        }
+        code = (code << 6) | (text[idx] & 0x3f);
+    }
+    if ((seq_len == 3 && (code < 0x800 || (code >= 0xd800 && code <= 0xdfff)))
+        || (seq_len == 4 && (code < 0x10000 || code > 0x10ffff))) {
+        return 0;
+    }
+    return seq_len;
+}
+
+/**
+ * Write the given text to a stream, escaped for use within a JSON string.
+ * Bytes which are not valid UTF-8 are each replaced by U+FFFD, so that
+ * every record remains valid JSON.
+ */
+static void trycmd_json_escape(const char* const text,
+                               const size_t len,
+                               FILE* const os) {
+    const unsigned char* const bytes = (const unsigned char*)text;
+    size_t idx = 0;
+    while (idx < len) {
+        const unsigned char c = bytes[idx];
+        if (c == '"' || c == '\\') {
+            fputc('\\', os);
+            fputc(c, os);
+        } else if (c < 0x20 || c == 0x7f) {
+            fprintf(os, N_("\\u%04x"), c);
+        } else if (c < 0x80) {
+            fputc(c, os);
+        } else {
+            const size_t seq_len = trycmd_json_utf8_len(&bytes[idx],
+                                                        len - idx);
+            if (seq_len == 0) {
+                fputs(N_("\\ufffd"), os);
+            } else {
+                fwrite(&bytes[idx], 1, seq_len, os);
+                idx += seq_len;
+                continue;
+            }
+        }
+        ++idx;
+    }
+}
+
+#if defined(HAVE_FOPENCOOKIE)
+/**
+ * Write to the stream given as cookie, escaping all written for JSON.
+ */
+static ssize_t trycmd_json_escape_write(void* const cookie,
+                                        const char* const buffer,
+                                        const size_t size) {
+    trycmd_json_escape(buffer, size, (FILE*)cookie);
+    return (ssize_t)size;
+}
+#endif
+
+/**
+ * Write a timestamp to a stream, as a JSON string in UTC (RFC 3339).
+ */
+static void trycmd_json_time(const struct timespec* const ts, FILE* const os) {
+    char text[32];
+    struct tm tm;
+    if (gmtime_r(&ts->tv_sec, &tm) == NULL
+        || strftime(text, sizeof(text), N_("%Y-%m-%dT%H:%M:%S"), &tm) == 0) {
+        fputs(N_("null"), os);
+        return;
+    }
+    fprintf(os, N_("\"%s.%03ldZ\""), text, ts->tv_nsec / 1000000);
+}
+
+int trycmd_json_open(struct trycmd_json* const json, const char* const target) {
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL json" && (json != NULL));
+    assert("Unexpected NULL target" && (target != NULL));
+    memset(json, 0, sizeof(*json));
+
+    /*
+     * Use a duplicate of an inherited descriptor, given by number (which
+     * itself is left open, and inherited by subcommands), or append to a
+     * file. Neither the duplicate nor the file is inherited.
+     */
+    if (target[0] != '\0' && target[strspn(target, "0123456789")] == '\0') {
+        long value;
+        errno = 0;
+        value = strtol(target, NULL, 10);
+        if (errno != 0 || value > INT_MAX) {
+            errno = EBADF;
+            return -1;
+        }
+        fd = fcntl((int)value, F_DUPFD_CLOEXEC, 3);
+        if (fd < 0) {
+            return -1;
+        }
+    } else {
+        fd = open(target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            return -1;
+        }
+    }
+    json->os = fdopen(fd, "a");
+    if (json->os == NULL) {
+        close(fd);
+        return -1;
+    }
+    setvbuf(json->os, NULL, _IOFBF, TRYCMD_JSON_BUFFER_SIZE);
+
+#if defined(HAVE_FOPENCOOKIE)
+    /* Prepare a stream upon which the command is escaped as printed. */
+    {
+        cookie_io_functions_t functions;
+        memset(&functions, 0, sizeof(functions));
+        functions.write = trycmd_json_escape_write;
+        json->escaped = fopencookie(json->os, "w", functions);
+        if (json->escaped != NULL) {
+            setvbuf(json->escaped, NULL, _IONBF, 0);
+        }
+    }
+#endif
+    return 0;
+}
+
+int trycmd_json_write(struct trycmd_json* const json,
+                      const struct trycmd_opts* const opts,
+                      const struct trycmd_result* const result) {
+    const struct rusage* const ru = &result->rusage;
+    FILE* const os = json->os;
+    char** argv;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL json" && (json != NULL));
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL result" && (result != NULL));
+
+    /* The command, both as given and as shown within a result message. */
+    fputs(N_("{\"argv\":["), os);
+    for (argv = opts->opt_sub_argv; *argv != NULL; ++argv) {
+        fputs((argv == opts->opt_sub_argv) ? N_("\"") : N_(",\""), os);
+        trycmd_json_escape(*argv, strlen(*argv), os);
+        fputc('"', os);
+    }
+    fputs(N_("],\"command\":\""), os);
+    for (argv = opts->opt_sub_argv; *argv != NULL; ++argv) {
+        if (argv != opts->opt_sub_argv) {
+            fputc(' ', os);
+        }
+        if (json->escaped != NULL) {
+            trycmd_pretty_print_arg(*argv, json->escaped);
+        } else {
+            trycmd_json_escape(*argv, strlen(*argv), os);
+        }
+    }
+
+    /* How it ended. */
+    fprintf(os, N_("\",\"status\":%d,\"signal\":"), result->exit_status);
+    if (result->term_signal > 0) {
+        fprintf(os, N_("%d"), result->term_signal);
+    } else {
+        fputs(N_("null"), os);
+    }
+    fprintf(os, N_(",\"timed_out\":%s,\"attempts\":%u"),
+            result->timed_out ? N_("true") : N_("false"), result->attempts);
+
+    /* When, and for how long. */
+    fputs(N_(",\"start\":"), os);
+    trycmd_json_time(&result->started, os);
+    fputs(N_(",\"end\":"), os);
+    trycmd_json_time(&result->ended, os);
+    fprintf(os, N_(",\"duration_ns\":%lu"), (unsigned long)result->elapsed_ns);
+
+    /* The resources used. */
+    fprintf(os, N_(",\"rusage\":{\"user_us\":%ld,\"sys_us\":%ld"
+                   ",\"maxrss_kib\":%ld,\"majflt\":%ld,\"minflt\":%ld"
+                   ",\"nvcsw\":%ld,\"nivcsw\":%ld}"),
+            (long)ru->ru_utime.tv_sec * 1000000 + (long)ru->ru_utime.tv_usec,
+            (long)ru->ru_stime.tv_sec * 1000000 + (long)ru->ru_stime.tv_usec,
+            ru->ru_maxrss, ru->ru_majflt, ru->ru_minflt,
+            ru->ru_nvcsw, ru->ru_nivcsw);
+    if (opts->opt_perf) {
+        int first = 1;
+        fputs(N_(",\"perf\":{"), os);
+        for (idx = 0; idx < trycmd_perf_events; ++idx) {
+            if (result->perf.valid & (1u << idx)) {
+                fprintf(os, N_("%s\"%s\":%lu"), first ? N_("") : N_(","),
+                        trycmd_perf_names[idx],
+                        (unsigned long)result->perf.value[idx]);
+                first = 0;
+            }
+        }
+        fputc('}', os);
+    }
+
+    /* End the record, and write it at once. */
+    fputs(N_("}\n"), os);
+    return (fflush(os) == 0) ? 0 : -1;
+}
+
+void trycmd_json_close(struct trycmd_json* const json) {
+    /* Check arguments. */
+    assert("Unexpected NULL json" && (json != NULL));
+    if (json->escaped != NULL) {
+        fclose(json->escaped);
+        json->escaped = NULL;
+    }
+    if (json->os != NULL) {
+        fclose(json->os);
+        json->os = NULL;
+    }
+}
+
+/* EOF */
@@ -0,0 +1,367 @@
+/**
+ * \file      trycmd_loop.c
+ * \brief     An epoll-based event loop, for supervising running subcommands.
+ * \details   Each source of events (a child's pidfd, a timerfd, a signalfd
+ *            or any other descriptor) is registered with a handler, whose
+ *            callback is run upon each of its events. Children for which no
+ *            pidfd is available (before Linux 5.3) are instead checked upon
+ *            each SIGCHLD, received through a shared signalfd.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>          /* assert. */
+#include <errno.h>           /* errno, EINTR. */
+#include <signal.h>          /* sigaddset, sigemptyset, sigprocmask, SIG*. */
+#include <stdint.h>          /* uint32_t, uint64_t. */
+#include <string.h>          /* memset, strerror. */
+#include <sys/epoll.h>       /* epoll_create1, epoll_ctl, epoll_wait. */
+#include <sys/signalfd.h>    /* signalfd, struct signalfd_siginfo. */
+#include <sys/timerfd.h>     /* timerfd_create, timerfd_settime. */
+#include <time.h>            /* time_t, CLOCK_MONOTONIC. */
+#include <sys/wait.h>        /* waitid, P_PID, WEXITED, WNOHANG, WNOWAIT. */
+#include <unistd.h>          /* close, read. */
+
+int trycmd_loop_open(struct trycmd_loop* const loop) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    memset(loop, 0, sizeof(*loop));
+    loop->sigchld.kind = trycmd_loop_none;
+    loop->sigchld.fd   = -1;
+    sigemptyset(&loop->blocked);
+    if (sigprocmask(SIG_BLOCK, NULL, &loop->saved_mask) != 0) {
+        return -1;
+    }
+
+    /* Create the epoll instance, upon which all handlers are registered. */
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return (loop->epoll_fd >= 0) ? 0 : -1;
+}
+
+void trycmd_loop_close(struct trycmd_loop* const loop) {
+    assert("Unexpected NULL loop" && (loop != NULL));
+
+    /* Release the loop's own handler, then restore the signal mask. */
+    trycmd_loop_remove(loop, &loop->sigchld);
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+        loop->epoll_fd = -1;
+    }
+    sigprocmask(SIG_SETMASK, &loop->saved_mask, NULL);
+}
+
+/**
+ * Register the given handler's descriptor with the loop's epoll instance.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+static int trycmd_loop_register(struct trycmd_loop* const loop,
+                                struct trycmd_loop_handler* const handler,
+                                const enum trycmd_loop_kind kind,
+                                const uint32_t events,
+                                const trycmd_loop_callback callback,
+                                void* const data) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events   = events;
+    event.data.ptr = handler;
+    if (handler->fd >= 0
+        && epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, handler->fd, &event) != 0) {
+        return -1;
+    }
+    handler->kind     = kind;
+    handler->callback = callback;
+    handler->data     = data;
+    ++loop->handlers;
+    return 0;
+}
+
+/**
+ * Block the given signals, so that they are instead delivered through a
+ * signalfd.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+static int trycmd_loop_block(struct trycmd_loop* const loop,
+                             const sigset_t* const signals) {
+    int signum;
+    if (sigprocmask(SIG_BLOCK, signals, NULL) != 0) {
+        return -1;
+    }
+    for (signum = 1; signum < NSIG; ++signum) {
+        if (sigismember(signals, signum) == 1) {
+            sigaddset(&loop->blocked, signum);
+        }
+    }
+    return 0;
+}
+
+int trycmd_loop_add(struct trycmd_loop* const loop,
+                    struct trycmd_loop_handler* const handler,
+                    const int fd,
+                    const uint32_t events,
+                    const trycmd_loop_callback callback,
+                    void* const data) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL handler" && (handler != NULL));
+    assert("Unexpected negative fd" && (fd >= 0));
+    assert("Unexpected NULL callback" && (callback != NULL));
+
+    handler->fd    = fd;
+    handler->owned = 0;
+    handler->pid   = -1;
+    handler->next  = NULL;
+    return trycmd_loop_register(loop, handler, trycmd_loop_fd, events,
+                                callback, data);
+}
+
+/**
+ * Drain the loop's SIGCHLD signalfd. Any child which has exited is found
+ * (and dispatched) by trycmd_loop_run, before it next waits.
+ */
+static void trycmd_loop_on_sigchld(struct trycmd_loop* const loop,
+                                   struct trycmd_loop_handler* const handler,
+                                   const uint32_t events) {
+    (void) loop;
+    (void) events;
+    while (trycmd_loop_read_signal(handler) > 0) {
+        /* Continue until no signal remains. */
+    }
+}
+
+int trycmd_loop_add_child(struct trycmd_loop* const loop,
+                          struct trycmd_loop_handler* const handler,
+                          struct trycmd_child* const child,
+                          const trycmd_loop_callback callback,
+                          void* const data) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL handler" && (handler != NULL));
+    assert("Unexpected NULL child" && (child != NULL));
+    assert("Unexpected NULL callback" && (callback != NULL));
+    assert("Unexpected non-positive pid" && (child->pid > 0));
+
+    /* A pidfd becomes readable once its process has exited. */
+    if (child->pidfd < 0) {
+        child->pidfd = trycmd_pidfd_open(child->pid);
+    }
+    handler->owned = 0;
+    handler->pid   = child->pid;
+    handler->next  = NULL;
+    if (child->pidfd >= 0) {
+        handler->fd = child->pidfd;
+        return trycmd_loop_register(loop, handler, trycmd_loop_child, EPOLLIN,
+                                    callback, data);
+    }
+
+    /* Otherwise, check the child upon each SIGCHLD. */
+    trycmd_debug("trycmd_loop_add_child: no pidfd for %d, using SIGCHLD\n",
+                 child->pid);
+    if (loop->sigchld.kind == trycmd_loop_none) {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGCHLD);
+        if (trycmd_loop_add_signals(loop, &loop->sigchld, &signals,
+                                    trycmd_loop_on_sigchld, NULL) != 0) {
+            return -1;
+        }
+        --loop->handlers;  /* Not counted, as it is the loop's own. */
+    }
+    handler->fd = -1;
+    if (trycmd_loop_register(loop, handler, trycmd_loop_child, 0,
+                             callback, data) != 0) {
+        return -1;
+    }
+    handler->next = loop->polled;
+    loop->polled  = handler;
+    return 0;
+}
+
+int trycmd_loop_add_timer(struct trycmd_loop* const loop,
+                          struct trycmd_loop_handler* const handler,
+                          const unsigned long ms,
+                          const trycmd_loop_callback callback,
+                          void* const data) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL handler" && (handler != NULL));
+    assert("Unexpected NULL callback" && (callback != NULL));
+
+    handler->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (handler->fd < 0) {
+        return -1;
+    }
+    handler->owned = 1;
+    handler->pid   = -1;
+    handler->next  = NULL;
+    if (trycmd_loop_set_timer(handler, ms) != 0
+        || trycmd_loop_register(loop, handler, trycmd_loop_timer, EPOLLIN,
+                                callback, data) != 0) {
+        close(handler->fd);
+        handler->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int trycmd_loop_set_timer(struct trycmd_loop_handler* const handler,
+                          const unsigned long ms) {
+    struct itimerspec spec;
+
+    /* Check arguments. */
+    assert("Unexpected NULL handler" && (handler != NULL));
+
+    /* Arm the timer once only (an it_value of zero disarms it). */
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec  = (time_t)(ms / 1000);
+    spec.it_value.tv_nsec = (long)(ms % 1000) * 1000000L;
+    return timerfd_settime(handler->fd, 0, &spec, NULL);
+}
+
+int trycmd_loop_add_signals(struct trycmd_loop* const loop,
+                            struct trycmd_loop_handler* const handler,
+                            const sigset_t* const signals,
+                            const trycmd_loop_callback callback,
+                            void* const data) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL handler" && (handler != NULL));
+    assert("Unexpected NULL signals" && (signals != NULL));
+    assert("Unexpected NULL callback" && (callback != NULL));
+
+    /* Signals must be blocked, else they would not reach the signalfd. */
+    if (trycmd_loop_block(loop, signals) != 0) {
+        return -1;
+    }
+    handler->fd = signalfd(-1, signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (handler->fd < 0) {
+        return -1;
+    }
+    handler->owned = 1;
+    handler->pid   = -1;
+    handler->next  = NULL;
+    if (trycmd_loop_register(loop, handler, trycmd_loop_signals, EPOLLIN,
+                             callback, data) != 0) {
+        close(handler->fd);
+        handler->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int trycmd_loop_read_signal(const struct trycmd_loop_handler* const handler) {
+    struct signalfd_siginfo info;
+    ssize_t result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL handler" && (handler != NULL));
+    assert("Unexpected handler kind"
+           && (handler->kind == trycmd_loop_signals));
+
+    do {
+        result = read(handler->fd, &info, sizeof(info));
+    } while (result < 0 && errno == EINTR);
+    return (result == (ssize_t)sizeof(info)) ? (int)info.ssi_signo : 0;
+}
+
+void trycmd_loop_remove(struct trycmd_loop* const loop,
+                        struct trycmd_loop_handler* const handler) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL handler" && (handler != NULL));
+    if (handler->kind == trycmd_loop_none) {
+        return;
+    }
+
+    /* Unregister the handler, closing its descriptor if the loop's own. */
+    if (handler->fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, handler->fd, NULL);
+        if (handler->owned) {
+            close(handler->fd);
+        }
+    } else {
+        struct trycmd_loop_handler** pos = &loop->polled;
+        while (*pos != NULL && *pos != handler) {
+            pos = &(*pos)->next;
+        }
+        if (*pos != NULL) {
+            *pos = handler->next;
+        }
+    }
+    if (handler != &loop->sigchld) {
+        --loop->handlers;
+    }
+    handler->kind  = trycmd_loop_none;
+    handler->fd    = -1;
+    handler->owned = 0;
+    handler->next  = NULL;
+}
+
+void trycmd_loop_stop(struct trycmd_loop* const loop) {
+    assert("Unexpected NULL loop" && (loop != NULL));
+    loop->stop = 1;
+}
+
+/**
+ * Dispatch the first child checked upon SIGCHLD which has exited (if any).
+ * @return 1 if a child was dispatched, otherwise 0.
+ */
+static int trycmd_loop_dispatch_polled(struct trycmd_loop* const loop) {
+    struct trycmd_loop_handler* handler;
+    for (handler = loop->polled; handler != NULL; handler = handler->next) {
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_PID, (id_t)handler->pid, &info,
+                   WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0) {
+            handler->callback(loop, handler, EPOLLIN);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int trycmd_loop_run(struct trycmd_loop* const loop) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+
+    /*
+     * Wait for, then dispatch, a single event at a time. Any callback may
+     * remove (or re-use) any other handler, so no event is ever held while
+     * a callback runs.
+     */
+    loop->stop = 0;
+    while (!loop->stop && loop->handlers > 0) {
+        struct epoll_event event;
+        int count;
+        if (trycmd_loop_dispatch_polled(loop)) {
+            continue;
+        }
+        count = epoll_wait(loop->epoll_fd, &event, 1, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            trycmd_debug("trycmd_loop_run: epoll_wait failed: %s\n",
+                         strerror(errno));
+            return -1;
+        } else if (count > 0) {
+            struct trycmd_loop_handler* const handler = event.data.ptr;
+            if (handler->kind == trycmd_loop_timer) {
+                /* Acknowledge the expiry (ignoring any already re-armed). */
+                uint64_t expirations;
+                if (read(handler->fd, &expirations, sizeof(expirations))
+                    != (ssize_t)sizeof(expirations)) {
+                    continue;
+                }
+            }
+            handler->callback(loop, handler, event.events);
+        }
+    }
+    return 0;
+}
+
+/* EOF */
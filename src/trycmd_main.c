@@ -10,11 +10,14 @@
 
 #include "trycmd_config.h"
 #include "trycmd.h"
+#include <errno.h>   /* errno. */
 #include <stdlib.h>  /* EXIT_SUCCESS, EXIT_FAILURE. */
-#include <stdio.h>   /* stdout. */
+#include <stdio.h>   /* fclose, fopen, fprintf, stderr, stdout. */
+#include <string.h>  /* strerror. */
 
 /* Application entry point. */
 int trycmd_main(const int argc, char* argv[]) {
+    struct trycmd_json json;
     struct trycmd_opts opts;
     int result;
 
@@ -24,22 +27,81 @@ int trycmd_main(const int argc, char* argv[]) {
 
     /* Read arguments. */
     if (trycmd_read_options(argc, argv, &opts) != 0
-        || opts.opt_sub_argc == 0
+        || (!opts.opt_history_query
+            && (opts.opt_sub_argc == 0) == (opts.opt_batch == NULL))
+        || (opts.opt_watch_len > 0
+            && (opts.opt_batch != NULL || opts.opt_history_query))
         || opts.opt_help) {
         /* Either: 1. one or more options is invalid, or
-         *         2. no subcommand has been given, or
-         *         3. the user has explicitly requested help.
+         *         2. neither or both a subcommand and a batch are given
+         *            (where not querying the history), or
+         *         3. paths are watched for a batch or history query, or
+         *         4. the user has explicitly requested help.
          * Show a usage message.
          */
         trycmd_print_usage(stdout);
         result = (opts.opt_help) ? EXIT_SUCCESS   /* Help was requested. */
                                  : EXIT_FAILURE;  /* Help is required. */
+    } else if (opts.opt_history_query) {
+        /* Summarize the subcommand's history (or all history) instead. */
+        if (opts.opt_history == NULL) {
+            fputs(_("try: no history file (see TRY_HISTORY)\n"), stderr);
+            result = EXIT_FAILURE;
+        } else if (trycmd_history_report(opts.opt_history,
+                                         (opts.opt_sub_argc > 0)
+                                         ? opts.opt_sub_argv : NULL,
+                                         stdout) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"), opts.opt_history,
+                    strerror(errno));
+            result = EXIT_FAILURE;
+        } else {
+            result = EXIT_SUCCESS;
+        }
+    } else if (opts.opt_batch != NULL) {
+        /* Run every command within the batch. */
+        result = trycmd_run_batch(&opts);
+        trycmd_debug("try: exiting with status %d\n", result);
+    } else if (opts.opt_watch_len > 0) {
+        /* Run the subcommand again upon each change, until stopped. */
+        result = trycmd_run_watch(&opts);
+        trycmd_debug("try: exiting with status %d\n", result);
+    } else if (opts.opt_json_out != NULL
+               && trycmd_json_open(&json, opts.opt_json_out) != 0) {
+        /* Results cannot be recorded, so run nothing. */
+        fprintf(stderr, _("try: %s: %s\n"), opts.opt_json_out,
+                strerror(errno));
+        result = EXIT_FAILURE;
     } else {
+        struct trycmd_result run_result;
+
         /* Prepare and run the subcommand. */
-        result = trycmd_run_subcommand(&opts);
+        trycmd_run_subcommand_result(&opts, &run_result);
+
+        /* Show a result message, and append it to any log. */
+        result = trycmd_show_result(&opts, &run_result, stderr);
+        if (opts.opt_log != NULL) {
+            FILE* const log = fopen(opts.opt_log, "a");
+            if (log != NULL) {
+                trycmd_show_result(&opts, &run_result, log);
+                fclose(log);
+            }
+        }
+        trycmd_ring_free(&run_result.tail);
 
-        /* Show a result message. */
-        result = trycmd_show_exit_status(&opts, result, stderr);
+        /* Record the result, if requested. */
+        if (opts.opt_json_out != NULL) {
+            if (trycmd_json_write(&json, &opts, &run_result) != 0) {
+                fprintf(stderr, _("try: %s: %s\n"), opts.opt_json_out,
+                        strerror(errno));
+            }
+            trycmd_json_close(&json);
+        }
+        if (opts.opt_history != NULL
+            && trycmd_history_append(opts.opt_history, &opts,
+                                     &run_result) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"), opts.opt_history,
+                    strerror(errno));
+        }
 
         /* Pass the child's result out without modification. */
         trycmd_debug("try: exiting with status %d\n", result);
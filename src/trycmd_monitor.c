@@ -0,0 +1,190 @@
+/**
+ * \file      trycmd_monitor.c
+ * \brief     Supervise running subcommands upon an event loop.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EINTR. */
+#include <signal.h>        /* kill, sigaddset, sigemptyset, SIG*. */
+#include <string.h>        /* memset, strerror. */
+#include <sys/resource.h>  /* struct rusage. */
+#include <sys/types.h>     /* pid_t. */
+#include <sys/wait.h>      /* wait4, WIFSIGNALED, WTERMSIG. */
+#include <unistd.h>        /* close. */
+
+void trycmd_monitor_signal(const struct trycmd_monitor* const monitor,
+                           const int signum) {
+    pid_t pid;
+
+    /* Check arguments. */
+    assert("Unexpected NULL monitor" && (monitor != NULL));
+    pid = monitor->child.pid;
+    if (pid <= 0) {
+        return;
+    }
+
+    /*
+     * A group exists under the subcommand's own ID only if the subcommand
+     * created it. It is held until the subcommand is reaped, even if every
+     * process within it has exited.
+     */
+    trycmd_debug("trycmd_monitor_signal: sending signal %d to %d\n",
+                 signum, pid);
+    if (kill(-pid, signum) != 0) {
+        kill(pid, signum);
+    }
+}
+
+/**
+ * Reap a supervised subcommand which has exited (or been killed), then
+ * release its handlers. Its resource usage is recorded.
+ * @return The subcommand's wait status.
+ */
+static int trycmd_monitor_reap(struct trycmd_loop* const loop,
+                               struct trycmd_monitor* const monitor) {
+    int wait_status = 0;
+    pid_t wait_result;
+
+    trycmd_loop_remove(loop, &monitor->exit_handler);
+    trycmd_loop_remove(loop, &monitor->timer_handler);
+    do {
+        wait_result = wait4(monitor->child.pid, &wait_status, 0,
+                            &monitor->rusage);
+    } while (wait_result < 0 && errno == EINTR);
+    trycmd_debug("trycmd_monitor_reap: child %d status is %d\n",
+                 monitor->child.pid, wait_status);
+    assert("Unexpected result from wait4"
+           && (wait_result == monitor->child.pid));
+    (void) wait_result;
+    if (monitor->child.pidfd >= 0) {
+        close(monitor->child.pidfd);
+    }
+    monitor->child.pid   = -1;
+    monitor->child.pidfd = -1;
+    return wait_status;
+}
+
+/**
+ * Handle a supervised subcommand's exit.
+ */
+static void trycmd_monitor_on_exit(struct trycmd_loop* const loop,
+                                   struct trycmd_loop_handler* const handler,
+                                   const uint32_t events) {
+    struct trycmd_monitor* const monitor = handler->data;
+    int wait_status;
+    (void) events;
+
+    /*
+     * Once timed out, kill whatever remains of the subcommand's group
+     * before it is released, rather than leave it behind.
+     */
+    if (monitor->timed_out && monitor->opts->opt_kill_after > 0
+        && monitor->signalled != SIGKILL) {
+        trycmd_monitor_signal(monitor, SIGKILL);
+        monitor->signalled = SIGKILL;
+    }
+
+    /* Child ends and parent process continues. */
+    wait_status = trycmd_monitor_reap(loop, monitor);
+    monitor->exit_status = monitor->timed_out ? TRYCMD_STATUS_TIMED_OUT
+                                              : trycmd_exit_status(wait_status);
+    monitor->term_signal = WIFSIGNALED(wait_status) ? WTERMSIG(wait_status)
+                                                    : 0;
+    monitor->finished(loop, monitor);
+}
+
+/**
+ * Handle a supervised subcommand's timeout: first with SIGTERM and then,
+ * after any kill-after delay, SIGKILL.
+ */
+static void trycmd_monitor_on_timer(struct trycmd_loop* const loop,
+                                    struct trycmd_loop_handler* const handler,
+                                    const uint32_t events) {
+    struct trycmd_monitor* const monitor = handler->data;
+    (void) events;
+
+    if (monitor->signalled == 0) {
+        trycmd_debug("trycmd_monitor_on_timer: timed out after %lums\n",
+                     monitor->opts->opt_timeout);
+        monitor->timed_out = 1;
+        monitor->signalled = SIGTERM;
+        trycmd_monitor_signal(monitor, SIGTERM);
+        trycmd_monitor_signal(monitor, SIGCONT);  /* If stopped. */
+        if (monitor->opts->opt_kill_after > 0
+            && trycmd_loop_set_timer(handler,
+                                     monitor->opts->opt_kill_after) == 0) {
+            return;
+        }
+    } else {
+        monitor->signalled = SIGKILL;
+        trycmd_monitor_signal(monitor, SIGKILL);
+    }
+    trycmd_loop_remove(loop, handler);
+}
+
+int trycmd_monitor_start(struct trycmd_loop* const loop,
+                         struct trycmd_monitor* const monitor,
+                         const struct trycmd_opts* const opts,
+                         const struct trycmd_child* const child,
+                         void (*finished)(struct trycmd_loop*,
+                                          struct trycmd_monitor*),
+                         void* const data) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL monitor" && (monitor != NULL));
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL child" && (child != NULL));
+    assert("Unexpected NULL finished" && (finished != NULL));
+    memset(monitor, 0, sizeof(*monitor));
+    monitor->opts        = opts;
+    monitor->child       = *child;
+    monitor->exit_status = -1;
+    monitor->finished    = finished;
+    monitor->data        = data;
+
+    /* Await the subcommand's exit and, if it has one, its timeout. */
+    if (trycmd_loop_add_child(loop, &monitor->exit_handler, &monitor->child,
+                              trycmd_monitor_on_exit, monitor) != 0
+        || (opts->opt_timeout > 0
+            && trycmd_loop_add_timer(loop, &monitor->timer_handler,
+                                     opts->opt_timeout,
+                                     trycmd_monitor_on_timer, monitor) != 0)) {
+        const int saved_errno = errno;
+        trycmd_debug("trycmd_monitor_start: cannot supervise %d: %s\n",
+                     monitor->child.pid, strerror(saved_errno));
+        trycmd_monitor_cancel(loop, monitor);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
+
+void trycmd_monitor_cancel(struct trycmd_loop* const loop,
+                           struct trycmd_monitor* const monitor) {
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL monitor" && (monitor != NULL));
+
+    if (monitor->child.pid > 0) {
+        trycmd_monitor_signal(monitor, SIGKILL);
+        trycmd_monitor_reap(loop, monitor);
+    }
+}
+
+void trycmd_forwarded_signals(sigset_t* const signals) {
+    assert("Unexpected NULL signals" && (signals != NULL));
+    sigemptyset(signals);
+    sigaddset(signals, SIGHUP);
+    sigaddset(signals, SIGINT);
+    sigaddset(signals, SIGQUIT);
+    sigaddset(signals, SIGTERM);
+}
+
+/* EOF */
@@ -0,0 +1,74 @@
+/**
+ * \file      trycmd_obuf.c
+ * \brief     A growable buffer, rendering a message to be written at once.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <stdio.h>         /* FILE, fclose, fflush, fileno, open_memstream. */
+#include <stdlib.h>        /* free. */
+#include <string.h>        /* memset. */
+
+FILE* trycmd_obuf_open(struct trycmd_obuf* const obuf, FILE* const dest) {
+    /* Check arguments. */
+    assert("Unexpected NULL obuf" && (obuf != NULL));
+    assert("Unexpected NULL dest" && (dest != NULL));
+    memset(obuf, 0, sizeof(*obuf));
+    obuf->dest = dest;
+    obuf->os   = dest;
+
+    /*
+     * Only a stream with a descriptor can be written at once; any other
+     * (such as one rendering into memory already) is used as it is.
+     */
+    if (fileno(dest) >= 0) {
+        FILE* const os = open_memstream(&obuf->data, &obuf->len);
+        if (os != NULL) {
+            obuf->os = os;
+        } else {
+            trycmd_debug("trycmd_obuf_open: cannot open memory stream\n");
+        }
+    }
+    return obuf->os;
+}
+
+int trycmd_obuf_flush(struct trycmd_obuf* const obuf) {
+    int result = 0;
+
+    /* Check arguments. */
+    assert("Unexpected NULL obuf" && (obuf != NULL));
+    assert("Unexpected NULL dest" && (obuf->dest != NULL));
+
+    /* Nothing was buffered if rendered directly. */
+    if (obuf->os == obuf->dest) {
+        obuf->os = NULL;
+        return 0;
+    }
+
+    /*
+     * Close the memory stream to complete the message, then write it after
+     * anything pending upon the destination stream's own buffer.
+     */
+    if (fclose(obuf->os) != 0 || obuf->data == NULL) {
+        result = -1;
+    } else if (fflush(obuf->dest) != 0
+               || trycmd_write_all(fileno(obuf->dest),
+                                   obuf->data, obuf->len) != 0) {
+        trycmd_debug("trycmd_obuf_flush: cannot write %lu byte(s)\n",
+                     (unsigned long)obuf->len);
+        result = -1;
+    }
+    free(obuf->data);
+    obuf->os   = NULL;
+    obuf->data = NULL;
+    obuf->len  = 0;
+    return result;
+}
+
+/* EOF */
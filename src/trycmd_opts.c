@@ -12,10 +12,34 @@
 #include "trycmd.h"
 #include <assert.h>  /* assert. */
 #include <stddef.h>  /* size_t. */
+#include <errno.h>   /* errno. */
+#include <stdlib.h>  /* strtol. */
 #include <string.h>  /* strcmp. */
 #include <stdio.h>   /* fprintf, fputs, fputc, fflush. */
 #include <getopt.h>  /* struct option. */
-#include <unistd.h>  /* getopt_long. */
+#include <unistd.h>  /* getopt_long, sysconf. */
+
+/**
+ * Convert the given decimal string to an integer within [0, max].
+ * @return 0 on success, -1 on failure.
+ */
+static int trycmd_parse_count(const char* const text,
+                              const long max,
+                              int* const out) {
+    char* end;
+    long value;
+
+    if (text == NULL || text[0] < '0' || text[0] > '9') {
+        return -1;
+    }
+    errno = 0;
+    value = strtol(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value < 0 || value > max) {
+        return -1;
+    }
+    *out = (int)value;
+    return 0;
+}
 
 void trycmd_print_usage(FILE* const os) {
     /* Statically declare all command line and environment options. */
@@ -27,6 +51,43 @@ void trycmd_print_usage(FILE* const os) {
         { N_("-i, --interactive"), _("Execute the command in an interactive subshell.")            },
         { N_("--color[=WHEN],"),   _("Color the result according to command's exit status.")       },
         { N_("--colour[=WHEN]"),   _("WHEN is 'always' (default if omitted), 'never', or 'auto'.") },
+        { N_("--spawn=BACKEND"),   _("Spawn with 'auto' (default), 'fork', 'vfork',")              },
+        { N_(""),                  _("'posix_spawn', or 'clone3'.")                                },
+        { N_("--exec=MODE"),       _("Run via 'shell' (default), 'direct', or 'auto'.")            },
+        { N_("--no-shell"),        _("Run the command directly (same as '--exec=direct').")        },
+        { N_("-j, --jobs=N"),      _("Run up to N batch commands at once (0 for one per CPU).")    },
+        { N_("--batch=FILE"),      _("Run each line of FILE ('-' for stdin) as a command.")        },
+        { N_("--fail-fast"),       _("Start no further batch commands after a failure.")           },
+        { N_("--jobserver"),       _("Share N job slots with any 'make' run (see '--jobs').")      },
+        { N_("--retry=N"),         _("Retry a failed command up to N times.")                      },
+        { N_("--retry-delay=DUR"), _("Wait DUR before the first retry (default 1s).")              },
+        { N_("--backoff=MODE"),    _("Between retries, keep ('none') or double ('exp') DUR.")      },
+        { N_("--jitter"),          _("Randomize each delay, between DUR/2 and DUR.")               },
+        { N_("--retry-on=LIST"),   _("Retry only these statuses (e.g. '1,3-5,SIGKILL').")          },
+        { N_("--timeout=DUR"),     _("Send SIGTERM after DUR, then fail with status 124.")         },
+        { N_("--kill-after=DUR"),  _("Send SIGKILL if still running DUR after SIGTERM.")           },
+        { N_("--stats"),           _("Show the time, memory, faults and switches used.")           },
+        { N_("--perf"),            _("Show the command's performance counters.")                   },
+        { N_("--log=FILE"),        _("Also write all output, and the result, to FILE.")            },
+        { N_("--tail[=N]"),        _("On failure, show the last N lines of output again")          },
+        { N_(""),                  _("(default 20), or N kibibytes if given as 'NK'.")             },
+        { N_("-q, --quiet[=MAX]"), _("Show output only on failure, holding up to MAX")            },
+        { N_(""),                  _("(default 16M) in memory, then in a temporary file.")         },
+        { N_("--timestamps[=M]"),  _("Prefix each line of output with its time: M is")             },
+        { N_(""),                  _("'relative' (default if omitted) or 'absolute'.")             },
+        { N_("--json-out=DEST"),   _("Append a JSON record of each result to DEST, either")        },
+        { N_(""),                  _("a file or an inherited file descriptor (e.g. '3').")         },
+        { N_("--cache[=DIR]"),     _("Replay the result and output of an unchanged command")       },
+        { N_(""),                  _("from DIR (default ~/.cache/try), or run and keep them.")     },
+        { N_("--inputs=GLOB"),     _("Files upon which a cached result depends (repeatable).")     },
+        { N_("--cache-env=NAMES"), _("Variables upon which a cached result depends (e.g. 'CC').")   },
+        { N_("--cache-size=MAX"),  _("Evict the least recently used results above MAX (256M).")    },
+        { N_("--watch=PATH"),      _("Run COMMAND again upon each change within PATH,")            },
+        { N_(""),                  _("stopping any run in progress (repeatable, or as")            },
+        { N_(""),                  _("'--watch PATH... -- COMMAND').")                             },
+        { N_("--debounce=DUR"),    _("Wait for changes to settle for DUR (default 100ms).")        },
+        { N_("--history"),         _("Instead of running COMMAND, summarize its past results")     },
+        { N_(""),                  _("(or, if none, those of all) from TRY_HISTORY.")              },
         { N_("-v, --verbose"),     _("Verbose output (echos the command being run).")              },
         { N_("-h, --help"),        _("Show this message.")                                         },
         { N_("--"),                _("End of options.")                                            },
@@ -36,12 +97,18 @@ void trycmd_print_usage(FILE* const os) {
     const struct option envopts[] = {
         { N_("TRY_INTERACTIVE=1"),     _("Always execute commands in an interactive subshell.") },
         { N_("TRY_COLOR=WHEN"),        _("Add color to the result (see '--color').") },
+        { N_("TRY_SPAWN=BACKEND"),     _("Select the spawn backend (see '--spawn').") },
+        { N_("TRY_EXEC=MODE"),         _("Select how to run the command (see '--exec').") },
+        { N_("TRY_HISTORY=FILE"),      _("Append each result to a history FILE.") },
+        { N_("TRY_DAEMON=SOCKET"),     _("Have a waiting 'tryd' run the command.") },
         { N_("SHELL=" DEF_SHELL_PATH), _("The shell to use when executing the command.") },
     };
     size_t idx;
 
     /* Print a standard header. */
     fputs(_("Usage: try [OPTION]... COMMAND [ARG]...\n"
+            "  or:  try [OPTION]... --batch=FILE\n"
+            "  or:  try [OPTION]... --watch PATH... -- COMMAND [ARG]...\n"
             "Run COMMAND to completion then show its result in a clear and consistent form.\n"
             "Example: try wget www.ietf.org/rfc/rfc2324.txt  # Download an RFC.\n"), os);
 
@@ -64,20 +131,52 @@ void trycmd_print_usage(FILE* const os) {
 
 int trycmd_read_options(const int argc, char* argv[],
                         struct trycmd_opts* const opts_out) {
-    const char* const shortopts = N_("+ivh");
+    const char* const shortopts = N_("+ivhj:q");
     const struct option longopts[] = {
         { N_("interactive"), no_argument,       NULL, 'i' },
         { N_("color"),       optional_argument, NULL, 'C' },
         { N_("colour"),      optional_argument, NULL, 'C' },
+        { N_("spawn"),       required_argument, NULL, 'S' },
+        { N_("exec"),        required_argument, NULL, 'E' },
+        { N_("no-shell"),    no_argument,       NULL, 'N' },
+        { N_("jobs"),        required_argument, NULL, 'j' },
+        { N_("batch"),       required_argument, NULL, 'B' },
+        { N_("fail-fast"),   no_argument,       NULL, 'F' },
+        { N_("jobserver"),   no_argument,       NULL, 'J' },
+        { N_("retry"),       required_argument, NULL, 'r' },
+        { N_("retry-delay"), required_argument, NULL, 'D' },
+        { N_("backoff"),     required_argument, NULL, 'b' },
+        { N_("jitter"),      no_argument,       NULL, 'R' },
+        { N_("retry-on"),    required_argument, NULL, 'o' },
+        { N_("timeout"),     required_argument, NULL, 'T' },
+        { N_("kill-after"),  required_argument, NULL, 'K' },
+        { N_("stats"),       no_argument,       NULL, 'U' },
+        { N_("perf"),        no_argument,       NULL, 'P' },
+        { N_("log"),         required_argument, NULL, 'L' },
+        { N_("tail"),        optional_argument, NULL, 't' },
+        { N_("quiet"),       optional_argument, NULL, 'q' },
+        { N_("timestamps"),  optional_argument, NULL, 'm' },
+        { N_("json-out"),    required_argument, NULL, 'O' },
+        { N_("cache"),       optional_argument, NULL, 'c' },
+        { N_("inputs"),      required_argument, NULL, 'I' },
+        { N_("cache-env"),   required_argument, NULL, 'e' },
+        { N_("cache-size"),  required_argument, NULL, 'z' },
+        { N_("watch"),       required_argument, NULL, 'W' },
+        { N_("debounce"),    required_argument, NULL, 'd' },
+        { N_("history"),     no_argument,       NULL, 'Y' },
         { N_("verbose"),     no_argument,       NULL, 'v' },
         { N_("help"),        no_argument,       NULL, 'h' },
         { NULL,              0,                 NULL, 0   }
     };
     struct trycmd_opts opts_out_tmp = { 0 };
     const char* opt_color_when;
+    const char* opt_spawn_name;
+    const char* opt_exec_mode;
     extern char* optarg;
     extern int optind;
+    char* path;
     int opt;
+    int idx;
 
     /* Check arguments. */
     assert("Unexpected negative argc" && (argc >= 0));
@@ -96,7 +195,17 @@ int trycmd_read_options(const int argc, char* argv[],
      */
     opts_out_tmp.opt_interactive = !!trycmd_getenv_i(N_("TRY_INTERACTIVE"), 0);
     opts_out_tmp.opt_shell = trycmd_getenv_s(N_("SHELL"), DEF_SHELL_PATH);
+    opts_out_tmp.opt_jobs = 1;
+    opts_out_tmp.opt_retry_delay = 1000;
+    opts_out_tmp.opt_cache_size = TRYCMD_CACHE_SIZE;
+    opts_out_tmp.opt_debounce = TRYCMD_WATCH_DEBOUNCE;
     opt_color_when = trycmd_getenv_s(N_("TRY_COLOR"), NULL);
+    opt_spawn_name = trycmd_getenv_s(N_("TRY_SPAWN"), NULL);
+    opt_exec_mode = trycmd_getenv_s(N_("TRY_EXEC"), NULL);
+    opts_out_tmp.opt_history = trycmd_getenv_s(N_("TRY_HISTORY"), NULL);
+    if (opts_out_tmp.opt_history != NULL && opts_out_tmp.opt_history[0] == '\0') {
+        opts_out_tmp.opt_history = NULL;
+    }
 
     /* Attempt to parse any TRY_COLOR=WHEN environment setting. */
     if (opt_color_when != NULL) {
@@ -111,6 +220,26 @@ int trycmd_read_options(const int argc, char* argv[],
         }
     }
 
+    /* Attempt to parse any TRY_SPAWN=BACKEND environment setting. */
+    if (opt_spawn_name != NULL) {
+        if (trycmd_parse_spawn(opt_spawn_name, &opts_out_tmp.opt_spawn) != 0) {
+            /* Parse failure. Report it but continue, as for TRY_COLOR. */
+            trycmd_debug("trycmd_read_options: unrecognised"
+                         " TRY_SPAWN value: \"%s\"\n",
+                         opt_spawn_name);
+        }
+    }
+
+    /* Attempt to parse any TRY_EXEC=MODE environment setting. */
+    if (opt_exec_mode != NULL) {
+        if (trycmd_parse_exec(opt_exec_mode, &opts_out_tmp.opt_exec) != 0) {
+            /* Parse failure. Report it but continue, as for TRY_COLOR. */
+            trycmd_debug("trycmd_read_options: unrecognised"
+                         " TRY_EXEC value: \"%s\"\n",
+                         opt_exec_mode);
+        }
+    }
+
     /*
      * Read all standard "-X" and "--X" options.
      * These are higher precedence than options
@@ -133,6 +262,214 @@ int trycmd_read_options(const int argc, char* argv[],
                     return -1;
                 }
                 break;
+            case 'S':  /* Spawn=BACKEND. */
+                if (trycmd_parse_spawn(optarg, &opts_out_tmp.opt_spawn) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: unrecognised"
+                                 " --spawn value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'E':  /* Exec=MODE. */
+                if (trycmd_parse_exec(optarg, &opts_out_tmp.opt_exec) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: unrecognised"
+                                 " --exec value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'N':  /* No shell. */
+                opts_out_tmp.opt_exec = trycmd_exec_direct;
+                break;
+            case 'j':  /* Jobs=N. */
+                if (trycmd_parse_jobs(optarg, &opts_out_tmp.opt_jobs) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --jobs value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'B':  /* Batch=FILE. */
+                opts_out_tmp.opt_batch = optarg;
+                break;
+            case 'F':  /* Fail fast. */
+                opts_out_tmp.opt_fail_fast = 1;
+                break;
+            case 'J':  /* Jobserver. */
+                opts_out_tmp.opt_jobserver = 1;
+                break;
+            case 'r':  /* Retry=N. */
+                if (trycmd_parse_count(optarg, 65535,
+                                       &opts_out_tmp.opt_retry) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --retry value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'D':  /* Retry-delay=DURATION. */
+                if (trycmd_parse_duration(optarg,
+                                          &opts_out_tmp.opt_retry_delay) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --retry-delay value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'b':  /* Backoff=MODE. */
+                if (trycmd_parse_backoff(optarg,
+                                         &opts_out_tmp.opt_backoff) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: unrecognised"
+                                 " --backoff value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'R':  /* Jitter. */
+                opts_out_tmp.opt_jitter = 1;
+                break;
+            case 'o':  /* Retry-on=STATUSES. */
+                if (trycmd_parse_retry_on(optarg,
+                                          opts_out_tmp.opt_retry_on) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --retry-on value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'T':  /* Timeout=DURATION. */
+                if (trycmd_parse_duration(optarg,
+                                          &opts_out_tmp.opt_timeout) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --timeout value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'K':  /* Kill-after=DURATION. */
+                if (trycmd_parse_duration(optarg,
+                                          &opts_out_tmp.opt_kill_after) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --kill-after value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'U':  /* Stats (resource 'U'sage). */
+                opts_out_tmp.opt_stats = 1;
+                break;
+            case 'P':  /* Perf. */
+                opts_out_tmp.opt_perf = 1;
+                break;
+            case 'L':  /* Log=FILE. */
+                opts_out_tmp.opt_log = optarg;
+                break;
+            case 't':  /* Tail[=N]. */
+                if (trycmd_parse_tail(optarg, &opts_out_tmp.opt_tail_lines,
+                                      &opts_out_tmp.opt_tail_size) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --tail value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'q':  /* Quiet[=MAX]. */
+                opts_out_tmp.opt_quiet = TRYCMD_QUIET_SIZE;
+                if (optarg != NULL
+                    && trycmd_parse_size(optarg, &opts_out_tmp.opt_quiet) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --quiet value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'm':  /* Timestamps[=MODE]. */
+                opts_out_tmp.opt_timestamps = trycmd_timestamps_relative;
+                if (optarg != NULL
+                    && trycmd_parse_timestamps(optarg,
+                                               &opts_out_tmp.opt_timestamps) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: unrecognised"
+                                 " --timestamps value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'O':  /* JSON-out=FD|FILE. */
+                opts_out_tmp.opt_json_out = optarg;
+                break;
+            case 'c':  /* Cache[=DIR]. */
+                opts_out_tmp.opt_cache = 1;
+                opts_out_tmp.opt_cache_dir = optarg;
+                break;
+            case 'I':  /* Inputs=GLOB. */
+                if (opts_out_tmp.opt_inputs_len >= TRYCMD_INPUTS_MAX) {
+                    /* Too many. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: too many"
+                                 " --inputs (at most %d)\n",
+                                 TRYCMD_INPUTS_MAX);
+                    return -1;
+                }
+                opts_out_tmp.opt_inputs[opts_out_tmp.opt_inputs_len++] = optarg;
+                break;
+            case 'e':  /* Cache-env=NAMES. */
+                opts_out_tmp.opt_cache_env = optarg;
+                break;
+            case 'z':  /* Cache-size=MAX. */
+                if (trycmd_parse_size(optarg, &opts_out_tmp.opt_cache_size) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --cache-size value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'W':  /* Watch=PATH. */
+                /*
+                 * Should a later "--" end the options, every other argument
+                 * before it (up to the next option) is a further PATH.
+                 */
+                for (idx = optind; idx < argc && strcmp(argv[idx], "--") != 0;
+                     ++idx) {
+                }
+                path = optarg;
+                do {
+                    if (opts_out_tmp.opt_watch_len >= TRYCMD_WATCH_MAX) {
+                        /* Too many. Report the error and fail fast. */
+                        trycmd_debug("trycmd_read_options: too many"
+                                     " --watch paths (at most %d)\n",
+                                     TRYCMD_WATCH_MAX);
+                        return -1;
+                    }
+                    opts_out_tmp.opt_watch[opts_out_tmp.opt_watch_len++] = path;
+                    path = (idx < argc && optind < idx
+                            && argv[optind][0] != '-') ? argv[optind++] : NULL;
+                } while (path != NULL);
+                break;
+            case 'd':  /* Debounce=DURATION. */
+                if (trycmd_parse_duration(optarg,
+                                          &opts_out_tmp.opt_debounce) != 0) {
+                    /* Parse failure. Report the error and fail fast. */
+                    trycmd_debug("trycmd_read_options: invalid"
+                                 " --debounce value: \"%s\"\n",
+                                 optarg);
+                    return -1;
+                }
+                break;
+            case 'Y':  /* History. */
+                opts_out_tmp.opt_history_query = 1;
+                break;
             case 'v':  /* Verbose. */
                 opts_out_tmp.opt_verbose = 1;
                 break;
@@ -187,4 +524,122 @@ int trycmd_parse_when(const char* const when, enum trycmd_color* const out) {
     return -1;
 }
 
+int trycmd_parse_exec(const char* const mode, enum trycmd_exec* const out) {
+    const struct exec_opt {
+        const char* key;
+        enum trycmd_exec value;
+    } execopts[] = {
+        { N_("shell"),  trycmd_exec_shell  },
+        { N_("direct"), trycmd_exec_direct },
+        { N_("auto"),   trycmd_exec_auto   },
+    };
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+
+    /* Convert the given MODE string to an enumeration value. */
+    if (mode != NULL) {
+        for (idx = 0; idx < sizeof(execopts) / sizeof(execopts[0]); ++idx) {
+            if (strcmp(mode, execopts[idx].key) == 0) {
+                *out = execopts[idx].value;
+                return 0;
+            }
+        }
+    }
+
+    /* Missing or unrecognised MODE string. */
+    return -1;
+}
+
+int trycmd_parse_jobs(const char* const jobs, int* const out) {
+    int value;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+
+    /* Convert the given JOBS string to a bounded integer. */
+    if (trycmd_parse_count(jobs, 4096, &value) != 0) {
+        return -1;
+    }
+
+    /* Zero selects one job per online processor. */
+    if (value == 0) {
+        const long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+        value = (nprocs > 1) ? (int)nprocs : 1;
+    }
+    *out = value;
+    return 0;
+}
+
+int trycmd_parse_tail(const char* const tail,
+                      unsigned long* const lines,
+                      unsigned long* const size) {
+    char* end;
+    long value;
+
+    /* Check arguments. */
+    assert("Unexpected NULL lines" && (lines != NULL));
+    assert("Unexpected NULL size" && (size != NULL));
+
+    /* Without a TAIL, select the default number of lines. */
+    if (tail == NULL) {
+        *lines = TRYCMD_TAIL_LINES;
+        *size  = 0;
+        return 0;
+    }
+
+    /* Otherwise, read "N" lines or "NK" kibibytes. */
+    if (tail[0] < '0' || tail[0] > '9') {
+        return -1;
+    }
+    errno = 0;
+    value = strtol(tail, &end, 10);
+    if (errno != 0 || value <= 0) {
+        return -1;
+    } else if (*end == '\0' && value <= 65535) {
+        *lines = (unsigned long)value;
+        *size  = 0;
+        return 0;
+    } else if ((strcmp(end, N_("K")) == 0 || strcmp(end, N_("KiB")) == 0)
+               && value <= 65536) {
+        *lines = 0;
+        *size  = (unsigned long)value * 1024;
+        return 0;
+    }
+    return -1;
+}
+
+int trycmd_parse_size(const char* const size, unsigned long* const out) {
+    unsigned long scale = 1;
+    char* end;
+    long value;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+    if (size == NULL || size[0] < '0' || size[0] > '9') {
+        return -1;
+    }
+
+    /* Read a number, then any binary suffix. */
+    errno = 0;
+    value = strtol(size, &end, 10);
+    if (errno != 0 || value <= 0) {
+        return -1;
+    } else if (strcmp(end, N_("K")) == 0) {
+        scale = 1024UL;
+    } else if (strcmp(end, N_("M")) == 0) {
+        scale = 1024UL * 1024;
+    } else if (strcmp(end, N_("G")) == 0) {
+        scale = 1024UL * 1024 * 1024;
+    } else if (*end != '\0') {
+        return -1;
+    }
+    if ((unsigned long)value > ((unsigned long)-1) / scale) {
+        return -1;
+    }
+    *out = (unsigned long)value * scale;
+    return 0;
+}
+
 /* EOF */
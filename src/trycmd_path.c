@@ -0,0 +1,157 @@
+/**
+ * \file      trycmd_path.c
+ * \brief     Program resolution, without the aid of a shell.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EACCES, ENOENT, ENAMETOOLONG. */
+#include <stddef.h>        /* size_t. */
+#include <string.h>        /* memcpy, strchr, strcmp, strlen. */
+#include <sys/stat.h>      /* stat, S_ISREG. */
+#include <unistd.h>        /* access, confstr, X_OK. */
+
+/*
+ * Shell reserved words and builtins, each of which either has no
+ * standalone program equivalent, only has an effect within the shell
+ * itself, or (as do 'echo', 'printf', 'test' and 'pwd') may behave
+ * differently as a standalone program. This holds every POSIX special
+ * and regular builtin. A command named thus must always be given to the
+ * shell.
+ */
+static const char* const shell_words[] = {
+    "!", ".", ":", "[", "[[", "]]", "{", "}",
+    "alias", "bg", "break", "builtin", "case", "cd", "command",
+    "continue", "declare", "do", "done", "echo", "elif", "else", "enable",
+    "esac", "eval", "exec", "exit", "export", "false", "fc", "fg", "fi",
+    "for", "function", "getopts", "hash", "history", "if", "in", "jobs",
+    "kill", "let", "local", "newgrp", "printf", "pwd", "readonly", "read",
+    "return", "select", "set", "shift", "shopt", "source", "test", "then",
+    "time", "times", "trap", "true", "type", "typeset", "ulimit", "umask",
+    "unalias", "unset", "until", "wait", "while",
+};
+
+int trycmd_is_plain_command(const char* const name) {
+    const char* pos;
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL name" && (name != NULL));
+
+    /*
+     * Any character which would require quoting may have a meaning to the
+     * shell (e.g. word splitting, expansion, assignment or redirection).
+     */
+    if (name[0] == '\0' || name[0] == '-') {
+        return 0;
+    }
+    for (pos = name; *pos; ++pos) {
+        if (trycmd_needs_quoting(*pos)) {
+            return 0;
+        }
+    }
+
+    /* Reserved words and builtins are only meaningful to the shell. */
+    for (idx = 0; idx < sizeof(shell_words) / sizeof(shell_words[0]); ++idx) {
+        if (strcmp(name, shell_words[idx]) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int trycmd_check_program(const char* const path) {
+    struct stat st;
+
+    /* Check arguments. */
+    assert("Unexpected NULL path" && (path != NULL));
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode) || access(path, X_OK) != 0) {
+        errno = EACCES;
+        return -1;
+    }
+    return 0;
+}
+
+int trycmd_find_program(const char* const name,
+                        char* const path_out,
+                        const size_t path_len) {
+    size_t name_len;
+    char default_path[64];
+    const char* search;
+    struct trycmd_pathcache cache;
+    unsigned int dir_index;
+    const char* dir;
+    int saved_errno = ENOENT;
+
+    /* Check arguments. */
+    assert("Unexpected NULL name" && (name != NULL));
+    assert("Unexpected NULL path_out" && (path_out != NULL));
+    name_len = strlen(name);
+
+    /* A name containing a slash is used as-is, without any search. */
+    if (strchr(name, '/') != NULL) {
+        if (name_len + 1 > path_len) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(path_out, name, name_len + 1);
+        return trycmd_check_program(path_out);
+    }
+
+    /* Search PATH, or the system's default path if it is unset. */
+    search = trycmd_getenv_s("PATH", NULL);
+    if (search == NULL) {
+        const size_t len = confstr(_CS_PATH, default_path, sizeof(default_path));
+        search = (len > 0 && len <= sizeof(default_path)) ? default_path
+                                                          : "/bin:/usr/bin";
+    }
+    trycmd_debug("trycmd_find_program: searching for %s\n", name);
+    if (trycmd_pathcache_open(&cache, search) == 0
+        && trycmd_pathcache_lookup(&cache, name, path_out, path_len) == 0) {
+        trycmd_pathcache_close(&cache);
+        return 0;
+    }
+    for (dir = search, dir_index = 0; dir != NULL; ++dir_index) {
+        const char* const dir_end = strchr(dir, ':');
+        size_t dir_len = (dir_end != NULL) ? (size_t)(dir_end - dir)
+                                           : strlen(dir);
+
+        /* An empty element refers to the current directory. */
+        if (dir_len + name_len + 2 <= path_len) {
+            if (dir_len == 0) {
+                path_out[0] = '.';
+                dir_len = 1;
+            } else {
+                memcpy(path_out, dir, dir_len);
+            }
+            path_out[dir_len] = '/';
+            memcpy(&path_out[dir_len + 1], name, name_len + 1);
+            if (trycmd_check_program(path_out) == 0) {
+                trycmd_debug("trycmd_find_program: found %s\n", path_out);
+                trycmd_pathcache_store(&cache, name, dir_index);
+                trycmd_pathcache_close(&cache);
+                return 0;
+            } else if (errno == EACCES) {
+                /* Found but unusable. Continue, but remember why. */
+                saved_errno = EACCES;
+            }
+        }
+        dir = (dir_end != NULL) ? dir_end + 1 : NULL;
+    }
+    trycmd_pathcache_close(&cache);
+
+    /* Not found. */
+    errno = saved_errno;
+    return -1;
+}
+
+/* EOF */
@@ -0,0 +1,309 @@
+/**
+ * \file      trycmd_pathcache.c
+ * \brief     Persistent cache of PATH resolution results.
+ * \details   Resolved programs are recorded within a small, memory-mapped
+ *            hash table under $XDG_RUNTIME_DIR, one file per PATH string.
+ *            Each entry records the PATH directory in which its program was
+ *            found and a stamp of every directory searched to get there, so
+ *            that any change which could alter the result invalidates it.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <fcntl.h>         /* open, O_*. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint32_t, uint64_t. */
+#include <stdio.h>         /* snprintf. */
+#include <string.h>        /* memcmp, memcpy, strchr, strlen. */
+#include <sys/mman.h>      /* mmap, munmap. */
+#include <sys/stat.h>      /* fstat, stat. */
+#include <unistd.h>        /* close, ftruncate. */
+#include <linux/limits.h>  /* PATH_MAX. */
+
+/** Identifies a path cache file, and its layout version. */
+#define TRYCMD_PATHCACHE_MAGIC   (0x54525950u)  /* "TRYP". */
+#define TRYCMD_PATHCACHE_VERSION (1u)
+
+/** The number of entries within each cache file (a power of two). */
+#define TRYCMD_PATHCACHE_SLOTS   (256u)
+
+/** The maximum number of slots examined by a single lookup. */
+#define TRYCMD_PATHCACHE_PROBES  (8u)
+
+/** The longest program name that will be cached, including its NUL. */
+#define TRYCMD_PATHCACHE_NAME_SZ (104u)
+
+/** A single cached resolution (128 bytes). */
+struct trycmd_pathcache_slot {
+    /** Hash of name, or 0 if this slot is unused. Written last. */
+    uint64_t name_hash;
+
+    /** Stamp of PATH directories [0, dir_index], when found. */
+    uint64_t dir_stamp;
+
+    /** Index of the PATH directory in which name was found. */
+    uint32_t dir_index;
+
+    /** Length of name, excluding its NUL. */
+    uint32_t name_len;
+
+    /** The program's name, NUL terminated. */
+    char     name[TRYCMD_PATHCACHE_NAME_SZ];
+};
+
+/** A cache file's header, followed by all of its slots. */
+struct trycmd_pathcache_file {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t path_hash;
+    struct trycmd_pathcache_slot slots[TRYCMD_PATHCACHE_SLOTS];
+};
+
+int trycmd_pathcache_open(struct trycmd_pathcache* const cache,
+                          const char* const search) {
+    struct trycmd_pathcache_file* file;
+    const char* runtime_dir;
+    char filename[PATH_MAX];
+    struct stat st;
+    int result;
+    int fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL cache" && (cache != NULL));
+    assert("Unexpected NULL search" && (search != NULL));
+
+    cache->search = search;
+    cache->search_hash = trycmd_hash64(search, strlen(search), 0);
+    cache->map = NULL;
+
+    /* The cache is private to this user, so requires $XDG_RUNTIME_DIR. */
+    runtime_dir = trycmd_getenv_s("XDG_RUNTIME_DIR", NULL);
+    if (runtime_dir == NULL || runtime_dir[0] != '/'
+        || !trycmd_getenv_i("TRY_PATH_CACHE", 1)) {
+        return -1;
+    }
+    result = snprintf(filename, sizeof(filename), "%s/try-pathcache-%016llx",
+                      runtime_dir, (unsigned long long)cache->search_hash);
+    if (result < 0 || (size_t)result >= sizeof(filename)) {
+        return -1;
+    }
+
+    /* Open, size and then map the cache file. */
+    fd = open(filename, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        trycmd_debug("trycmd_pathcache_open: cannot open %s\n", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0
+        || (st.st_size < (off_t)sizeof(*file)
+            && ftruncate(fd, sizeof(*file)) != 0)) {
+        close(fd);
+        return -1;
+    }
+    file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return -1;
+    }
+
+    /* (Re)initialize any new or incompatible file. */
+    if (file->magic != TRYCMD_PATHCACHE_MAGIC
+        || file->version != TRYCMD_PATHCACHE_VERSION
+        || file->path_hash != cache->search_hash) {
+        trycmd_debug("trycmd_pathcache_open: initializing %s\n", filename);
+        memset(file, 0, sizeof(*file));
+        file->magic     = TRYCMD_PATHCACHE_MAGIC;
+        file->version   = TRYCMD_PATHCACHE_VERSION;
+        file->path_hash = cache->search_hash;
+    }
+    cache->map = file;
+    return 0;
+}
+
+void trycmd_pathcache_close(struct trycmd_pathcache* const cache) {
+    assert("Unexpected NULL cache" && (cache != NULL));
+    if (cache->map != NULL) {
+        munmap(cache->map, sizeof(struct trycmd_pathcache_file));
+        cache->map = NULL;
+    }
+}
+
+/**
+ * Copy the PATH directory at the given index into path_out.
+ * An empty directory is returned as ".", as for the current directory.
+ * @return The directory's length, or 0 if there is no such directory or
+ *         if path_out is too small.
+ */
+static size_t trycmd_pathcache_dir(const char* search, uint32_t dir_index,
+                                   char* const path_out, const size_t path_len) {
+    const char* dir_end;
+    size_t dir_len;
+
+    for (; dir_index > 0; --dir_index) {
+        if ((search = strchr(search, ':')) == NULL) {
+            return 0;
+        }
+        ++search;
+    }
+    dir_end = strchr(search, ':');
+    dir_len = (dir_end != NULL) ? (size_t)(dir_end - search) : strlen(search);
+    if (dir_len == 0) {
+        search = ".";
+        dir_len = 1;
+    }
+    if (dir_len + 1 > path_len) {
+        return 0;
+    }
+    memcpy(path_out, search, dir_len);
+    path_out[dir_len] = '\0';
+    return dir_len;
+}
+
+/**
+ * Stamp the PATH directories [0, dir_index], such that the addition,
+ * removal or renaming of a file within any of them alters the stamp.
+ * @return The stamp, or 0 if any directory could not be examined.
+ */
+static uint64_t trycmd_pathcache_stamp(const char* const search,
+                                       const uint32_t dir_index) {
+    uint64_t stamp = 0;
+    char dir[PATH_MAX];
+    uint32_t idx;
+
+    for (idx = 0; idx <= dir_index; ++idx) {
+        struct stat st;
+        uint64_t fields[4];
+        if (trycmd_pathcache_dir(search, idx, dir, sizeof(dir)) == 0) {
+            return 0;
+        }
+        if (stat(dir, &st) != 0) {
+            /* A missing directory remains a valid (empty) part of PATH. */
+            memset(&st, 0, sizeof(st));
+        }
+        fields[0] = (uint64_t)st.st_dev;
+        fields[1] = (uint64_t)st.st_ino;
+        fields[2] = (uint64_t)st.st_mtim.tv_sec;
+        fields[3] = (uint64_t)st.st_mtim.tv_nsec;
+        stamp = trycmd_hash64(fields, sizeof(fields), stamp);
+    }
+    return (stamp != 0) ? stamp : 1;
+}
+
+int trycmd_pathcache_lookup(const struct trycmd_pathcache* const cache,
+                            const char* const name,
+                            char* const path_out,
+                            const size_t path_len) {
+    const size_t name_len = strlen(name);
+    const uint64_t name_hash = trycmd_hash64(name, name_len, 0) | 1;
+    struct trycmd_pathcache_file* const file = cache->map;
+    uint32_t probe;
+
+    /* Check arguments. */
+    assert("Unexpected NULL path_out" && (path_out != NULL));
+    if (file == NULL || name_len >= TRYCMD_PATHCACHE_NAME_SZ) {
+        return -1;
+    }
+
+    for (probe = 0; probe < TRYCMD_PATHCACHE_PROBES; ++probe) {
+        const struct trycmd_pathcache_slot* const slot =
+            &file->slots[(name_hash + probe) % TRYCMD_PATHCACHE_SLOTS];
+        struct trycmd_pathcache_slot entry;
+        uint64_t stamp;
+        size_t dir_len;
+
+        /*
+         * Take a private copy, as other processes may be writing, then
+         * check that its hash is unchanged: else it may have been torn.
+         */
+        entry.name_hash = __atomic_load_n(&slot->name_hash, __ATOMIC_ACQUIRE);
+        if (entry.name_hash == 0) {
+            break;
+        }
+        if (entry.name_hash != name_hash) {
+            continue;
+        }
+        memcpy(&entry, slot, sizeof(entry));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->name_hash, __ATOMIC_RELAXED) != name_hash) {
+            trycmd_debug("trycmd_pathcache_lookup: entry for %s changed\n",
+                         name);
+            return -1;
+        }
+        if (entry.name_hash != name_hash
+            || entry.name_len != name_len
+            || memcmp(entry.name, name, name_len) != 0) {
+            continue;
+        }
+
+        /* Found. Check that nothing has since changed. */
+        dir_len = trycmd_pathcache_dir(cache->search, entry.dir_index,
+                                       path_out, path_len);
+        stamp = trycmd_pathcache_stamp(cache->search, entry.dir_index);
+        if (dir_len == 0 || dir_len + name_len + 2 > path_len
+            || stamp == 0 || stamp != entry.dir_stamp) {
+            trycmd_debug("trycmd_pathcache_lookup: stale entry for %s\n", name);
+            return -1;
+        }
+        path_out[dir_len] = '/';
+        memcpy(&path_out[dir_len + 1], name, name_len + 1);
+        if (trycmd_check_program(path_out) != 0) {
+            return -1;
+        }
+        trycmd_debug("trycmd_pathcache_lookup: hit %s\n", path_out);
+        return 0;
+    }
+    return -1;
+}
+
+void trycmd_pathcache_store(const struct trycmd_pathcache* const cache,
+                            const char* const name,
+                            const unsigned int dir_index) {
+    const size_t name_len = strlen(name);
+    const uint64_t name_hash = trycmd_hash64(name, name_len, 0) | 1;
+    struct trycmd_pathcache_file* const file = cache->map;
+    struct trycmd_pathcache_slot* victim;
+    uint64_t stamp;
+    uint32_t probe;
+
+    if (file == NULL || name_len >= TRYCMD_PATHCACHE_NAME_SZ
+        || (stamp = trycmd_pathcache_stamp(cache->search, dir_index)) == 0) {
+        return;
+    }
+
+    /* Reuse this name's slot, else the first free slot, else evict. */
+    victim = &file->slots[name_hash % TRYCMD_PATHCACHE_SLOTS];
+    for (probe = 0; probe < TRYCMD_PATHCACHE_PROBES; ++probe) {
+        struct trycmd_pathcache_slot* const slot =
+            &file->slots[(name_hash + probe) % TRYCMD_PATHCACHE_SLOTS];
+        if (slot->name_hash == 0
+            || (slot->name_hash == name_hash
+                && slot->name_len == name_len
+                && memcmp(slot->name, name, name_len) == 0)) {
+            victim = slot;
+            break;
+        }
+    }
+
+    /*
+     * Invalidate the slot, fill it, then publish its hash last. A reader
+     * checks the hash both before and after copying the slot, so sees
+     * either no entry or a complete one (or, should this same name be
+     * stored again meanwhile, a mix of two whose stamp cannot match).
+     */
+    __atomic_store_n(&victim->name_hash, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    victim->dir_index = dir_index;
+    victim->dir_stamp = stamp;
+    victim->name_len  = (uint32_t)name_len;
+    memcpy(victim->name, name, name_len + 1);
+    __atomic_store_n(&victim->name_hash, name_hash, __ATOMIC_RELEASE);
+    trycmd_debug("trycmd_pathcache_store: %s in PATH[%u]\n", name, dir_index);
+}
+
+/* EOF */
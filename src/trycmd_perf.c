@@ -0,0 +1,217 @@
+/**
+ * \file      trycmd_perf.c
+ * \brief     Hardware and software performance counters for subcommands.
+ * \details   Counters are opened upon try itself, disabled, before any
+ *            subcommand is spawned. Each is inherited by every process
+ *            created afterwards, and enabled only within those which exec
+ *            (the subcommand, and all it starts). As each such process
+ *            exits, its counts are added to try's own, from which they are
+ *            read. This works alike for every spawn backend, including
+ *            those (vfork, posix_spawn) which run no code of ours before
+ *            exec.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EACCES, ENOSYS, EPERM. */
+#include <stdint.h>        /* uint32_t, uint64_t. */
+#include <stdio.h>         /* fprintf, fputc, fputs. */
+#include <string.h>        /* memset, strerror. */
+#include <unistd.h>        /* close, read, syscall. */
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(HAVE_SYS_SYSCALL_H)
+#  include <linux/perf_event.h> /* struct perf_event_attr, PERF_*. */
+#  include <sys/syscall.h> /* SYS_perf_event_open. */
+#  if defined(SYS_perf_event_open)
+#    define TRYCMD_HAVE_PERF_EVENT 1
+#  endif
+#endif
+
+const char* const trycmd_perf_names[trycmd_perf_events] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "cache-misses",
+    "task-clock",
+    "page-faults",
+    "context-switches",
+    "cpu-migrations",
+};
+
+#if defined(TRYCMD_HAVE_PERF_EVENT)
+/** The type and configuration of each event, as for perf_event_open. */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} trycmd_perf_configs[trycmd_perf_events] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES        },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS      },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES     },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES      },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK        },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS       },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES  },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS    },
+};
+
+/**
+ * Open a single event upon the calling process, to be inherited by its
+ * future children and enabled once they exec. Hardware events count only
+ * user-space activity, as permitted by the default perf_event_paranoid
+ * setting; software events (such as context switches) are counted by the
+ * kernel on the process's behalf, so include it where permitted.
+ * @return A descriptor for the event, or -1 on failure.
+ */
+static int trycmd_perf_open_event(const enum trycmd_perf_event event) {
+    struct perf_event_attr attr;
+    int fd;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = trycmd_perf_configs[event].type;
+    attr.config         = trycmd_perf_configs[event].config;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED
+                        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled       = 1;
+    attr.inherit        = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = (attr.type == PERF_TYPE_HARDWARE);
+    attr.exclude_hv     = attr.exclude_kernel;
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                      PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0 && (errno == EACCES || errno == EPERM) && !attr.exclude_kernel) {
+        /* Kernel activity is not permitted here; count without it. */
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                          PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+#else
+static int trycmd_perf_open_event(const enum trycmd_perf_event event) {
+    (void) event;
+    errno = ENOSYS;
+    return -1;
+}
+#endif
+
+int trycmd_perf_open(struct trycmd_perf* const perf) {
+    const int hardware = (1 << trycmd_perf_task_clock) - 1;
+    int opened = 0;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL perf" && (perf != NULL));
+
+    /*
+     * Open every hardware and default software event. Should no hardware
+     * event be available (as within many virtual machines), fall back to
+     * further software events in their place.
+     */
+    for (idx = 0; idx < trycmd_perf_events; ++idx) {
+        perf->fd[idx] = -1;
+    }
+    for (idx = 0; idx < trycmd_perf_context_switches; ++idx) {
+        perf->fd[idx] = trycmd_perf_open_event((enum trycmd_perf_event)idx);
+        if (perf->fd[idx] < 0) {
+            trycmd_debug("trycmd_perf_open: no %s: %s\n",
+                         trycmd_perf_names[idx], strerror(errno));
+        }
+        opened |= (perf->fd[idx] >= 0) << idx;
+    }
+    if ((opened & hardware) == 0) {
+        for (idx = trycmd_perf_context_switches;
+             idx < trycmd_perf_events; ++idx) {
+            perf->fd[idx] = trycmd_perf_open_event((enum trycmd_perf_event)idx);
+            opened |= (perf->fd[idx] >= 0) << idx;
+        }
+    }
+    trycmd_debug("trycmd_perf_open: opened events 0x%x\n", opened);
+    return (opened != 0) ? 0 : -1;
+}
+
+void trycmd_perf_read(const struct trycmd_perf* const perf,
+                      struct trycmd_perf_counts* const counts) {
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL perf" && (perf != NULL));
+    assert("Unexpected NULL counts" && (counts != NULL));
+    memset(counts, 0, sizeof(*counts));
+
+    /*
+     * Read each event's value, with the times for which it was enabled and
+     * running. Should more events be open than the hardware can count at
+     * once, each is multiplexed and so its value is scaled to estimate it.
+     */
+    for (idx = 0; idx < trycmd_perf_events; ++idx) {
+        uint64_t values[3];
+        if (perf->fd[idx] < 0
+            || read(perf->fd[idx], values, sizeof(values))
+               != (ssize_t)sizeof(values)) {
+            continue;
+        }
+        if (values[2] > 0 && values[2] < values[1]) {
+            values[0] = (uint64_t)((double)values[0]
+                                   * ((double)values[1] / (double)values[2]));
+        }
+        counts->value[idx] = values[0];
+        counts->valid |= 1u << idx;
+    }
+}
+
+void trycmd_perf_close(struct trycmd_perf* const perf) {
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL perf" && (perf != NULL));
+    for (idx = 0; idx < trycmd_perf_events; ++idx) {
+        if (perf->fd[idx] >= 0) {
+            close(perf->fd[idx]);
+            perf->fd[idx] = -1;
+        }
+    }
+}
+
+void trycmd_print_perf(const struct trycmd_perf_counts* const counts,
+                       FILE* const os) {
+    const unsigned int cycles_and_instructions =
+        (1u << trycmd_perf_cycles) | (1u << trycmd_perf_instructions);
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL counts" && (counts != NULL));
+    assert("Unexpected NULL os" && (os != NULL));
+
+    /* Print every event counted, then the rate of instructions (if any). */
+    fputs(_("Perf:"), os);
+    if (counts->valid == 0) {
+        fputs(_(" unavailable"), os);
+    }
+    for (idx = 0; idx < trycmd_perf_events; ++idx) {
+        if ((counts->valid & (1u << idx)) == 0) {
+            continue;
+        } else if (idx == trycmd_perf_task_clock) {
+            const uint64_t us = counts->value[idx] / 1000;
+            fprintf(os, N_(" %s=%lu.%03lums"), trycmd_perf_names[idx],
+                    (unsigned long)(us / 1000), (unsigned long)(us % 1000));
+        } else {
+            fprintf(os, N_(" %s=%lu"), trycmd_perf_names[idx],
+                    (unsigned long)counts->value[idx]);
+        }
+    }
+    if ((counts->valid & cycles_and_instructions) == cycles_and_instructions
+        && counts->value[trycmd_perf_cycles] > 0) {
+        fprintf(os, _(" insn-per-cycle=%.2f"),
+                (double)counts->value[trycmd_perf_instructions]
+                / (double)counts->value[trycmd_perf_cycles]);
+    }
+    fputc('\n', os);
+}
+
+/* EOF */
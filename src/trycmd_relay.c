@@ -0,0 +1,498 @@
+/**
+ * \file      trycmd_relay.c
+ * \brief     Relay subcommand output to both try's own outputs and a log.
+ * \details   Each of the subcommand's standard output and error is a pipe,
+ *            read upon an event loop. Where try's own output is also a
+ *            pipe, data is duplicated onto it with tee(2) then moved into
+ *            the log with splice(2), and so never copied through user
+ *            space. Otherwise (as for a terminal), data is read into a
+ *            buffer then written to both. Should the output's tail be kept
+ *            (within a trycmd_ring), data is always read into a buffer,
+ *            but is still duplicated onto a piped output by tee(2). Output
+ *            held back within a trycmd_spool takes the place of try's own,
+ *            and is spliced there unless it must also be kept. Timestamped
+ *            output is always read into a buffer, then written with one
+ *            writev(2) per batch of lines. Output captured for a result
+ *            cache is always read into a buffer, then written to a spool
+ *            per stream.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EINTR, EINVAL. */
+#include <fcntl.h>         /* open, splice, tee, O_*, SPLICE_F_*. */
+#include <stddef.h>        /* size_t. */
+#include <stdio.h>         /* fdopen, fclose, fflush, snprintf. */
+#include <string.h>        /* memchr, memcpy, memset, strcmp, strerror. */
+#include <sys/epoll.h>     /* EPOLLIN. */
+#include <sys/ioctl.h>     /* ioctl, FIONREAD. */
+#include <sys/stat.h>      /* fstat, S_ISFIFO. */
+#include <sys/uio.h>       /* struct iovec, writev. */
+#include <time.h>          /* clock_gettime, localtime_r, struct tm. */
+#include <unistd.h>        /* close, pipe2, read, write. */
+
+/** The size of the buffer used when data must be copied. */
+#define TRYCMD_RELAY_BUFFER_SIZE (64 * 1024)
+
+/** The most buffers (each a timestamp, or a line) written at once. */
+#define TRYCMD_RELAY_IOV_MAX (512)
+
+int trycmd_parse_timestamps(const char* const mode,
+                            enum trycmd_timestamps* const out) {
+    const struct timestamps_opt {
+        const char* key;
+        enum trycmd_timestamps value;
+    } timestampsopts[] = {
+        { N_("relative"), trycmd_timestamps_relative },
+        { N_("absolute"), trycmd_timestamps_absolute },
+    };
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+
+    /* Convert the given MODE string to an enumeration value. */
+    if (mode != NULL) {
+        for (idx = 0; idx < sizeof(timestampsopts) / sizeof(timestampsopts[0]); ++idx) {
+            if (strcmp(mode, timestampsopts[idx].key) == 0) {
+                *out = timestampsopts[idx].value;
+                return 0;
+            }
+        }
+    }
+
+    /* Unrecognised MODE string. */
+    return -1;
+}
+
+int trycmd_write_all(const int fd, const char* data, size_t len) {
+    /* Check arguments. */
+    assert("Unexpected NULL data" && (data != NULL || len == 0));
+    while (len > 0) {
+        const ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        len  -= (size_t)written;
+    }
+    return 0;
+}
+
+int trycmd_writev_all(const int fd, struct iovec* iov, int iovcnt) {
+    /* Check arguments. */
+    assert("Unexpected NULL iov" && (iov != NULL || iovcnt == 0));
+
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        /* Skip those buffers written, then any part of the next. */
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base  = (char*)iov->iov_base + written;
+            iov->iov_len  -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Capture data read from a stream, if a copy of its output is kept.
+ */
+static void trycmd_relay_capture(const struct trycmd_relay_stream* const stream,
+                                 const char* const data,
+                                 const size_t len) {
+    if (stream->capture != NULL
+        && trycmd_spool_write(stream->capture, data, len) != 0) {
+        trycmd_debug("trycmd_relay_capture: cannot capture: %s\n",
+                     strerror(errno));
+    }
+}
+
+/**
+ * Keep data read from a stream, by writing it to the log and tail (if any).
+ */
+static void trycmd_relay_keep(struct trycmd_relay* const relay,
+                              const struct trycmd_relay_stream* const stream,
+                              const char* const data,
+                              const size_t len) {
+    if (relay->log_fd >= 0 && trycmd_write_all(relay->log_fd, data, len) != 0) {
+        trycmd_debug("trycmd_relay_keep: cannot write log: %s\n",
+                     strerror(errno));
+    }
+    if (relay->tail != NULL) {
+        trycmd_ring_write(relay->tail, data, len);
+    }
+    trycmd_relay_capture(stream, data, len);
+}
+
+/**
+ * Read up to len bytes, known to be waiting within a stream's pipe, into
+ * the given buffer.
+ * @return The number of bytes read, or -1 on failure.
+ */
+static ssize_t trycmd_relay_read(const struct trycmd_relay_stream* const stream,
+                                 char* const buffer,
+                                 const size_t len) {
+    ssize_t nread;
+    do {
+        nread = read(stream->pipe_fd, buffer,
+                     (len < TRYCMD_RELAY_BUFFER_SIZE)
+                     ? len : TRYCMD_RELAY_BUFFER_SIZE);
+    } while (nread < 0 && errno == EINTR);
+    return (nread > 0) ? nread : -1;
+}
+
+/**
+ * Relay up to len bytes, known to be waiting within a stream's pipe, by
+ * duplicating them onto a piped output. Those bytes are then moved into
+ * the log without copying them through user space or, should a tail be
+ * kept, read into the given buffer.
+ * @return The number of bytes relayed, or -1 on failure.
+ */
+static ssize_t trycmd_relay_tee(struct trycmd_relay* const relay,
+                                const struct trycmd_relay_stream* const stream,
+                                char* const buffer,
+                                const size_t len) {
+    ssize_t teed;
+    ssize_t moved;
+    ssize_t total;
+
+    /* Duplicate the data onto the output, blocking while it is full. */
+    do {
+        teed = tee(stream->pipe_fd, stream->out_fd, len, 0);
+    } while (teed < 0 && errno == EINTR);
+    if (teed <= 0) {
+        return -1;
+    }
+
+    /* Then consume that same data from the pipe. */
+    for (total = 0; total < teed; total += moved) {
+        const size_t remaining = (size_t)(teed - total);
+        if (relay->tail != NULL || relay->log_fd < 0
+            || stream->capture != NULL) {
+            moved = trycmd_relay_read(stream, buffer, remaining);
+            if (moved > 0) {
+                trycmd_relay_keep(relay, stream, buffer, (size_t)moved);
+            }
+        } else {
+            moved = splice(stream->pipe_fd, NULL, relay->log_fd, NULL,
+                           remaining, SPLICE_F_MOVE);
+            if (moved < 0 && errno == EINTR) {
+                moved = 0;  /* Retry. */
+                continue;
+            }
+        }
+        if (moved <= 0) {
+            return -1;
+        }
+    }
+    return teed;
+}
+
+/**
+ * Relay up to len bytes, known to be waiting within a stream's pipe,
+ * by copying them through the given buffer.
+ * @return The number of bytes relayed, or -1 on failure.
+ */
+static ssize_t trycmd_relay_copy(struct trycmd_relay* const relay,
+                                 const struct trycmd_relay_stream* const stream,
+                                 char* const buffer,
+                                 const size_t len) {
+    const ssize_t nread = trycmd_relay_read(stream, buffer, len);
+    if (nread < 0) {
+        return -1;
+    }
+
+    /* A failure to write the output loses data, but not from the log. */
+    if ((relay->spool != NULL)
+        ? trycmd_spool_write(relay->spool, buffer, (size_t)nread) != 0
+        : trycmd_write_all(stream->out_fd, buffer, (size_t)nread) != 0) {
+        trycmd_debug("trycmd_relay_copy: cannot write output: %s\n",
+                     strerror(errno));
+    }
+    trycmd_relay_keep(relay, stream, buffer, (size_t)nread);
+    return nread;
+}
+
+/**
+ * Write the given buffers to the log and tail (if any), then the output.
+ */
+static void trycmd_relay_writev(struct trycmd_relay* const relay,
+                                const struct trycmd_relay_stream* const stream,
+                                struct iovec* const iov,
+                                const int iovcnt) {
+    struct iovec copy[TRYCMD_RELAY_IOV_MAX];
+    int idx;
+
+    if (relay->log_fd >= 0) {
+        memcpy(copy, iov, (size_t)iovcnt * sizeof(*iov));
+        if (trycmd_writev_all(relay->log_fd, copy, iovcnt) != 0) {
+            trycmd_debug("trycmd_relay_writev: cannot write log: %s\n",
+                         strerror(errno));
+        }
+    }
+    for (idx = 0; relay->tail != NULL && idx < iovcnt; ++idx) {
+        trycmd_ring_write(relay->tail, iov[idx].iov_base, iov[idx].iov_len);
+    }
+    if ((relay->spool != NULL)
+        ? trycmd_spool_writev(relay->spool, iov, iovcnt) != 0
+        : trycmd_writev_all(stream->out_fd, iov, iovcnt) != 0) {
+        trycmd_debug("trycmd_relay_writev: cannot write output: %s\n",
+                     strerror(errno));
+    }
+}
+
+/**
+ * Format the timestamp of data read now.
+ * @return The length of the timestamp.
+ */
+static size_t trycmd_relay_timestamp(const struct trycmd_relay* const relay,
+                                     char* const prefix,
+                                     const size_t size) {
+    int len;
+    if (relay->timestamps == trycmd_timestamps_absolute) {
+        struct timespec ts;
+        struct tm tm;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        localtime_r(&ts.tv_sec, &tm);
+        len = snprintf(prefix, size, N_("[%02d:%02d:%02d.%03ld] "),
+                       tm.tm_hour, tm.tm_min, tm.tm_sec,
+                       ts.tv_nsec / 1000000);
+    } else {
+        const uint64_t ms = (trycmd_clock_ns() - relay->start_ns) / 1000000;
+        len = snprintf(prefix, size, N_("[%5lu.%03lu] "),
+                       (unsigned long)(ms / 1000), (unsigned long)(ms % 1000));
+    }
+    return (len > 0 && (size_t)len < size) ? (size_t)len : 0;
+}
+
+/**
+ * Relay up to len bytes, known to be waiting within a stream's pipe, by
+ * reading them into the given buffer then writing them back out with a
+ * timestamp before each line. The time is read once for all lines read.
+ * @return The number of bytes relayed, or -1 on failure.
+ */
+static ssize_t trycmd_relay_stamp(struct trycmd_relay* const relay,
+                                  struct trycmd_relay_stream* const stream,
+                                  char* const buffer,
+                                  const size_t len) {
+    struct iovec iov[TRYCMD_RELAY_IOV_MAX];
+    char prefix[32];
+    size_t prefix_len;
+    size_t pos;
+    int iovcnt = 0;
+    const ssize_t nread = trycmd_relay_read(stream, buffer, len);
+    if (nread < 0) {
+        return -1;
+    }
+    trycmd_relay_capture(stream, buffer, (size_t)nread);
+
+    /* Gather each line, preceded by a timestamp if it begins here. */
+    prefix_len = trycmd_relay_timestamp(relay, prefix, sizeof(prefix));
+    for (pos = 0; pos < (size_t)nread; ) {
+        const char* const newline = memchr(&buffer[pos], '\n',
+                                           (size_t)nread - pos);
+        const size_t end = (newline != NULL)
+                         ? (size_t)(newline - buffer) + 1
+                         : (size_t)nread;
+        if (iovcnt > TRYCMD_RELAY_IOV_MAX - 2) {
+            trycmd_relay_writev(relay, stream, iov, iovcnt);
+            iovcnt = 0;
+        }
+        if (stream->at_line_start && prefix_len > 0) {
+            iov[iovcnt].iov_base = prefix;
+            iov[iovcnt].iov_len  = prefix_len;
+            ++iovcnt;
+        }
+        iov[iovcnt].iov_base = &buffer[pos];
+        iov[iovcnt].iov_len  = end - pos;
+        ++iovcnt;
+        stream->at_line_start = (newline != NULL);
+        pos = end;
+    }
+    trycmd_relay_writev(relay, stream, iov, iovcnt);
+    return nread;
+}
+
+/**
+ * Relay all data now waiting within a stream's pipe.
+ */
+static void trycmd_relay_drain(struct trycmd_relay* const relay,
+                               struct trycmd_relay_stream* const stream) {
+    char buffer[TRYCMD_RELAY_BUFFER_SIZE];
+    for (;;) {
+        int waiting = 0;
+        ssize_t relayed;
+        if (ioctl(stream->pipe_fd, FIONREAD, &waiting) != 0 || waiting <= 0) {
+            break;
+        }
+        if (relay->timestamps != trycmd_timestamps_none) {
+            relayed = trycmd_relay_stamp(relay, stream, buffer,
+                                         (size_t)waiting);
+        } else if (relay->spool != NULL && relay->log_fd < 0
+                   && relay->tail == NULL && stream->capture == NULL) {
+            relayed = trycmd_spool_splice(relay->spool, stream->pipe_fd,
+                                          (size_t)waiting);
+        } else if (stream->use_tee) {
+            relayed = trycmd_relay_tee(relay, stream, buffer, (size_t)waiting);
+            if (relayed < 0 && errno == EINVAL) {
+                /* Not supported for these descriptors. Copy instead. */
+                trycmd_debug("trycmd_relay_drain: tee unsupported, copying\n");
+                stream->use_tee = 0;
+                continue;
+            }
+        } else {
+            relayed = trycmd_relay_copy(relay, stream, buffer,
+                                        (size_t)waiting);
+        }
+        if (relayed < 0) {
+            trycmd_debug("trycmd_relay_drain: cannot relay: %s\n",
+                         strerror(errno));
+            break;
+        }
+    }
+}
+
+/**
+ * Handle data arriving from the subcommand.
+ */
+static void trycmd_relay_on_data(struct trycmd_loop* const loop,
+                                 struct trycmd_loop_handler* const handler,
+                                 const uint32_t events) {
+    struct trycmd_relay* const relay = handler->data;
+    struct trycmd_relay_stream* const stream =
+        (handler == &relay->streams[0].handler) ? &relay->streams[0]
+                                                : &relay->streams[1];
+    (void) loop;
+    (void) events;
+    trycmd_relay_drain(relay, stream);
+}
+
+int trycmd_relay_open(struct trycmd_loop* const loop,
+                      struct trycmd_relay* const relay,
+                      const char* const path,
+                      struct trycmd_ring* const tail,
+                      struct trycmd_spool* const spool) {
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL loop" && (loop != NULL));
+    assert("Unexpected NULL relay" && (relay != NULL));
+    memset(relay, 0, sizeof(*relay));
+    relay->loop     = loop;
+    relay->log_fd   = -1;
+    relay->tail     = tail;
+    relay->spool    = spool;
+    relay->start_ns = trycmd_clock_ns();
+    for (idx = 0; idx < 2; ++idx) {
+        relay->streams[idx].pipe_fd  = -1;
+        relay->streams[idx].child_fd = -1;
+        relay->streams[idx].out_fd   = idx + 1;  /* stdout, stderr. */
+    }
+
+    /* Open any log, then a pipe in place of each output. */
+    if (path != NULL) {
+        relay->log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                             0666);
+        if (relay->log_fd < 0) {
+            return -1;
+        }
+    }
+    for (idx = 0; idx < 2; ++idx) {
+        struct trycmd_relay_stream* const stream = &relay->streams[idx];
+        struct stat out_stat;
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            const int saved_errno = errno;
+            trycmd_relay_close(relay);
+            errno = saved_errno;
+            return -1;
+        }
+        stream->pipe_fd  = fds[0];
+        stream->child_fd = fds[1];
+        stream->at_line_start = 1;
+        stream->use_tee  = (spool == NULL
+                            && fstat(stream->out_fd, &out_stat) == 0
+                            && S_ISFIFO(out_stat.st_mode));
+        if (trycmd_loop_add(loop, &stream->handler, stream->pipe_fd, EPOLLIN,
+                            trycmd_relay_on_data, relay) != 0) {
+            const int saved_errno = errno;
+            trycmd_relay_close(relay);
+            errno = saved_errno;
+            return -1;
+        }
+        trycmd_debug("trycmd_relay_open: relaying fd %d by %s\n",
+                     stream->out_fd, (spool != NULL) ? "spool"
+                                     : stream->use_tee ? "tee" : "copy");
+    }
+    return 0;
+}
+
+void trycmd_relay_flush(struct trycmd_relay* const relay) {
+    /* Check arguments. */
+    assert("Unexpected NULL relay" && (relay != NULL));
+    trycmd_relay_drain(relay, &relay->streams[0]);
+    trycmd_relay_drain(relay, &relay->streams[1]);
+}
+
+FILE* trycmd_relay_log(struct trycmd_relay* const relay) {
+    /* Check arguments. */
+    assert("Unexpected NULL relay" && (relay != NULL));
+
+    /* Share the log's offset, so all is written in order once flushed. */
+    if (relay->log == NULL && relay->log_fd >= 0) {
+        relay->log = fdopen(relay->log_fd, "w");
+    }
+    return relay->log;
+}
+
+void trycmd_relay_close(struct trycmd_relay* const relay) {
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL relay" && (relay != NULL));
+
+    /* Relay whatever remains, then release everything. */
+    for (idx = 0; idx < 2; ++idx) {
+        struct trycmd_relay_stream* const stream = &relay->streams[idx];
+        if (stream->child_fd >= 0) {
+            close(stream->child_fd);
+            stream->child_fd = -1;
+        }
+        if (stream->pipe_fd >= 0) {
+            trycmd_relay_drain(relay, stream);
+            trycmd_loop_remove(relay->loop, &stream->handler);
+            close(stream->pipe_fd);
+            stream->pipe_fd = -1;
+        }
+    }
+    if (relay->log != NULL) {
+        fclose(relay->log);  /* Also closes log_fd. */
+        relay->log = NULL;
+    } else if (relay->log_fd >= 0) {
+        close(relay->log_fd);
+    }
+    relay->log_fd = -1;
+}
+
+/* EOF */
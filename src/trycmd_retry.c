@@ -0,0 +1,197 @@
+/**
+ * \file      trycmd_retry.c
+ * \brief     Retry policy: which failures to retry, and when.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>  /* assert. */
+#include <signal.h>  /* SIG*. */
+#include <stddef.h>  /* size_t. */
+#include <stdint.h>  /* uint32_t, uint64_t, UINT64_C. */
+#include <string.h>  /* strcmp, strlen, strncmp. */
+
+/** Delays are never doubled beyond one hour. */
+#define TRYCMD_RETRY_MAX_DELAY (3600000UL)
+
+int trycmd_parse_backoff(const char* const mode,
+                         enum trycmd_backoff* const out) {
+    const struct backoff_opt {
+        const char* key;
+        enum trycmd_backoff value;
+    } backoffopts[] = {
+        { N_("none"), trycmd_backoff_none },
+        { N_("exp"),  trycmd_backoff_exp  },
+    };
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+
+    /* Convert the given MODE string to an enumeration value. */
+    if (mode != NULL) {
+        for (idx = 0; idx < sizeof(backoffopts) / sizeof(backoffopts[0]); ++idx) {
+            if (strcmp(mode, backoffopts[idx].key) == 0) {
+                *out = backoffopts[idx].value;
+                return 0;
+            }
+        }
+    }
+
+    /* Unrecognised MODE string. */
+    return -1;
+}
+
+/**
+ * Read a single exit status, or a signal name, from the given string.
+ * @return 0 on success (advancing *pos), -1 on failure.
+ */
+static int trycmd_parse_status(const char** const pos, int* const out) {
+    const struct signal_name {
+        const char* name;
+        int         signum;
+    } signal_names[] = {
+        { N_("HUP"),  SIGHUP  }, { N_("INT"),  SIGINT  },
+        { N_("QUIT"), SIGQUIT }, { N_("ILL"),  SIGILL  },
+        { N_("ABRT"), SIGABRT }, { N_("BUS"),  SIGBUS  },
+        { N_("FPE"),  SIGFPE  }, { N_("KILL"), SIGKILL },
+        { N_("USR1"), SIGUSR1 }, { N_("SEGV"), SIGSEGV },
+        { N_("USR2"), SIGUSR2 }, { N_("PIPE"), SIGPIPE },
+        { N_("ALRM"), SIGALRM }, { N_("TERM"), SIGTERM },
+    };
+    const char* text = *pos;
+    size_t idx;
+
+    if (*text >= '0' && *text <= '9') {
+        /* A decimal exit status. */
+        int value = 0;
+        for (; *text >= '0' && *text <= '9'; ++text) {
+            value = value * 10 + (*text - '0');
+            if (value > 255) {
+                return -1;
+            }
+        }
+        *out = value;
+        *pos = text;
+        return 0;
+    }
+
+    /* A signal name, with or without its "SIG" prefix. */
+    if (strncmp(text, "SIG", 3) == 0) {
+        text += 3;
+    }
+    for (idx = 0; idx < sizeof(signal_names) / sizeof(signal_names[0]); ++idx) {
+        const size_t len = strlen(signal_names[idx].name);
+        if (strncmp(text, signal_names[idx].name, len) == 0
+            && (text[len] == '\0' || text[len] == ',')) {
+            *out = TRYCMD_SIGNAL_BASE + signal_names[idx].signum;
+            *pos = text + len;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int trycmd_parse_retry_on(const char* const statuses, uint32_t out[8]) {
+    uint32_t bitmap[8] = { 0 };
+    const char* pos = statuses;
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+    if (statuses == NULL || statuses[0] == '\0') {
+        return -1;
+    }
+
+    /* Read "A[-B][,...]". */
+    for (;;) {
+        int first;
+        int last;
+        int status;
+        if (trycmd_parse_status(&pos, &first) != 0) {
+            return -1;
+        }
+        last = first;
+        if (*pos == '-') {
+            ++pos;
+            if (trycmd_parse_status(&pos, &last) != 0 || last < first) {
+                return -1;
+            }
+        }
+        for (status = first; status <= last; ++status) {
+            bitmap[status / 32] |= UINT32_C(1) << (status % 32);
+        }
+        if (*pos == '\0') {
+            break;
+        } else if (*pos++ != ',') {
+            return -1;
+        }
+    }
+
+    /* Copy the result and return 0 for success. */
+    for (idx = 0; idx < 8; ++idx) {
+        out[idx] = bitmap[idx];
+    }
+    return 0;
+}
+
+int trycmd_is_retryable(const struct trycmd_opts* const opts,
+                        const int exit_status) {
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    if (exit_status <= 0 || exit_status > 255) {
+        return 0;
+    }
+
+    /* With no filter, every failure may be retried. */
+    for (idx = 0; idx < 8; ++idx) {
+        if (opts->opt_retry_on[idx] != 0) {
+            return (opts->opt_retry_on[exit_status / 32]
+                    >> (exit_status % 32)) & 1;
+        }
+    }
+    return 1;
+}
+
+unsigned long trycmd_retry_delay(const struct trycmd_opts* const opts,
+                                 const unsigned int retry,
+                                 uint64_t* const seed) {
+    unsigned long delay;
+    unsigned int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL seed" && (seed != NULL));
+
+    /* Grow the delay, as requested. */
+    delay = opts->opt_retry_delay;
+    if (opts->opt_backoff == trycmd_backoff_exp) {
+        for (idx = 1; idx < retry && delay < TRYCMD_RETRY_MAX_DELAY; ++idx) {
+            delay = (delay < TRYCMD_RETRY_MAX_DELAY / 2)
+                  ? delay * 2
+                  : TRYCMD_RETRY_MAX_DELAY;
+        }
+    }
+
+    /* Choose at random from [delay/2, delay], using xorshift64*. */
+    if (opts->opt_jitter && delay > 1) {
+        uint64_t x = (*seed != 0) ? *seed : UINT64_C(0x9E3779B97F4A7C15);
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        *seed = x;
+        x *= UINT64_C(0x2545F4914F6CDD1D);
+        delay = delay - delay / 2
+              + (unsigned long)((x >> 11) % (uint64_t)(delay / 2 + 1));
+    }
+    return delay;
+}
+
+/* EOF */
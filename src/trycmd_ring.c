@@ -0,0 +1,132 @@
+/**
+ * \file      trycmd_ring.c
+ * \brief     A fixed-size ring buffer, keeping the tail of a stream.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint64_t. */
+#include <stdio.h>         /* fputc, fwrite. */
+#include <stdlib.h>        /* free, malloc. */
+#include <string.h>        /* memcpy, memset. */
+
+int trycmd_ring_init(struct trycmd_ring* const ring, const size_t size) {
+    /* Check arguments. */
+    assert("Unexpected NULL ring" && (ring != NULL));
+    assert("Unexpected zero size" && (size > 0));
+    memset(ring, 0, sizeof(*ring));
+    ring->data = malloc(size);
+    if (ring->data == NULL) {
+        return -1;
+    }
+    ring->size = size;
+    return 0;
+}
+
+void trycmd_ring_write(struct trycmd_ring* const ring,
+                       const char* data,
+                       size_t len) {
+    size_t pos;
+
+    /* Check arguments. */
+    assert("Unexpected NULL ring" && (ring != NULL));
+    assert("Unexpected NULL data" && (data != NULL || len == 0));
+
+    /* Only the last size bytes can be kept, so skip any before them. */
+    ring->total += len;
+    if (len > ring->size) {
+        data += len - ring->size;
+        len   = ring->size;
+    }
+
+    /* Copy the data to its position, wrapping (at most once) at the end. */
+    pos = (size_t)((ring->total - len) % ring->size);
+    if (pos + len > ring->size) {
+        const size_t first = ring->size - pos;
+        memcpy(&ring->data[pos], data, first);
+        memcpy(ring->data, data + first, len - first);
+    } else {
+        memcpy(&ring->data[pos], data, len);
+    }
+}
+
+/**
+ * Gain the byte at the given offset from the oldest byte kept.
+ */
+static char trycmd_ring_at(const struct trycmd_ring* const ring,
+                           const uint64_t start,
+                           const size_t offset) {
+    return ring->data[(size_t)((start + offset) % ring->size)];
+}
+
+void trycmd_ring_print(const struct trycmd_ring* const ring,
+                       const unsigned long lines,
+                       FILE* const os) {
+    unsigned long newlines = 0;
+    uint64_t start;
+    size_t kept;
+    size_t from = 0;
+    size_t pos;
+
+    /* Check arguments. */
+    assert("Unexpected NULL ring" && (ring != NULL));
+    assert("Unexpected NULL os" && (os != NULL));
+    kept  = (ring->total < ring->size) ? (size_t)ring->total : ring->size;
+    start = ring->total - kept;
+    if (kept == 0) {
+        return;
+    }
+
+    /*
+     * Find the first byte to print: that after the newline ending the line
+     * before the last N lines (where any final newline ends the last line).
+     * Otherwise, should the oldest line kept have been partly overwritten,
+     * start from the first whole line.
+     */
+    if (lines > 0) {
+        for (pos = kept - 1; pos > 0; --pos) {
+            if (trycmd_ring_at(ring, start, pos - 1) == '\n'
+                && ++newlines == lines) {
+                from = pos;
+                break;
+            }
+        }
+    }
+    if (from == 0 && start > 0) {
+        for (pos = 0; pos < kept - 1; ++pos) {
+            if (trycmd_ring_at(ring, start, pos) == '\n') {
+                from = pos + 1;
+                break;
+            }
+        }
+    }
+
+    /* Print from there in (at most) two parts, ending with a newline. */
+    for (pos = from; pos < kept; ) {
+        const size_t at = (size_t)((start + pos) % ring->size);
+        const size_t len = (at + (kept - pos) > ring->size)
+                         ? ring->size - at
+                         : kept - pos;
+        fwrite(&ring->data[at], 1, len, os);
+        pos += len;
+    }
+    if (trycmd_ring_at(ring, start, kept - 1) != '\n') {
+        fputc('\n', os);
+    }
+}
+
+void trycmd_ring_free(struct trycmd_ring* const ring) {
+    /* Check arguments. */
+    assert("Unexpected NULL ring" && (ring != NULL));
+    free(ring->data);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* EOF */
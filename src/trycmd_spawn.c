@@ -0,0 +1,480 @@
+/**
+ * \file      trycmd_spawn.c
+ * \brief     Pluggable process spawn backends.
+ * \details   Each backend starts a child process which immediately execs
+ *            the given program. Exec failures are reported synchronously,
+ *            to the caller, by every backend.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EINTR, ENOSYS. */
+#include <fcntl.h>         /* O_CLOEXEC. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint64_t, uintptr_t. */
+#include <string.h>        /* memset, strcmp. */
+#include <signal.h>        /* sigprocmask, SIGCHLD, SIG_SETMASK. */
+#include <sys/types.h>     /* pid_t. */
+#include <sys/wait.h>      /* waitpid. */
+#include <unistd.h>        /* dup2, fork, vfork, execv, pipe2, read, setpgid, write, _exit. */
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWN)
+#  include <spawn.h>       /* posix_spawn, posix_spawnattr_*. */
+#  define TRYCMD_HAVE_POSIX_SPAWN 1
+#endif
+#if defined(HAVE_SYS_SYSCALL_H)
+#  include <sys/syscall.h> /* syscall, SYS_clone3, SYS_pidfd_open. */
+#  if defined(SYS_clone3)
+#    define TRYCMD_HAVE_CLONE3 1
+#  endif
+#  if defined(SYS_pidfd_open)
+#    define TRYCMD_HAVE_PIDFD_OPEN 1
+#  endif
+#endif
+
+/* Check for required defined values. */
+#if !defined(HAVE_FORK)
+#  error Missing required function 'fork'.
+#endif
+
+#if !defined(CLONE_PIDFD)
+#  define CLONE_PIDFD 0x00001000
+#endif
+
+/** The exit status of a child which failed to exec, before reporting. */
+#define TRYCMD_SPAWN_EXEC_FAILED (127)
+
+extern char** environ;
+
+#if defined(TRYCMD_HAVE_CLONE3)
+/**
+ * Arguments to the clone3 system call (see clone(2)).
+ * Mirrors the kernel's own 'struct clone_args', version 0, to avoid
+ * depending upon the (conflicting) <linux/sched.h> header.
+ */
+struct trycmd_clone_args {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+};
+#endif
+
+/* Names of all spawn backends (not to be translated). */
+static const struct spawn_name {
+    const char* key;
+    enum trycmd_spawn value;
+} spawn_names[] = {
+    { "auto",        trycmd_spawn_auto        },
+    { "fork",        trycmd_spawn_fork        },
+    { "vfork",       trycmd_spawn_vfork       },
+    { "posix_spawn", trycmd_spawn_posix_spawn },
+    { "clone3",      trycmd_spawn_clone3      },
+};
+
+void trycmd_spawn_attr_init(struct trycmd_spawn_attr* const attr,
+                            const struct trycmd_opts* const opts) {
+    /* Check arguments. */
+    assert("Unexpected NULL attr" && (attr != NULL));
+
+    /* Default to inheriting all standard streams. */
+    attr->backend  = (opts != NULL) ? opts->opt_spawn : trycmd_spawn_auto;
+    attr->stdio[0] = -1;
+    attr->stdio[1] = -1;
+    attr->stdio[2] = -1;
+    attr->new_pgroup = 0;
+    attr->sigmask    = NULL;
+}
+
+int trycmd_parse_spawn(const char* const name, enum trycmd_spawn* const out) {
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+
+    /* Convert the given backend name to an enumeration value. */
+    if (name != NULL) {
+        for (idx = 0; idx < sizeof(spawn_names) / sizeof(spawn_names[0]); ++idx) {
+            if (strcmp(name, spawn_names[idx].key) == 0) {
+                *out = spawn_names[idx].value;
+                return 0;
+            }
+        }
+    }
+
+    /* Missing or unrecognised backend name. */
+    return -1;
+}
+
+const char* trycmd_spawn_name(const enum trycmd_spawn backend) {
+    size_t idx;
+    for (idx = 0; idx < sizeof(spawn_names) / sizeof(spawn_names[0]); ++idx) {
+        if (spawn_names[idx].value == backend) {
+            return spawn_names[idx].key;
+        }
+    }
+    assert("Unrecognised trycmd_spawn value" && 0);
+    return N_("unknown");
+}
+
+enum trycmd_spawn trycmd_resolve_spawn(const enum trycmd_spawn backend) {
+    switch (backend) {
+        case trycmd_spawn_auto:
+            /*
+             * Prefer posix_spawn: glibc implements it with CLONE_VM and
+             * CLONE_VFORK, so no page tables are copied, yet it remains
+             * safe to use from multi-threaded callers.
+             */
+#if defined(TRYCMD_HAVE_POSIX_SPAWN)
+            return trycmd_spawn_posix_spawn;
+#elif defined(HAVE_WORKING_VFORK)
+            return trycmd_spawn_vfork;
+#else
+            return trycmd_spawn_fork;
+#endif
+        case trycmd_spawn_vfork:
+#if defined(HAVE_WORKING_VFORK)
+            return backend;
+#else
+            return trycmd_spawn_fork;
+#endif
+        case trycmd_spawn_posix_spawn:
+#if defined(TRYCMD_HAVE_POSIX_SPAWN)
+            return backend;
+#else
+            return trycmd_spawn_fork;
+#endif
+        case trycmd_spawn_clone3:
+#if defined(TRYCMD_HAVE_CLONE3)
+            return backend;
+#else
+            return trycmd_spawn_fork;
+#endif
+        case trycmd_spawn_fork:
+        default:
+            return trycmd_spawn_fork;
+    }
+}
+
+/**
+ * Report the result of an exec, in a child, through the given pipe.
+ * If the exec succeeded then the pipe will have been closed (it must be
+ * O_CLOEXEC) and nothing will be read. Otherwise, errno will be read.
+ * In all cases, the parent's end of the pipe will be closed.
+ * @param  child The child process, reaped upon exec failure.
+ * @param  fd    The read end of the child's status pipe.
+ * @return 0 if the child exec'd successfully, otherwise -1 with errno set.
+ */
+static int trycmd_spawn_read_status(const pid_t child, const int fd) {
+    int child_errno = 0;
+    ssize_t readlen;
+
+    /* Wait for the child to either exec (closing the pipe) or fail. */
+    do {
+        readlen = read(fd, &child_errno, sizeof(child_errno));
+    } while (readlen < 0 && errno == EINTR);
+    close(fd);
+
+    if (readlen == (ssize_t)sizeof(child_errno)) {
+        /* Exec failed. Reap the child then report its error. */
+        while (waitpid(child, NULL, 0) < 0 && errno == EINTR) {
+            /* Retry. */
+        }
+        errno = child_errno;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Install the requested process group, signal mask and standard streams
+ * within a child. Only async-signal-safe functions may be used, as this
+ * runs after vfork.
+ * @return 0 on success, -1 on failure with errno set.
+ */
+static int trycmd_spawn_setup_child(const struct trycmd_spawn_attr* const attr) {
+    int fd;
+    if (attr->new_pgroup && setpgid(0, 0) != 0) {
+        return -1;
+    }
+    if (attr->sigmask != NULL
+        && sigprocmask(SIG_SETMASK, attr->sigmask, NULL) != 0) {
+        return -1;
+    }
+    for (fd = 0; fd < 3; ++fd) {
+        if (attr->stdio[fd] >= 0 && dup2(attr->stdio[fd], fd) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Exec the given program then, upon failure, report errno through
+ * the given pipe and exit. For use in a forked child only.
+ */
+static void trycmd_spawn_exec_child(const struct trycmd_spawn_attr* const attr,
+                                    const char* const path,
+                                    char* argv[],
+                                    const int fd) {
+    int child_errno;
+    if (trycmd_spawn_setup_child(attr) == 0) {
+        execv(path, argv);
+    }
+    child_errno = errno;
+    if (write(fd, &child_errno, sizeof(child_errno)) < 0) {
+        /* Nothing more can be done. */
+    }
+    _exit(TRYCMD_SPAWN_EXEC_FAILED);
+}
+
+static int trycmd_spawn_with_fork(const struct trycmd_spawn_attr* const attr,
+                                  const char* const path,
+                                  char* argv[],
+                                  struct trycmd_child* const child_out) {
+    int status_pipe[2];
+    pid_t pid;
+
+    if (pipe2(status_pipe, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    if ((pid = fork()) == 0) {
+        /* Child process. */
+        close(status_pipe[0]);
+        trycmd_spawn_exec_child(attr, path, argv, status_pipe[1]);
+    }
+
+    /* Parent process. */
+    close(status_pipe[1]);
+    if (pid < 0) {
+        close(status_pipe[0]);
+        return -1;
+    }
+    child_out->pid = pid;
+    return trycmd_spawn_read_status(pid, status_pipe[0]);
+}
+
+static int trycmd_spawn_with_vfork(const struct trycmd_spawn_attr* const attr,
+                                   const char* const path,
+                                   char* argv[],
+                                   struct trycmd_child* const child_out) {
+#if defined(HAVE_WORKING_VFORK)
+    /*
+     * The child shares our memory until it execs or exits, so it may
+     * report its errno directly. It must do nothing else but _exit.
+     */
+    volatile int child_errno = 0;
+    pid_t pid;
+
+    if ((pid = vfork()) == 0) {
+        /* Child process. */
+        if (trycmd_spawn_setup_child(attr) == 0) {
+            execv(path, argv);
+        }
+        child_errno = errno;
+        _exit(TRYCMD_SPAWN_EXEC_FAILED);
+    }
+
+    /* Parent process (resumes once the child has exec'd or exited). */
+    if (pid < 0) {
+        return -1;
+    }
+    child_out->pid = pid;
+    if (child_errno != 0) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+            /* Retry. */
+        }
+        errno = child_errno;
+        return -1;
+    }
+    return 0;
+#else
+    return trycmd_spawn_with_fork(attr, path, argv, child_out);
+#endif
+}
+
+static int trycmd_spawn_with_posix_spawn(const struct trycmd_spawn_attr* const attr,
+                                         const char* const path,
+                                         char* argv[],
+                                         struct trycmd_child* const child_out) {
+#if defined(TRYCMD_HAVE_POSIX_SPAWN)
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_t* actions_ptr = NULL;
+    posix_spawnattr_t spawnattr;
+    posix_spawnattr_t* spawnattr_ptr = NULL;
+    int result = 0;
+    pid_t pid;
+    int fd;
+
+    /* Create a new process group and set the signal mask (if requested). */
+    if (attr->new_pgroup || attr->sigmask != NULL) {
+        short flags = 0;
+        if (attr->new_pgroup) {
+            flags |= POSIX_SPAWN_SETPGROUP;
+        }
+        if (attr->sigmask != NULL) {
+            flags |= POSIX_SPAWN_SETSIGMASK;
+        }
+        posix_spawnattr_init(&spawnattr);
+        spawnattr_ptr = &spawnattr;
+        result = posix_spawnattr_setflags(spawnattr_ptr, flags);
+        if (result == 0 && attr->new_pgroup) {
+            result = posix_spawnattr_setpgroup(spawnattr_ptr, 0);
+        }
+        if (result == 0 && attr->sigmask != NULL) {
+            result = posix_spawnattr_setsigmask(spawnattr_ptr, attr->sigmask);
+        }
+    }
+
+    /* Install the requested standard streams (if any). */
+    for (fd = 0; fd < 3 && result == 0; ++fd) {
+        if (attr->stdio[fd] >= 0) {
+            if (actions_ptr == NULL) {
+                posix_spawn_file_actions_init(&actions);
+                actions_ptr = &actions;
+            }
+            result = posix_spawn_file_actions_adddup2(actions_ptr,
+                                                      attr->stdio[fd], fd);
+        }
+    }
+    if (result == 0) {
+        result = posix_spawn(&pid, path, actions_ptr, spawnattr_ptr, argv,
+                             environ);
+    }
+    if (actions_ptr != NULL) {
+        posix_spawn_file_actions_destroy(actions_ptr);
+    }
+    if (spawnattr_ptr != NULL) {
+        posix_spawnattr_destroy(spawnattr_ptr);
+    }
+    if (result != 0) {
+        errno = result;
+        return -1;
+    }
+    child_out->pid = pid;
+    return 0;
+#else
+    return trycmd_spawn_with_fork(attr, path, argv, child_out);
+#endif
+}
+
+static int trycmd_spawn_with_clone3(const struct trycmd_spawn_attr* const attr,
+                                    const char* const path,
+                                    char* argv[],
+                                    struct trycmd_child* const child_out) {
+#if defined(TRYCMD_HAVE_CLONE3)
+    /*
+     * clone3 without CLONE_VM copies our memory, much as fork does, but it
+     * additionally returns a pidfd for the child, atomically and without
+     * any risk of the child's pid being reused.
+     */
+    struct trycmd_clone_args args;
+    int status_pipe[2];
+    int pidfd = -1;
+    long pid;
+
+    if (pipe2(status_pipe, O_CLOEXEC) != 0) {
+        return -1;
+    }
+    memset(&args, 0, sizeof(args));
+    args.flags       = CLONE_PIDFD;
+    args.pidfd       = (uint64_t)(uintptr_t)&pidfd;
+    args.exit_signal = SIGCHLD;
+    if ((pid = syscall(SYS_clone3, &args, sizeof(args))) == 0) {
+        /* Child process. */
+        close(status_pipe[0]);
+        trycmd_spawn_exec_child(attr, path, argv, status_pipe[1]);
+    }
+
+    /* Parent process. */
+    if (pid < 0) {
+        close(status_pipe[0]);
+        close(status_pipe[1]);
+        if (errno == ENOSYS) {
+            /* Kernel predates clone3 (Linux 5.3). */
+            trycmd_debug("trycmd_spawn: clone3 unsupported, using fork\n");
+            return trycmd_spawn_with_fork(attr, path, argv, child_out);
+        }
+        return -1;
+    }
+    close(status_pipe[1]);
+    child_out->pid   = (pid_t)pid;
+    child_out->pidfd = pidfd;
+    if (trycmd_spawn_read_status(child_out->pid, status_pipe[0]) != 0) {
+        const int saved_errno = errno;
+        close(pidfd);
+        child_out->pidfd = -1;
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+#else
+    return trycmd_spawn_with_fork(attr, path, argv, child_out);
+#endif
+}
+
+int trycmd_spawn(const struct trycmd_spawn_attr* const attr,
+                 const char* const path,
+                 char* argv[],
+                 struct trycmd_child* const child_out) {
+    enum trycmd_spawn backend;
+    int result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL attr" && (attr != NULL));
+    assert("Unexpected NULL path" && (path != NULL));
+    assert("Unexpected NULL argv" && (argv != NULL));
+    assert("Unexpected NULL child_out" && (child_out != NULL));
+
+    /* Select, report and then use the requested backend. */
+    backend = trycmd_resolve_spawn(attr->backend);
+    trycmd_debug("trycmd_spawn: backend=%s (requested %s)\n",
+                 trycmd_spawn_name(backend),
+                 trycmd_spawn_name(attr->backend));
+    child_out->pid   = -1;
+    child_out->pidfd = -1;
+    switch (backend) {
+        case trycmd_spawn_vfork:
+            result = trycmd_spawn_with_vfork(attr, path, argv, child_out);
+            break;
+        case trycmd_spawn_posix_spawn:
+            result = trycmd_spawn_with_posix_spawn(attr, path, argv, child_out);
+            break;
+        case trycmd_spawn_clone3:
+            result = trycmd_spawn_with_clone3(attr, path, argv, child_out);
+            break;
+        case trycmd_spawn_fork:
+        default:
+            result = trycmd_spawn_with_fork(attr, path, argv, child_out);
+            break;
+    }
+
+    if (result != 0) {
+        trycmd_debug("trycmd_spawn: failed to exec %s (errno=%d)\n",
+                     path, errno);
+        child_out->pid = -1;
+    }
+    return result;
+}
+
+int trycmd_pidfd_open(const pid_t pid) {
+#if defined(TRYCMD_HAVE_PIDFD_OPEN)
+    /* pidfd_open always sets close-on-exec upon its result. */
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void) pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* EOF */
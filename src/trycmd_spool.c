@@ -0,0 +1,242 @@
+/**
+ * \file      trycmd_spool.c
+ * \brief     Hold back subcommand output, to be replayed only upon failure.
+ * \details   Output is spooled into an anonymous memory-backed file (see
+ *            memfd_create(2)) until it exceeds a given size, after which
+ *            it is moved to an unlinked temporary file and spooled there
+ *            instead, so that try's memory use remains bounded. Data is
+ *            spliced into the spool and replayed with sendfile(2) where
+ *            possible, so is never copied through user space.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, EINTR, EINVAL, ENOSYS. */
+#include <fcntl.h>         /* open, splice, O_*. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint64_t. */
+#include <stdlib.h>        /* getenv, mkstemp. */
+#include <string.h>        /* memcpy, memset, strerror, strlen. */
+#include <sys/types.h>     /* off_t, ssize_t. */
+#include <sys/uio.h>       /* struct iovec. */
+#include <unistd.h>        /* close, pread, read, unlink. */
+#if defined(HAVE_SYS_MMAN_H)
+#  include <sys/mman.h>    /* memfd_create, MFD_CLOEXEC. */
+#endif
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+#  include <sys/sendfile.h> /* sendfile. */
+#  define TRYCMD_HAVE_SENDFILE 1
+#endif
+
+/** The size of the buffer used when data must be copied. */
+#define TRYCMD_SPOOL_BUFFER_SIZE (16 * 1024)
+
+/**
+ * Create an unlinked temporary file within $TMPDIR (or /tmp).
+ * @return A descriptor for the file, or -1 on failure.
+ */
+static int trycmd_spool_tmpfile(void) {
+    const char* dir = getenv("TMPDIR");
+    int fd;
+
+    if (dir == NULL || dir[0] == '\0') {
+        dir = "/tmp";
+    }
+#if defined(O_TMPFILE)
+    /* Prefer a file which never had a name. */
+    fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        return fd;
+    }
+#endif
+    {
+        static const char base[] = "/try_spool_XXXXXX";
+        char path[strlen(dir) + sizeof(base)];
+        memcpy(path, dir, strlen(dir));
+        memcpy(&path[strlen(dir)], base, sizeof(base));
+        fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    return fd;
+}
+
+int trycmd_sendfile_all(const int out_fd,
+                        const int in_fd,
+                        off_t offset,
+                        uint64_t len) {
+    char buffer[TRYCMD_SPOOL_BUFFER_SIZE];
+
+#if defined(TRYCMD_HAVE_SENDFILE)
+    /* Within the kernel, where possible. */
+    while (len > 0) {
+        const ssize_t sent = sendfile(out_fd, in_fd, &offset, (size_t)len);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent <= 0) {
+            break;
+        }
+        len -= (uint64_t)sent;
+    }
+    if (len == 0) {
+        return 0;
+    } else if (errno != EINVAL && errno != ENOSYS) {
+        return -1;
+    }
+#endif
+
+    /* Otherwise, through a buffer. */
+    while (len > 0) {
+        const ssize_t nread = pread(in_fd, buffer,
+                                    (len < sizeof(buffer))
+                                    ? (size_t)len : sizeof(buffer),
+                                    offset);
+        if (nread < 0 && errno == EINTR) {
+            continue;
+        } else if (nread <= 0) {
+            return -1;
+        } else if (trycmd_write_all(out_fd, buffer, (size_t)nread) != 0) {
+            return -1;
+        }
+        offset += nread;
+        len    -= (uint64_t)nread;
+    }
+    return 0;
+}
+
+/**
+ * Once a spool outgrows its limit, move it from memory to a temporary file.
+ */
+static void trycmd_spool_spill(struct trycmd_spool* const spool) {
+    int fd;
+
+    if (spool->spilled || spool->size <= spool->limit) {
+        return;
+    }
+    fd = trycmd_spool_tmpfile();
+    if (fd < 0 || trycmd_sendfile_all(fd, spool->fd, 0, spool->size) != 0) {
+        /* Keep spooling into memory, rather than lose any output. */
+        trycmd_debug("trycmd_spool_spill: cannot spill: %s\n",
+                     strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    trycmd_debug("trycmd_spool_spill: spilled %lu bytes\n",
+                 (unsigned long)spool->size);
+    close(spool->fd);
+    spool->fd      = fd;
+    spool->spilled = 1;
+}
+
+int trycmd_spool_open(struct trycmd_spool* const spool, const uint64_t limit) {
+    /* Check arguments. */
+    assert("Unexpected NULL spool" && (spool != NULL));
+    memset(spool, 0, sizeof(*spool));
+    spool->limit = limit;
+
+    /* Spool into memory where possible, or directly to a file. */
+#if defined(HAVE_MEMFD_CREATE)
+    spool->fd = memfd_create("try-spool", MFD_CLOEXEC);
+#else
+    spool->fd = -1;
+    errno = ENOSYS;
+#endif
+    if (spool->fd < 0) {
+        trycmd_debug("trycmd_spool_open: no memfd: %s\n", strerror(errno));
+        spool->fd      = trycmd_spool_tmpfile();
+        spool->spilled = 1;
+    }
+    return (spool->fd >= 0) ? 0 : -1;
+}
+
+int trycmd_spool_write(struct trycmd_spool* const spool,
+                       const char* const data,
+                       const size_t len) {
+    struct iovec iov;
+
+    /* Check arguments. */
+    assert("Unexpected NULL data" && (data != NULL || len == 0));
+    iov.iov_base = (char*)data;
+    iov.iov_len  = len;
+    return trycmd_spool_writev(spool, &iov, 1);
+}
+
+int trycmd_spool_writev(struct trycmd_spool* const spool,
+                        struct iovec* const iov,
+                        const int iovcnt) {
+    uint64_t len = 0;
+    int idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL spool" && (spool != NULL));
+    assert("Unexpected NULL iov" && (iov != NULL || iovcnt == 0));
+
+    for (idx = 0; idx < iovcnt; ++idx) {
+        len += iov[idx].iov_len;
+    }
+    if (trycmd_writev_all(spool->fd, iov, iovcnt) != 0) {
+        return -1;
+    }
+    spool->size += len;
+    trycmd_spool_spill(spool);
+    return 0;
+}
+
+ssize_t trycmd_spool_splice(struct trycmd_spool* const spool,
+                            const int pipe_fd,
+                            const size_t len) {
+    char buffer[TRYCMD_SPOOL_BUFFER_SIZE];
+    ssize_t moved;
+
+    /* Check arguments. */
+    assert("Unexpected NULL spool" && (spool != NULL));
+
+    do {
+        moved = splice(pipe_fd, NULL, spool->fd, NULL, len, SPLICE_F_MOVE);
+    } while (moved < 0 && errno == EINTR);
+    if (moved < 0 && errno == EINVAL) {
+        /* Not supported for this file. Copy instead. */
+        do {
+            moved = read(pipe_fd, buffer,
+                         (len < sizeof(buffer)) ? len : sizeof(buffer));
+        } while (moved < 0 && errno == EINTR);
+        if (moved > 0
+            && trycmd_write_all(spool->fd, buffer, (size_t)moved) != 0) {
+            return -1;
+        }
+    }
+    if (moved <= 0) {
+        return -1;
+    }
+    spool->size += (uint64_t)moved;
+    trycmd_spool_spill(spool);
+    return moved;
+}
+
+int trycmd_spool_replay(const struct trycmd_spool* const spool,
+                        const int out_fd) {
+    /* Check arguments. */
+    assert("Unexpected NULL spool" && (spool != NULL));
+    return trycmd_sendfile_all(out_fd, spool->fd, 0, spool->size);
+}
+
+void trycmd_spool_close(struct trycmd_spool* const spool) {
+    /* Check arguments. */
+    assert("Unexpected NULL spool" && (spool != NULL));
+    if (spool->fd >= 0) {
+        close(spool->fd);
+    }
+    spool->fd = -1;
+}
+
+/* EOF */
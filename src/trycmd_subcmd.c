@@ -11,23 +11,18 @@
 #include "trycmd_config.h"
 #include "trycmd.h"
 #include <assert.h>        /* assert. */
+#include <errno.h>         /* errno, ENOENT. */
+#include <signal.h>        /* sigset_t. */
 #include <stddef.h>        /* size_t. */
-#include <stdio.h>         /* snprintf, fprintf, fputs, stderr. */
+#include <stdio.h>         /* fprintf, fputs, stderr. */
 #include <stdlib.h>        /* EXIT_SUCCESS, abort. */
-#include <string.h>        /* strncpy, strnlen. */
+#include <string.h>        /* memcpy, memset, strchr, strerror, strlen. */
+#include <sys/resource.h>  /* struct rusage. */
 #include <sys/types.h>     /* pid_t. */
-#include <sys/wait.h>      /* waitpid. */
+#include <sys/wait.h>      /* WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG. */
+#include <time.h>          /* clock_gettime, CLOCK_REALTIME. */
 #include <linux/limits.h>  /* PATH_MAX. */
-#include <unistd.h>        /* fork, execv. */
-
-/* Check for required defined values. */
-#if !defined(HAVE_FORK)
-#  error Missing required function 'fork'.
-#endif
-
-#if !defined(HAVE_STRNLEN)
-#  error Missing required function 'strnlen'.
-#endif
+#include <unistd.h>        /* getpid, STDERR_FILENO. */
 
 size_t trycmd_make_shell_cmd(const struct trycmd_opts* const opts,
                              void*        buffer,
@@ -41,217 +36,800 @@ size_t trycmd_make_shell_cmd(const struct trycmd_opts* const opts,
      *      (included for command-line safety),
      *   5. for the command to be run followed by the magic shell variable "$@",
      *   6. for a NULL, marking argv's end.
+     * Only the fifth is built within the buffer: all others are referred to
+     * in place, never copied.
      */
-    const char shell_arg0_ext[]        = "\"$@\"";
-    const char shell_opt_interactive[] = "-i";
-    const char shell_opt_command[]     = "-c";
-    const char shell_opts_end[]        = "--";
-    const char eol_marker              = (char)0xff;
+    static char shell_opt_interactive[] = "-i";
+    static char shell_opt_command[]     = "-c";
+    static char shell_opts_end[]        = "--";
+    const char  shell_arg0_ext[]        = " \"$@\"";
 
     const int argc_required      = 5
                                  + !!opts->opt_interactive
                                  + opts->opt_sub_argc;
-    const size_t shell_sz        = strnlen(opts->opt_shell, PATH_MAX) + 1;
-    const size_t shell_arg0_sz   = strnlen(opts->opt_sub_argv[0], PATH_MAX)
-                                 + sizeof(shell_arg0_ext)
-                                 + 1;
+    const size_t sub_arg0_len    = strlen(opts->opt_sub_argv[0]);
+    const size_t shell_arg0_sz   = sub_arg0_len + sizeof(shell_arg0_ext);
     const size_t argc_sz         = sizeof(char*) * argc_required;
-    const size_t min_buflen      = argc_sz
-                                 + shell_sz
-                                 + sizeof(shell_opt_interactive) * !!opts->opt_interactive
-                                 + sizeof(shell_opt_command)
-                                 + sizeof(shell_opts_end)
-                                 + shell_arg0_sz
-                                 + 1;
-    const size_t required_buflen = trycmd_align_sz(min_buflen, sizeof(char*));
+    const size_t required_buflen = argc_sz + shell_arg0_sz + sizeof(char*) - 1;
 
     /* If sufficient buffer space is available... */
     trycmd_debug("trycmd_make_shell_cmd: buflen=%zu required_buflen=%zu\n",
                  buflen, required_buflen);
     if (buflen >= required_buflen) {
-        int idx;
-        int result;
-        char* aligned_buf;
         char** argv_pos;
-        char* buffer_pos;
+        char* shell_arg0;
+        int idx;
 
         /* Check arguments. */
         assert(buffer != NULL);
         assert(argv_out != NULL);
-        assert(min_buflen != 0);
-
-        /* Gain a pointer into the buffer at the first char* aligned boundary. */
-        aligned_buf = trycmd_align_ptr(buffer, sizeof(char*));
-
-        /* Place an EOL marker, to search for after building the command. */
-        aligned_buf[min_buflen - 2] = eol_marker;
-        aligned_buf[min_buflen - 1] = eol_marker;
-        buffer_pos = aligned_buf;
 
-        /* Build the command. */
-        *argv_out   = (char**)buffer_pos;
-        argv_pos    = &(*argv_out)[0];
-        buffer_pos += argc_sz;
-
-        /* Shell. */
-        *argv_pos++ = buffer_pos;
-        strncpy(buffer_pos, opts->opt_shell, shell_sz);
-        buffer_pos += shell_sz;
+        /*
+         * Build the command at the first char* aligned boundary, followed
+         * by the command script.
+         */
+        *argv_out  = trycmd_align_ptr(buffer, sizeof(char*));
+        argv_pos   = &(*argv_out)[0];
+        shell_arg0 = (char*)&(*argv_out)[argc_required];
+        assert("Unexpected buffer overrun" &&
+               (shell_arg0 + shell_arg0_sz <= (char*)buffer + buflen));
 
-        /* Interactive (-i, optional). */
+        /* Shell, then interactive (-i, optional), command (-c) and (--). */
+        *argv_pos++ = opts->opt_shell;
         if (opts->opt_interactive) {
-            *argv_pos++ = buffer_pos;
-            strncpy(buffer_pos, shell_opt_interactive, sizeof(shell_opt_interactive));
-            buffer_pos += sizeof(shell_opt_interactive);
+            *argv_pos++ = shell_opt_interactive;
         }
-
-        /* Command (-c). */
-        *argv_pos++ = buffer_pos;
-        strncpy(buffer_pos, shell_opt_command, sizeof(shell_opt_command));
-        buffer_pos += sizeof(shell_opt_command);
-
-        /* End of options (--). */
-        *argv_pos++ = buffer_pos;
-        strncpy(buffer_pos, shell_opts_end, sizeof(shell_opts_end));
-        buffer_pos += sizeof(shell_opts_end);
+        *argv_pos++ = shell_opt_command;
+        *argv_pos++ = shell_opts_end;
 
         /* Command script. */
-        *argv_pos++ = buffer_pos;
-        result = snprintf(buffer_pos, shell_arg0_sz, "%s %s",
-                          opts->opt_sub_argv[0], shell_arg0_ext);
-        assert("Unexpected result from snprintf" && (result > 0));
-        assert("Unexpected result from snprintf" &&
-               ((size_t)result == shell_arg0_sz - 1));
-        buffer_pos[result] = '\0';
-
-        /* Copy all remaining arguments into the shell's positional list. */
+        *argv_pos++ = shell_arg0;
+        memcpy(shell_arg0, opts->opt_sub_argv[0], sub_arg0_len);
+        memcpy(&shell_arg0[sub_arg0_len], shell_arg0_ext, sizeof(shell_arg0_ext));
+
+        /* Refer to all remaining arguments as the shell's positional list. */
         for (idx = 0; idx < opts->opt_sub_argc; ++idx) {
             *argv_pos++ = opts->opt_sub_argv[idx];
         }
 
         /* End of options. */
         *argv_pos = NULL;
+    }
 
-        /* Check that the EOL marker remained intact. */
-        assert("Unexpected buffer underrun" &&
-               (aligned_buf[min_buflen - 2] == '\0'));
-        assert("Unexpected buffer overrun" &&
-               (aligned_buf[min_buflen - 1] == eol_marker));
+    /* Return the buffer space required or used. */
+    return required_buflen;
+}
+
+size_t trycmd_make_direct_cmd(const struct trycmd_opts* const opts,
+                              void*        buffer,
+                              const size_t buflen,
+                              char**       argv_out[]) {
+    /* Each argument is referred to in place, with one more for a NULL. */
+    const size_t argc_sz         = sizeof(char*) * (opts->opt_sub_argc + 1);
+    const size_t required_buflen = argc_sz + sizeof(char*) - 1;
+
+    /* If sufficient buffer space is available... */
+    trycmd_debug("trycmd_make_direct_cmd: buflen=%zu required_buflen=%zu\n",
+                 buflen, required_buflen);
+    if (buflen >= required_buflen) {
+        char** argv_pos;
+        int idx;
+
+        /* Check arguments. */
+        assert(buffer != NULL);
+        assert(argv_out != NULL);
+
+        /* Build the command at the first char* aligned boundary. */
+        *argv_out = trycmd_align_ptr(buffer, sizeof(char*));
+        argv_pos  = &(*argv_out)[0];
+        for (idx = 0; idx < opts->opt_sub_argc; ++idx) {
+            *argv_pos++ = opts->opt_sub_argv[idx];
+        }
+        *argv_pos = NULL;
     }
 
     /* Return the buffer space required or used. */
     return required_buflen;
 }
 
-int trycmd_run_subcommand(const struct trycmd_opts* const opts) {
-    /* Build the subcommand. */
-    const size_t req_buflen = trycmd_make_shell_cmd(opts, NULL, 0, NULL);
-    int result = 255;
+/**
+ * Select how the given subcommand is to be executed.
+ * If the subcommand may be executed directly, its path is resolved.
+ * @param  opts       Options describing the shell and subcommand.
+ * @param  path_out   Destination for the resolved program path.
+ * @param  path_len   Length of path_out, in bytes.
+ * @param  errno_out  On failure to resolve the program, its errno value.
+ * @return The trycmd_exec mode to be used: never 'auto'.
+ */
+static enum trycmd_exec trycmd_select_exec(const struct trycmd_opts* const opts,
+                                           char* const path_out,
+                                           const size_t path_len,
+                                           int* const errno_out) {
+    const char* const name = opts->opt_sub_argv[0];
+
+    *errno_out = 0;
+    switch (opts->opt_exec) {
+        case trycmd_exec_direct:
+            if (trycmd_find_program(name, path_out, path_len) != 0) {
+                *errno_out = errno;
+            }
+            return trycmd_exec_direct;
+        case trycmd_exec_auto:
+            /*
+             * Only bypass the shell where it would make no difference:
+             * interactive shells may define aliases, and any name which
+             * cannot be found may be a shell function or builtin.
+             */
+            if (!opts->opt_interactive
+                && trycmd_is_plain_command(name)
+                && trycmd_find_program(name, path_out, path_len) == 0) {
+                return trycmd_exec_direct;
+            }
+            return trycmd_exec_shell;
+        case trycmd_exec_shell:
+        default:
+            return trycmd_exec_shell;
+    }
+}
+
+/** A subcommand, resolved and ready to be built. */
+struct trycmd_plan {
+    /** How the subcommand is to be executed. */
+    enum trycmd_exec exec_mode;
+
+    /** The resolved program, if exec_mode is trycmd_exec_direct. */
+    char             direct_path[PATH_MAX];
+
+    /** The buffer length required to build the subcommand. */
+    size_t           buflen;
+
+    /** Storage for the subcommand, of buflen bytes, as it is built. */
+    struct trycmd_arena arena;
+};
+
+/**
+ * Resolve how the given subcommand is to be run, and prepare the storage
+ * it requires (to be released by trycmd_arena_free). If the subcommand
+ * cannot be run, say why on stderr.
+ * @return 0 on success, otherwise the subcommand's exit status.
+ */
+static int trycmd_plan_subcommand(const struct trycmd_opts* const opts,
+                                  struct trycmd_plan* const plan) {
+    int direct_errno;
 
     /* Check arguments. */
-    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected empty subcommand" && (opts->opt_sub_argc > 0));
+
+    /* Choose between the shell and a direct execution. */
+    plan->exec_mode = trycmd_select_exec(opts, plan->direct_path,
+                                         sizeof(plan->direct_path),
+                                         &direct_errno);
+    trycmd_debug("trycmd_plan_subcommand: exec=%s\n",
+                 (plan->exec_mode == trycmd_exec_direct) ? "direct" : "shell");
+    if (direct_errno != 0) {
+        /* The program could not be run. Match Bash's message and status. */
+        const char* const name = opts->opt_sub_argv[0];
+        fprintf(stderr, _("try: %s: %s\n"), name,
+                (direct_errno == ENOENT && strchr(name, '/') == NULL)
+                    ? _("command not found")
+                    : strerror(direct_errno));
+        plan->buflen = 0;
+        return (direct_errno == ENOENT) ? TRYCMD_STATUS_NOT_FOUND
+                                        : TRYCMD_STATUS_NOT_EXECUTABLE;
+    }
+    plan->buflen = (plan->exec_mode == trycmd_exec_direct)
+                 ? trycmd_make_direct_cmd(opts, NULL, 0, NULL)
+                 : trycmd_make_shell_cmd(opts, NULL, 0, NULL);
+    if (trycmd_arena_init(&plan->arena, plan->buflen) != 0) {
+        fprintf(stderr, _("try: %s: %s\n"), opts->opt_sub_argv[0],
+                strerror(errno));
+        return TRYCMD_STATUS_NOT_EXECUTABLE;
+    }
+    return 0;
+}
 
-    if (req_buflen > 0) {
-        pid_t child_pid;
-        pid_t wait_result;
-        char** argv = NULL;
-        char dyn_buffer[req_buflen];
-        const size_t dyn_buflen = trycmd_make_shell_cmd(opts,
-                                                        dyn_buffer,
-                                                        req_buflen,
-                                                        &argv);
-        assert("Unexpected change in req_buflen" && req_buflen == dyn_buflen);
-        assert("Unexpected NULL argv" && (argv != NULL));
-        assert("Unexpected NULL argv[0]" && (argv[0] != NULL));
-        (void) dyn_buflen;
-
-        /* Print the subcommand if requested. */
-        if (opts->opt_verbose || trycmd_debug_enabled) {
-            trycmd_print_argv("try:", argv, stderr);
-        }
+/**
+ * Build a planned subcommand within its arena, printing it if requested.
+ * @return The path of the program to be executed.
+ */
+static const char* trycmd_build_subcommand(const struct trycmd_opts* const opts,
+                                           struct trycmd_plan* const plan,
+                                           char*** const argv_out) {
+    void* const buffer = trycmd_arena_alloc(&plan->arena, plan->buflen);
+    const size_t buflen = (plan->exec_mode == trycmd_exec_direct)
+        ? trycmd_make_direct_cmd(opts, buffer, plan->buflen, argv_out)
+        : trycmd_make_shell_cmd(opts, buffer, plan->buflen, argv_out);
+    assert("Unexpected exhausted arena" && (buffer != NULL));
+    assert("Unexpected change in buflen" && plan->buflen == buflen);
+    assert("Unexpected NULL argv" && (*argv_out != NULL));
+    assert("Unexpected NULL argv[0]" && ((*argv_out)[0] != NULL));
+    (void) buflen;
+
+    /* Print the subcommand if requested. */
+    if (opts->opt_verbose || trycmd_debug_enabled) {
+        trycmd_print_argv("try:", *argv_out, stderr);
+    }
+    return (plan->exec_mode == trycmd_exec_direct) ? plan->direct_path
+                                                   : (*argv_out)[0];
+}
 
-        /* Spawn the subprocess then wait for it to finish. */
-        trycmd_debug("trycmd_run_subcommand: spawning %s\n", argv[0]);
-        if ((child_pid = fork()) == 0) {
-            /* Child process. */
-            execv(argv[0], argv);
-            assert("Unexpected return from execv" && 0);
-            abort();
+/**
+ * Spawn a built subcommand.
+ * @return 0 if the subcommand was started, otherwise its exit status.
+ */
+static int trycmd_spawn_subcommand(const struct trycmd_spawn_attr* const attr,
+                                   const char* const path,
+                                   char* argv[],
+                                   struct trycmd_child* const child_out) {
+    /*
+     * Spawn the subprocess. Once this returns, the child has either
+     * exec'd or failed, so the command buffer is no longer needed.
+     */
+    trycmd_debug("trycmd_spawn_subcommand: spawning %s\n", path);
+    if (trycmd_spawn(attr, path, argv, child_out) != 0) {
+        /* The program could not be run. Match Bash's exit status. */
+        return (errno == ENOENT) ? TRYCMD_STATUS_NOT_FOUND
+                                 : TRYCMD_STATUS_NOT_EXECUTABLE;
+    }
+    return 0;
+}
+
+/** The state of a single subcommand's run, upon an event loop. */
+struct trycmd_run_state {
+    /** The current attempt's monitor (whose pid is -1 between attempts). */
+    struct trycmd_monitor monitor;
+
+    /** The first terminating signal received by try, or 0 if none. */
+    int                   interrupted;
+};
+
+/**
+ * Stop the event loop once a subcommand has finished.
+ */
+static void trycmd_run_finished(struct trycmd_loop* const loop,
+                                struct trycmd_monitor* const monitor) {
+    (void) monitor;
+    trycmd_loop_stop(loop);
+}
+
+/**
+ * Stop the event loop once a delay has passed.
+ */
+static void trycmd_run_delayed(struct trycmd_loop* const loop,
+                               struct trycmd_loop_handler* const handler,
+                               const uint32_t events) {
+    (void) handler;
+    (void) events;
+    trycmd_loop_stop(loop);
+}
+
+/**
+ * Forward each terminating signal received by try to a running subcommand
+ * (which is within a process group of its own). Between attempts, stop.
+ */
+static void trycmd_run_forward(struct trycmd_loop* const loop,
+                               struct trycmd_loop_handler* const handler,
+                               const uint32_t events) {
+    struct trycmd_run_state* const state = handler->data;
+    int signum;
+    (void) events;
+    while ((signum = trycmd_loop_read_signal(handler)) > 0) {
+        if (state->interrupted == 0) {
+            state->interrupted = signum;
+        }
+        if (state->monitor.child.pid > 0) {
+            trycmd_monitor_signal(&state->monitor, signum);
         } else {
-            /* Parent process. */
-            trycmd_debug("trycmd_run_subcommand: waitpid(%d)\n", child_pid);
-            wait_result = waitpid(child_pid, &result, 0);
-            trycmd_debug("trycmd_run_subcommand: child status is %d\n", result);
-            assert("Unexpected result from waitpid" && (wait_result == child_pid));
-            (void) wait_result;
+            trycmd_loop_stop(loop);
         }
+    }
+}
+
+/**
+ * Run a started subcommand to completion, upon the given event loop.
+ * @return The subcommand's exit status.
+ */
+static int trycmd_run_started(struct trycmd_loop* const loop,
+                              struct trycmd_run_state* const state,
+                              const struct trycmd_opts* const opts,
+                              const struct trycmd_child* const child) {
+    if (trycmd_monitor_start(loop, &state->monitor, opts, child,
+                             trycmd_run_finished, state) != 0) {
+        fprintf(stderr, _("try: cannot wait for command: %s\n"),
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (trycmd_loop_run(loop) != 0) {
+        fprintf(stderr, _("try: cannot wait for command: %s\n"),
+                strerror(errno));
+        trycmd_monitor_cancel(loop, &state->monitor);
+        return EXIT_FAILURE;
+    }
+    return state->monitor.exit_status;
+}
+
+/**
+ * Wait for the given delay to pass, upon the given event loop (and so
+ * handling any signals received meanwhile).
+ */
+static void trycmd_run_delay(struct trycmd_loop* const loop,
+                             const unsigned long ms) {
+    struct trycmd_loop_handler timer_handler;
+    memset(&timer_handler, 0, sizeof(timer_handler));
+    if (ms > 0 && trycmd_loop_add_timer(loop, &timer_handler, ms,
+                                        trycmd_run_delayed, NULL) == 0) {
+        trycmd_loop_run(loop);
+        trycmd_loop_remove(loop, &timer_handler);
+    }
+}
 
+/**
+ * Add the resources used by one attempt to those used by all before it.
+ * Counters and times are summed; the maximum resident set size is the
+ * greatest of any.
+ */
+static void trycmd_add_rusage(struct rusage* const total,
+                              const struct rusage* const attempt) {
+    total->ru_utime.tv_sec  += attempt->ru_utime.tv_sec;
+    total->ru_utime.tv_usec += attempt->ru_utime.tv_usec;
+    if (total->ru_utime.tv_usec >= 1000000) {
+        total->ru_utime.tv_usec -= 1000000;
+        ++total->ru_utime.tv_sec;
+    }
+    total->ru_stime.tv_sec  += attempt->ru_stime.tv_sec;
+    total->ru_stime.tv_usec += attempt->ru_stime.tv_usec;
+    if (total->ru_stime.tv_usec >= 1000000) {
+        total->ru_stime.tv_usec -= 1000000;
+        ++total->ru_stime.tv_sec;
+    }
+    if (attempt->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = attempt->ru_maxrss;
+    }
+    total->ru_majflt += attempt->ru_majflt;
+    total->ru_minflt += attempt->ru_minflt;
+    total->ru_nvcsw  += attempt->ru_nvcsw;
+    total->ru_nivcsw += attempt->ru_nivcsw;
+}
+
+int trycmd_start_subcommand(const struct trycmd_opts* const opts,
+                            const struct trycmd_spawn_attr* const attr,
+                            struct trycmd_child* const child_out) {
+    struct trycmd_plan plan;
+    int result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL attr" && (attr != NULL));
+    assert("Unexpected NULL child_out" && (child_out != NULL));
+    child_out->pid   = -1;
+    child_out->pidfd = -1;
+
+    /* Plan, build then spawn the subcommand. */
+    result = trycmd_plan_subcommand(opts, &plan);
+    if (result == 0) {
+        char** argv = NULL;
+        const char* const path = trycmd_build_subcommand(opts, &plan, &argv);
+        result = trycmd_spawn_subcommand(attr, path, argv, child_out);
+        trycmd_arena_free(&plan.arena);
+    }
+    return result;
+}
+
+int trycmd_exit_status(const int wait_status) {
+    /*
+     * Convert the given wait status to a value which can be
+     * returned from main() without modification.
+     */
+    if (WIFEXITED(wait_status)) {
+        /* Exited normally (via exit(n)). */
+        return WEXITSTATUS(wait_status);
+    } else if (WIFSIGNALED(wait_status)) {
         /*
-         * Child ends and parent process continues.
-         * Convert the result to a value which can be
-         * returned from main() without modification.
+         * Exited due to a signal. Use K+n where K is a constant and
+         * n is the signal value, to match the behaviour of Bash.
          */
-        if (WIFEXITED(result)) {
-            /* Exited normally (via exit(n)). */
-            result = WEXITSTATUS(result);
-        } else if (WIFSIGNALED(result)) {
-            /*
-             * Exited due to a signal. Use K+n where K is a constant and
-             * n is the signal value, to match the behaviour of Bash.
-             */
-            result = TRYCMD_SIGNAL_BASE + WTERMSIG(result);
+        return TRYCMD_SIGNAL_BASE + WTERMSIG(wait_status);
+    } else {
+        /* Exited for another reason. Use 255 as a catch-all. */
+        return 255;
+    }
+}
+
+int trycmd_run_subcommand(const struct trycmd_opts* const opts) {
+    struct trycmd_result result;
+    const int exit_status = trycmd_run_subcommand_result(opts, &result);
+    trycmd_ring_free(&result.tail);
+    return exit_status;
+}
+
+int trycmd_run_subcommand_result(const struct trycmd_opts* const opts,
+                                 struct trycmd_result* const result_out) {
+    struct trycmd_spawn_attr spawn_attr;
+    struct trycmd_jobserver jobserver;
+    struct trycmd_loop_handler signal_handler;
+    struct trycmd_cache cache;
+    struct trycmd_run_state state;
+    struct trycmd_relay relay;
+    struct trycmd_spool spool;
+    struct trycmd_perf perf;
+    struct trycmd_loop loop;
+    struct trycmd_plan plan;
+    int have_jobserver;
+    int have_cache = 0;
+    int have_capture = 0;
+    int have_perf = 0;
+    int have_relay = 0;
+    int have_spool = 0;
+    int result;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL result_out" && (result_out != NULL));
+    result_out->attempts    = 1;
+    result_out->elapsed_ns  = 0;
+    result_out->timed_out   = 0;
+    result_out->term_signal = 0;
+    clock_gettime(CLOCK_REALTIME, &result_out->started);
+    result_out->ended       = result_out->started;
+    memset(&result_out->rusage, 0, sizeof(result_out->rusage));
+    memset(&result_out->perf, 0, sizeof(result_out->perf));
+    memset(&result_out->tail, 0, sizeof(result_out->tail));
+    result_out->cached      = 0;
+    result_out->cancelled   = 0;
+
+    /* Replay a cached result, if the subcommand and its inputs are unchanged. */
+    if (opts->opt_cache) {
+        const uint64_t replay_ns = trycmd_clock_ns();
+        have_cache = (trycmd_cache_open(&cache, opts) == 0);
+        if (!have_cache) {
+            trycmd_debug("trycmd_run_subcommand: cannot cache: %s\n",
+                         strerror(errno));
+            trycmd_cache_close(&cache);
+        } else if (trycmd_cache_replay(&cache, result_out) == 0) {
+            trycmd_cache_close(&cache);
+            result_out->elapsed_ns = trycmd_clock_ns() - replay_ns;
+            clock_gettime(CLOCK_REALTIME, &result_out->ended);
+            trycmd_debug("trycmd_run_subcommand: replayed %d from cache\n",
+                         result_out->exit_status);
+            return result_out->exit_status;
         } else {
-            /* Exited for another reason. Use 255 as a catch-all. */
-            result = 255;
+            have_capture = (trycmd_cache_capture(&cache) == 0);
+        }
+    }
+
+    /* Open the event loop, upon which every attempt is supervised. */
+    if (trycmd_loop_open(&loop) != 0) {
+        fprintf(stderr, _("try: cannot wait for command: %s\n"),
+                strerror(errno));
+        result_out->exit_status = EXIT_FAILURE;
+        return EXIT_FAILURE;
+    }
+    memset(&signal_handler, 0, sizeof(signal_handler));
+    memset(&state, 0, sizeof(state));
+    state.monitor.child.pid   = -1;
+    state.monitor.child.pidfd = -1;
+
+    /*
+     * Keep the tail of all output, if it is to be shown upon failure. By
+     * default, allow for lines of up to a few hundred bytes on average.
+     */
+    if (opts->opt_tail_lines > 0 || opts->opt_tail_size > 0) {
+        size_t tail_size = opts->opt_tail_size;
+        if (tail_size == 0) {
+            tail_size = opts->opt_tail_lines * 256;
+            if (tail_size < TRYCMD_TAIL_MIN_SIZE) {
+                tail_size = TRYCMD_TAIL_MIN_SIZE;
+            }
+        }
+        if (trycmd_ring_init(&result_out->tail, tail_size) != 0) {
+            trycmd_debug("trycmd_run_subcommand: cannot keep tail: %s\n",
+                         strerror(errno));
+        }
+    }
+
+    /* Hold back all output until it is known to be wanted, if quiet. */
+    if (opts->opt_quiet > 0) {
+        have_spool = (trycmd_spool_open(&spool, opts->opt_quiet) == 0);
+        if (!have_spool) {
+            trycmd_debug("trycmd_run_subcommand: cannot spool: %s\n",
+                         strerror(errno));
+        }
+    }
+
+    /*
+     * Relay all output through the loop, if it is to be logged, kept, held
+     * back or timestamped.
+     */
+    if (opts->opt_log != NULL || result_out->tail.data != NULL || have_spool
+        || have_capture || opts->opt_timestamps != trycmd_timestamps_none) {
+        if (trycmd_relay_open(&loop, &relay, opts->opt_log,
+                              (result_out->tail.data != NULL)
+                              ? &result_out->tail : NULL,
+                              have_spool ? &spool : NULL) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"),
+                    (opts->opt_log != NULL) ? opts->opt_log : N_("output"),
+                    strerror(errno));
+            trycmd_ring_free(&result_out->tail);
+            if (have_spool) {
+                trycmd_spool_close(&spool);
+            }
+            if (have_cache) {
+                trycmd_cache_close(&cache);
+            }
+            trycmd_loop_close(&loop);
+            result_out->exit_status = EXIT_FAILURE;
+            return EXIT_FAILURE;
+        }
+        relay.timestamps = opts->opt_timestamps;
+        if (have_capture) {
+            relay.streams[0].capture = &cache.output[0];
+            relay.streams[1].capture = &cache.output[1];
+        }
+        have_relay = 1;
+    }
+
+    /*
+     * Pass any jobserver on to the subprocess (which inherits our own
+     * implicit slot), or create one if requested.
+     */
+    have_jobserver = (trycmd_jobserver_setup(&jobserver, opts) == 0);
+
+    /*
+     * Plan and build the subcommand, once for all attempts. A subcommand
+     * which may time out is given its own process group, so that every
+     * process it starts can be stopped with it, and is forwarded those
+     * signals that it would otherwise receive from the terminal. An
+     * interactive shell expects to control the terminal, so is kept within
+     * our own group.
+     */
+    trycmd_spawn_attr_init(&spawn_attr, opts);
+    spawn_attr.new_pgroup = (opts->opt_timeout > 0 && !opts->opt_interactive);
+    spawn_attr.sigmask    = &loop.saved_mask;
+    if (have_relay) {
+        spawn_attr.stdio[1] = relay.streams[0].child_fd;
+        spawn_attr.stdio[2] = relay.streams[1].child_fd;
+    }
+    if (spawn_attr.new_pgroup) {
+        sigset_t signals;
+        trycmd_forwarded_signals(&signals);
+        if (trycmd_loop_add_signals(&loop, &signal_handler, &signals,
+                                    trycmd_run_forward, &state) != 0) {
+            trycmd_debug("trycmd_run_subcommand: cannot forward signals: %s\n",
+                         strerror(errno));
         }
     }
 
+    /* Count the performance of every attempt, if requested. */
+    if (opts->opt_perf) {
+        have_perf = (trycmd_perf_open(&perf) == 0);
+    }
+    result = trycmd_plan_subcommand(opts, &plan);
+    if (result == 0) {
+        char** argv = NULL;
+        const char* const path = trycmd_build_subcommand(opts, &plan, &argv);
+        uint64_t seed = trycmd_clock_ns() ^ (uint64_t)getpid();
+
+        /* Spawn the subprocess then wait for it to finish, retrying. */
+        for (result_out->attempts = 1; ; ++result_out->attempts) {
+            const uint64_t start_ns = trycmd_clock_ns();
+            struct trycmd_child child;
+            unsigned long delay;
+
+            state.monitor.timed_out   = 0;
+            state.monitor.term_signal = 0;
+            memset(&state.monitor.rusage, 0, sizeof(state.monitor.rusage));
+            result = trycmd_spawn_subcommand(&spawn_attr, path, argv, &child);
+            if (result == 0) {
+                result = trycmd_run_started(&loop, &state, opts, &child);
+            }
+            if (have_relay) {
+                trycmd_relay_flush(&relay);
+            }
+            result_out->elapsed_ns += trycmd_clock_ns() - start_ns;
+            result_out->timed_out   = state.monitor.timed_out;
+            result_out->term_signal = state.monitor.term_signal;
+            trycmd_add_rusage(&result_out->rusage, &state.monitor.rusage);
+            if (result == EXIT_SUCCESS
+                || state.interrupted != 0
+                || result_out->attempts > (unsigned int)opts->opt_retry
+                || !trycmd_is_retryable(opts, result)) {
+                break;
+            }
+
+            /* Wait, then try again (unless interrupted meanwhile). */
+            delay = trycmd_retry_delay(opts, result_out->attempts, &seed);
+            fprintf(stderr, _("try: attempt %u of %u failed (status=%d),"
+                              " retrying in %lu.%03lus\n"),
+                    result_out->attempts, (unsigned int)opts->opt_retry + 1,
+                    result, delay / 1000, delay % 1000);
+            trycmd_run_delay(&loop, delay);
+            if (state.interrupted != 0) {
+                break;
+            }
+        }
+        trycmd_arena_free(&plan.arena);
+    }
+    if (have_perf) {
+        trycmd_perf_read(&perf, &result_out->perf);
+        trycmd_perf_close(&perf);
+    }
+    if (have_jobserver) {
+        trycmd_jobserver_close(&jobserver);
+    }
+    if (have_relay) {
+        trycmd_relay_close(&relay);
+    }
+    if (have_spool) {
+        /* Upon failure, replay all output held back. */
+        if (result != EXIT_SUCCESS
+            && trycmd_spool_replay(&spool, STDERR_FILENO) != 0) {
+            trycmd_debug("trycmd_run_subcommand: cannot replay: %s\n",
+                         strerror(errno));
+        }
+        trycmd_spool_close(&spool);
+    }
+    if (have_cache) {
+        /* Keep the result, unless the subcommand was stopped early. */
+        result_out->exit_status = result;
+        if (have_capture && !result_out->timed_out
+            && result_out->term_signal == 0 && state.interrupted == 0
+            && trycmd_cache_store(&cache, result_out) != 0) {
+            trycmd_debug("trycmd_run_subcommand: cannot keep result: %s\n",
+                         strerror(errno));
+        }
+        trycmd_cache_close(&cache);
+    }
+    trycmd_loop_remove(&loop, &signal_handler);
+    trycmd_loop_close(&loop);
+
     /* All done. */
-    trycmd_debug("trycmd_run_subcommand: returning %d\n", result);
+    trycmd_debug("trycmd_run_subcommand: returning %d after %u attempt(s)\n",
+                 result, result_out->attempts);
+    clock_gettime(CLOCK_REALTIME, &result_out->ended);
+    result_out->exit_status = result;
     return result;
 }
 
+/* Make a dividing line to separate results from child messages. */
+static const char divider_line[] = "=========================="
+                                    "=========================="
+                                    "==========================";
+static const char color_green[]  = "\033[1;32m";
+static const char color_red[]    = "\033[1;31m";
+static const char color_none[]   = "\033[0m";
+
 int trycmd_show_exit_status(const struct trycmd_opts* const opts,
                             const int exit_status,
                             FILE* os) {
-    /* Make a dividing line to separate the result from child messages. */
-    const char* const divider_line = N_("=========================="
-                                        "=========================="
-                                        "==========================");
-    const char* const color_green  = N_("\033[1;32m");
-    const char* const color_red    = N_("\033[1;31m");
-    const char* const color_none   = N_("\033[0m");
-    const char* color_off          = N_("");
-    const char* color_on           = N_("");
+    struct trycmd_result result;
+    memset(&result, 0, sizeof(result));
+    result.exit_status = exit_status;
+    result.attempts    = 1;
+    return trycmd_show_result(opts, &result, os);
+}
+
+int trycmd_show_result(const struct trycmd_opts* const opts,
+                       const struct trycmd_result* const result,
+                       FILE* os) {
+    const int exit_status = result->exit_status;
+    const unsigned long elapsed_ms =  /* Rounded, so as not to show 0. */
+        (unsigned long)((result->elapsed_ns + 500000) / 1000000);
+    const char* color_off = N_("");
+    const char* color_on  = N_("");
+    struct trycmd_obuf obuf;
+    FILE* out;
 
     /* Check arguments. */
     assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL result" && (result != NULL));
     assert("Unexpected NULL os" && (os != NULL));
 
     /* Enable colored output on request. */
     if (trycmd_is_color_enabled(opts->opt_color, os)) {
         color_off = color_none;
-        color_on  = (exit_status == EXIT_SUCCESS)
-                  ? /* success  */ color_green
-                  : /* failiure */ color_red;
+        color_on  = result->cancelled           ? /* cancelled */ color_none
+                  : (exit_status == EXIT_SUCCESS) ? /* success   */ color_green
+                  :                                 /* failiure  */ color_red;
     }
 
-    /* Print a prologue. */
-    fprintf(os, N_("%s%s\n"), color_on, divider_line);
+    /* Render the whole message, to be written at once. */
+    out = trycmd_obuf_open(&obuf, os);
 
-    /* Print the status. */
-    if (exit_status == EXIT_SUCCESS) {
-        fputs(_("Success:"), os);
+    /* Print a prologue. */
+    fprintf(out, N_("%s%s\n"), color_on, divider_line);
+
+    /* Print the status, with the attempts made if retrying. */
+    if (result->cancelled) {
+        fprintf(out, _("Cancelled (status=%d):"), exit_status);
+    } else if (opts->opt_retry <= 0) {
+        if (exit_status == EXIT_SUCCESS) {
+            fputs(_("Success:"), out);
+        } else if (result->timed_out) {
+            fprintf(out, _("Timed out (status=%d, limit=%lu.%03lus):"),
+                     exit_status, opts->opt_timeout / 1000,
+                     opts->opt_timeout % 1000);
+        } else {
+            fprintf(out, _("Failed (status=%d):"), exit_status);
+        }
+    } else if (result->timed_out) {
+        fprintf(out, _("Timed out (status=%d, attempts=%u, time=%lu.%03lus):"),
+                 exit_status, result->attempts,
+                 elapsed_ms / 1000, elapsed_ms % 1000);
+    } else if (exit_status == EXIT_SUCCESS) {
+        fprintf(out, _("Success (attempts=%u, time=%lu.%03lus):"),
+                 result->attempts, elapsed_ms / 1000, elapsed_ms % 1000);
     } else {
-        fprintf(os, _("Failed (status=%d):"), exit_status);
+        fprintf(out, _("Failed (status=%d, attempts=%u, time=%lu.%03lus):"),
+                 exit_status, result->attempts,
+                 elapsed_ms / 1000, elapsed_ms % 1000);
     }
 
     /* Print the command itself. */
-    trycmd_print_argv(color_off, opts->opt_sub_argv, os);
+    trycmd_print_argv(color_off, opts->opt_sub_argv, out);
+
+    /* Print the resources used, if requested. */
+    if (opts->opt_stats) {
+        const struct rusage* const ru = &result->rusage;
+        fprintf(out, _("Stats: wall=%lu.%03lus user=%ld.%03lds sys=%ld.%03lds"
+                       " maxrss=%ldKiB majflt=%ld minflt=%ld"
+                       " nvcsw=%ld nivcsw=%ld\n"),
+                 elapsed_ms / 1000, elapsed_ms % 1000,
+                 (long)ru->ru_utime.tv_sec, (long)ru->ru_utime.tv_usec / 1000,
+                 (long)ru->ru_stime.tv_sec, (long)ru->ru_stime.tv_usec / 1000,
+                 ru->ru_maxrss, ru->ru_majflt, ru->ru_minflt,
+                 ru->ru_nvcsw, ru->ru_nivcsw);
+    }
+    if (opts->opt_perf) {
+        trycmd_print_perf(&result->perf, out);
+    }
+    if (result->cached) {
+        fputs(_("Replayed from cache.\n"), out);
+    }
+
+    /* Upon failure, print the tail of the subcommand's output (if kept). */
+    if (exit_status != EXIT_SUCCESS && !result->cancelled
+        && result->tail.total > 0) {
+        fprintf(out, N_("%s%s%s\n"), color_on, _("Output tail:"), color_off);
+        trycmd_ring_print(&result->tail, opts->opt_tail_lines, out);
+    }
 
     /* Print an epilogue. */
-    fprintf(os, N_("%s%s%s\n"), color_on, divider_line, color_off);
+    fprintf(out, N_("%s%s%s\n"), color_on, divider_line, color_off);
+    trycmd_obuf_flush(&obuf);
     return exit_status;
 }
 
+void trycmd_show_batch_status(const struct trycmd_opts* const opts,
+                              const unsigned long succeeded,
+                              const unsigned long failed,
+                              const unsigned long skipped,
+                              FILE* os) {
+    const char* color_off = N_("");
+    const char* color_on  = N_("");
+    struct trycmd_obuf obuf;
+    FILE* out;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected NULL os" && (os != NULL));
+
+    /* Enable colored output on request. */
+    if (trycmd_is_color_enabled(opts->opt_color, os)) {
+        color_off = color_none;
+        color_on  = (failed == 0 && skipped == 0)
+                  ? /* success  */ color_green
+                  : /* failiure */ color_red;
+    }
+
+    /* Render the whole summary, to be written at once. */
+    out = trycmd_obuf_open(&obuf, os);
+
+    /* Print the summary between dividers, as for a single subcommand. */
+    fprintf(out, N_("%s%s\n"), color_on, divider_line);
+    fprintf(out, _("Batch: %lu succeeded, %lu failed, %lu skipped.%s\n"),
+             succeeded, failed, skipped, color_off);
+    fprintf(out, N_("%s%s%s\n"), color_on, divider_line, color_off);
+    trycmd_obuf_flush(&obuf);
+}
+
 /* EOF */
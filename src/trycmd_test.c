@@ -11,12 +11,24 @@
 #include "trycmd_config.h"
 #include "trycmd.h"
 #include <assert.h>  /* assert. */
+#include <errno.h>   /* errno, ENOENT. */
 #include <limits.h>  /* INT_MAX. */
-#include <signal.h>  /* raise, SIGABRT, SIGSEGV. */
-#include <stdlib.h>  /* abort, setenv, unsetenv, EXIT_FAILURE, EXIT_SUCCESS. */
-#include <stdio.h>   /* fmemopen, printf, puts. */
-#include <string.h>  /* strcmp. */
-#include <unistd.h>  /* isatty, close, dup, dup2, fsync, read,
+#include <locale.h>  /* setlocale, LC_ALL. */
+#include <linux/limits.h>  /* PATH_MAX. */
+#include <signal.h>  /* raise, sigaddset, sigemptyset, signal, SIGABRT,
+                        SIGSEGV, SIGTERM, SIGUSR1, SIG_IGN. */
+#include <stdlib.h>  /* abort, free, malloc, mkdtemp, mkstemp, setenv, system,
+                        unsetenv,
+                        EXIT_FAILURE, EXIT_SUCCESS. */
+#include <stdio.h>   /* fdopen, fmemopen, fprintf, open_memstream, printf, puts. */
+#include <string.h>  /* memset, strchr, strcmp, strncmp, strstr. */
+#include <fcntl.h>   /* fcntl, open, F_*, FD_CLOEXEC, O_*. */
+#include <stdint.h>  /* UINT64_C. */
+#include <sys/stat.h>  /* chmod, mkdir, mkfifo. */
+#include <sys/wait.h>  /* waitpid, WIFEXITED, WEXITSTATUS. */
+#include <time.h>    /* nanosleep, struct timespec. */
+#include <unistd.h>  /* access, isatty, close, dup, dup2, fsync, getpgid, pause, pipe,
+                        pipe2, read, truncate, unlink, write,
                         STDOUT_FILENO, STDERR_FILENO. */
 
 /* Standard testing apparatus. */
@@ -47,24 +59,74 @@
 #define TEST_EQUAL_S(X, Y) do {                                           \
     const char* const x_result = (X);                                     \
     const char* const y_result = (Y);                                     \
-    if (x_result != y_result) {                                           \
-        if (x_result == NULL || y_result == NULL ||                       \
-            strcmp(x_result, y_result) != 0) {                            \
-            printf("Expected %s == %s at line %d (\"%s\" != \"%s\")\n",   \
-                   "" #X "", "" #Y "", __LINE__,                          \
-                   x_result, y_result);                                   \
-            return 1;                                                     \
-        }                                                                 \
+    if (!trycmd_test_equal_s(x_result, y_result)) {                       \
+        printf("Expected %s == %s at line %d (\"%s\" != \"%s\")\n",       \
+               "" #X "", "" #Y "", __LINE__,                              \
+               trycmd_test_show_s(x_result),                              \
+               trycmd_test_show_s(y_result));                             \
+        return 1;                                                         \
     }                                                                     \
 } while (0)
 
+/**
+ * Compare two strings, either of which may be NULL (equal only to NULL).
+ */
+static int trycmd_test_equal_s(const char* const x, const char* const y) {
+    if (x == NULL || y == NULL) {
+        return x == y;
+    }
+    return strcmp(x, y) == 0;
+}
+
+/**
+ * Show a string which may be NULL, as printf would show it.
+ */
+static const char* trycmd_test_show_s(const char* const s) {
+    return (s != NULL) ? s : "(null)";
+}
+
 /* Test function declarations. */
 static int      test_trycmd_make_shell_cmd(void);
+static int      test_trycmd_make_direct_cmd(void);
+static int      test_trycmd_arena(void);
 static int      test_trycmd_run_subcommand(void);
+static int      test_trycmd_run_subcommand_result(void);
+static int      test_trycmd_run_batch(void);
+static int      test_trycmd_run_watch(void);
+static int      test_trycmd_loop(void);
+static int      test_trycmd_relay(void);
+static int      test_trycmd_ring(void);
+static int      test_trycmd_obuf(void);
+static int      test_trycmd_spool(void);
+static int      test_trycmd_timestamps(void);
+static int      test_trycmd_json(void);
+static int      test_trycmd_history(void);
+static int      test_trycmd_cache(void);
+static int      test_trycmd_daemon(void);
+static int      test_trycmd_spawn(void);
+static int      test_trycmd_parse_spawn(void);
 static int      test_trycmd_show_exit_status(void);
+static int      test_trycmd_show_result(void);
 static int      test_trycmd_print_usage(void);
 static int      test_trycmd_read_options(void);
 static int      test_trycmd_parse_when(void);
+static int      test_trycmd_parse_exec(void);
+static int      test_trycmd_parse_jobs(void);
+static int      test_trycmd_parse_size(void);
+static int      test_trycmd_parse_backoff(void);
+static int      test_trycmd_parse_timestamps(void);
+static int      test_trycmd_parse_retry_on(void);
+static int      test_trycmd_is_retryable(void);
+static int      test_trycmd_retry_delay(void);
+static int      test_trycmd_is_plain_command(void);
+static int      test_trycmd_find_program(void);
+static int      test_trycmd_pathcache(void);
+static int      test_trycmd_jobserver(void);
+static int      test_trycmd_perf(void);
+static int      test_trycmd_intl(void);
+static int      test_trycmd_hash64(void);
+static int      test_trycmd_xxh64(void);
+static int      test_trycmd_parse_duration(void);
 static int      test_trycmd_align_sz(void);
 static int      test_trycmd_align_ptr(void);
 static int      test_trycmd_getenv_s(void);
@@ -88,11 +150,46 @@ struct test_func {
 
 static const struct test_func all_tests[] = {
     { "trycmd_make_shell_cmd",   &test_trycmd_make_shell_cmd   },
+    { "trycmd_make_direct_cmd",  &test_trycmd_make_direct_cmd  },
+    { "trycmd_arena",            &test_trycmd_arena            },
     { "trycmd_run_subcommand",   &test_trycmd_run_subcommand   },
+    { "trycmd_run_subcommand_result", &test_trycmd_run_subcommand_result },
+    { "trycmd_run_batch",        &test_trycmd_run_batch        },
+    { "trycmd_run_watch",        &test_trycmd_run_watch        },
+    { "trycmd_loop",             &test_trycmd_loop             },
+    { "trycmd_relay",            &test_trycmd_relay            },
+    { "trycmd_ring",             &test_trycmd_ring             },
+    { "trycmd_obuf",             &test_trycmd_obuf             },
+    { "trycmd_spool",            &test_trycmd_spool            },
+    { "trycmd_timestamps",       &test_trycmd_timestamps       },
+    { "trycmd_json",             &test_trycmd_json             },
+    { "trycmd_history",          &test_trycmd_history          },
+    { "trycmd_cache",            &test_trycmd_cache            },
+    { "trycmd_daemon",           &test_trycmd_daemon           },
+    { "trycmd_spawn",            &test_trycmd_spawn            },
+    { "trycmd_parse_spawn",      &test_trycmd_parse_spawn      },
     { "trycmd_show_exit_status", &test_trycmd_show_exit_status },
+    { "trycmd_show_result",      &test_trycmd_show_result      },
     { "trycmd_print_usage",      &test_trycmd_print_usage      },
     { "trycmd_read_options",     &test_trycmd_read_options     },
     { "trycmd_parse_when",       &test_trycmd_parse_when       },
+    { "trycmd_parse_exec",       &test_trycmd_parse_exec       },
+    { "trycmd_parse_jobs",       &test_trycmd_parse_jobs       },
+    { "trycmd_parse_size",       &test_trycmd_parse_size       },
+    { "trycmd_parse_backoff",    &test_trycmd_parse_backoff    },
+    { "trycmd_parse_timestamps", &test_trycmd_parse_timestamps },
+    { "trycmd_parse_retry_on",   &test_trycmd_parse_retry_on   },
+    { "trycmd_is_retryable",     &test_trycmd_is_retryable     },
+    { "trycmd_retry_delay",      &test_trycmd_retry_delay      },
+    { "trycmd_is_plain_command", &test_trycmd_is_plain_command },
+    { "trycmd_find_program",     &test_trycmd_find_program     },
+    { "trycmd_pathcache",        &test_trycmd_pathcache        },
+    { "trycmd_jobserver",        &test_trycmd_jobserver        },
+    { "trycmd_perf",             &test_trycmd_perf             },
+    { "trycmd_intl",             &test_trycmd_intl             },
+    { "trycmd_hash64",           &test_trycmd_hash64           },
+    { "trycmd_xxh64",            &test_trycmd_xxh64            },
+    { "trycmd_parse_duration",   &test_trycmd_parse_duration   },
     { "trycmd_align_sz",         &test_trycmd_align_sz         },
     { "trycmd_align_ptr",        &test_trycmd_align_ptr        },
     { "trycmd_getenv_s",         &test_trycmd_getenv_s         },
@@ -130,6 +227,13 @@ static void trycmd_initialize_tests(int argc, char* argv[]) {
     /* Reset environment options to an expected, initial state. */
     unsetenv("TRY_INTERACTIVE");
     unsetenv("TRY_COLOR");
+    unsetenv("TRY_SPAWN");
+    unsetenv("TRY_EXEC");
+    unsetenv("TRY_HISTORY");
+    unsetenv("TRY_DAEMON");
+    unsetenv("TRY_PATH_CACHE");
+    unsetenv("XDG_RUNTIME_DIR");
+    unsetenv("MAKEFLAGS");
     unsetenv("SHELL");
     unsetenv("TESTKEY_1");
     unsetenv("TESTKEY_2");
@@ -142,6 +246,10 @@ static void trycmd_initialize_tests(int argc, char* argv[]) {
 static void trycmd_capture_begin(void) {
     int out_pipe[2] = { -1, -1 };
 
+    /* Write anything pending, such as a test's name, before redirecting. */
+    fflush(stdout);
+    fflush(stderr);
+
     /*
      * Create and install a pipe as a new
      * destination for both stdout and stderr.
@@ -215,9 +323,7 @@ int test_trycmd_make_shell_cmd(void) {
     opts.opt_sub_argv = argv_true;
     opts.opt_shell = "/bin/dummy_shell";
     opts.opt_interactive = 0;
-    sz = trycmd_align_sz(6 * sizeof(char*) +
-        sizeof("/bin/dummy_shell -c -- true \"$@\" "),
-        sizeof(char*));
+    sz = 6 * sizeof(char*) + sizeof("true \"$@\"") + sizeof(char*) - 1;
     assert("Buffer too small" && sz < sizeof(buffer));
     memset(buffer, 0xef, sizeof(buffer));
     TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, buffer, 0, &argv), sz);
@@ -225,22 +331,23 @@ int test_trycmd_make_shell_cmd(void) {
     TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, buffer, sz - 1, &argv), sz);
     TEST_EQUAL_I(buffer[0], 0xef);
 
-    TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, buffer, sz, &argv), sz);
+    /* Only the command script is copied; all else is referred to in place. */
+    TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, &buffer[1], sz, &argv), sz);
     TEST_EQUAL_S(argv[0], "/bin/dummy_shell");
+    TEST_EQUAL_P(argv[0], opts.opt_shell);
     TEST_EQUAL_S(argv[1], "-c");
     TEST_EQUAL_S(argv[2], "--");
     TEST_EQUAL_S(argv[3], "true \"$@\"");
     TEST_EQUAL_S(argv[4], "true");
+    TEST_EQUAL_P(argv[4], argv_true[0]);
     TEST_EQUAL_S(argv[5], NULL);
-    TEST_EQUAL_I(buffer[sz], 0xef);
+    TEST_EQUAL_I(buffer[sz + 1], 0xef);
 
     opts.opt_sub_argc = 1;
     opts.opt_sub_argv = argv_true;
     opts.opt_shell = "/bin/dummy_shell";
     opts.opt_interactive = 1;
-    sz = trycmd_align_sz(7 * sizeof(char*) +
-        sizeof("/bin/dummy_shell -i -c -- true \"$@\" "),
-        sizeof(char*));
+    sz = 7 * sizeof(char*) + sizeof("true \"$@\"") + sizeof(char*) - 1;
     assert("Buffer too small" && sz < sizeof(buffer));
     memset(buffer, 0xef, sizeof(buffer));
     TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, buffer, sizeof(buffer), &argv), sz);
@@ -257,9 +364,7 @@ int test_trycmd_make_shell_cmd(void) {
     opts.opt_sub_argv = argv_echo;
     opts.opt_shell = "/bin/dummy_shell";
     opts.opt_interactive = 0;
-    sz = trycmd_align_sz(11 * sizeof(char*) +
-         sizeof("/bin/dummy_shell -c -- echo \"$@\" "), /* 29 */
-         sizeof(char*));
+    sz = 11 * sizeof(char*) + sizeof("echo \"$@\"") + sizeof(char*) - 1;
     assert("Buffer too small" && sz < sizeof(buffer));
     memset(buffer, 0xef, sizeof(buffer));
     TEST_EQUAL_I(trycmd_make_shell_cmd(&opts, buffer, sizeof(buffer), &argv), sz);
@@ -278,16 +383,1249 @@ int test_trycmd_make_shell_cmd(void) {
     return 0;
 }
 
+int test_trycmd_make_direct_cmd(void) {
+    char* argv_echo[] = { "echo", "hello", "test", NULL };
+    struct trycmd_opts opts = { 0 };
+    unsigned char buffer[256];
+    char** argv = NULL;
+    size_t sz;
+
+    opts.opt_sub_argc = 3;
+    opts.opt_sub_argv = argv_echo;
+    opts.opt_shell = "/bin/dummy_shell";
+    sz = 4 * sizeof(char*) + sizeof(char*) - 1;
+    assert("Buffer too small" && sz < sizeof(buffer));
+    memset(buffer, 0xef, sizeof(buffer));
+    TEST_EQUAL_I(trycmd_make_direct_cmd(&opts, buffer, 0, &argv), sz);
+    TEST_EQUAL_I(buffer[0], 0xef);
+    TEST_EQUAL_I(trycmd_make_direct_cmd(&opts, buffer, sz - 1, &argv), sz);
+    TEST_EQUAL_I(buffer[0], 0xef);
+
+    /* Arguments are referred to in place, never copied. */
+    TEST_EQUAL_I(trycmd_make_direct_cmd(&opts, &buffer[1], sz, &argv), sz);
+    TEST_EQUAL_P(argv[0], argv_echo[0]);
+    TEST_EQUAL_P(argv[1], argv_echo[1]);
+    TEST_EQUAL_P(argv[2], argv_echo[2]);
+    TEST_EQUAL_P(argv[3], NULL);
+    TEST_EQUAL_I(buffer[sz + 1], 0xef);
+    return 0;
+}
+
+int test_trycmd_arena(void) {
+    const size_t chunk = 64 * 1024;
+    struct trycmd_arena arena;
+    struct trycmd_opts opts = { 0 };
+    char** argv;
+    char** envp;
+    char* strings;
+    size_t arg_max = (size_t)sysconf(_SC_ARG_MAX);
+    size_t argc;
+    size_t size = 0;
+    size_t idx;
+
+    /* Small arenas are held locally, larger are mapped. */
+    TEST_EQUAL_I(trycmd_arena_init(&arena, 16), 0);
+    TEST_EQUAL_P(arena.base, arena.local.bytes);
+    TEST_EQUAL_I(trycmd_arena_alloc(&arena, 1) == arena.base, 1);
+    TEST_EQUAL_I(trycmd_arena_alloc(&arena, 1) == arena.base + sizeof(char*), 1);
+    TEST_EQUAL_P(trycmd_arena_alloc(&arena, TRYCMD_ARENA_LOCAL_SIZE), NULL);
+    trycmd_arena_free(&arena);
+    TEST_EQUAL_I(trycmd_arena_init(&arena, TRYCMD_ARENA_LOCAL_SIZE + 1), 0);
+    TEST_EQUAL_I(arena.mapped, 1);
+    TEST_EQUAL_I(trycmd_arena_alloc(&arena, TRYCMD_ARENA_LOCAL_SIZE + 1) != NULL, 1);
+    TEST_EQUAL_P(trycmd_arena_alloc(&arena, 1), NULL);
+    trycmd_arena_free(&arena);
+    TEST_EQUAL_P(arena.base, NULL);
+
+    /*
+     * Run a command filling the kernel's limit upon the size of all of its
+     * arguments and environment, less a pointer to each (as of Linux
+     * 2.6.23, a quarter of the stack limit, to at most 6 MiB). Each of its
+     * arguments (no more than 128 KiB, as the kernel allows) is referred to
+     * in place, save the script, which is of much more than PATH_MAX.
+     */
+    if (arg_max > 6 * 1024 * 1024) {
+        arg_max = 6 * 1024 * 1024;
+    }
+    for (envp = environ; *envp != NULL; ++envp) {
+        size += strlen(*envp) + 1 + sizeof(char*);
+    }
+    size += 2 * sizeof(DEF_SHELL_PATH) + sizeof("-c") + sizeof("--")
+          + 4 * sizeof(char*)           /* shell, options and script. */
+          + chunk + sizeof(" \"$@\"") - 1 /* script. */
+          + 64;                         /* slack. */
+    for (argc = 0; size + chunk + sizeof(char*) <= arg_max; ++argc) {
+        size += chunk + sizeof(char*);
+    }
+    argv    = malloc((argc + 5) * sizeof(char*));
+    strings = malloc((argc + 4) * chunk);
+    TEST_EQUAL_I(argv != NULL && strings != NULL, 1);
+    memset(strings, '_', (argc + 4) * chunk);
+    memcpy(strings, "true #", 6);
+    for (idx = 0; idx < argc + 4; ++idx) {
+        argv[idx] = &strings[idx * chunk];
+        argv[idx][chunk - 1] = '\0';
+    }
+    argv[argc][(arg_max - size > sizeof(char*))
+               ? arg_max - size - sizeof(char*) - 1 : 0] = '\0';
+    argv[argc + 1] = NULL;
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_sub_argc = (int)argc + 1;
+    opts.opt_sub_argv = argv;
+    TEST_EQUAL_I(trycmd_run_subcommand(&opts), 0);
+
+    /* Beyond that limit (by one argument, net), it cannot be run. */
+    argv[0] = "true";
+    argv[argc + 1] = &strings[(argc + 1) * chunk];
+    argv[argc + 2] = &strings[(argc + 2) * chunk];
+    argv[argc + 3] = &strings[(argc + 3) * chunk];
+    argv[argc + 4] = NULL;
+    opts.opt_sub_argc = (int)argc + 4;
+    TEST_EQUAL_I(trycmd_run_subcommand(&opts), TRYCMD_STATUS_NOT_EXECUTABLE);
+    free(argv);
+    free(strings);
+    return 0;
+}
+
 int test_trycmd_run_subcommand(void) {
     char* argv_true[]  = { trycmd_test_progname, "T", NULL };
     char* argv_false[] = { trycmd_test_progname, "F", NULL };
+    char* argv_echo[]  = { "echo", "a\\nb", NULL };
+    char shell_buffer[64] = { 0 };
+    char auto_buffer[64] = { 0 };
     struct trycmd_opts opts = { 0 };
 
+    const enum trycmd_spawn backends[] = {
+        trycmd_spawn_auto,
+        trycmd_spawn_fork,
+        trycmd_spawn_vfork,
+        trycmd_spawn_posix_spawn,
+        trycmd_spawn_clone3,
+    };
+    size_t idx;
+
     opts.opt_shell = DEF_SHELL_PATH;
     opts.opt_sub_argc = ARGV_LEN(argv_true);
     assert(ARGV_LEN(argv_true) == ARGV_LEN(argv_false));
+    for (idx = 0; idx < sizeof(backends) / sizeof(backends[0]); ++idx) {
+        opts.opt_spawn = backends[idx];
+        TEST_EQUAL_I((opts.opt_sub_argv = argv_true, trycmd_run_subcommand(&opts)), 0);
+        TEST_EQUAL_I((opts.opt_sub_argv = argv_false, trycmd_run_subcommand(&opts)), 1);
+    }
+
+    /* Direct and automatic execution, bypassing the shell. */
+    opts.opt_spawn = trycmd_spawn_auto;
+    opts.opt_exec = trycmd_exec_direct;
+    TEST_EQUAL_I((opts.opt_sub_argv = argv_true, trycmd_run_subcommand(&opts)), 0);
+    TEST_EQUAL_I((opts.opt_sub_argv = argv_false, trycmd_run_subcommand(&opts)), 1);
+    opts.opt_exec = trycmd_exec_auto;
     TEST_EQUAL_I((opts.opt_sub_argv = argv_true, trycmd_run_subcommand(&opts)), 0);
     TEST_EQUAL_I((opts.opt_sub_argv = argv_false, trycmd_run_subcommand(&opts)), 1);
+
+    /* A builtin is always run by the shell, as its program may differ. */
+    opts.opt_sub_argv = argv_echo;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand(&opts), 0);
+    trycmd_capture_end(auto_buffer, sizeof(auto_buffer));
+    opts.opt_exec = trycmd_exec_shell;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand(&opts), 0);
+    trycmd_capture_end(shell_buffer, sizeof(shell_buffer));
+    TEST_EQUAL_S(auto_buffer, shell_buffer);
+
+    /* A shell which does not exist. */
+    opts.opt_shell = "/XX_this_should_not_exist_XX";
+    TEST_EQUAL_I((opts.opt_sub_argv = argv_true, trycmd_run_subcommand(&opts)), 127);
+    return 0;
+}
+
+int test_trycmd_run_subcommand_result(void) {
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char script[48], command[80];
+    char* argv_true[]   = { trycmd_test_progname, "T", NULL };
+    char* argv_false[]  = { trycmd_test_progname, "F", NULL };
+    char* argv_script[] = { script, NULL };
+    char* argv_hang[]   = { trycmd_test_progname, "H", NULL };
+    char* argv_ignore[] = { trycmd_test_progname, "I", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result;
+    char buffer[512] = { 0 };
+    FILE* fout;
+
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_sub_argc = ARGV_LEN(argv_true);
+
+    /* A single attempt, by default. */
+    opts.opt_sub_argv = argv_false;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 1);
+    TEST_EQUAL_I(result.exit_status, 1);
+    TEST_EQUAL_I(result.attempts, 1);
+    TEST_EQUAL_I(result.elapsed_ns > 0, 1);
+    TEST_EQUAL_I(result.rusage.ru_maxrss > 0, 1);
+    TEST_EQUAL_I(result.rusage.ru_minflt > 0, 1);
+
+    /* Success needs no retry; failure is retried until none remain. */
+    opts.opt_retry = 2;
+    opts.opt_sub_argv = argv_true;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 0);
+    TEST_EQUAL_I(result.attempts, 1);
+    opts.opt_sub_argv = argv_false;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 1);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.attempts, 3);
+    TEST_EQUAL_I(strstr(buffer, "try: attempt 1 of 3 failed (status=1), retrying in 0.000s\n") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "try: attempt 2 of 3 failed (status=1), retrying in 0.000s\n") != NULL, 1);
+
+    /* Only those statuses requested are retried. */
+    assert(trycmd_parse_retry_on("2-255", opts.opt_retry_on) == 0);
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 1);
+    TEST_EQUAL_I(result.attempts, 1);
+    memset(opts.opt_retry_on, 0, sizeof(opts.opt_retry_on));
+
+    /* A command which fails once, then succeeds, with a 10ms delay. */
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(script, sizeof(script), "%s/flaky", tmpdir);
+    fout = fopen(script, "w");
+    assert(fout != NULL);
+    fprintf(fout, "#!/bin/sh\n[ -e \"$0.ok\" ] && exit 0\ntouch \"$0.ok\"\nexit 3\n");
+    fclose(fout);
+    assert(chmod(script, 0700) == 0);
+    opts.opt_sub_argc = ARGV_LEN(argv_script);
+    opts.opt_sub_argv = argv_script;
+    opts.opt_retry_delay = 10;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.attempts, 2);
+    TEST_EQUAL_S(buffer, "try: attempt 1 of 3 failed (status=3), retrying in 0.010s\n");
+
+    /* A command which hangs, stopped upon its timeout (then retried). */
+    opts.opt_sub_argc = ARGV_LEN(argv_hang);
+    opts.opt_sub_argv = argv_hang;
+    opts.opt_retry = 0;
+    opts.opt_timeout = 50;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(result.timed_out, 1);
+    TEST_EQUAL_I(result.attempts, 1);
+    TEST_EQUAL_I(result.elapsed_ns >= UINT64_C(50000000), 1);
+    opts.opt_retry = 1;
+    opts.opt_retry_delay = 0;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), TRYCMD_STATUS_TIMED_OUT);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.attempts, 2);
+    TEST_EQUAL_I(strstr(buffer, "try: attempt 1 of 2 failed (status=124)") != NULL, 1);
+
+    /* A command which ignores SIGTERM, killed after a further delay. */
+    opts.opt_sub_argv = argv_ignore;
+    opts.opt_retry = 0;
+    opts.opt_kill_after = 50;
+    opts.opt_exec = trycmd_exec_direct;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(result.timed_out, 1);
+    TEST_EQUAL_I(result.elapsed_ns >= UINT64_C(100000000), 1);
+
+    /* As above, within a shell which exits upon SIGTERM (killing the rest). */
+    opts.opt_exec = trycmd_exec_shell;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(result.timed_out, 1);
+
+    /* A command which completes within its timeout. */
+    opts.opt_sub_argv = argv_true;
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 0);
+    TEST_EQUAL_I(result.timed_out, 0);
+
+    /* Clean up (skipped on test failure). */
+    snprintf(command, sizeof(command), "rm -rf '%s'", tmpdir);
+    return system(command);
+}
+
+/** Read up to sz - 1 bytes of the given file, as a string. */
+static void trycmd_test_read_file(const char* const path,
+                                  char* const buffer,
+                                  const size_t sz) {
+    const int fd = open(path, O_RDONLY);
+    ssize_t readlen = -1;
+    if (fd >= 0) {
+        readlen = read(fd, buffer, sz - 1);
+        close(fd);
+    }
+    buffer[(readlen > 0) ? readlen : 0] = '\0';
+}
+
+int test_trycmd_run_batch(void) {
+    char batch[] = "/tmp/try_test_XXXXXX";
+    char log[] = "/tmp/try_test_XXXXXX";
+    char* argv_none[] = { "try", "--batch=/XX_this_should_not_exist_XX", NULL };
+    char* argv_both[] = { "try", "--batch=-", "true", NULL };
+    char expected[1024];
+    char buffer[1024] = { 0 };
+    struct trycmd_opts opts = { 0 };
+    const char* const divider = "=============================="
+                                "=============================="
+                                "==================";
+    FILE* fout;
+    int result;
+
+    /* Prepare a batch of three commands, among blanks and comments. */
+    fout = fdopen(mkstemp(batch), "w");
+    assert(fout != NULL);
+    fprintf(fout, "# A comment.\n\n%s T\n  %s F\n%s T\n",
+            trycmd_test_progname, trycmd_test_progname, trycmd_test_progname);
+    fclose(fout);
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_batch = batch;
+    opts.opt_jobs = 1;
+
+    /* Sequentially, every command is run and its result shown in order. */
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, 1);
+    snprintf(expected, sizeof(expected),
+             "try_test: Returning 0\n%s\nSuccess: %s T\n%s\n"
+             "try_test: Returning 1\n%s\nFailed (status=1): %s F\n%s\n"
+             "try_test: Returning 0\n%s\nSuccess: %s T\n%s\n"
+             "%s\nBatch: 2 succeeded, 1 failed, 0 skipped.\n%s\n",
+             divider, trycmd_test_progname, divider,
+             divider, trycmd_test_progname, divider,
+             divider, trycmd_test_progname, divider,
+             divider, divider);
+    TEST_EQUAL_S(buffer, expected);
+
+    /* Failing fast skips all commands after the first failure. */
+    opts.opt_fail_fast = 1;
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, 1);
+    TEST_EQUAL_I(strstr(buffer, "Batch: 1 succeeded, 1 failed, 1 skipped.\n") != NULL, 1);
+    opts.opt_fail_fast = 0;
+
+    /* In parallel, the same results are found (in any order). */
+    opts.opt_jobs = 3;
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, 1);
+    TEST_EQUAL_I(strstr(buffer, "Batch: 2 succeeded, 1 failed, 0 skipped.\n") != NULL, 1);
+
+    /* With a jobserver of our own, the same results are found. */
+    opts.opt_jobserver = 1;
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, 1);
+    TEST_EQUAL_I(strstr(buffer, "Batch: 2 succeeded, 1 failed, 0 skipped.\n") != NULL, 1);
+    TEST_EQUAL_P(getenv("MAKEFLAGS"), NULL);
+    opts.opt_jobserver = 0;
+
+    /* Commands which run for too long are timed out, alongside others. */
+    fout = fopen(batch, "w");
+    assert(fout != NULL);
+    fprintf(fout, "%s H\n%s T\n", trycmd_test_progname, trycmd_test_progname);
+    fclose(fout);
+    opts.opt_timeout = 20;
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(strstr(buffer, "Timed out (status=124, limit=0.020s): ") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "Batch: 1 succeeded, 1 failed, 0 skipped.\n") != NULL, 1);
+    opts.opt_timeout = 0;
+
+    /* A logged batch records every command's output and result. */
+    fout = fopen(batch, "w");
+    assert(fout != NULL);
+    fprintf(fout, "%s T\n", trycmd_test_progname);
+    fclose(fout);
+    close(mkstemp(log));
+    opts.opt_log = log;
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    opts.opt_log = NULL;
+    TEST_EQUAL_I(result, 0);
+    trycmd_test_read_file(log, buffer, sizeof(buffer));
+    unlink(log);
+    TEST_EQUAL_I(strstr(buffer, "try_test: Returning 0\n") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "\nSuccess: ") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "\nBatch: 1 succeeded, 0 failed, 0 skipped.\n") != NULL, 1);
+
+    /* A line which cannot be parsed counts as a failure. */
+    fout = fopen(batch, "w");
+    assert(fout != NULL);
+    fprintf(fout, "%s T 'unterminated\n%s X\n", trycmd_test_progname, trycmd_test_progname);
+    fclose(fout);
+    trycmd_capture_begin();
+    result = trycmd_run_batch(&opts);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, EXIT_FAILURE);
+    TEST_EQUAL_I(strstr(buffer, "Batch: 0 succeeded, 2 failed, 0 skipped.\n") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, ":1: cannot parse command: ") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "Failed (status=129): ") != NULL, 1);
+
+    /* A batch which cannot be read, or is given alongside a command. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_none), argv_none), EXIT_FAILURE);
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_both), argv_both), EXIT_FAILURE);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    return unlink(batch);
+}
+
+/* Create an empty, executable file. */
+static int trycmd_test_touch_program(const char* const path) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0700);
+    return (fd >= 0) ? close(fd) : -1;
+}
+
+/**
+ * Wait (for up to 5s) until the given file holds at least the given number
+ * of lines, then return the number it holds.
+ */
+static int trycmd_test_await_lines(const char* const path, const int lines) {
+    const struct timespec delay = { 0, 10 * 1000 * 1000 };
+    char buffer[256];
+    int count = 0;
+    int idx;
+    for (idx = 0; idx < 500; ++idx) {
+        const char* line;
+        trycmd_test_read_file(path, buffer, sizeof(buffer));
+        for (count = 0, line = buffer; (line = strchr(line, '\n')) != NULL;
+             ++line) {
+            ++count;
+        }
+        if (count >= lines) {
+            break;
+        }
+        nanosleep(&delay, NULL);
+    }
+    return count;
+}
+
+int test_trycmd_run_watch(void) {
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char src[32], runs[32], json[64], log[32], path[64], script[128];
+    char command[PATH_MAX];
+    char* argv_paths[] = { "try", "--watch", "a", "b", "--debounce=1s", "--", "c", NULL };
+    char* argv_path[]  = { "try", "--watch", "a", "b", "c", NULL };
+    char* argv_bad[]   = { "try", "--watch=a", "--debounce=soon", "c", NULL };
+    char* argv_watch[] = { "try", "--debounce=50ms", json, "--watch", src, "--", script, NULL };
+    char* argv_kill[]  = { "try", "--debounce=50ms", "--kill-after=100ms", "--watch", src, "--",
+                           script, NULL };
+    const struct timespec settle = { 0, 300 * 1000 * 1000 };
+    struct trycmd_opts opts;
+    const char* stopped;
+    int status = -1;
+    pid_t pid;
+    int idx;
+
+    /* Every PATH before "--" is watched, else only that given. */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(argv_paths), argv_paths, &opts), 0);
+    TEST_EQUAL_I(opts.opt_watch_len, 2);
+    TEST_EQUAL_S(opts.opt_watch[0], "a");
+    TEST_EQUAL_S(opts.opt_watch[1], "b");
+    TEST_EQUAL_I(opts.opt_debounce, 1000);
+    TEST_EQUAL_I(opts.opt_sub_argc, 1);
+    TEST_EQUAL_S(opts.opt_sub_argv[0], "c");
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(argv_path), argv_path, &opts), 0);
+    TEST_EQUAL_I(opts.opt_watch_len, 1);
+    TEST_EQUAL_I(opts.opt_debounce, TRYCMD_WATCH_DEBOUNCE);
+    TEST_EQUAL_I(opts.opt_sub_argc, 2);
+    TEST_EQUAL_S(opts.opt_sub_argv[0], "b");
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(argv_bad), argv_bad, &opts), -1);
+
+    /* Watch a directory with a command which logs each run, then waits. */
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(src, sizeof(src), "%s/src", tmpdir);
+    snprintf(runs, sizeof(runs), "%s/runs", tmpdir);
+    snprintf(json, sizeof(json), "--json-out=%s/json", tmpdir);
+    snprintf(log, sizeof(log), "%s/log", tmpdir);
+    snprintf(script, sizeof(script), "echo run >> '%s'; sleep 60", runs);
+    TEST_EQUAL_I(mkdir(src, 0700), 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(argv_watch), argv_watch, &opts), 0);
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        const int null_fd = open("/dev/null", O_WRONLY);
+        const int log_fd  = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        _exit(trycmd_run_watch(&opts));
+    }
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 1), 1);
+
+    /* A directory added stops the run, and is itself watched thereafter. */
+    snprintf(path, sizeof(path), "%s/sub", src);
+    TEST_EQUAL_I(mkdir(path, 0700), 0);
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 2), 2);
+    snprintf(path, sizeof(path), "%s/sub/file", src);
+    TEST_EQUAL_I(trycmd_test_touch_program(path), 0);
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 3), 3);
+
+    /* A burst of changes causes a single run; hidden files are ignored. */
+    for (idx = 0; idx < 8; ++idx) {
+        snprintf(path, sizeof(path), "%s/file%d", src, idx);
+        TEST_EQUAL_I(trycmd_test_touch_program(path), 0);
+    }
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 4), 4);
+    snprintf(path, sizeof(path), "%s/.hidden", src);
+    TEST_EQUAL_I(trycmd_test_touch_program(path), 0);
+    nanosleep(&settle, NULL);
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 0), 4);
+
+    /* Once stopped, the status is that of the last run (also stopped). */
+    TEST_EQUAL_I(kill(pid, SIGTERM), 0);
+    TEST_EQUAL_I(waitpid(pid, &status, 0), pid);
+    TEST_EQUAL_I(WIFEXITED(status) ? WEXITSTATUS(status) : -1, 128 + SIGTERM);
+
+    /* Runs cancelled upon a change are shown as such, but not recorded. */
+    trycmd_test_read_file(log, command, sizeof(command));
+    TEST_EQUAL_I(strstr(command, "Cancelled (status=143): ") != NULL, 1);
+    stopped = strstr(command, "Failed (status=143): ");
+    TEST_EQUAL_I(stopped != NULL && strstr(stopped, "Cancelled") == NULL, 1);
+    snprintf(path, sizeof(path), "%s/json", tmpdir);
+    trycmd_test_read_file(path, command, sizeof(command));
+    TEST_EQUAL_I(strncmp(command, "{\"argv\":", 8), 0);
+    TEST_EQUAL_I(strchr(command, '\n') == &command[strlen(command) - 1], 1);
+    TEST_EQUAL_I(strstr(command, "\"status\":143,") != NULL, 1);
+
+    /* A run which ignores SIGTERM is killed, upon a change or once stopped. */
+    TEST_EQUAL_I(unlink(runs), 0);
+    snprintf(script, sizeof(script), "trap '' TERM; echo run >> '%s'; sleep 60", runs);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(argv_kill), argv_kill, &opts), 0);
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        const int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        _exit(trycmd_run_watch(&opts));
+    }
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 1), 1);
+    snprintf(path, sizeof(path), "%s/file", src);
+    TEST_EQUAL_I(trycmd_test_touch_program(path), 0);
+    TEST_EQUAL_I(trycmd_test_await_lines(runs, 2), 2);
+    TEST_EQUAL_I(kill(pid, SIGTERM), 0);
+    TEST_EQUAL_I(waitpid(pid, &status, 0), pid);
+    TEST_EQUAL_I(WIFEXITED(status) ? WEXITSTATUS(status) : -1, 128 + SIGKILL);
+
+    /* Clean up (skipped on test failure). */
+    snprintf(command, sizeof(command), "rm -rf '%s'", tmpdir);
+    return system(command);
+}
+
+/** Count each event upon a handler, then remove it (once done). */
+static void trycmd_test_loop_event(struct trycmd_loop* const loop,
+                                   struct trycmd_loop_handler* const handler,
+                                   const uint32_t events) {
+    int* const count = handler->data;
+    (void) events;
+    ++*count;
+    if (handler->kind == trycmd_loop_signals) {
+        while (trycmd_loop_read_signal(handler) > 0) {
+            /* Drained. */
+        }
+    }
+    trycmd_loop_remove(loop, handler);
+}
+
+/** Record a monitored child's completion. */
+static void trycmd_test_loop_finished(struct trycmd_loop* const loop,
+                                      struct trycmd_monitor* const monitor) {
+    int* const count = monitor->data;
+    (void) loop;
+    ++*count;
+}
+
+int test_trycmd_loop(void) {
+    char* argv_true[] = { trycmd_test_progname, "T", NULL };
+    char* argv_hang[] = { trycmd_test_progname, "H", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_spawn_attr attr;
+    struct trycmd_child child;
+    struct trycmd_loop loop;
+    struct trycmd_loop_handler timer;
+    struct trycmd_loop_handler signals;
+    struct trycmd_monitor monitor;
+    sigset_t usr1;
+    char buffer[256];
+    int timer_count = 0;
+    int signal_count = 0;
+    int finished = 0;
+
+    /* An empty loop returns immediately. */
+    TEST_EQUAL_I(trycmd_loop_open(&loop), 0);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+
+    /* A timer fires once, and a signal is received without being raised. */
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    TEST_EQUAL_I(trycmd_loop_add_timer(&loop, &timer, 10,
+                                       trycmd_test_loop_event,
+                                       &timer_count), 0);
+    TEST_EQUAL_I(trycmd_loop_add_signals(&loop, &signals, &usr1,
+                                         trycmd_test_loop_event,
+                                         &signal_count), 0);
+    TEST_EQUAL_I(raise(SIGUSR1), 0);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+    TEST_EQUAL_I(timer_count, 1);
+    TEST_EQUAL_I(signal_count, 1);
+    TEST_EQUAL_I(timer.kind, trycmd_loop_none);
+    TEST_EQUAL_I(signals.kind, trycmd_loop_none);
+
+    /* A disarmed (then removed) timer never fires. */
+    TEST_EQUAL_I(trycmd_loop_add_timer(&loop, &timer, 10,
+                                       trycmd_test_loop_event,
+                                       &timer_count), 0);
+    TEST_EQUAL_I(trycmd_loop_set_timer(&timer, 0), 0);
+    trycmd_loop_remove(&loop, &timer);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+    TEST_EQUAL_I(timer_count, 1);
+
+    /* A monitored child's exit status is mapped as by trycmd_exit_status. */
+    trycmd_spawn_attr_init(&attr, NULL);
+    attr.sigmask = &loop.saved_mask;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_spawn(&attr, argv_true[0], argv_true, &child), 0);
+    TEST_EQUAL_I(trycmd_monitor_start(&loop, &monitor, &opts, &child,
+                                      trycmd_test_loop_finished,
+                                      &finished), 0);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(finished, 1);
+    TEST_EQUAL_I(monitor.exit_status, EXIT_SUCCESS);
+    TEST_EQUAL_I(monitor.timed_out, 0);
+    TEST_EQUAL_I(monitor.child.pid, -1);
+
+    /* A monitored child which outlives its timeout is terminated. */
+    opts.opt_timeout = 20;
+    attr.new_pgroup  = 1;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_spawn(&attr, argv_hang[0], argv_hang, &child), 0);
+    TEST_EQUAL_I(trycmd_monitor_start(&loop, &monitor, &opts, &child,
+                                      trycmd_test_loop_finished,
+                                      &finished), 0);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(finished, 2);
+    TEST_EQUAL_I(monitor.exit_status, TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(monitor.timed_out, 1);
+    TEST_EQUAL_I(monitor.signalled, SIGTERM);
+
+    /* A cancelled child is killed without being reported. */
+    TEST_EQUAL_I(trycmd_spawn(&attr, argv_hang[0], argv_hang, &child), 0);
+    TEST_EQUAL_I(trycmd_monitor_start(&loop, &monitor, &opts, &child,
+                                      trycmd_test_loop_finished,
+                                      &finished), 0);
+    trycmd_monitor_cancel(&loop, &monitor);
+    TEST_EQUAL_I(monitor.child.pid, -1);
+    TEST_EQUAL_I(trycmd_loop_run(&loop), 0);
+    TEST_EQUAL_I(finished, 2);
+    trycmd_loop_close(&loop);
+    return 0;
+}
+
+int test_trycmd_relay(void) {
+    char log[] = "/tmp/try_test_XXXXXX";
+    char out[] = "/tmp/try_test_XXXXXX";
+    char* argv_true[] = { trycmd_test_progname, "T", NULL };
+    char* argv_log[] = { "try", "--log", log, trycmd_test_progname, "F", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result;
+    char buffer[512] = { 0 };
+    int saved_stdout;
+    int saved_stderr;
+    int out_fd;
+
+    close(mkstemp(log));
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_sub_argc = ARGV_LEN(argv_true);
+    opts.opt_sub_argv = argv_true;
+    opts.opt_log = log;
+
+    /* Into a pipe, output is relayed (with tee) and logged. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try_test: Returning 0\n");
+    trycmd_test_read_file(log, buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try_test: Returning 0\n");
+
+    /* Into a file, output is relayed (by copying) and logged afresh. */
+    out_fd = mkstemp(out);
+    assert(out_fd >= 0);
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    saved_stderr = dup(STDERR_FILENO);
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(out_fd, STDERR_FILENO);
+    result.exit_status = trycmd_run_subcommand_result(&opts, &result);
+    dup2(saved_stdout, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stdout);
+    close(saved_stderr);
+    close(out_fd);
+    TEST_EQUAL_I(result.exit_status, 0);
+    trycmd_test_read_file(out, buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try_test: Returning 0\n");
+    trycmd_test_read_file(log, buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try_test: Returning 0\n");
+
+    /* The result message is also logged, after all output. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_log), argv_log), 1);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    trycmd_test_read_file(log, buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "try_test: Returning 1\n=====", 27), 0);
+    TEST_EQUAL_I(strstr(buffer, "\nFailed (status=1): ") != NULL, 1);
+
+    /* A log which cannot be created is a failure to run. */
+    opts.opt_log = "/XX_this_should_not_exist_XX/log";
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), EXIT_FAILURE);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strstr(buffer, "XX_this_should_not_exist_XX/log: ") != NULL, 1);
+    unlink(out);
+    return unlink(log);
+}
+
+int test_trycmd_ring(void) {
+    char* argv_tail[] = { "try", "--tail=1", trycmd_test_progname, "F", NULL };
+    char* argv_true[] = { "try", "--tail", trycmd_test_progname, "T", NULL };
+    struct trycmd_ring ring;
+    char buffer[1024] = { 0 };
+    FILE* os;
+
+    /* Once full, only the last bytes written are kept. */
+    TEST_EQUAL_I(trycmd_ring_init(&ring, 16), 0);
+    trycmd_ring_write(&ring, "one\ntwo\nthree", 13);
+    os = fmemopen(buffer, sizeof(buffer), "w");
+    trycmd_ring_print(&ring, 2, os);
+    fclose(os);
+    TEST_EQUAL_S(buffer, "two\nthree\n");
+    trycmd_ring_write(&ring, "\nfour\nfive\n", 11);
+    TEST_EQUAL_I(ring.total, 24);
+    os = fmemopen(buffer, sizeof(buffer), "w");
+    trycmd_ring_print(&ring, 2, os);
+    fclose(os);
+    TEST_EQUAL_S(buffer, "four\nfive\n");
+
+    /* A line partly overwritten is never shown. */
+    os = fmemopen(buffer, sizeof(buffer), "w");
+    trycmd_ring_print(&ring, 0, os);
+    fclose(os);
+    TEST_EQUAL_S(buffer, "four\nfive\n");
+    trycmd_ring_write(&ring, "0123456789abcdefXYZ", 19);
+    os = fmemopen(buffer, sizeof(buffer), "w");
+    trycmd_ring_print(&ring, 5, os);
+    fclose(os);
+    TEST_EQUAL_S(buffer, "3456789abcdefXYZ\n");
+    trycmd_ring_free(&ring);
+    TEST_EQUAL_P(ring.data, NULL);
+
+    /* Upon failure, the tail is shown again within the result. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_tail), argv_tail), 1);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strstr(buffer, "\nOutput tail:\ntry_test: Returning 1\n=====")
+                 != NULL, 1);
+
+    /* Upon success, it is not. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_true), argv_true), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strstr(buffer, "Output tail:") == NULL, 1);
+    return 0;
+}
+
+int test_trycmd_obuf(void) {
+    struct trycmd_obuf obuf;
+    char buffer[256] = { 0 };
+    char* argv[] = { "echo", "it's", "done", NULL };
+    int fds[2];
+    FILE* os;
+    FILE* out;
+
+    /* A message to a descriptor is held back until flushed... */
+    TEST_EQUAL_I(pipe2(fds, O_NONBLOCK), 0);
+    os = fdopen(fds[1], "w");
+    TEST_EQUAL_I(os != NULL, 1);
+    setvbuf(os, NULL, _IONBF, 0);
+    out = trycmd_obuf_open(&obuf, os);
+    TEST_EQUAL_I(out != os, 1);
+    fputs("try:", out);
+    trycmd_print_argv("", argv, out);
+    TEST_EQUAL_I(read(fds[0], buffer, sizeof(buffer)), -1);
+    TEST_EQUAL_I(errno, EAGAIN);
+
+    /* ...then written whole, after anything already pending. */
+    TEST_EQUAL_I(trycmd_obuf_flush(&obuf), 0);
+    TEST_EQUAL_I(read(fds[0], buffer, sizeof(buffer)), 25);
+    TEST_EQUAL_S(buffer, "try: echo 'it'\\''s' done\n");
+    fclose(os);
+    close(fds[0]);
+
+    /* A stream without a descriptor is rendered into directly. */
+    memset(buffer, 0, sizeof(buffer));
+    os = fmemopen(buffer, sizeof(buffer), "w");
+    TEST_EQUAL_P(trycmd_obuf_open(&obuf, os), os);
+    trycmd_pretty_print_arg("a b", os);
+    TEST_EQUAL_I(trycmd_obuf_flush(&obuf), 0);
+    fclose(os);
+    TEST_EQUAL_S(buffer, "'a b'");
+    return 0;
+}
+
+int test_trycmd_spool(void) {
+    char* argv_false[] = { "try", "--quiet", trycmd_test_progname, "F", NULL };
+    char* argv_true[] = { "try", "-q", trycmd_test_progname, "T", NULL };
+    struct trycmd_spool spool;
+    char buffer[1024] = { 0 };
+    int fds[2];
+
+    /* Output is spooled into memory, then spilled beyond its limit. */
+    TEST_EQUAL_I(trycmd_spool_open(&spool, 8), 0);
+    TEST_EQUAL_I(trycmd_spool_write(&spool, "one\n", 4), 0);
+    TEST_EQUAL_I(spool.size, 4);
+    TEST_EQUAL_I(pipe(fds), 0);
+    TEST_EQUAL_I(write(fds[1], "two\nthree\n", 10), 10);
+    TEST_EQUAL_I(trycmd_spool_splice(&spool, fds[0], 10), 10);
+    TEST_EQUAL_I(spool.size, 14);
+    TEST_EQUAL_I(spool.spilled, 1);
+    TEST_EQUAL_I(trycmd_spool_write(&spool, "four\n", 5), 0);
+
+    /* Everything is replayed, in order. */
+    TEST_EQUAL_I(trycmd_spool_replay(&spool, fds[1]), 0);
+    TEST_EQUAL_I(read(fds[0], buffer, sizeof(buffer) - 1), 19);
+    TEST_EQUAL_S(buffer, "one\ntwo\nthree\nfour\n");
+    trycmd_spool_close(&spool);
+    TEST_EQUAL_I(spool.fd, -1);
+    close(fds[0]);
+    close(fds[1]);
+
+    /* Upon success, only the result is shown. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_true), argv_true), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "=====", 5), 0);
+    TEST_EQUAL_I(strstr(buffer, "try_test:") == NULL, 1);
+
+    /* Upon failure, all output is shown first. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_false), argv_false), 1);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "try_test: Returning 1\n=====", 27), 0);
+    return 0;
+}
+
+int test_trycmd_timestamps(void) {
+    char* argv_partial[] = { "sh", "-c", "printf a; sleep 0.1; printf 'b\\nc\\n'", NULL };
+    char* argv_clock[] = { "try", "--timestamps=absolute", trycmd_test_progname, "T", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result;
+    char buffer[1024] = { 0 };
+
+    /* Each line is prefixed by the time since start, even if read in parts. */
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_sub_argc = ARGV_LEN(argv_partial);
+    opts.opt_sub_argv = argv_partial;
+    opts.opt_timestamps = trycmd_timestamps_relative;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "[    0.0", 8), 0);
+    TEST_EQUAL_I(strncmp(&buffer[10], "] ab\n[    0.", 12), 0);
+    TEST_EQUAL_S(&buffer[25], "] c\n");
+
+    /* Or by the time of day. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_clock), argv_clock), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(buffer[0] == '[' && buffer[3] == ':' && buffer[6] == ':'
+                 && buffer[9] == '.', 1);
+    TEST_EQUAL_I(strncmp(&buffer[13], "] try_test: Returning 0\n", 24), 0);
+
+    return 0;
+}
+
+int test_trycmd_json(void) {
+    char path[] = "/tmp/try_test_XXXXXX";
+    char fd_text[16];
+    char json_out[64];
+    char* argv_file[] = { "try", json_out, "sh", "-c", "exit 1", "it's", NULL };
+    char* argv_fd[] = { "try", "--no-shell", json_out, trycmd_test_progname, "A", NULL };
+    char* argv_bad[] = { "try", "--json-out=/XX_this_should_not_exist_XX/json",
+                         trycmd_test_progname, "T", NULL };
+    char* argv_stdout[] = { "try", "--json-out=1", "sh", "-c", "echo hi", NULL };
+    char* argv_stderr[] = { "try", "--json-out=2", "sh", "-c", "echo x >&2", NULL };
+    char* argv_bytes[] = { "try", json_out, "true", "\xff\x7f", "caf\xc3\xa9",
+                           "\xed\xa0\x80", "\xe2\x82", NULL };
+    char buffer[2048] = { 0 };
+    int fds[2];
+
+    /* A record is appended to a file for each run. */
+    close(mkstemp(path));
+    snprintf(json_out, sizeof(json_out), "--json-out=%s", path);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_file), argv_file), 1);
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_file), argv_file), 1);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    trycmd_test_read_file(path, buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "{\"argv\":[\"sh\",\"-c\",\"exit 1\",\"it's\"],"
+                         "\"command\":\"sh -c 'exit 1' 'it'\\\\''s'\",\"status\":1,"
+                         "\"signal\":null,", 96), 0);
+    TEST_EQUAL_I(strstr(buffer, "\"signal\":null,"
+                                "\"timed_out\":false,\"attempts\":1,\"start\":\"20")
+                 != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "Z\",\"duration_ns\":") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, ",\"rusage\":{\"user_us\":") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "}}\n{\"argv\":") != NULL, 1);
+    TEST_EQUAL_I(strchr(buffer, '\n') != NULL
+                 && strcmp(strchr(buffer, '\n') + 1, "") != 0
+                 && buffer[strlen(buffer) - 1] == '\n', 1);
+
+    /* Or to an inherited descriptor, showing any signal. */
+    TEST_EQUAL_I(pipe(fds), 0);
+    snprintf(fd_text, sizeof(fd_text), "%d", fds[1]);
+    snprintf(json_out, sizeof(json_out), "--json-out=%s", fd_text);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_fd), argv_fd), TRYCMD_SIGNAL_BASE + SIGABRT);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    memset(buffer, 0, sizeof(buffer));
+    TEST_EQUAL_I(read(fds[0], buffer, sizeof(buffer) - 1) > 0, 1);
+    TEST_EQUAL_I(strstr(buffer, "\"status\":134,\"signal\":6,") != NULL, 1);
+    close(fds[0]);
+    close(fds[1]);
+
+    /* Such a descriptor remains open, and is inherited by the command. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_stdout), argv_stdout), 0);
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_stderr), argv_stderr), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "hi\n", 3), 0);
+    TEST_EQUAL_I(strstr(buffer, "\n{\"argv\":[\"sh\",\"-c\",\"echo hi\"],") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "\nx\n") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "{\"argv\":[\"sh\",\"-c\",\"echo x >&2\"],") != NULL, 1);
+
+    /* Bytes which are not valid UTF-8 are replaced, keeping valid JSON. */
+    TEST_EQUAL_I(truncate(path, 0), 0);
+    snprintf(json_out, sizeof(json_out), "--json-out=%s", path);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_bytes), argv_bytes), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    trycmd_test_read_file(path, buffer, sizeof(buffer));
+    TEST_EQUAL_I(strncmp(buffer, "{\"argv\":[\"true\",\"\\ufffd\\u007f\","
+                         "\"caf\xc3\xa9\",\"\\ufffd\\ufffd\\ufffd\","
+                         "\"\\ufffd\\ufffd\"],", 76), 0);
+
+    /* A destination which cannot be opened is a failure to run. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_bad), argv_bad), EXIT_FAILURE);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try: /XX_this_should_not_exist_XX/json: No such file or directory\n");
+    return unlink(path);
+}
+
+int test_trycmd_history(void) {
+    char path[] = "/tmp/try_test_XXXXXX";
+    char* argv_make[] = { "make", "check", NULL };
+    char* argv_long[] = { "a-very-long-program-name", "with-arguments", NULL };
+    char* argv_none[] = { "make", "check", "-k", NULL };
+    char* argv_run[] = { "try", trycmd_test_progname, "T", NULL };
+    char* argv_query[] = { "try", "--history", trycmd_test_progname, "T", NULL };
+    char* argv_all[] = { "try", "--history", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result = { 0 };
+    char buffer[1024] = { 0 };
+    char expected[256];
+    FILE* fout;
+    int idx;
+
+    /* Record ten runs of one command, with one failure, and one of another. */
+    close(mkstemp(path));
+    for (idx = 0; idx < 10; ++idx) {
+        opts.opt_sub_argv = argv_make;
+        result.exit_status = (idx == 3) ? 2 : 0;
+        result.elapsed_ns = (uint64_t)(10 - idx) * UINT64_C(100000000);
+        TEST_EQUAL_I(trycmd_history_append(path, &opts, &result), 0);
+        if (idx == 4) {
+            opts.opt_sub_argv = argv_long;
+            result.exit_status = 0;
+            result.elapsed_ns = UINT64_C(5000000);
+            TEST_EQUAL_I(trycmd_history_append(path, &opts, &result), 0);
+        }
+    }
+
+    /* Every command is summarized, in order of first run. */
+    fout = fmemopen(buffer, sizeof(buffer), "w");
+    TEST_EQUAL_I(trycmd_history_report(path, NULL, fout), 0);
+    fclose(fout);
+    TEST_EQUAL_S(buffer,
+        "History (runs=10, failed=10.0%, p50=0.500s, p90=0.900s, p99=1.000s): make check\n"
+        "History (runs=1, failed=0.0%, p50=0.005s, p90=0.005s, p99=0.005s): a-very-long-program-nam\n");
+
+    /* Or only a given command, which need not have been run. */
+    fout = fmemopen(buffer, sizeof(buffer), "w");
+    TEST_EQUAL_I(trycmd_history_report(path, argv_make, fout), 0);
+    TEST_EQUAL_I(trycmd_history_report(path, argv_none, fout), 0);
+    fclose(fout);
+    TEST_EQUAL_S(buffer,
+        "History (runs=10, failed=10.0%, p50=0.500s, p90=0.900s, p99=1.000s): make check\n"
+        "History (runs=0): make check -k\n");
+
+    /* Each run of try is recorded, given TRY_HISTORY, and may be queried. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_query), argv_query), EXIT_FAILURE);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_S(buffer, "try: no history file (see TRY_HISTORY)\n");
+    setenv("TRY_HISTORY", path, 1);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_run), argv_run), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_query), argv_query), 0);
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_all), argv_all), 0);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    snprintf(expected, sizeof(expected), "): %s T\n", trycmd_test_progname);
+    TEST_EQUAL_I(strstr(buffer, "History (runs=1, failed=0.0%, p50=") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, expected) != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "): make check\n") != NULL, 1);
+    unsetenv("TRY_HISTORY");
+    return unlink(path);
+}
+
+int test_trycmd_cache(void) {
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char cache_dir[48], input[48], command[80];
+    char* argv_cat[] = { "/bin/sh", "-c", "cat \"$0\"; exit 3", input, NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result;
+    char buffer[512] = { 0 };
+    FILE* fout;
+
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(cache_dir, sizeof(cache_dir), "%s/cache", tmpdir);
+    snprintf(input, sizeof(input), "%s/input", tmpdir);
+    fout = fopen(input, "w");
+    assert(fout != NULL);
+    fputs("one\n", fout);
+    fclose(fout);
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_exec = trycmd_exec_direct;
+    opts.opt_sub_argc = ARGV_LEN(argv_cat);
+    opts.opt_sub_argv = argv_cat;
+    opts.opt_cache = 1;
+    opts.opt_cache_dir = cache_dir;
+    opts.opt_cache_size = TRYCMD_CACHE_SIZE;
+    opts.opt_inputs[opts.opt_inputs_len++] = input;
+
+    /* The first run is kept, then replayed while its input is unchanged. */
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 0);
+    TEST_EQUAL_I(strstr(buffer, "one\n") != NULL, 1);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 1);
+    TEST_EQUAL_I(result.exit_status, 3);
+    TEST_EQUAL_I(strstr(buffer, "one\n") != NULL, 1);
+    trycmd_capture_begin();
+    trycmd_show_result(&opts, &result, stdout);
+    fflush(stdout);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(strstr(buffer, "Replayed from cache.\n") != NULL, 1);
+
+    /* A changed input, or environment, is run again. */
+    fout = fopen(input, "w");
+    assert(fout != NULL);
+    fputs("two\n", fout);
+    fclose(fout);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 0);
+    TEST_EQUAL_I(strstr(buffer, "two\n") != NULL, 1);
+    opts.opt_cache_env = "TRY_TEST_CACHE_ENV";
+    setenv("TRY_TEST_CACHE_ENV", "1", 1);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 0);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 1);
+    unsetenv("TRY_TEST_CACHE_ENV");
+
+    /* Results beyond the cache's size are evicted. */
+    opts.opt_cache_size = 1;
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 0);
+    trycmd_capture_begin();
+    TEST_EQUAL_I(trycmd_run_subcommand_result(&opts, &result), 3);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result.cached, 0);
+
+    /* Clean up (skipped on test failure). */
+    snprintf(command, sizeof(command), "rm -rf '%s'", tmpdir);
+    return system(command);
+}
+
+int test_trycmd_daemon(void) {
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char path[48], command[80];
+    char* argv_false[] = { "try", trycmd_test_progname, "F", NULL };
+    const struct timespec delay = { 0, 10000000 };
+    char buffer[512] = { 0 };
+    int result = -1;
+    int status = -1;
+    pid_t pid;
+    int idx;
+
+    /* Without a daemon, nothing is run. */
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(path, sizeof(path), "%s/socket", tmpdir);
+    TEST_EQUAL_I(trycmd_daemon_call(ARGV_LEN(argv_false), argv_false, &result), -1);
+    setenv("TRY_DAEMON", path, 1);
+    TEST_EQUAL_I(trycmd_daemon_call(ARGV_LEN(argv_false), argv_false, &result), -1);
+    TEST_EQUAL_I(result, -1);
+
+    /* Start a daemon, then wait for its socket. */
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        _exit((trycmd_daemon_serve(path, 1) == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    for (idx = 0; idx < 500 && access(path, F_OK) != 0; ++idx) {
+        nanosleep(&delay, NULL);
+    }
+
+    /* Each command is run by a worker, as it would be by trycmd_main. */
+    for (idx = 0; idx < 2; ++idx) {
+        trycmd_capture_begin();
+        TEST_EQUAL_I(trycmd_daemon_call(ARGV_LEN(argv_false), argv_false, &result), 0);
+        trycmd_capture_end(buffer, sizeof(buffer));
+        TEST_EQUAL_I(result, EXIT_FAILURE);
+        TEST_EQUAL_I(strstr(buffer, "Failed (status=1): ") != NULL, 1);
+    }
+
+    /* The daemon removes its socket once stopped. */
+    TEST_EQUAL_I(kill(pid, SIGTERM), 0);
+    TEST_EQUAL_I(waitpid(pid, &status, 0), pid);
+    TEST_EQUAL_I(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS, 1);
+    TEST_EQUAL_I(access(path, F_OK), -1);
+    unsetenv("TRY_DAEMON");
+
+    /* Clean up (skipped on test failure). */
+    snprintf(command, sizeof(command), "rm -rf '%s'", tmpdir);
+    return system(command);
+}
+
+int test_trycmd_spawn(void) {
+    char* argv_true[] = { trycmd_test_progname, "T", NULL };
+    char* argv_none[] = { "XX_this_should_not_exist_XX", NULL };
+    const enum trycmd_spawn backends[] = {
+        trycmd_spawn_auto,
+        trycmd_spawn_fork,
+        trycmd_spawn_vfork,
+        trycmd_spawn_posix_spawn,
+        trycmd_spawn_clone3,
+    };
+    char* argv_echo[] = { "/bin/sh", "-c", "echo hello", NULL };
+    struct trycmd_spawn_attr attr;
+    struct trycmd_child child;
+    char buffer[16];
+    int out_pipe[2];
+    size_t idx;
+    int null_fd;
+    int status;
+
+    trycmd_spawn_attr_init(&attr, NULL);
+    TEST_EQUAL_I(attr.backend, trycmd_spawn_auto);
+    TEST_EQUAL_I(attr.stdio[0], -1);
+    TEST_EQUAL_I(attr.stdio[1], -1);
+    TEST_EQUAL_I(attr.stdio[2], -1);
+    TEST_EQUAL_I(attr.new_pgroup, 0);
+
+    /* Discard the output of each child, as none is captured. */
+    null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    assert(null_fd >= 0);
+    attr.stdio[1] = null_fd;
+    for (idx = 0; idx < sizeof(backends) / sizeof(backends[0]); ++idx) {
+        attr.backend = backends[idx];
+
+        /* A successful spawn yields a child to be reaped. */
+        TEST_EQUAL_I(trycmd_spawn(&attr, argv_true[0], argv_true, &child), 0);
+        TEST_EQUAL_I(child.pid > 0, 1);
+        TEST_EQUAL_I(waitpid(child.pid, &status, 0), child.pid);
+        TEST_EQUAL_I(WIFEXITED(status), 1);
+        TEST_EQUAL_I(WEXITSTATUS(status), 0);
+        if (child.pidfd >= 0) {
+            close(child.pidfd);
+        }
+
+        /* A failure to exec is reported synchronously, by all backends. */
+        errno = 0;
+        TEST_EQUAL_I(trycmd_spawn(&attr, "/XX_this_should_not_exist_XX", argv_none, &child), -1);
+        TEST_EQUAL_I(errno, ENOENT);
+        TEST_EQUAL_I(child.pid, -1);
+        TEST_EQUAL_I(child.pidfd, -1);
+
+        /* Standard streams may be redirected, by all backends. */
+        assert(pipe(out_pipe) == 0);
+        attr.stdio[1] = out_pipe[1];
+        TEST_EQUAL_I(trycmd_spawn(&attr, argv_echo[0], argv_echo, &child), 0);
+        attr.stdio[1] = null_fd;
+        close(out_pipe[1]);
+        TEST_EQUAL_I(waitpid(child.pid, &status, 0), child.pid);
+        memset(buffer, 0, sizeof(buffer));
+        TEST_EQUAL_I(read(out_pipe[0], buffer, sizeof(buffer) - 1), 6);
+        TEST_EQUAL_S(buffer, "hello\n");
+        close(out_pipe[0]);
+        if (child.pidfd >= 0) {
+            close(child.pidfd);
+        }
+
+        /* A new process group may be created, by all backends. */
+        attr.new_pgroup = 1;
+        TEST_EQUAL_I(trycmd_spawn(&attr, argv_true[0], argv_true, &child), 0);
+        attr.new_pgroup = 0;
+        TEST_EQUAL_I(getpgid(child.pid), child.pid);
+        if (child.pidfd < 0) {
+            child.pidfd = trycmd_pidfd_open(child.pid);
+            TEST_EQUAL_I(child.pidfd >= 0 || errno == ENOSYS, 1);
+        }
+        TEST_EQUAL_I(waitpid(child.pid, &status, 0), child.pid);
+        if (child.pidfd >= 0) {
+            close(child.pidfd);
+        }
+    }
+    close(null_fd);
+    return 0;
+}
+
+int test_trycmd_parse_spawn(void) {
+    enum trycmd_spawn ts = trycmd_spawn_auto;
+    TEST_EQUAL_I((trycmd_parse_spawn(NULL, &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_spawn("", &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_spawn("Fork", &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_spawn(" fork", &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_spawn("auto", &ts), ts), trycmd_spawn_auto);
+    TEST_EQUAL_I((trycmd_parse_spawn("fork", &ts), ts), trycmd_spawn_fork);
+    TEST_EQUAL_I((trycmd_parse_spawn("vfork", &ts), ts), trycmd_spawn_vfork);
+    TEST_EQUAL_I((trycmd_parse_spawn("posix_spawn", &ts), ts), trycmd_spawn_posix_spawn);
+    TEST_EQUAL_I((trycmd_parse_spawn("clone3", &ts), ts), trycmd_spawn_clone3);
+    TEST_EQUAL_I((ts = (enum trycmd_spawn)-1, trycmd_parse_spawn("XX_BAD_SPAWN_XX", &ts), ts), -1);
+    TEST_EQUAL_S(trycmd_spawn_name(trycmd_spawn_posix_spawn), "posix_spawn");
+    TEST_EQUAL_S(trycmd_spawn_name(trycmd_spawn_clone3), "clone3");
+    TEST_EQUAL_I(trycmd_resolve_spawn(trycmd_spawn_fork), trycmd_spawn_fork);
+    TEST_EQUAL_I(trycmd_resolve_spawn(trycmd_spawn_auto) != trycmd_spawn_auto, 1);
     return 0;
 }
 
@@ -361,8 +1699,132 @@ int test_trycmd_show_exit_status(void) {
     return 0;
 }
 
+int test_trycmd_show_result(void) {
+    char buffer[2048] = { 0 };
+    char* argv_true[] = { "true", NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_result result = { 0 };
+    FILE* fout;
+    long fpos;
+
+    opts.opt_color = trycmd_color_never;
+    opts.opt_sub_argv = argv_true;
+    result.exit_status = 0;
+    result.attempts = 1;
+    result.elapsed_ns = UINT64_C(1234567890);
+    result.timed_out = 0;
+    memset(&result.rusage, 0, sizeof(result.rusage));
+
+    /* Write results to a memory stream then check its content. */
+    fout = fmemopen(buffer, sizeof(buffer), "w");
+
+    /* Without retries, the result is shown as for its exit status alone. */
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 0);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Success: true\n"
+        "==============================================================================\n");
+
+    /* With retries, the attempts made and their total time are shown. */
+    opts.opt_retry = 3;
+    result.attempts = 2;
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 0);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Success (attempts=2, time=1.235s): true\n"
+        "==============================================================================\n");
+
+    result.exit_status = 137;
+    result.attempts = 4;
+    result.elapsed_ns = UINT64_C(61005000000);
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 137);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Failed (status=137, attempts=4, time=61.005s): true\n"
+        "==============================================================================\n");
+
+    /* A timed out result shows its limit or, with retries, its attempts. */
+    result.exit_status = TRYCMD_STATUS_TIMED_OUT;
+    result.timed_out = 1;
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 124);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Timed out (status=124, attempts=4, time=61.005s): true\n"
+        "==============================================================================\n");
+    opts.opt_retry = 0;
+    opts.opt_timeout = 2500;
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 124);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Timed out (status=124, limit=2.500s): true\n"
+        "==============================================================================\n");
+    opts.opt_timeout = 0;
+
+    /* A cancelled result is shown as such, whatever its status. */
+    result.exit_status = 143;
+    result.timed_out = 0;
+    result.cancelled = 1;
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 143);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Cancelled (status=143): true\n"
+        "==============================================================================\n");
+    result.cancelled = 0;
+
+    /* With stats, the resources used follow the command. */
+    result.exit_status = 0;
+    result.timed_out = 0;
+    result.rusage.ru_utime.tv_sec = 1;
+    result.rusage.ru_utime.tv_usec = 250000;
+    result.rusage.ru_stime.tv_usec = 7999;
+    result.rusage.ru_maxrss = 2048;
+    result.rusage.ru_majflt = 1;
+    result.rusage.ru_minflt = 321;
+    result.rusage.ru_nvcsw = 12;
+    result.rusage.ru_nivcsw = 3;
+    opts.opt_stats = 1;
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 0);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Success: true\n"
+        "Stats: wall=61.005s user=1.250s sys=0.007s maxrss=2048KiB"
+        " majflt=1 minflt=321 nvcsw=12 nivcsw=3\n"
+        "==============================================================================\n");
+
+    /* A run of under a millisecond is shown, rounded, as taking one. */
+    result.elapsed_ns = UINT64_C(860000);
+    memset(&result.rusage, 0, sizeof(result.rusage));
+    fpos = ftell(fout);
+    TEST_EQUAL_I(trycmd_show_result(&opts, &result, fout), 0);
+    fflush(fout);
+    TEST_EQUAL_S(&buffer[fpos],
+        "==============================================================================\n"
+        "Success: true\n"
+        "Stats: wall=0.001s user=0.000s sys=0.000s maxrss=0KiB"
+        " majflt=0 minflt=0 nvcsw=0 nivcsw=0\n"
+        "==============================================================================\n");
+
+    /* Clean up (skipped on test failure). */
+    fclose(fout);
+    return 0;
+}
+
 int test_trycmd_print_usage(void) {
-    char buffer[968] = { 0 };
+    char buffer[4096] = { 0 };
     FILE* fout;
 
     /* Write usage information to a memory stream then check its content. */
@@ -372,6 +1834,8 @@ int test_trycmd_print_usage(void) {
 
     TEST_EQUAL_S(buffer,
         "Usage: try [OPTION]... COMMAND [ARG]...\n"
+        "  or:  try [OPTION]... --batch=FILE\n"
+        "  or:  try [OPTION]... --watch PATH... -- COMMAND [ARG]...\n"
         "Run COMMAND to completion then show its result in a clear and consistent form.\n"
         "Example: try wget www.ietf.org/rfc/rfc2324.txt  # Download an RFC.\n"
         "\n"
@@ -379,6 +1843,43 @@ int test_trycmd_print_usage(void) {
         "  -i, --interactive  Execute the command in an interactive subshell.\n"
         "  --color[=WHEN],    Color the result according to command's exit status.\n"
         "  --colour[=WHEN]    WHEN is 'always' (default if omitted), 'never', or 'auto'.\n"
+        "  --spawn=BACKEND    Spawn with 'auto' (default), 'fork', 'vfork',\n"
+        "                     'posix_spawn', or 'clone3'.\n"
+        "  --exec=MODE        Run via 'shell' (default), 'direct', or 'auto'.\n"
+        "  --no-shell         Run the command directly (same as '--exec=direct').\n"
+        "  -j, --jobs=N       Run up to N batch commands at once (0 for one per CPU).\n"
+        "  --batch=FILE       Run each line of FILE ('-' for stdin) as a command.\n"
+        "  --fail-fast        Start no further batch commands after a failure.\n"
+        "  --jobserver        Share N job slots with any 'make' run (see '--jobs').\n"
+        "  --retry=N          Retry a failed command up to N times.\n"
+        "  --retry-delay=DUR  Wait DUR before the first retry (default 1s).\n"
+        "  --backoff=MODE     Between retries, keep ('none') or double ('exp') DUR.\n"
+        "  --jitter           Randomize each delay, between DUR/2 and DUR.\n"
+        "  --retry-on=LIST    Retry only these statuses (e.g. '1,3-5,SIGKILL').\n"
+        "  --timeout=DUR      Send SIGTERM after DUR, then fail with status 124.\n"
+        "  --kill-after=DUR   Send SIGKILL if still running DUR after SIGTERM.\n"
+        "  --stats            Show the time, memory, faults and switches used.\n"
+        "  --perf             Show the command's performance counters.\n"
+        "  --log=FILE         Also write all output, and the result, to FILE.\n"
+        "  --tail[=N]         On failure, show the last N lines of output again\n"
+        "                     (default 20), or N kibibytes if given as 'NK'.\n"
+        "  -q, --quiet[=MAX]  Show output only on failure, holding up to MAX\n"
+        "                     (default 16M) in memory, then in a temporary file.\n"
+        "  --timestamps[=M]   Prefix each line of output with its time: M is\n"
+        "                     'relative' (default if omitted) or 'absolute'.\n"
+        "  --json-out=DEST    Append a JSON record of each result to DEST, either\n"
+        "                     a file or an inherited file descriptor (e.g. '3').\n"
+        "  --cache[=DIR]      Replay the result and output of an unchanged command\n"
+        "                     from DIR (default ~/.cache/try), or run and keep them.\n"
+        "  --inputs=GLOB      Files upon which a cached result depends (repeatable).\n"
+        "  --cache-env=NAMES  Variables upon which a cached result depends (e.g. 'CC').\n"
+        "  --cache-size=MAX   Evict the least recently used results above MAX (256M).\n"
+        "  --watch=PATH       Run COMMAND again upon each change within PATH,\n"
+        "                     stopping any run in progress (repeatable, or as\n"
+        "                     '--watch PATH... -- COMMAND').\n"
+        "  --debounce=DUR     Wait for changes to settle for DUR (default 100ms).\n"
+        "  --history          Instead of running COMMAND, summarize its past results\n"
+        "                     (or, if none, those of all) from TRY_HISTORY.\n"
         "  -v, --verbose      Verbose output (echos the command being run).\n"
         "  -h, --help         Show this message.\n"
         "  --                 End of options.\n"
@@ -388,6 +1889,10 @@ int test_trycmd_print_usage(void) {
         "Environment:\n"
         "  TRY_INTERACTIVE=1  Always execute commands in an interactive subshell.\n"
         "  TRY_COLOR=WHEN     Add color to the result (see '--color').\n"
+        "  TRY_SPAWN=BACKEND  Select the spawn backend (see '--spawn').\n"
+        "  TRY_EXEC=MODE      Select how to run the command (see '--exec').\n"
+        "  TRY_HISTORY=FILE   Append each result to a history FILE.\n"
+        "  TRY_DAEMON=SOCKET  Have a waiting 'tryd' run the command.\n"
         "  SHELL=/bin/sh      The shell to use when executing the command.\n"
         "\n");
     return 0;
@@ -408,6 +1913,35 @@ int test_trycmd_read_options(void) {
     char* test_argv_color_auto[]        = { "try", "--color=auto", NULL };
     char* test_argv_colour_always[]     = { "try", "--colour=always", NULL };
     char* test_argv_color_invalid[]     = { "try", "--color=XX_BAD_WHEN_XX", NULL };
+    char* test_argv_spawn_vfork[]       = { "try", "--spawn=vfork", NULL };
+    char* test_argv_spawn_invalid[]     = { "try", "--spawn=XX_BAD_SPAWN_XX", NULL };
+    char* test_argv_exec_auto[]         = { "try", "--exec=auto", NULL };
+    char* test_argv_exec_invalid[]      = { "try", "--exec=XX_BAD_EXEC_XX", NULL };
+    char* test_argv_no_shell[]          = { "try", "--no-shell", "test_name", NULL };
+    char* test_argv_batch[]             = { "try", "-j", "4", "--batch=-", "--fail-fast",
+                                            "--jobserver", NULL };
+    char* test_argv_jobs_invalid[]      = { "try", "--jobs=XX_BAD_JOBS_XX", NULL };
+    char* test_argv_retry[]             = { "try", "--retry=3", "--retry-delay=250ms", "--backoff=exp",
+                                            "--jitter", "--retry-on=1,SIGKILL", NULL };
+    char* test_argv_retry_invalid[]     = { "try", "--retry=-1", NULL };
+    char* test_argv_delay_invalid[]     = { "try", "--retry-delay=XX_BAD_DURATION_XX", NULL };
+    char* test_argv_backoff_invalid[]   = { "try", "--backoff=XX_BAD_BACKOFF_XX", NULL };
+    char* test_argv_retry_on_invalid[]  = { "try", "--retry-on=XX_BAD_STATUS_XX", NULL };
+    char* test_argv_timeout[]           = { "try", "--timeout=1.5m", "--kill-after=5", NULL };
+    char* test_argv_timeout_invalid[]   = { "try", "--timeout=XX_BAD_DURATION_XX", NULL };
+    char* test_argv_kill_invalid[]      = { "try", "--kill-after=-1s", NULL };
+    char* test_argv_stats[]             = { "try", "--stats", NULL };
+    char* test_argv_perf[]              = { "try", "--perf", NULL };
+    char* test_argv_tail[]              = { "try", "--tail", NULL };
+    char* test_argv_tail_lines[]        = { "try", "--tail=5", NULL };
+    char* test_argv_tail_size[]         = { "try", "--tail=16K", NULL };
+    char* test_argv_tail_invalid[]      = { "try", "--tail=0", NULL };
+    char* test_argv_quiet[]             = { "try", "-q", NULL };
+    char* test_argv_quiet_size[]        = { "try", "--quiet=4K", NULL };
+    char* test_argv_quiet_invalid[]     = { "try", "--quiet=4X", NULL };
+    char* test_argv_timestamps[]        = { "try", "--timestamps", NULL };
+    char* test_argv_timestamps_mode[]   = { "try", "--timestamps=absolute", NULL };
+    char* test_argv_timestamps_invalid[] = { "try", "--timestamps=XX_BAD_MODE_XX", NULL };
     char* test_argv_compound[]          = { "try", "-ivh", NULL };
     char* test_argv_cmd_single[]        = { "try", "test_name", NULL };
     char* test_argv_cmd_double[]        = { "try", "test_name", "test_arg_1", NULL };
@@ -533,6 +2067,113 @@ int test_trycmd_read_options(void) {
     /* Command with an invalid color request. */
     TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_color_invalid), test_argv_color_invalid, &opts), -1);
 
+    /* Command with a spawn backend, equivalent to "try --spawn=vfork". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_spawn, trycmd_spawn_auto);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_spawn_vfork), test_argv_spawn_vfork, &opts), 0);
+    TEST_EQUAL_I(opts.opt_spawn, trycmd_spawn_vfork);
+    TEST_EQUAL_I(opts.opt_sub_argc, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_spawn_invalid), test_argv_spawn_invalid, &opts), -1);
+
+    /* Command with an exec mode, equivalent to "try --exec=auto" or "try --no-shell". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_exec, trycmd_exec_shell);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_exec_auto), test_argv_exec_auto, &opts), 0);
+    TEST_EQUAL_I(opts.opt_exec, trycmd_exec_auto);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_no_shell), test_argv_no_shell, &opts), 0);
+    TEST_EQUAL_I(opts.opt_exec, trycmd_exec_direct);
+    TEST_EQUAL_I(opts.opt_sub_argc, 1);
+    TEST_EQUAL_S(opts.opt_sub_argv[0], test_argv_no_shell[2]);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_exec_invalid), test_argv_exec_invalid, &opts), -1);
+
+    /* Batch command, equivalent to "$ try -j 4 --batch=- --fail-fast". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_jobs, 1);
+    TEST_EQUAL_P(opts.opt_batch, NULL);
+    TEST_EQUAL_I(opts.opt_fail_fast, 0);
+    TEST_EQUAL_I(opts.opt_jobserver, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_batch), test_argv_batch, &opts), 0);
+    TEST_EQUAL_I(opts.opt_jobs, 4);
+    TEST_EQUAL_S(opts.opt_batch, "-");
+    TEST_EQUAL_I(opts.opt_fail_fast, 1);
+    TEST_EQUAL_I(opts.opt_jobserver, 1);
+    TEST_EQUAL_I(opts.opt_sub_argc, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_jobs_invalid), test_argv_jobs_invalid, &opts), -1);
+
+    /* Retry command, equivalent to "$ try --retry=3 --retry-delay=250ms ...". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_retry, 0);
+    TEST_EQUAL_I(opts.opt_retry_delay, 1000);
+    TEST_EQUAL_I(opts.opt_backoff, trycmd_backoff_none);
+    TEST_EQUAL_I(opts.opt_jitter, 0);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 2), 1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_retry), test_argv_retry, &opts), 0);
+    TEST_EQUAL_I(opts.opt_retry, 3);
+    TEST_EQUAL_I(opts.opt_retry_delay, 250);
+    TEST_EQUAL_I(opts.opt_backoff, trycmd_backoff_exp);
+    TEST_EQUAL_I(opts.opt_jitter, 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 1), 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 2), 0);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, TRYCMD_SIGNAL_BASE + SIGKILL), 1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_retry_invalid), test_argv_retry_invalid, &opts), -1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_delay_invalid), test_argv_delay_invalid, &opts), -1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_backoff_invalid), test_argv_backoff_invalid, &opts), -1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_retry_on_invalid), test_argv_retry_on_invalid, &opts), -1);
+
+    /* Timeout command, equivalent to "$ try --timeout=1.5m --kill-after=5". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_timeout, 0);
+    TEST_EQUAL_I(opts.opt_kill_after, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_timeout), test_argv_timeout, &opts), 0);
+    TEST_EQUAL_I(opts.opt_timeout, 90000);
+    TEST_EQUAL_I(opts.opt_kill_after, 5000);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_timeout_invalid), test_argv_timeout_invalid, &opts), -1);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_kill_invalid), test_argv_kill_invalid, &opts), -1);
+
+    /* Stats command, equivalent to "$ try --stats". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_stats, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_stats), test_argv_stats, &opts), 0);
+    TEST_EQUAL_I(opts.opt_stats, 1);
+    TEST_EQUAL_I(opts.opt_perf, 0);
+
+    /* Perf command, equivalent to "$ try --perf". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_perf), test_argv_perf, &opts), 0);
+    TEST_EQUAL_I(opts.opt_perf, 1);
+
+    /* Tail command, equivalent to "$ try --tail[=N]". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_tail_lines, 0);
+    TEST_EQUAL_I(opts.opt_tail_size, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_tail), test_argv_tail, &opts), 0);
+    TEST_EQUAL_I(opts.opt_tail_lines, TRYCMD_TAIL_LINES);
+    TEST_EQUAL_I(opts.opt_tail_size, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_tail_lines), test_argv_tail_lines, &opts), 0);
+    TEST_EQUAL_I(opts.opt_tail_lines, 5);
+    TEST_EQUAL_I(opts.opt_tail_size, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_tail_size), test_argv_tail_size, &opts), 0);
+    TEST_EQUAL_I(opts.opt_tail_lines, 0);
+    TEST_EQUAL_I(opts.opt_tail_size, 16384);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_tail_invalid), test_argv_tail_invalid, &opts), -1);
+
+    /* Quiet command, equivalent to "$ try -q" or "$ try --quiet=MAX". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_quiet, 0);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_quiet), test_argv_quiet, &opts), 0);
+    TEST_EQUAL_I(opts.opt_quiet, TRYCMD_QUIET_SIZE);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_quiet_size), test_argv_quiet_size, &opts), 0);
+    TEST_EQUAL_I(opts.opt_quiet, 4096);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_quiet_invalid), test_argv_quiet_invalid, &opts), -1);
+
+    /* Timestamps command, equivalent to "$ try --timestamps[=MODE]". */
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+    TEST_EQUAL_I(opts.opt_timestamps, trycmd_timestamps_none);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_timestamps), test_argv_timestamps, &opts), 0);
+    TEST_EQUAL_I(opts.opt_timestamps, trycmd_timestamps_relative);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_timestamps_mode), test_argv_timestamps_mode, &opts), 0);
+    TEST_EQUAL_I(opts.opt_timestamps, trycmd_timestamps_absolute);
+    TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_timestamps_invalid), test_argv_timestamps_invalid, &opts), -1);
+
     /* Compound command, equivalent to "$ try -ivh". */
     TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_compound), test_argv_compound, &opts), 0);
     TEST_EQUAL_I(opts.opt_interactive, 1);
@@ -664,6 +2305,28 @@ int test_trycmd_read_options(void) {
         TEST_EQUAL_S(opts.opt_sub_argv[0], NULL);
     unsetenv("TRY_COLOR");
 
+    /* Spawn backend controlled by environment string TRY_SPAWN=BACKEND. */
+    setenv("TRY_SPAWN", "clone3", 0);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+        TEST_EQUAL_I(opts.opt_spawn, trycmd_spawn_clone3);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_spawn_vfork), test_argv_spawn_vfork, &opts), 0);
+        TEST_EQUAL_I(opts.opt_spawn, trycmd_spawn_vfork);
+    setenv("TRY_SPAWN", "XX_BAD_SPAWN_XX", 1);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+        TEST_EQUAL_I(opts.opt_spawn, trycmd_spawn_auto);
+    unsetenv("TRY_SPAWN");
+
+    /* Exec mode controlled by environment string TRY_EXEC=MODE. */
+    setenv("TRY_EXEC", "direct", 0);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+        TEST_EQUAL_I(opts.opt_exec, trycmd_exec_direct);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_exec_auto), test_argv_exec_auto, &opts), 0);
+        TEST_EQUAL_I(opts.opt_exec, trycmd_exec_auto);
+    setenv("TRY_EXEC", "XX_BAD_EXEC_XX", 1);
+        TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
+        TEST_EQUAL_I(opts.opt_exec, trycmd_exec_shell);
+    unsetenv("TRY_EXEC");
+
     /* Sub-shell controlled controlled by environment string SHELL. */
     setenv("SHELL", "/bin/dummy_shell", 0);
         TEST_EQUAL_I(trycmd_read_options(ARGV_LEN(test_argv_empty), test_argv_empty, &opts), 0);
@@ -711,6 +2374,484 @@ int test_trycmd_parse_when(void) {
     return 0;
 }
 
+int test_trycmd_parse_exec(void) {
+    enum trycmd_exec te = trycmd_exec_shell;
+    TEST_EQUAL_I((trycmd_parse_exec(NULL, &te)), -1);
+    TEST_EQUAL_I((trycmd_parse_exec("", &te)), -1);
+    TEST_EQUAL_I((trycmd_parse_exec("Direct", &te)), -1);
+    TEST_EQUAL_I((trycmd_parse_exec("shell", &te), te), trycmd_exec_shell);
+    TEST_EQUAL_I((trycmd_parse_exec("direct", &te), te), trycmd_exec_direct);
+    TEST_EQUAL_I((trycmd_parse_exec("auto", &te), te), trycmd_exec_auto);
+    TEST_EQUAL_I((te = (enum trycmd_exec)-1, trycmd_parse_exec("XX_BAD_EXEC_XX", &te), te), -1);
+    return 0;
+}
+
+int test_trycmd_parse_jobs(void) {
+    int jobs = 0;
+    TEST_EQUAL_I((trycmd_parse_jobs(NULL, &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs("", &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs("-1", &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs(" 1", &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs("1x", &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs("4097", &jobs)), -1);
+    TEST_EQUAL_I((trycmd_parse_jobs("1", &jobs), jobs), 1);
+    TEST_EQUAL_I((trycmd_parse_jobs("16", &jobs), jobs), 16);
+    TEST_EQUAL_I((trycmd_parse_jobs("4096", &jobs), jobs), 4096);
+    TEST_EQUAL_I((trycmd_parse_jobs("0", &jobs), jobs >= 1), 1);
+    TEST_EQUAL_I((jobs = -1, trycmd_parse_jobs("XX_BAD_JOBS_XX", &jobs), jobs), -1);
+    return 0;
+}
+
+int test_trycmd_parse_size(void) {
+    unsigned long size = 0;
+    TEST_EQUAL_I((trycmd_parse_size(NULL, &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("", &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("0", &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("-1", &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("1k", &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("1KB", &size)), -1);
+    TEST_EQUAL_I((trycmd_parse_size("1", &size), size), 1);
+    TEST_EQUAL_I((trycmd_parse_size("4K", &size), size), 4096);
+    TEST_EQUAL_I((trycmd_parse_size("16M", &size), size), 16 * 1024 * 1024);
+    TEST_EQUAL_I((trycmd_parse_size("1G", &size), size), 1024 * 1024 * 1024);
+    TEST_EQUAL_I((size = 1, trycmd_parse_size("XX_BAD_SIZE_XX", &size), size), 1);
+    return 0;
+}
+
+int test_trycmd_parse_backoff(void) {
+    enum trycmd_backoff tb = trycmd_backoff_none;
+    TEST_EQUAL_I((trycmd_parse_backoff(NULL, &tb)), -1);
+    TEST_EQUAL_I((trycmd_parse_backoff("", &tb)), -1);
+    TEST_EQUAL_I((trycmd_parse_backoff("Exp", &tb)), -1);
+    TEST_EQUAL_I((trycmd_parse_backoff("exp", &tb), tb), trycmd_backoff_exp);
+    TEST_EQUAL_I((trycmd_parse_backoff("none", &tb), tb), trycmd_backoff_none);
+    TEST_EQUAL_I((tb = (enum trycmd_backoff)-1, trycmd_parse_backoff("XX_BAD_BACKOFF_XX", &tb), tb), -1);
+    return 0;
+}
+
+int test_trycmd_parse_timestamps(void) {
+    enum trycmd_timestamps ts = trycmd_timestamps_none;
+    TEST_EQUAL_I((trycmd_parse_timestamps(NULL, &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_timestamps("", &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_timestamps("none", &ts)), -1);
+    TEST_EQUAL_I((trycmd_parse_timestamps("relative", &ts), ts), trycmd_timestamps_relative);
+    TEST_EQUAL_I((trycmd_parse_timestamps("absolute", &ts), ts), trycmd_timestamps_absolute);
+    TEST_EQUAL_I((ts = (enum trycmd_timestamps)-1, trycmd_parse_timestamps("XX_BAD_TIMESTAMPS_XX", &ts), ts), -1);
+    return 0;
+}
+
+int test_trycmd_parse_retry_on(void) {
+    uint32_t bitmap[8] = { 0 };
+    TEST_EQUAL_I(trycmd_parse_retry_on(NULL, bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("1,", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on(",1", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("256", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("5-2", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("SIGXX", bitmap), -1);
+    TEST_EQUAL_I(trycmd_parse_retry_on("1 ", bitmap), -1);
+    TEST_EQUAL_I(bitmap[0], 0);
+    TEST_EQUAL_I(trycmd_parse_retry_on("1", bitmap), 0);
+    TEST_EQUAL_I(bitmap[0], 0x2);
+    TEST_EQUAL_I(trycmd_parse_retry_on("0,2-4,33", bitmap), 0);
+    TEST_EQUAL_I(bitmap[0], 0x1D);
+    TEST_EQUAL_I(bitmap[1], 0x2);
+    TEST_EQUAL_I(trycmd_parse_retry_on("SIGKILL,TERM", bitmap), 0);
+    TEST_EQUAL_I(bitmap[0], 0);
+    TEST_EQUAL_I(bitmap[(TRYCMD_SIGNAL_BASE + SIGKILL) / 32],
+                 (1u << ((TRYCMD_SIGNAL_BASE + SIGKILL) % 32))
+                 | (1u << ((TRYCMD_SIGNAL_BASE + SIGTERM) % 32)));
+    return 0;
+}
+
+int test_trycmd_is_retryable(void) {
+    struct trycmd_opts opts = { 0 };
+
+    /* With no filter, every failure may be retried. */
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 0), 0);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 1), 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 255), 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 256), 0);
+
+    /* Otherwise, only those statuses given. */
+    assert(trycmd_parse_retry_on("3,KILL", opts.opt_retry_on) == 0);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 1), 0);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, 3), 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, TRYCMD_SIGNAL_BASE + SIGKILL), 1);
+    TEST_EQUAL_I(trycmd_is_retryable(&opts, TRYCMD_SIGNAL_BASE + SIGTERM), 0);
+    return 0;
+}
+
+int test_trycmd_retry_delay(void) {
+    struct trycmd_opts opts = { 0 };
+    uint64_t seed = 1;
+    unsigned long delay;
+    unsigned int idx;
+
+    /* A constant delay. */
+    opts.opt_retry_delay = 500;
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 1, &seed), 500);
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 5, &seed), 500);
+
+    /* An exponential delay, limited to one hour. */
+    opts.opt_backoff = trycmd_backoff_exp;
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 1, &seed), 500);
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 2, &seed), 1000);
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 4, &seed), 4000);
+    TEST_EQUAL_I(trycmd_retry_delay(&opts, 1000, &seed), 3600000);
+
+    /* A randomized delay, within [delay/2, delay]. */
+    opts.opt_jitter = 1;
+    for (idx = 0; idx < 100; ++idx) {
+        delay = trycmd_retry_delay(&opts, 2, &seed);
+        TEST_EQUAL_I(delay >= 500 && delay <= 1000, 1);
+    }
+    TEST_EQUAL_I(seed != 1, 1);
+    return 0;
+}
+
+int test_trycmd_is_plain_command(void) {
+    TEST_EQUAL_I(trycmd_is_plain_command("make"), 1);
+    TEST_EQUAL_I(trycmd_is_plain_command("gcc-12"), 1);
+    TEST_EQUAL_I(trycmd_is_plain_command("/bin/true"), 1);
+    TEST_EQUAL_I(trycmd_is_plain_command("./configure"), 1);
+    TEST_EQUAL_I(trycmd_is_plain_command(""), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("-x"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("ls -l"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("FOO=1"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("$CC"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("~/bin/x"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("*.sh"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("cd"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("export"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("."), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("if"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("echo"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("printf"), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("["), 0);
+    TEST_EQUAL_I(trycmd_is_plain_command("true"), 0);
+    return 0;
+}
+
+int test_trycmd_find_program(void) {
+    char path[PATH_MAX];
+    char* const saved_path = trycmd_getenv_s("PATH", NULL);
+
+    /* Names containing a slash are not searched for. */
+    TEST_EQUAL_I(trycmd_find_program(DEF_SHELL_PATH, path, sizeof(path)), 0);
+    TEST_EQUAL_S(path, DEF_SHELL_PATH);
+    TEST_EQUAL_I((errno = 0, trycmd_find_program("/XX_this_should_not_exist_XX", path, sizeof(path))), -1);
+    TEST_EQUAL_I(errno, ENOENT);
+    TEST_EQUAL_I((errno = 0, trycmd_find_program("/", path, sizeof(path))), -1);
+    TEST_EQUAL_I(errno, EACCES);
+    TEST_EQUAL_I((errno = 0, trycmd_find_program(DEF_SHELL_PATH, path, 2)), -1);
+    TEST_EQUAL_I(errno, ENAMETOOLONG);
+
+    /* All others are searched for upon PATH, in order. */
+    setenv("PATH", "/XX_bad_dir_XX:/bin:/usr/bin", 1);
+        TEST_EQUAL_I(trycmd_find_program("sh", path, sizeof(path)), 0);
+        TEST_EQUAL_S(path, "/bin/sh");
+        TEST_EQUAL_I((errno = 0, trycmd_find_program("XX_this_should_not_exist_XX", path, sizeof(path))), -1);
+        TEST_EQUAL_I(errno, ENOENT);
+    setenv("PATH", "", 1);
+        TEST_EQUAL_I((errno = 0, trycmd_find_program("sh", path, sizeof(path))), -1);
+        TEST_EQUAL_I(errno, ENOENT);
+    if (saved_path != NULL) {
+        setenv("PATH", saved_path, 1);
+    }
+    return 0;
+}
+
+int test_trycmd_pathcache(void) {
+    char* const saved_path = trycmd_getenv_s("PATH", NULL);
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char dir_a[32], dir_b[32], prog_a[48], prog_b[48], search[80];
+    char path[PATH_MAX];
+    struct trycmd_pathcache cache;
+
+    /* Prepare a runtime directory and PATH: "${tmpdir}/a:${tmpdir}/b". */
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(dir_a, sizeof(dir_a), "%s/a", tmpdir);
+    snprintf(dir_b, sizeof(dir_b), "%s/b", tmpdir);
+    snprintf(prog_a, sizeof(prog_a), "%s/prog", dir_a);
+    snprintf(prog_b, sizeof(prog_b), "%s/prog", dir_b);
+    snprintf(search, sizeof(search), "%s:%s", dir_a, dir_b);
+    assert(mkdir(dir_a, 0700) == 0 && mkdir(dir_b, 0700) == 0);
+    assert(trycmd_test_touch_program(prog_b) == 0);
+    setenv("XDG_RUNTIME_DIR", tmpdir, 1);
+    setenv("PATH", search, 1);
+
+    /* An empty cache misses, until a program has been found once. */
+    TEST_EQUAL_I(trycmd_pathcache_open(&cache, search), 0);
+    TEST_EQUAL_I(trycmd_pathcache_lookup(&cache, "prog", path, sizeof(path)), -1);
+    trycmd_pathcache_close(&cache);
+    TEST_EQUAL_I(trycmd_find_program("prog", path, sizeof(path)), 0);
+    TEST_EQUAL_S(path, prog_b);
+    TEST_EQUAL_I(trycmd_pathcache_open(&cache, search), 0);
+    TEST_EQUAL_I(trycmd_pathcache_lookup(&cache, "prog", path, sizeof(path)), 0);
+    TEST_EQUAL_S(path, prog_b);
+    TEST_EQUAL_I(trycmd_pathcache_lookup(&cache, "XX_not_cached_XX", path, sizeof(path)), -1);
+    trycmd_pathcache_close(&cache);
+
+    /* Shadowing the program, earlier within PATH, invalidates its entry. */
+    assert(trycmd_test_touch_program(prog_a) == 0);
+    TEST_EQUAL_I(trycmd_pathcache_open(&cache, search), 0);
+    TEST_EQUAL_I(trycmd_pathcache_lookup(&cache, "prog", path, sizeof(path)), -1);
+    trycmd_pathcache_close(&cache);
+    TEST_EQUAL_I(trycmd_find_program("prog", path, sizeof(path)), 0);
+    TEST_EQUAL_S(path, prog_a);
+
+    /* Removing the program also invalidates its entry. */
+    assert(unlink(prog_a) == 0);
+    TEST_EQUAL_I(trycmd_find_program("prog", path, sizeof(path)), 0);
+    TEST_EQUAL_S(path, prog_b);
+
+    /* An entry naming a directory (however stored) is never a program. */
+    snprintf(path, sizeof(path), "%s/subdir", dir_a);
+    assert(mkdir(path, 0700) == 0);
+    TEST_EQUAL_I(trycmd_pathcache_open(&cache, search), 0);
+    trycmd_pathcache_store(&cache, "subdir", 0);
+    TEST_EQUAL_I(trycmd_pathcache_lookup(&cache, "subdir", path, sizeof(path)), -1);
+    trycmd_pathcache_close(&cache);
+
+    /* The cache may be disabled. */
+    setenv("TRY_PATH_CACHE", "0", 1);
+        TEST_EQUAL_I(trycmd_pathcache_open(&cache, search), -1);
+        trycmd_pathcache_close(&cache);
+        TEST_EQUAL_I(trycmd_find_program("prog", path, sizeof(path)), 0);
+        TEST_EQUAL_S(path, prog_b);
+    unsetenv("TRY_PATH_CACHE");
+
+    /* Clean up (skipped on test failure). */
+    unsetenv("XDG_RUNTIME_DIR");
+    if (saved_path != NULL) {
+        setenv("PATH", saved_path, 1);
+    }
+    snprintf(path, sizeof(path), "rm -rf '%s'", tmpdir);
+    return system(path);
+}
+
+int test_trycmd_jobserver(void) {
+    char tmpdir[] = "/tmp/try_test_XXXXXX";
+    char fifo[48], makeflags[128], fd_path[32];
+    char* argv_test_fd[] = { "test", "-e", fd_path, NULL };
+    struct trycmd_opts opts = { 0 };
+    struct trycmd_jobserver js, client;
+    int pipe_fds[2];
+    int token = -1;
+    int token_2 = -1;
+    char buffer[4];
+
+    /* No jobserver, or one which is unusable. */
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, NULL), -1);
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, "-j4"), -1);
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, "-j --jobserver-auth=1000,1001"), -1);
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, "-j --jobserver-auth=x,y"), -1);
+    TEST_EQUAL_I(js.token_fd, -1);
+
+    /* An inherited pipe holding one token, which is passed on to children. */
+    assert(pipe2(pipe_fds, O_CLOEXEC) == 0);
+    assert(write(pipe_fds[1], "+", 1) == 1);
+    snprintf(makeflags, sizeof(makeflags), " -j --jobserver-auth=%d,%d",
+             pipe_fds[0], pipe_fds[1]);
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, makeflags), 0);
+    TEST_EQUAL_I(fcntl(pipe_fds[0], F_GETFD) & FD_CLOEXEC, 0);
+    TEST_EQUAL_I(fcntl(pipe_fds[1], F_GETFD) & FD_CLOEXEC, 0);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token), 0);
+    TEST_EQUAL_I(token, '+');
+    TEST_EQUAL_I((errno = 0, trycmd_jobserver_acquire(&js, &token_2)), -1);
+    TEST_EQUAL_I(errno, EAGAIN);
+    trycmd_jobserver_release(&js, token);
+    trycmd_jobserver_close(&js);
+    TEST_EQUAL_I(read(pipe_fds[0], buffer, 1), 1);
+    TEST_EQUAL_I(buffer[0], '+');
+
+    /* Subcommands inherit the jobserver's descriptors. */
+    assert(fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC) == 0);
+    snprintf(fd_path, sizeof(fd_path), "/dev/fd/%d", pipe_fds[0]);
+    setenv("MAKEFLAGS", makeflags, 1);
+    opts.opt_shell = DEF_SHELL_PATH;
+    opts.opt_sub_argc = ARGV_LEN(argv_test_fd);
+    opts.opt_sub_argv = argv_test_fd;
+    TEST_EQUAL_I(trycmd_run_subcommand(&opts), 0);
+    unsetenv("MAKEFLAGS");
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+
+    /* The older --jobserver-fds form, and a named fifo (the last wins). */
+    assert(mkdtemp(tmpdir) != NULL);
+    snprintf(fifo, sizeof(fifo), "%s/fifo", tmpdir);
+    assert(mkfifo(fifo, 0600) == 0);
+    snprintf(makeflags, sizeof(makeflags),
+             "-j --jobserver-fds=1000,1001 --jobserver-auth=fifo:%s", fifo);
+    TEST_EQUAL_I(trycmd_jobserver_open(&js, makeflags), 0);
+    TEST_EQUAL_I(js.read_fd, -1);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token), -1);
+    trycmd_jobserver_release(&js, '+');
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token), 0);
+    TEST_EQUAL_I(token, '+');
+    trycmd_jobserver_close(&js);
+
+    /* A jobserver of three slots holds two tokens, exported via MAKEFLAGS. */
+    setenv("MAKEFLAGS", "k", 1);
+    TEST_EQUAL_I(trycmd_jobserver_create(&js, 3), 0);
+    TEST_EQUAL_I(strncmp(getenv("MAKEFLAGS"), "k -j3 --jobserver-auth=", 23), 0);
+    TEST_EQUAL_I(trycmd_jobserver_open(&client, getenv("MAKEFLAGS")), 0);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&client, &token), 0);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token_2), 0);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token_2), -1);
+    trycmd_jobserver_release(&client, token);
+    trycmd_jobserver_close(&client);
+    TEST_EQUAL_I(trycmd_jobserver_acquire(&js, &token), 0);
+    trycmd_jobserver_close(&js);
+    TEST_EQUAL_S(getenv("MAKEFLAGS"), "k");
+    unsetenv("MAKEFLAGS");
+
+    /* A jobserver is only created upon request. */
+    opts.opt_jobs = 2;
+    TEST_EQUAL_I(trycmd_jobserver_setup(&js, &opts), -1);
+    opts.opt_jobserver = 1;
+    TEST_EQUAL_I(trycmd_jobserver_setup(&js, &opts), 0);
+    TEST_EQUAL_I(js.owner, 1);
+    trycmd_jobserver_close(&js);
+    TEST_EQUAL_P(getenv("MAKEFLAGS"), NULL);
+
+    /* Clean up (skipped on test failure). */
+    snprintf(makeflags, sizeof(makeflags), "rm -rf '%s'", tmpdir);
+    return system(makeflags);
+}
+
+int test_trycmd_perf(void) {
+    char* argv_true[] = { trycmd_test_progname, "T", NULL };
+    struct trycmd_perf_counts counts;
+    struct trycmd_spawn_attr attr;
+    struct trycmd_child child;
+    struct trycmd_perf perf;
+    char buffer[256] = { 0 };
+    FILE* fout;
+    int status;
+
+    /* Counted events are shown in order, with instructions per cycle. */
+    fout = fmemopen(buffer, sizeof(buffer), "w");
+    memset(&counts, 0, sizeof(counts));
+    trycmd_print_perf(&counts, fout);
+    fflush(fout);
+    TEST_EQUAL_S(buffer, "Perf: unavailable\n");
+    rewind(fout);
+    counts.valid = (1u << trycmd_perf_cycles)
+                 | (1u << trycmd_perf_instructions)
+                 | (1u << trycmd_perf_task_clock)
+                 | (1u << trycmd_perf_page_faults);
+    counts.value[trycmd_perf_cycles]       = 2000;
+    counts.value[trycmd_perf_instructions] = 3000;
+    counts.value[trycmd_perf_task_clock]   = UINT64_C(12345678);
+    counts.value[trycmd_perf_page_faults]  = 42;
+    trycmd_print_perf(&counts, fout);
+    fputc('\0', fout);
+    fflush(fout);
+    TEST_EQUAL_S(buffer, "Perf: cycles=2000 instructions=3000"
+                         " task-clock=12.345ms page-faults=42"
+                         " insn-per-cycle=1.50\n");
+    fclose(fout);
+
+    /*
+     * A spawned child is counted from its exec, with whatever events this
+     * system permits (if any).
+     */
+    if (trycmd_perf_open(&perf) == 0) {
+        trycmd_spawn_attr_init(&attr, NULL);
+        trycmd_capture_begin();
+        TEST_EQUAL_I(trycmd_spawn(&attr, argv_true[0], argv_true, &child), 0);
+        TEST_EQUAL_I(waitpid(child.pid, &status, 0), child.pid);
+        trycmd_capture_end(buffer, sizeof(buffer));
+        if (child.pidfd >= 0) {
+            close(child.pidfd);
+        }
+        trycmd_perf_read(&perf, &counts);
+        trycmd_perf_close(&perf);
+        TEST_EQUAL_I(counts.valid != 0, 1);
+        if (counts.valid & (1u << trycmd_perf_task_clock)) {
+            TEST_EQUAL_I(counts.value[trycmd_perf_task_clock] > 0, 1);
+        }
+        TEST_EQUAL_I(perf.fd[trycmd_perf_task_clock], -1);
+    }
+    return 0;
+}
+
+int test_trycmd_intl(void) {
+    char* const message = "Show this message.";
+    const int have_utf8 = (setlocale(LC_ALL, "C.UTF-8") != NULL);
+    char* translated;
+
+    /* The locale is not loaded when initialized... */
+    setlocale(LC_ALL, "C");
+    setenv("LC_ALL", "C.UTF-8", 1);
+    trycmd_intl_init();
+    TEST_EQUAL_S(setlocale(LC_ALL, NULL), "C");
+
+    /* ...but only once a message is translated (if ever), then kept. */
+    translated = _(message);
+    TEST_EQUAL_S(translated, message);
+#if defined(TRYCMD_NO_INTL)
+    TEST_EQUAL_S(setlocale(LC_ALL, NULL), "C");
+    (void) have_utf8;
+#else
+    TEST_EQUAL_I(strcmp(setlocale(LC_ALL, NULL), "C") != 0, have_utf8);
+#endif
+    TEST_EQUAL_P(_(message), translated);
+
+    /* Reinitializing forgets both. */
+    unsetenv("LC_ALL");
+    trycmd_intl_init();
+    TEST_EQUAL_P(_(message), translated);
+    TEST_EQUAL_S(setlocale(LC_ALL, NULL), "C");
+    return 0;
+}
+
+int test_trycmd_hash64(void) {
+    /* Reference values for FNV-1a, 64-bit. */
+    TEST_EQUAL_I(trycmd_hash64("", 0, 0) == UINT64_C(0xcbf29ce484222325), 1);
+    TEST_EQUAL_I(trycmd_hash64("a", 1, 0) == UINT64_C(0xaf63dc4c8601ec8c), 1);
+    TEST_EQUAL_I(trycmd_hash64("foobar", 6, 0) == UINT64_C(0x85944171f73967e8), 1);
+    TEST_EQUAL_I(trycmd_hash64("bar", 3, trycmd_hash64("foo", 3, 0))
+                 == trycmd_hash64("foobar", 6, 0), 1);
+    return 0;
+}
+
+int test_trycmd_xxh64(void) {
+    static const char text[] = "Nobody inspects the spammish repetition";
+
+    /* Reference values for XXH64, both short and of several stripes. */
+    TEST_EQUAL_I(trycmd_xxh64("", 0, 0) == UINT64_C(0xef46db3751d8e999), 1);
+    TEST_EQUAL_I(trycmd_xxh64("abc", 3, 0) == UINT64_C(0x44bc2cf5ad770999), 1);
+    TEST_EQUAL_I(trycmd_xxh64(text, sizeof(text) - 1, 0)
+                 == UINT64_C(0xfbcea83c8a378bf1), 1);
+    TEST_EQUAL_I(trycmd_xxh64("abc", 3, 1) != trycmd_xxh64("abc", 3, 0), 1);
+    return 0;
+}
+
+int test_trycmd_parse_duration(void) {
+    unsigned long ms = 0;
+    TEST_EQUAL_I(trycmd_parse_duration(NULL, &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("s", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("-1", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration(".5", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("1 s", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("1d", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("99999999999", &ms), -1);
+    TEST_EQUAL_I(trycmd_parse_duration("9999h", &ms), -1);
+    TEST_EQUAL_I((trycmd_parse_duration("0", &ms), ms), 0);
+    TEST_EQUAL_I((trycmd_parse_duration("2", &ms), ms), 2000);
+    TEST_EQUAL_I((trycmd_parse_duration("1.5", &ms), ms), 1500);
+    TEST_EQUAL_I((trycmd_parse_duration("0.0015", &ms), ms), 1);
+    TEST_EQUAL_I((trycmd_parse_duration("250ms", &ms), ms), 250);
+    TEST_EQUAL_I((trycmd_parse_duration("3s", &ms), ms), 3000);
+    TEST_EQUAL_I((trycmd_parse_duration("1.25m", &ms), ms), 75000);
+    TEST_EQUAL_I((trycmd_parse_duration("2h", &ms), ms), 7200000);
+    return 0;
+}
+
 int test_trycmd_align_sz(void) {
     TEST_EQUAL_I(trycmd_align_sz(0, 1), 0);
     TEST_EQUAL_I(trycmd_align_sz(0, 2), 0);
@@ -864,13 +3005,57 @@ int test_trycmd_needs_quoting(void) {
     TEST_EQUAL_I(trycmd_needs_quoting('|'), 1);
     TEST_EQUAL_I(trycmd_needs_quoting('}'), 1);
     TEST_EQUAL_I(trycmd_needs_quoting('~'), 1);
+    TEST_EQUAL_I(trycmd_needs_quoting('\x7f'), 1);
+    TEST_EQUAL_I(trycmd_needs_quoting('\x80'), 1);
+    TEST_EQUAL_I(trycmd_needs_quoting('\xe9'), 1);
+    TEST_EQUAL_I(trycmd_needs_quoting('\xff'), 1);
     return 0;
 }
 
+/**
+ * Print an argument with quoting as did trycmd_pretty_print_arg() before
+ * its scan was vectorised, by checking each character in turn.
+ */
+static void test_pretty_print_arg_reference(const char* const arg,
+                                            FILE* const os) {
+    const char* apos;
+    const char* bpos;
+    int needs_quoting = 0;
+    for (apos = arg; *apos && needs_quoting == 0; ++apos) {
+        needs_quoting = !(strchr("_-./", *apos) != NULL
+                          || (*apos >= '0' && *apos <= '9')
+                          || (*apos >= 'a' && *apos <= 'z')
+                          || (*apos >= 'A' && *apos <= 'Z'));
+    }
+    if (!needs_quoting) {
+        fputs(arg, os);
+        return;
+    }
+    apos = arg;
+    bpos = strchr(apos, '\'');
+    while (bpos != NULL) {
+        if (apos != bpos) {
+            fprintf(os, "'%.*s'", (int)(bpos - apos), apos);
+        }
+        fputs("\\'", os);
+        apos = bpos + 1;
+        bpos = strchr(apos, '\'');
+    }
+    if (*apos) {
+        fprintf(os, "'%s'", apos);
+    }
+}
+
 int test_trycmd_pretty_print_arg(void) {
     char buffer[42] = { 0 };
+    uint64_t seed = 42;
+    char* large;
+    char* actual_large = NULL;
+    size_t actual_large_len = 0;
     FILE* fout;
     long fpos;
+    int result;
+    int iter;
 
     /* Write arguments to a memory stream then check its content. */
     fout = fmemopen(buffer, sizeof(buffer), "w");
@@ -895,6 +3080,57 @@ int test_trycmd_pretty_print_arg(void) {
 
     /* Clean up (skipped on test failure). */
     fclose(fout);
+
+    /*
+     * Quote many random arguments, of lengths spanning several vectors and
+     * mixing safe, unsafe, quote and non-ASCII bytes, as did the original.
+     */
+    for (iter = 0; iter < 4000; ++iter) {
+        static const char alphabet[] = "aZ09_-./' \"$\x80\xe9\xff";
+        char arg[96];
+        char* actual = NULL;
+        char* expected = NULL;
+        size_t actual_len = 0;
+        size_t expected_len = 0;
+        size_t len;
+        size_t idx;
+
+        seed = seed * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+        len = (size_t)(seed >> 33) % sizeof(arg);
+        for (idx = 0; idx < len; ++idx) {
+            seed = seed * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+            /* Mostly safe bytes, so that many arguments need no quoting. */
+            arg[idx] = ((seed >> 60) < 15)
+                     ? alphabet[(seed >> 33) % 5]
+                     : alphabet[(seed >> 33) % (sizeof(alphabet) - 1)];
+        }
+        arg[len] = '\0';
+        fout = open_memstream(&actual, &actual_len);
+        trycmd_pretty_print_arg(arg, fout);
+        fclose(fout);
+        fout = open_memstream(&expected, &expected_len);
+        test_pretty_print_arg_reference(arg, fout);
+        fclose(fout);
+        result = strcmp(actual, expected);
+        free(actual);
+        free(expected);
+        TEST_EQUAL_I(result, 0);
+    }
+
+    /* A long argument's quotes are each escaped. */
+    large = malloc(256 * 1024 + 1);
+    TEST_EQUAL_I(large != NULL, 1);
+    memset(large, 'x', 256 * 1024);
+    large[256 * 1024] = '\0';
+    large[1000] = '\'';
+    large[200000] = ' ';
+    fout = open_memstream(&actual_large, &actual_large_len);
+    trycmd_pretty_print_arg(large, fout);
+    fclose(fout);
+    free(large);
+    TEST_EQUAL_I(actual_large_len, 256 * 1024 + 5);
+    TEST_EQUAL_I(strncmp(&actual_large[1000], "x'\\''x", 6), 0);
+    free(actual_large);
     return 0;
 }
 
@@ -920,9 +3156,18 @@ int test_trycmd_main(void) {
     char* argv_segflt[]       = { "try", trycmd_test_progname, "S", NULL };
     char* argv_exit_status[]  = { "try", trycmd_test_progname, "X", NULL };
     char* argv_non_existent[] = { "try", "XX_this_should_not_exist_XX", NULL };
+    char* argv_direct_none[]  = { "try", "--no-shell", "XX_this_should_not_exist_XX", NULL };
+    char* argv_auto_none[]    = { "try", "--exec=auto", "XX_this_should_not_exist_XX", NULL };
+    char* argv_direct_echo[]  = { "try", "--no-shell", "echo", "hello", "this", "is", "a", "test", NULL };
+    char* argv_direct_false[] = { "try", "--no-shell", trycmd_test_progname, "F", NULL };
+    char* argv_auto_segflt[]  = { "try", "--exec=auto", trycmd_test_progname, "S", NULL };
     char* argv_color_true[]   = { "try", "--color=always", "true", NULL };
     char* argv_color_false[]  = { "try", "--color=always", "false", NULL };
-    char buffer[256] = { 0 };
+    char* argv_retry_false[]  = { "try", "--retry=1", "--retry-delay=0", "false", NULL };
+    char* argv_timeout_hang[] = { "try", "--timeout=20ms", trycmd_test_progname, "H", NULL };
+    char* argv_stats[]        = { "try", "--stats", trycmd_test_progname, "T", NULL };
+    char* argv_perf[]         = { "try", "--perf", trycmd_test_progname, "T", NULL };
+    char buffer[512] = { 0 };
     int result;
 
     /* Test with captured stdout, stderr. */
@@ -962,6 +3207,64 @@ int test_trycmd_main(void) {
     TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_segflt), argv_segflt), TRYCMD_SIGNAL_BASE + SIGSEGV);
     TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_exit_status), argv_exit_status), trycmd_test_high_exit_status);
     TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_non_existent), argv_non_existent), 127);  /* To match bash. */
+
+    /* Test direct execution, without a shell. */
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_direct_echo), argv_direct_echo);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, EXIT_SUCCESS);
+    TEST_EQUAL_S(buffer,
+        "hello this is a test\n"
+        "==============================================================================\n"
+        "Success: echo hello this is a test\n"
+        "==============================================================================\n");
+
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_direct_none), argv_direct_none);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, 127);  /* To match bash. */
+    TEST_EQUAL_S(buffer,
+        "try: XX_this_should_not_exist_XX: command not found\n"
+        "==============================================================================\n"
+        "Failed (status=127): XX_this_should_not_exist_XX\n"
+        "==============================================================================\n");
+
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_auto_none), argv_auto_none), 127);  /* To match bash. */
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_direct_false), argv_direct_false), EXIT_FAILURE);
+    TEST_EQUAL_I(trycmd_main(ARGV_LEN(argv_auto_segflt), argv_auto_segflt), TRYCMD_SIGNAL_BASE + SIGSEGV);
+
+    /* Test retries (whose total time varies). */
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_retry_false), argv_retry_false);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, EXIT_FAILURE);
+    TEST_EQUAL_I(strncmp(buffer,
+        "try: attempt 1 of 2 failed (status=1), retrying in 0.000s\n"
+        "==============================================================================\n"
+        "Failed (status=1, attempts=2, time=", 172), 0);
+    TEST_EQUAL_I(strstr(buffer, "s): false\n") != NULL, 1);
+
+    /* Test timeouts. */
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_timeout_hang), argv_timeout_hang);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, TRYCMD_STATUS_TIMED_OUT);
+    TEST_EQUAL_I(strstr(buffer, "Timed out (status=124, limit=0.020s): ") != NULL, 1);
+
+    /* Test stats. */
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_stats), argv_stats);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, EXIT_SUCCESS);
+    TEST_EQUAL_I(strstr(buffer, " T\nStats: wall=") != NULL, 1);
+    TEST_EQUAL_I(strstr(buffer, "KiB majflt=") != NULL, 1);
+
+    /* Test perf (whether or not any event is available). */
+    trycmd_capture_begin();
+    result = trycmd_main(ARGV_LEN(argv_perf), argv_perf);
+    trycmd_capture_end(buffer, sizeof(buffer));
+    TEST_EQUAL_I(result, EXIT_SUCCESS);
+    TEST_EQUAL_I(strstr(buffer, " T\nPerf: ") != NULL, 1);
     return 0;
 }
 
@@ -998,6 +3301,21 @@ int main(int argc, char* argv[]) {
             printf("try_test: Returning %d\n", EXIT_FAILURE);
             result = EXIT_FAILURE;
             break;
+        case 'H':  /* 'H'ang. */
+            printf("try_test: Hanging\n");
+            fflush(stdout);
+            for (;;) {
+                pause();
+            }
+            break;
+        case 'I':  /* 'I'gnore SIGTERM, then hang. */
+            printf("try_test: Ignoring SIGTERM\n");
+            fflush(stdout);
+            signal(SIGTERM, SIG_IGN);
+            for (;;) {
+                pause();
+            }
+            break;
         case 'X':  /* E'X'it status. */
             printf("try_test: Returning %d\n", trycmd_test_high_exit_status);
             result = trycmd_test_high_exit_status;
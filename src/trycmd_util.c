@@ -12,11 +12,15 @@
 #include "trycmd.h"
 #include <assert.h>  /* assert. */
 #include <stddef.h>  /* size_t. */
+#include <stdint.h>  /* uint64_t, UINT64_C. */
 #include <stdlib.h>  /* atoi. */
-#include <string.h>  /* strchr. */
-#include <ctype.h>   /* isalnum. */
+#include <string.h>  /* memchr, memcpy, strcmp, strlen. */
 #include <stdio.h>   /* fileno, fputc, fputs, fprintf, fwrite. */
+#include <time.h>    /* clock_gettime, CLOCK_MONOTONIC. */
 #include <unistd.h>  /* isatty. */
+#if defined(__SSE2__)
+#  include <emmintrin.h>  /* _mm_*, __m128i. */
+#endif
 
 size_t trycmd_align_sz(const size_t sz, const size_t alignment) {
     /* Check arguments. */
@@ -54,6 +58,187 @@ void* trycmd_align_ptr(void* const ptr, const size_t alignment) {
     return result;
 }
 
+uint64_t trycmd_hash64(const void* const data,
+                       const size_t len,
+                       const uint64_t seed) {
+    const unsigned char* pos = data;
+    const unsigned char* const end = pos + len;
+    uint64_t hash = (seed != 0) ? seed : UINT64_C(0xcbf29ce484222325);
+
+    /* FNV-1a, 64-bit. */
+    for (; pos != end; ++pos) {
+        hash ^= *pos;
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+/** The primes of XXH64. */
+#define TRYCMD_XXH_PRIME1 UINT64_C(0x9e3779b185ebca87)
+#define TRYCMD_XXH_PRIME2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define TRYCMD_XXH_PRIME3 UINT64_C(0x165667b19e3779f9)
+#define TRYCMD_XXH_PRIME4 UINT64_C(0x85ebca77c2b2ae63)
+#define TRYCMD_XXH_PRIME5 UINT64_C(0x27d4eb2f165667c5)
+
+static uint64_t trycmd_xxh64_rotl(const uint64_t value, const int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t trycmd_xxh64_round(uint64_t acc, const uint64_t input) {
+    acc += input * TRYCMD_XXH_PRIME2;
+    acc  = trycmd_xxh64_rotl(acc, 31);
+    return acc * TRYCMD_XXH_PRIME1;
+}
+
+static uint64_t trycmd_xxh64_merge(uint64_t acc, const uint64_t value) {
+    acc ^= trycmd_xxh64_round(0, value);
+    return acc * TRYCMD_XXH_PRIME1 + TRYCMD_XXH_PRIME4;
+}
+
+/** Read 8 (or 4) bytes of little-endian input, as XXH64 is defined. */
+static uint64_t trycmd_xxh64_read64(const unsigned char* const pos) {
+    uint64_t value;
+    memcpy(&value, pos, sizeof(value));
+#if defined(WORDS_BIGENDIAN)
+    value = ((value & UINT64_C(0x00000000000000ff)) << 56)
+          | ((value & UINT64_C(0x000000000000ff00)) << 40)
+          | ((value & UINT64_C(0x0000000000ff0000)) << 24)
+          | ((value & UINT64_C(0x00000000ff000000)) << 8)
+          | ((value & UINT64_C(0x000000ff00000000)) >> 8)
+          | ((value & UINT64_C(0x0000ff0000000000)) >> 24)
+          | ((value & UINT64_C(0x00ff000000000000)) >> 40)
+          | ((value & UINT64_C(0xff00000000000000)) >> 56);
+#endif
+    return value;
+}
+
+static uint64_t trycmd_xxh64_read32(const unsigned char* const pos) {
+    return (uint64_t)pos[0]
+         | ((uint64_t)pos[1] << 8)
+         | ((uint64_t)pos[2] << 16)
+         | ((uint64_t)pos[3] << 24);
+}
+
+uint64_t trycmd_xxh64(const void* const data,
+                      const size_t len,
+                      const uint64_t seed) {
+    const unsigned char* pos = data;
+    const unsigned char* const end = pos + len;
+    uint64_t hash;
+
+    /* Check arguments. */
+    assert("Unexpected NULL data" && (data != NULL || len == 0));
+
+    /* Consume 32 byte stripes within four independent lanes. */
+    if (len >= 32) {
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = seed + TRYCMD_XXH_PRIME1 + TRYCMD_XXH_PRIME2;
+        uint64_t v2 = seed + TRYCMD_XXH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - TRYCMD_XXH_PRIME1;
+        do {
+            v1 = trycmd_xxh64_round(v1, trycmd_xxh64_read64(pos));
+            v2 = trycmd_xxh64_round(v2, trycmd_xxh64_read64(pos + 8));
+            v3 = trycmd_xxh64_round(v3, trycmd_xxh64_read64(pos + 16));
+            v4 = trycmd_xxh64_round(v4, trycmd_xxh64_read64(pos + 24));
+            pos += 32;
+        } while (pos <= limit);
+        hash = trycmd_xxh64_rotl(v1, 1) + trycmd_xxh64_rotl(v2, 7)
+             + trycmd_xxh64_rotl(v3, 12) + trycmd_xxh64_rotl(v4, 18);
+        hash = trycmd_xxh64_merge(hash, v1);
+        hash = trycmd_xxh64_merge(hash, v2);
+        hash = trycmd_xxh64_merge(hash, v3);
+        hash = trycmd_xxh64_merge(hash, v4);
+    } else {
+        hash = seed + TRYCMD_XXH_PRIME5;
+    }
+    hash += (uint64_t)len;
+
+    /* Then any remaining words and bytes. */
+    for (; pos + 8 <= end; pos += 8) {
+        hash ^= trycmd_xxh64_round(0, trycmd_xxh64_read64(pos));
+        hash  = trycmd_xxh64_rotl(hash, 27) * TRYCMD_XXH_PRIME1
+              + TRYCMD_XXH_PRIME4;
+    }
+    if (pos + 4 <= end) {
+        hash ^= trycmd_xxh64_read32(pos) * TRYCMD_XXH_PRIME1;
+        hash  = trycmd_xxh64_rotl(hash, 23) * TRYCMD_XXH_PRIME2
+              + TRYCMD_XXH_PRIME3;
+        pos  += 4;
+    }
+    for (; pos != end; ++pos) {
+        hash ^= (uint64_t)*pos * TRYCMD_XXH_PRIME5;
+        hash  = trycmd_xxh64_rotl(hash, 11) * TRYCMD_XXH_PRIME1;
+    }
+
+    /* Finally, avalanche. */
+    hash ^= hash >> 33;
+    hash *= TRYCMD_XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= TRYCMD_XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+int trycmd_parse_duration(const char* const text, unsigned long* const out) {
+    const struct duration_unit {
+        const char*   suffix;
+        unsigned long ms;
+    } units[] = {
+        { N_(""),   1000UL    },
+        { N_("ms"), 1UL       },
+        { N_("s"),  1000UL    },
+        { N_("m"),  60000UL   },
+        { N_("h"),  3600000UL },
+    };
+    const unsigned long max_ms = 0xFFFFFFFFUL;  /* Over 49 days. */
+    const char* pos = text;
+    unsigned long whole = 0;
+    unsigned long frac = 0;    /* Thousandths. */
+    unsigned long scale = 100; /* Of the next fractional digit. */
+    size_t idx;
+
+    /* Check arguments. */
+    assert("Unexpected NULL out" && (out != NULL));
+    if (text == NULL || (*pos < '0' || *pos > '9')) {
+        return -1;
+    }
+
+    /* Read "N[.N]", independent of the current locale. */
+    for (; *pos >= '0' && *pos <= '9'; ++pos) {
+        whole = whole * 10 + (unsigned long)(*pos - '0');
+        if (whole > max_ms) {
+            return -1;
+        }
+    }
+    if (*pos == '.') {
+        for (++pos; *pos >= '0' && *pos <= '9'; ++pos) {
+            frac += scale * (unsigned long)(*pos - '0');
+            scale /= 10;
+        }
+    }
+
+    /* Apply the unit suffix, defaulting to seconds. */
+    for (idx = 0; idx < sizeof(units) / sizeof(units[0]); ++idx) {
+        if (strcmp(pos, units[idx].suffix) == 0) {
+            if (whole > max_ms / units[idx].ms) {
+                return -1;
+            }
+            *out = whole * units[idx].ms + frac * units[idx].ms / 1000;
+            return (*out <= max_ms) ? 0 : -1;
+        }
+    }
+
+    /* Unrecognised unit. */
+    return -1;
+}
+
+uint64_t trycmd_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
 char* trycmd_getenv_s(const char* const key, char* const def) {
     char* result;
     
@@ -101,40 +286,112 @@ int trycmd_is_color_enabled(const enum trycmd_color c, FILE* const os) {
     }
 }
 
+/**
+ * The class of each byte when given to a typical shell, whatever the
+ * locale: TRYCMD_QUOTE_SAFE for those needing no quoting ([0-9a-zA-Z] and
+ * '_', '-', '.' and '/'), TRYCMD_QUOTE_QUOTE for the single quote, and
+ * otherwise zero. Every byte from 0x80 upward needs quoting.
+ */
+#define TRYCMD_QUOTE_SAFE  (1)
+#define TRYCMD_QUOTE_QUOTE (2)
+static const unsigned char trycmd_quote_class[256] = {
+    /* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x20 */ 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 1, 1,
+    /* 0x30 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    /* 0x40 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+    /* 0x60 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+    /* 0x80 to 0xff: zero. */
+};
+
 int trycmd_needs_quoting(const char c) {
-    switch (c) {
-        case '_':
-        case '-':
-        case '.':
-        case '/':
-            // Special, allowed chars.
-            return 0;
-        default:
-            // Only needs quoting if outside range [0-9a-zA-Z].
-            return !isalnum(c);
+    return !(trycmd_quote_class[(unsigned char)c] & TRYCMD_QUOTE_SAFE);
+}
+
+#if defined(__SSE2__)
+/**
+ * Mark those bytes of v which are within [lo, hi], both ASCII. As the
+ * comparison is signed, any byte from 0x80 upward is never marked.
+ */
+static __m128i trycmd_quote_in(const __m128i v, const char lo, const char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+#endif
+
+int trycmd_scan_arg(const char* const arg,
+                    const size_t len,
+                    size_t* const quotes_out) {
+    const unsigned char* const bytes = (const unsigned char*)arg;
+    unsigned safe = TRYCMD_QUOTE_SAFE;
+    size_t quotes = 0;
+    size_t pos = 0;
+
+    /* Check arguments. */
+    assert("Unexpected NULL arg" && (arg != NULL || len == 0));
+    assert("Unexpected NULL quotes_out" && (quotes_out != NULL));
+
+#if defined(__SSE2__)
+    /*
+     * Classify sixteen bytes at a time: each is safe if within '-' to '9'
+     * (so '-', '.', '/' or a digit), a letter or '_'.
+     */
+    for (; pos + 16 <= len; pos += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)&bytes[pos]);
+        const __m128i is_safe = _mm_or_si128(
+            _mm_or_si128(trycmd_quote_in(v, '-', '9'),
+                         trycmd_quote_in(v, 'A', 'Z')),
+            _mm_or_si128(trycmd_quote_in(v, 'a', 'z'),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+        const int is_quote = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+        if (_mm_movemask_epi8(is_safe) != 0xFFFF) {
+            safe = 0;
+        }
+        quotes += (size_t)__builtin_popcount((unsigned)is_quote);
     }
+#endif
+
+    /* Classify any remaining bytes by table, without branching. */
+    for (; pos < len; ++pos) {
+        const unsigned c = trycmd_quote_class[bytes[pos]];
+        safe   &= c;
+        quotes += (c == TRYCMD_QUOTE_QUOTE);
+    }
+    *quotes_out = quotes;
+    return !safe;
 }
 
 void trycmd_pretty_print_arg(const char* const arg, FILE* const os) {
-    int needs_quoting = 0;
+    struct trycmd_obuf obuf;
     const char* apos;
     const char* bpos;
+    const char* end;
+    size_t quotes;
+    FILE* out;
 
     /* Check arguments. */
     assert("Unexpected NULL arg" && (arg != NULL));
     assert("Unexpected NULL os" && (os != NULL));
 
+    /* Render the argument whole, to be written at once. */
+    end = arg + strlen(arg);
+    out = trycmd_obuf_open(&obuf, os);
+
     /*
      * Search for any non-alphanumeric characters
-     * that would necessitate quoting.
+     * that would necessitate quoting, counting any quotes.
      */
-    for (apos = arg; *apos && needs_quoting == 0; ++apos) {
-        needs_quoting = trycmd_needs_quoting(*apos);
-    }
-
-    if (!needs_quoting) {
+    if (!trycmd_scan_arg(arg, (size_t)(end - arg), &quotes)) {
         /* This argument requires no quoting. */
-        fputs(arg, os);
+        fwrite(arg, sizeof(*arg), end - arg, out);
+    } else if (quotes == 0) {
+        /* This argument may be printed within single quotes as it is. */
+        fputc('\'', out);
+        fwrite(arg, sizeof(*arg), end - arg, out);
+        fputc('\'', out);
     } else {
         /*
          * This argument is not completely alpha-numeric.
@@ -142,47 +399,55 @@ void trycmd_pretty_print_arg(const char* const arg, FILE* const os) {
          * escaping any internal quotes as found.
          */
         apos = arg;
-        bpos = strchr(apos, '\'');
+        bpos = memchr(apos, '\'', end - apos);
         while (bpos != NULL) {
             /* Print everything before the quote. */
             if (apos != bpos) {
-                fputc('\'', os);
-                fwrite(apos, sizeof(*apos), bpos - apos, os);
-                fputc('\'', os);
+                fputc('\'', out);
+                fwrite(apos, sizeof(*apos), bpos - apos, out);
+                fputc('\'', out);
             }
 
             /* Now the quote itself, escaped. */
-            fprintf(os, "\\\'");
+            fputs("\\\'", out);
 
             /* Search for the next quote. */
             apos = bpos + 1;
-            bpos = strchr(apos, '\'');
+            bpos = memchr(apos, '\'', end - apos);
         }
 
         /* If any argument text remains, print it within quotes. */
-        if (*apos) {
-            fprintf(os, "\'%s\'", apos);
+        if (apos != end) {
+            fputc('\'', out);
+            fwrite(apos, sizeof(*apos), end - apos, out);
+            fputc('\'', out);
         }
     }
+    trycmd_obuf_flush(&obuf);
 }
 
 void trycmd_print_argv(const char* const prefix, char* argv[], FILE* const os) {
+    struct trycmd_obuf obuf;
+    FILE* out;
+
     /* Check arguments. */
     assert("Unexpected NULL prefix" && (prefix != NULL));
     assert("Unexpected NULL argv" && (argv != NULL));
     assert("Unexpected NULL os" && (os != NULL));
 
-    /* Print the prefix. */
-    fputs(prefix, os);
+    /* Print the prefix, rendering the whole list to be written at once. */
+    out = trycmd_obuf_open(&obuf, os);
+    fputs(prefix, out);
 
     /* Print any arguments. */
     for (; *argv != NULL; ++argv) {
-        fputc(' ', os);
-        trycmd_pretty_print_arg(*argv, os);
+        fputc(' ', out);
+        trycmd_pretty_print_arg(*argv, out);
     }
-    
+
     /* Finish with a newline. */
-    fputc('\n', os);
+    fputc('\n', out);
+    trycmd_obuf_flush(&obuf);
 }
 
 /* EOF */
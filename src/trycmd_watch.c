@@ -0,0 +1,544 @@
+/**
+ * \file      trycmd_watch.c
+ * \brief     Run a subcommand again upon each change to the paths watched.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+#include <assert.h>        /* assert. */
+#include <dirent.h>        /* DIR, opendir, readdir, closedir, DT_*. */
+#include <errno.h>         /* errno. */
+#include <fcntl.h>         /* open, O_*. */
+#include <signal.h>        /* sigset_t, SIGKILL, SIGTERM. */
+#include <stddef.h>        /* size_t. */
+#include <stdint.h>        /* uint32_t, uint64_t. */
+#include <stdio.h>         /* fprintf, stderr. */
+#include <stdlib.h>        /* free, malloc, realloc, EXIT_FAILURE. */
+#include <string.h>        /* memcpy, memset, strerror, strlen. */
+#include <sys/epoll.h>     /* EPOLLIN. */
+#include <sys/inotify.h>   /* inotify_*, IN_*. */
+#include <sys/stat.h>      /* lstat, S_ISDIR. */
+#include <time.h>          /* clock_gettime, CLOCK_REALTIME. */
+#include <unistd.h>        /* close, read. */
+
+/** Those events upon which a watched file or directory has changed. */
+#define TRYCMD_WATCH_EVENTS (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE      \
+                             | IN_DELETE | IN_DELETE_SELF | IN_MODIFY    \
+                             | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO)
+
+/** The progress of a watch, so far. */
+struct trycmd_watch_state {
+    /** The options of every run (which is never retried, nor counted). */
+    struct trycmd_opts opts;
+    int           result;
+    int           stop;
+
+    /** The inotify instance, and the watch of each opts.opt_watch path. */
+    int           inotify_fd;
+    int           roots[TRYCMD_WATCH_MAX];
+
+    /** The path of each watched directory, indexed by its watch. */
+    char**        dirs;
+    size_t        dirs_len;
+
+    /** If non-zero, a change has been seen since the last run started. */
+    int           changed;
+
+    /** If non-zero, changes are still settling (see opt_debounce). */
+    int           settling;
+
+    /** The current run, whose pid is -1 if none is running. */
+    struct trycmd_monitor monitor;
+    struct trycmd_spawn_attr spawn_attr;
+    uint64_t      start_ns;
+    struct timespec started;
+
+    /** If non-zero, the current run has been stopped upon a change. */
+    int           cancelled;
+
+    /** The event loop, upon which every run and change is awaited. */
+    struct trycmd_loop loop;
+    struct trycmd_loop_handler change_handler;
+    struct trycmd_loop_handler timer_handler;
+    struct trycmd_loop_handler kill_handler;
+    struct trycmd_loop_handler signal_handler;
+
+    /** The relay of all output, if have_relay is non-zero. */
+    int           have_relay;
+    struct trycmd_relay relay;
+
+    /** The destination of JSON result records, if have_json is non-zero. */
+    int           have_json;
+    struct trycmd_json json;
+};
+
+/**
+ * Watch the given file or directory and, recursively, every directory
+ * within it (excepting those hidden), recording the path of each.
+ * @return The watch of path, or -1 if it cannot be watched.
+ */
+static int trycmd_watch_add(struct trycmd_watch_state* const state,
+                            const char* const path) {
+    const size_t path_len = strlen(path);
+    struct dirent* entry;
+    DIR* dir;
+    int wd;
+
+    /* Watch path itself, then, should it be a directory, all within. */
+    wd = inotify_add_watch(state->inotify_fd, path, TRYCMD_WATCH_EVENTS);
+    if (wd < 0) {
+        trycmd_debug("trycmd_watch_add: cannot watch %s: %s\n",
+                     path, strerror(errno));
+        return -1;
+    }
+    dir = opendir(path);
+    if (dir == NULL) {
+        return wd;
+    }
+    if ((size_t)wd >= state->dirs_len) {
+        const size_t dirs_len = (size_t)wd * 2 + 16;
+        char** const dirs = realloc(state->dirs, dirs_len * sizeof(*dirs));
+        if (dirs == NULL) {
+            closedir(dir);
+            return wd;
+        }
+        memset(&dirs[state->dirs_len], 0,
+               (dirs_len - state->dirs_len) * sizeof(*dirs));
+        state->dirs     = dirs;
+        state->dirs_len = dirs_len;
+    }
+    free(state->dirs[wd]);
+    state->dirs[wd] = malloc(path_len + 1);
+    if (state->dirs[wd] != NULL) {
+        memcpy(state->dirs[wd], path, path_len + 1);
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        const size_t name_len = strlen(entry->d_name);
+        char* sub_path;
+        struct stat st;
+        if (entry->d_name[0] == '.'
+            || (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)) {
+            continue;  /* Hidden, or neither a directory nor perhaps one. */
+        }
+        sub_path = malloc(path_len + name_len + 2);
+        if (sub_path == NULL) {
+            continue;
+        }
+        memcpy(sub_path, path, path_len);
+        sub_path[path_len] = '/';
+        memcpy(&sub_path[path_len + 1], entry->d_name, name_len + 1);
+        if (entry->d_type == DT_DIR
+            || (lstat(sub_path, &st) == 0 && S_ISDIR(st.st_mode))) {
+            trycmd_watch_add(state, sub_path);
+        }
+        free(sub_path);
+    }
+    closedir(dir);
+    return wd;
+}
+
+/**
+ * Forget a watch, once it has been removed (along with what it watched).
+ */
+static void trycmd_watch_forget(struct trycmd_watch_state* const state,
+                                const int wd) {
+    int idx;
+    if (wd >= 0 && (size_t)wd < state->dirs_len) {
+        free(state->dirs[wd]);
+        state->dirs[wd] = NULL;
+    }
+    for (idx = 0; idx < state->opts.opt_watch_len; ++idx) {
+        if (state->roots[idx] == wd) {
+            state->roots[idx] = -1;
+        }
+    }
+}
+
+/**
+ * Record a run's completion, showing its exit status. A run cancelled upon
+ * a change is shown as such, but not recorded (as JSON, or within the
+ * history), nor is its status returned unless try is then stopped.
+ */
+static void trycmd_watch_finish(struct trycmd_watch_state* const state,
+                                const int exit_status) {
+    struct trycmd_result result;
+    result.exit_status = exit_status;
+    result.attempts    = 1;
+    result.elapsed_ns  = trycmd_clock_ns() - state->start_ns;
+    result.timed_out   = state->monitor.timed_out;
+    result.term_signal = state->monitor.term_signal;
+    result.started     = state->started;
+    result.rusage      = state->monitor.rusage;
+    clock_gettime(CLOCK_REALTIME, &result.ended);
+    memset(&result.tail, 0, sizeof(result.tail));  /* Never kept. */
+    result.cached      = 0;                        /* Never cached. */
+    result.cancelled   = state->cancelled;
+    trycmd_show_result(&state->opts, &result, stderr);
+    if (state->have_relay && trycmd_relay_log(&state->relay) != NULL) {
+        trycmd_show_result(&state->opts, &result, state->relay.log);
+        fflush(state->relay.log);
+    }
+    if (state->have_json && !result.cancelled
+        && trycmd_json_write(&state->json, &state->opts, &result) != 0) {
+        trycmd_debug("trycmd_watch_finish: cannot write JSON: %s\n",
+                     strerror(errno));
+    }
+    if (state->opts.opt_history != NULL && !result.cancelled
+        && trycmd_history_append(state->opts.opt_history, &state->opts,
+                                 &result) != 0) {
+        trycmd_debug("trycmd_watch_finish: cannot append history: %s\n",
+                     strerror(errno));
+    }
+    if (!result.cancelled || state->stop) {
+        state->result = exit_status;
+    }
+    trycmd_loop_set_timer(&state->kill_handler, 0);
+    state->monitor.child.pid   = -1;
+    state->monitor.child.pidfd = -1;
+    state->monitor.timed_out   = 0;
+    memset(&state->monitor.rusage, 0, sizeof(state->monitor.rusage));
+}
+
+static void trycmd_watch_finished(struct trycmd_loop* loop,
+                                  struct trycmd_monitor* monitor);
+
+/**
+ * Stop the current run with the given signal, and kill it should it not
+ * have exited after opts.opt_kill_after (or TRYCMD_WATCH_KILL_AFTER).
+ */
+static void trycmd_watch_stop(struct trycmd_watch_state* const state,
+                              const int signum) {
+    trycmd_debug("trycmd_watch_stop: stopping pid %d\n",
+                 (int)state->monitor.child.pid);
+    trycmd_monitor_signal(&state->monitor, signum);
+    if (trycmd_loop_set_timer(&state->kill_handler,
+                              (state->opts.opt_kill_after > 0)
+                              ? state->opts.opt_kill_after
+                              : TRYCMD_WATCH_KILL_AFTER) != 0) {
+        trycmd_debug("trycmd_watch_stop: cannot set timer: %s\n",
+                     strerror(errno));
+    }
+}
+
+/**
+ * Handle a stopped run which has yet to exit, by killing it.
+ */
+static void trycmd_watch_kill(struct trycmd_loop* const loop,
+                              struct trycmd_loop_handler* const handler,
+                              const uint32_t events) {
+    struct trycmd_watch_state* const state = handler->data;
+    (void) loop;
+    (void) events;
+    if (state->monitor.child.pid > 0) {
+        trycmd_debug("trycmd_watch_kill: killing pid %d\n",
+                     (int)state->monitor.child.pid);
+        trycmd_monitor_signal(&state->monitor, SIGKILL);
+    }
+}
+
+/**
+ * Start a run, first watching again any path replaced since the last.
+ */
+static void trycmd_watch_start(struct trycmd_watch_state* const state) {
+    struct trycmd_child child;
+    int result;
+    int idx;
+
+    for (idx = 0; idx < state->opts.opt_watch_len; ++idx) {
+        if (state->roots[idx] < 0) {
+            state->roots[idx] = trycmd_watch_add(state,
+                                                 state->opts.opt_watch[idx]);
+        }
+    }
+    state->changed   = 0;
+    state->cancelled = 0;
+    state->start_ns  = trycmd_clock_ns();
+    clock_gettime(CLOCK_REALTIME, &state->started);
+    if ((result = trycmd_start_subcommand(&state->opts, &state->spawn_attr,
+                                          &child)) != 0
+        || (result = trycmd_monitor_start(&state->loop, &state->monitor,
+                                          &state->opts, &child,
+                                          trycmd_watch_finished,
+                                          state)) != 0) {
+        if (result < 0) {
+            fprintf(stderr, _("try: cannot wait for command: %s\n"),
+                    strerror(errno));
+            result = EXIT_FAILURE;
+        }
+        trycmd_watch_finish(state, result);
+    }
+}
+
+/**
+ * Handle a run's completion then, should changes since have settled,
+ * start the next.
+ */
+static void trycmd_watch_finished(struct trycmd_loop* const loop,
+                                  struct trycmd_monitor* const monitor) {
+    struct trycmd_watch_state* const state = monitor->data;
+    if (state->have_relay) {
+        trycmd_relay_flush(&state->relay);
+    }
+    trycmd_watch_finish(state, monitor->exit_status);
+    if (state->stop) {
+        trycmd_loop_stop(loop);
+    } else if (state->changed && !state->settling) {
+        trycmd_watch_start(state);
+    }
+}
+
+/**
+ * Handle changes to the watched paths, watching any directory added
+ * meanwhile. The current run (if any) is stopped, and the next is
+ * deferred until the changes have settled.
+ */
+static void trycmd_watch_changed(struct trycmd_loop* const loop,
+                                 struct trycmd_loop_handler* const handler,
+                                 const uint32_t events) {
+    struct trycmd_watch_state* const state = handler->data;
+    union {
+        struct inotify_event event;
+        char bytes[4096];
+    } buffer;
+    int changed = 0;
+    ssize_t len;
+    (void) loop;
+    (void) events;
+
+    /* Read every pending event. */
+    while ((len = read(state->inotify_fd, buffer.bytes,
+                       sizeof(buffer.bytes))) > 0) {
+        ssize_t offset = 0;
+        while (offset < len) {
+            const struct inotify_event* const event =
+                (const struct inotify_event*)&buffer.bytes[offset];
+            const char* const dir_path =
+                (event->wd >= 0 && (size_t)event->wd < state->dirs_len)
+                ? state->dirs[event->wd] : NULL;
+            offset += (ssize_t)(sizeof(*event) + event->len);
+            if (event->mask & IN_IGNORED) {
+                trycmd_watch_forget(state, event->wd);
+            } else if (event->mask & IN_Q_OVERFLOW) {
+                changed = 1;
+            } else if (event->len == 0 || event->name[0] != '.') {
+                changed = 1;
+                if ((event->mask & IN_ISDIR)
+                    && (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    && dir_path != NULL && event->len > 0) {
+                    /* A directory was added: watch all within it too. */
+                    const size_t dir_len  = strlen(dir_path);
+                    const size_t name_len = strlen(event->name);
+                    char* const sub_path  = malloc(dir_len + name_len + 2);
+                    if (sub_path != NULL) {
+                        memcpy(sub_path, dir_path, dir_len);
+                        sub_path[dir_len] = '/';
+                        memcpy(&sub_path[dir_len + 1], event->name,
+                               name_len + 1);
+                        trycmd_watch_add(state, sub_path);
+                        free(sub_path);
+                    }
+                }
+            }
+        }
+    }
+    if (!changed || state->stop) {
+        return;
+    }
+
+    /*
+     * Stop the current run, then (re)start the wait for changes to settle,
+     * so that a burst of changes is coalesced into a single run.
+     */
+    state->changed = 1;
+    if (state->monitor.child.pid > 0 && !state->cancelled) {
+        trycmd_watch_stop(state, SIGTERM);
+        state->cancelled = 1;
+    }
+    if (trycmd_loop_set_timer(&state->timer_handler,
+                              (state->opts.opt_debounce > 0)
+                              ? state->opts.opt_debounce : 1) != 0) {
+        trycmd_debug("trycmd_watch_changed: cannot set timer: %s\n",
+                     strerror(errno));
+    }
+    state->settling = 1;
+}
+
+/**
+ * Handle the end of a burst of changes, by starting the next run (unless
+ * the last is still being stopped, in which case it follows that).
+ */
+static void trycmd_watch_settled(struct trycmd_loop* const loop,
+                                 struct trycmd_loop_handler* const handler,
+                                 const uint32_t events) {
+    struct trycmd_watch_state* const state = handler->data;
+    (void) loop;
+    (void) events;
+    state->settling = 0;
+    if (!state->stop && state->changed && state->monitor.child.pid < 0) {
+        trycmd_watch_start(state);
+    }
+}
+
+/**
+ * Forward each terminating signal received by try to the current run
+ * (within a process group of its own), and start no more. A run not yet
+ * stopped is killed should it not exit (see trycmd_watch_stop).
+ */
+static void trycmd_watch_forward(struct trycmd_loop* const loop,
+                                 struct trycmd_loop_handler* const handler,
+                                 const uint32_t events) {
+    struct trycmd_watch_state* const state = handler->data;
+    int signum;
+    (void) events;
+    while ((signum = trycmd_loop_read_signal(handler)) > 0) {
+        if (state->monitor.child.pid > 0 && !state->stop
+            && !state->cancelled) {
+            trycmd_watch_stop(state, signum);
+        } else {
+            trycmd_monitor_signal(&state->monitor, signum);
+        }
+        state->stop = 1;
+    }
+    if (state->monitor.child.pid < 0) {
+        trycmd_loop_stop(loop);
+    }
+}
+
+int trycmd_run_watch(const struct trycmd_opts* const opts) {
+    struct trycmd_watch_state state;
+    sigset_t signals;
+    size_t idx;
+    int null_fd;
+
+    /* Check arguments. */
+    assert("Unexpected NULL opts" && (opts != NULL));
+    assert("Unexpected no opt_watch" && (opts->opt_watch_len > 0));
+    memset(&state, 0, sizeof(state));
+    state.opts = *opts;
+    state.opts.opt_retry = 0;  /* Runs are never retried, */
+    state.opts.opt_perf  = 0;  /* nor counted (see trycmd_perf_open). */
+    state.monitor.child.pid   = -1;
+    state.monitor.child.pidfd = -1;
+
+    /*
+     * Open the event loop, a null input for every run, and the inotify
+     * instance upon which each path is watched.
+     */
+    state.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (state.inotify_fd < 0 || null_fd < 0
+        || trycmd_loop_open(&state.loop) != 0) {
+        fprintf(stderr, _("try: cannot watch: %s\n"), strerror(errno));
+        if (null_fd >= 0) {
+            close(null_fd);
+        }
+        if (state.inotify_fd >= 0) {
+            close(state.inotify_fd);
+        }
+        return EXIT_FAILURE;
+    }
+    for (idx = 0; idx < (size_t)opts->opt_watch_len; ++idx) {
+        state.roots[idx] = trycmd_watch_add(&state, opts->opt_watch[idx]);
+        if (state.roots[idx] < 0) {
+            fprintf(stderr, _("try: %s: %s\n"), opts->opt_watch[idx],
+                    strerror(errno));
+            state.result = EXIT_FAILURE;
+            state.stop   = 1;
+        }
+    }
+    if (opts->opt_log != NULL
+        || opts->opt_timestamps != trycmd_timestamps_none) {
+        if (trycmd_relay_open(&state.loop, &state.relay, opts->opt_log,
+                              NULL, NULL) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"),
+                    (opts->opt_log != NULL) ? opts->opt_log : N_("output"),
+                    strerror(errno));
+            state.result = EXIT_FAILURE;
+            state.stop   = 1;
+        } else {
+            state.relay.timestamps = opts->opt_timestamps;
+            state.have_relay = 1;
+        }
+    }
+    if (opts->opt_json_out != NULL) {
+        if (trycmd_json_open(&state.json, opts->opt_json_out) != 0) {
+            fprintf(stderr, _("try: %s: %s\n"), opts->opt_json_out,
+                    strerror(errno));
+            state.result = EXIT_FAILURE;
+            state.stop   = 1;
+        } else {
+            state.have_json = 1;
+        }
+    }
+
+    /*
+     * Each run is given its own process group (unless interactive), so
+     * that it may be stopped whole upon a change, and is forwarded
+     * terminating signals.
+     */
+    trycmd_spawn_attr_init(&state.spawn_attr, &state.opts);
+    state.spawn_attr.stdio[0]   = null_fd;
+    state.spawn_attr.new_pgroup = !opts->opt_interactive;
+    state.spawn_attr.sigmask    = &state.loop.saved_mask;
+    if (state.have_relay) {
+        state.spawn_attr.stdio[1] = state.relay.streams[0].child_fd;
+        state.spawn_attr.stdio[2] = state.relay.streams[1].child_fd;
+    }
+    trycmd_forwarded_signals(&signals);
+    if (!state.stop
+        && (trycmd_loop_add(&state.loop, &state.change_handler,
+                            state.inotify_fd, EPOLLIN, trycmd_watch_changed,
+                            &state) != 0
+            || trycmd_loop_add_timer(&state.loop, &state.timer_handler, 0,
+                                     trycmd_watch_settled, &state) != 0
+            || trycmd_loop_add_timer(&state.loop, &state.kill_handler, 0,
+                                     trycmd_watch_kill, &state) != 0
+            || trycmd_loop_add_signals(&state.loop, &state.signal_handler,
+                                       &signals, trycmd_watch_forward,
+                                       &state) != 0)) {
+        fprintf(stderr, _("try: cannot watch: %s\n"), strerror(errno));
+        state.result = EXIT_FAILURE;
+        state.stop   = 1;
+    }
+    trycmd_debug("trycmd_run_watch: %d path(s), debounce %lums\n",
+                 opts->opt_watch_len, opts->opt_debounce);
+
+    /* Run once, then again upon each change until stopped. */
+    if (!state.stop) {
+        trycmd_watch_start(&state);
+        if (trycmd_loop_run(&state.loop) != 0
+            && state.monitor.child.pid > 0) {
+            /* Not expected, but cannot continue. */
+            trycmd_monitor_cancel(&state.loop, &state.monitor);
+            trycmd_watch_finish(&state, EXIT_FAILURE);
+        }
+    }
+
+    /* Release everything. */
+    if (state.have_relay) {
+        trycmd_relay_close(&state.relay);
+    }
+    if (state.have_json) {
+        trycmd_json_close(&state.json);
+    }
+    trycmd_loop_remove(&state.loop, &state.change_handler);
+    trycmd_loop_remove(&state.loop, &state.timer_handler);
+    trycmd_loop_remove(&state.loop, &state.kill_handler);
+    trycmd_loop_remove(&state.loop, &state.signal_handler);
+    trycmd_loop_close(&state.loop);
+    for (idx = 0; idx < state.dirs_len; ++idx) {
+        free(state.dirs[idx]);
+    }
+    free(state.dirs);
+    close(state.inotify_fd);
+    close(null_fd);
+    trycmd_debug("trycmd_run_watch: returning %d\n", state.result);
+    return state.result;
+}
+
+/* EOF */
@@ -0,0 +1,20 @@
+/**
+ * \file      tryd.c
+ * \brief     Keep try resident, to run commands for each try client.
+ * \details   Defines the daemon's main entry point.
+ *
+ * \author    M. J. Tryhorn
+ * \date      2026-Oct-15
+ * \version   1.0
+ * \copyright MIT License (see LICENSE).
+ */
+
+#include "trycmd_config.h"
+#include "trycmd.h"
+
+/* Daemon entry point. */
+int main(int argc, char* argv[]) {
+    return trycmd_daemon_main(argc, argv);
+}
+
+/* EOF */